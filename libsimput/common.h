@@ -36,6 +36,7 @@
 #include <string.h>
 #include <assert.h>
 #include <ctype.h>
+#include <stdint.h>
 #include <fftw3.h> // FFTW3 library for Fast Fourier Transform.
 
 #include "arf.h"
@@ -60,6 +61,53 @@
 // Value to set this variable to in order to disable warnings
 #define SIMPUT_NOWARN_VALUE "YES"
 
+// Environment variable specifying a file for FFTW wisdom
+#define SIMPUT_FFTW_WISDOM_ENVVAR "SIMPUT_FFTW_WISDOM"
+
+// Number of rows read at once from a photon list
+#define SIMPUT_PHLIST_BLOCKROWS (100000)
+// Default maximal number of rows of a photon list to be kept in
+// memory completely (required for fast random access), see
+// setSimputPhListMaxMemRows
+#define SIMPUT_PHLIST_MAXMEMROWS (20000000)
+// Environment variable specifying the maximal number of rows of a
+// photon list to be kept in memory completely
+#define SIMPUT_PHLIST_MAXMEMROWS_ENVVAR "SIMPUT_PHLIST_MAXMEMROWS"
+// Distance between the rows in the time index of a photon list (must
+// not exceed SIMPUT_PHLIST_BLOCKROWS)
+#define SIMPUT_PHLIST_INDEXSTEP (1024)
+
+// Size of the memory blocks holding the strings of a string pool
+#define SIMPUT_STRPOOL_BLOCKSIZE (1048576)
+
+// Default maximal numbers of extensions kept in the internal buffers
+// (0 for unlimited), see setSimputCacheCapacity
+#define SIMPUT_CACHECAP_MIDPSPEC (0)
+#define SIMPUT_CACHECAP_IMAGE (1000)
+#define SIMPUT_CACHECAP_PHLIST (100)
+#define SIMPUT_CACHECAP_LC (1)
+#define SIMPUT_CACHECAP_PSD (100)
+
+// Environment variable specifying the memory budget of the internal
+// buffers of a catalog [bytes], optionally with the suffix k, M, or G
+#define SIMPUT_CACHE_BUDGET_ENVVAR "SIMPUT_CACHE_BUDGET"
+// Maximal number of buffers sharing a common memory budget
+#define SIMPUT_CACHEMGR_MAXINDICES (8)
+
+// Number of mission-independent spectra convolved with the ARF at once
+#define SIMPUT_CONV_BLOCKSIZE (64)
+
+// Number of random numbers obtained at once from a block generator
+#define SIMPUT_RND_BLOCKSIZE (256)
+
+// Maximal number of light curve bins passed sequentially while
+// drawing a photon time before the cumulative table is searched
+#define SIMPUT_LC_MAXWALK (8)
+
+// Environment variable specifying a directory for the files caching
+// spectral distributions across runs
+#define SIMPUT_SPEC_CACHE_ENVVAR "SIMPUT_SPEC_CACHE"
+
 
 
 /** Chatter level:
@@ -185,53 +233,348 @@ struct SimputSrcBuffer {
   // source is not contained in the storage, the value in the array
   // is -1.
   long* rowmap;
+
+  // Table with all sources of the catalog loaded at once by
+  // loadCacheAllSimputSrc. If it is present, the sources are
+  // returned from this table and the cache above is not used. The
+  // strings of the sources are contained in the string pool of the
+  // catalog.
+  long ntable;
+  SimputSrc* table;
 };
 
 
-struct SimputExttypeBuffer {
-  int type; // HDU type.
-  char* fileref; // Corresponding file reference.
-  struct SimputExttypeBuffer* left;
-  struct SimputExttypeBuffer* right;
+/** Pool of strings, where each distinct string is stored only once
+    and is identified by a unique number. The strings are placed one
+    after the other in large memory blocks. A hash table with open
+    addressing refers to them. */
+struct SimputStrPool {
+  long nstrs;  // Number of distinct strings in the pool.
+  char** strs; // Strings ordered by their identifiers.
+  long nslots; // Size of the hash table (power of 2).
+  long* slots; // Hash table with the identifiers of the strings (-1 if unused).
+  long nblocks; // Number of memory blocks.
+  char** blocks; // Memory blocks holding the strings.
+  char* blockpos; // Next unused byte in the last block.
+  long blockfree; // Unused bytes at the end of the last block.
 };
 
 
-struct SimputSpecBuffer {
-  SimputSpec* spectrum; // Cache for the spectrum.
-  struct SimputSpecBuffer* left;
-  struct SimputSpecBuffer* right;
+/** Entry of a SimputCacheIndex. */
+struct SimputCacheEntry {
+  long refid; // Identifier of the file reference of the extension.
+  void* obj;  // Cached extension.
+  long size;  // Memory occupied by the extension at the last access [bytes].
+  unsigned long stamp; // Time of the last access (see SimputCacheManager).
+
+  // Neighbours in the list ordered by the time of the last access
+  // (-1 at the ends of the list). For unused entries, next refers to
+  // the next unused entry.
+  long prev, next;
 };
 
 
-struct SimputMIdpSpecBuffer {
-  SimputMIdpSpec* spectrum; // Cache for the spectrum.
-  struct SimputMIdpSpecBuffer* left;
-  struct SimputMIdpSpecBuffer* right;
+/** Cache for extensions identified by the identifiers of their file
+    references. The entries are found via a hash table with open
+    addressing and linear probing. If the capacity is exhausted, the
+    least recently used entry is released. */
+struct SimputCacheIndex {
+  long nentries; // Current number of extensions in the cache.
+  long capacity; // Maximum number of extensions (0 for unlimited).
+
+  long nalloc; // Number of allocated entries.
+  struct SimputCacheEntry* entries;
+  long freeentry; // First unused entry (-1 if none).
+
+  int slotbits; // Binary logarithm of the size of the hash table.
+  long* slots;  // Hash table with the indices of the entries (-1 if unused).
+
+  // Most and least recently used entry (-1 if the cache is empty).
+  long first, last;
+
+  // Number of extensions released from the cache so far. References
+  // to extensions obtained before the last release may be invalid.
+  long nevicted;
+
+  // Numbers of searches, in which the extension has been found or
+  // not.
+  long nhits, nmisses;
+
+  // Function releasing an extension (NULL if nothing to be done).
+  void (*release)(void* obj, int* const status);
+
+  // Function determining the memory occupied by an extension [bytes]
+  // together with an additional argument passed to it (NULL if the
+  // memory is not accounted).
+  long (*size)(const void* obj, const void* arg);
+  const void* sizearg;
+  long nbytes; // Memory occupied by all extensions in the cache [bytes].
+
+  // Number of extensions, which are kept irrespective of the memory
+  // budget.
+  long minentries;
+
+  // Manager of the memory budget (NULL if none).
+  struct SimputCacheManager* mgr;
+};
+
+
+/** Common memory budget of several caches. If the budget is exceeded,
+    the least recently used extension among all registered caches is
+    released. Extensions of different caches are compared by the time
+    stamps of their last access, which are taken from a common
+    clock. */
+struct SimputCacheManager {
+  long budget; // Memory budget [bytes] (0 for unlimited).
+  long nbytes; // Memory occupied by the registered caches [bytes].
+  unsigned long clock; // Number of accesses to the registered caches.
+
+  int nindices; // Number of registered caches.
+  struct SimputCacheIndex* indices[SIMPUT_CACHEMGR_MAXINDICES];
 };
 
 
 struct SimputLCBuffer {
-  long nlcs; // Current number of light curves in the cache.
-  long clc;  // Index of next position in the cache that will be used.
-  SimputLC** lcs; // Cache for the light curves.
+  // Cache for the light curves loaded from files.
+  struct SimputCacheIndex* lcs;
+
+  // Cache for the light curves generated from PSDs, identified by
+  // the SRC_ID. Each source has its own realization. If it is
+  // released, a new independent realization is generated, when the
+  // source is accessed again.
+  struct SimputCacheIndex* psdlcs;
+};
+
+
+/** Flux densities of several mission-independent spectra loaded
+    from the same extension, which are stored as rows of a dense
+    matrix. The spectra refer to their rows and to the common energy
+    grid instead of holding own arrays. Only spectra with a deviating
+    energy grid hold an own energy array. The matrix is released
+    together with the last reference to it. */
+struct SimputMIdpSpecMatrix {
+  long nspec;    // Number of rows.
+  long nentries; // Number of points of the energy grid.
+  float* energy; // Common energy grid [keV].
+  float* fluxdensity; // Flux densities [photons/cm**2/keV].
+
+  long nrefs; // Number of spectra referring to the matrix.
+};
+
+
+/** Weights for the convolution of mission-independent spectra
+    defined on a particular energy grid with the ARF. ARF bin ii
+    receives contributions from the spectral points first[ii], ...,
+    first[ii]+offset[ii+1]-offset[ii]-1, which are weighted with the
+    values starting at weight[offset[ii]]. */
+struct SimputARFGrid {
+  struct ARF* arf; // ARF, which the weights have been determined for.
+
+  long nentries; // Number of points of the energy grid.
+  float* energy; // Energy grid of the spectra [keV].
+
+  long* first;   // First contributing spectral point of each ARF bin.
+  long* offset;  // Offset of the weights of each ARF bin.
+  float* weight; // Energy width times effective area [keV cm^2].
+
+  int partial; // Flag whether the ARF range is not fully covered.
+};
+
+
+/** Integrated flux of a light curve, from which the photon times are
+    obtained by inversion. For periodic light curves the table covers
+    the period with number 0. Due to the DPERIOD the widths of the
+    bins and therefore also their integrals are scaled by a factor of
+    exp(n*DPERIOD) in period n. */
+struct SimputLCRateTable {
+  long nbins; // Number of bins of the light curve (nentries-1).
+
+  // Integral of the flux divided by FLUXSCAL from the beginning of
+  // the light curve or the period respectively up to the beginning
+  // of each bin [s] (nbins+1 entries).
+  double* cumflux;
+
+  int periodic;  // Flag whether the light curve is periodic.
+  double dscale; // DPERIOD, if it is relevant, otherwise 0.
 };
 
 
-struct SimputPSDBuffer {
-  long npsds; // Current number of PSDs in the cache.
-  SimputPSD** psds; // Cache for the PSDs.
+/** Spectra referred to in the bins of a light curve with a SPECTRUM
+    column. The references are resolved with respect to the location
+    of the light curve, when the table is set up. The spectral
+    distributions are obtained on first use of a bin and remain valid
+    as long as no spectra are released from the buffer of the
+    catalog. */
+struct SimputLCSpecTable {
+  long nbins; // Number of bins of the light curve (nentries).
+
+  // References to the spectra in the table of references of the
+  // catalog and their extension types.
+  char** ref;
+  int* type;
+
+  // Spectral distributions (NULL if not obtained yet).
+  SimputSpec** spec;
+
+  // Number of spectra released from the buffer of the catalog, when
+  // the spectral distributions were obtained.
+  long evicted;
+
+  // Times of the bins [s] and reciprocal widths of the intervals
+  // between them [1/s], which determine the weights for the
+  // interpolation between the spectra of two adjacent bins.
+  double* time;
+  double* rwidth;
 };
 
 
-struct SimputImgBuffer {
-  long nimgs; // Current number of images in the cache.
-  SimputImg** imgs; // Cache for the images.
+/** Position in a light curve reached by the last photon time drawn
+    for a source. If the next photon time is drawn starting from
+    this time, the position does not have to be searched. */
+struct SimputLCCursor {
+  const SimputLC* lc; // Light curve, NULL if not valid.
+  double time;   // Time of the last photon [s].
+  double mjdref; // MJDREF the time refers to [d].
+  long long nperiods; // Number of periods.
+  long bin; // Bin of the light curve.
 };
 
 
-struct SimputPhListBuffer {
-  long nphls; // Current number of photon lists in the cache.
-  SimputPhList** phls; // Cache for the photon lists.
+/** Cache of spectral distributions on disk, which can be used by
+    subsequent runs instead of convolving the mission-independent
+    spectra with the ARF again. For each ARF a separate file is used,
+    whose name contains a hash of the ARF contents. The file starts
+    with a header (magic string, ARF hash, number of ARF bins), which
+    is followed by records consisting of the length of the record,
+    the modification time (seconds and nanoseconds), the size, and
+    the inode number of the FITS file containing the
+    mission-independent spectrum, the length of the file reference,
+    the file reference, and the distribution. All values
+    are aligned to 8 bytes. New records are appended to the file. */
+struct SimputSpecDiskCache {
+  char* dirname; // Directory containing the cache files.
+
+  struct ARF* arf; // ARF, which the cache file has been opened for.
+  char* filename;  // Cache file for this ARF.
+  void* map;       // Contents of the file mapped into memory.
+  size_t mapsize;  // Size of the mapped contents [bytes].
+  int fd;          // File descriptor for appending records.
+  int failed;      // Flag whether the file cannot be used.
+
+  // Valid records contained in the mapped file indexed by the
+  // identifiers of the file references. Records appended during
+  // the current run are contained with a NULL pointer.
+  struct SimputCacheIndex* records;
+
+  // Result of the last query of the modification time, the size,
+  // and the inode number of a FITS file.
+  char statfile[SIMPUT_MAXSTR];
+  int64_t statvals[4];
+  int statvalid;
+};
+
+
+/** Cache for the FFTW plans used to generate light curves from PSDs.
+    Each plan is kept together with the aligned input and output
+    buffers it has been created for. */
+struct SimputFFTWBuffer {
+  long nplans; // Current number of plans in the cache.
+  long cplan;  // Index of next position in the cache that will be used.
+  long* length; // Transform lengths of the plans (-1 for unused slots).
+  int* nthreads; // Numbers of threads used by the plans.
+  fftw_plan* plans; // Cache for the plans.
+  double** in;  // Input buffers of the plans.
+  double** out; // Output buffers of the plans.
+
+  // File for FFTW wisdom. If specified, the wisdom is imported before
+  // the first plan is created and exported after each new plan, which
+  // is created with FFTW_MEASURE instead of FFTW_ESTIMATE.
+  char* wisdomfile;
+  int wisdomloaded;
+};
+
+
+/** References of a source to its timing, spectrum, and image
+    extensions. The extension types are determined once. The pointers
+    to the extensions in the catalog buffers are filled on first
+    use. */
+struct SimputSrcResolved {
+  int timetype; // Extension type of the timing reference.
+  int spectype; // Extension type of the spectrum reference.
+  int imagtype; // Extension type of the image reference.
+
+  char* timeref; // Reference to the timing extension.
+  char* specref; // Reference to the spectrum extension.
+  char* imagref; // Reference to the image extension.
+
+  // Flag whether the light curve refers to individual spectra or
+  // images in its bins. In that case the spectrum and image
+  // references depend on time and are not resolved.
+  int varrefs;
+
+  // Light curve in the catalog buffer and the number of light curves
+  // released from the buffer at the time it was obtained.
+  SimputLC* lc;
+  long lcreleased;
+
+  SimputPhList* timephl; // Photon list providing the photon times.
+  SimputPhList* phl; // Photon list providing energies or positions.
+  SimputSpec* spec; // Spectral distribution.
+  SimputImg* img; // Image.
+
+  // Number of extensions released from the spectrum, image, and
+  // photon list buffers at the time the pointers above were obtained.
+  long evicted;
+
+  // Position of the last photon time drawn from the light curve.
+  // It is not used in a shared catalog.
+  struct SimputLCCursor lccursor;
+
+  // WCS of the image adapted to the position and IMGSCAL of the source,
+  // as well as cosine and sine of IMGROTA.
+  struct wcsprm* wcs;
+  double cosimgrota, sinimgrota;
+};
+
+
+/** State of an independent random number stream (xoshiro256++). */
+struct SimputRndStream {
+  uint64_t s[4];
+};
+
+
+/** Random number streams of the individual sources of a catalog (see
+    setSimputSrcRndSeed). The stream of a source is derived from the
+    seed and the SRC_ID, when the source is used for the first
+    time. */
+struct SimputSrcRndStreams {
+  unsigned long long seed;
+
+  // Streams indexed by the SRC_ID.
+  struct SimputCacheIndex* streams;
+
+  // Stream of the source, for which photons are currently produced
+  // (NULL if none).
+  struct SimputRndStream* current;
+};
+
+
+/** Binary min-heap over the pre-computed photons of all sources,
+    ordered by photon time (ties resolved by the source index). */
+struct SimputPhotonQueue {
+  long nsrcs; // Number of sources in the catalog.
+  long nheap; // Current number of sources in the heap.
+
+  // Array of pre-computed photons the heap refers to.
+  SimputPhoton* photons;
+
+  // Heap of source indices (starting at 0).
+  long* heap;
+
+  // Position of each source in the heap. If the source is not
+  // contained in the heap, because it cannot produce any further
+  // photons, the value in the array is -1.
+  long* pos;
 };
 
 
@@ -244,59 +587,217 @@ struct SimputSrcBuffer* newSimputSrcBuffer(int* const status);
 void freeSimputSrcBuffer(struct SimputSrcBuffer** sb);
 
 
-struct SimputExttypeBuffer* newSimputExttypeBuffer(int* const status);
-void freeSimputExttypeBuffer(struct SimputExttypeBuffer** eb);
-int searchSimputExttypeBuffer(void* buffer, const char* const filename);
-void insertSimputExttypeBuffer(void** buffer,
-			       const char* const filename,
-			       const int type,
-			       int* const status);
-
-
-struct SimputMIdpSpecBuffer* newSimputMIdpSpecBuffer(int* const status);
-void freeSimputMIdpSpecBuffer(struct SimputMIdpSpecBuffer** sb);
-SimputMIdpSpec* searchSimputMIdpSpecBuffer(void* buffer,
-					   const char* const filename);
-void insertSimputMIdpSpecBuffer(void** buffer,
-				SimputMIdpSpec* const spec,
-				int* const status);
-void buildSimputMIdpSpecBuffer(void** buffer,
-			       SimputMIdpSpec** const spectra,
-			       const long nspectra,
-			       const int sorted,
-			       int* const status);
+struct SimputStrPool* newSimputStrPool(int* const status);
+void freeSimputStrPool(struct SimputStrPool** sp);
+/** Return the identifier of the string in the pool. If the string is
+    not contained yet, it is inserted. */
+long internSimputStrPoolId(struct SimputStrPool* const sp,
+			   const char* const str,
+			   int* const status);
+/** Return the copy of the string contained in the pool. If the
+    string is not contained yet, it is inserted. */
+char* internSimputStrPool(struct SimputStrPool* const sp,
+			  const char* const str,
+			  int* const status);
+
+
+struct SimputCacheIndex* newSimputCacheIndex(const long capacity,
+					     void (*release)(void*, int* const),
+					     int* const status);
+void freeSimputCacheIndex(struct SimputCacheIndex** const ci,
+			  int* const status);
+/** Return the extension with the specified identifier or NULL, if it
+    is not contained in the cache. The extension is marked as most
+    recently used. */
+void* searchSimputCacheIndex(struct SimputCacheIndex* const ci,
+			     const long refid);
+/** Insert an extension, which must not be contained in the cache
+    yet. If evict is set and the capacity is exhausted, the least
+    recently used extensions are released before. */
+void insertSimputCacheIndex(struct SimputCacheIndex* const ci,
+			    const long refid,
+			    void* const obj,
+			    const int evict,
+			    int* const status);
+/** Release the extension with the specified identifier, if it is
+    contained in the cache. Like an eviction, this invalidates all
+    references to the extension and is counted as such. */
+void removeSimputCacheIndex(struct SimputCacheIndex* const ci,
+			    const long refid,
+			    int* const status);
+/** Return 1 if an extension with the specified identifier is
+    contained in the cache, otherwise 0. In contrast to
+    searchSimputCacheIndex the order and the statistics of the cache
+    are not modified. */
+int containsSimputCacheIndex(const struct SimputCacheIndex* const ci,
+			     const long refid);
+
+
+/** The following functions create the caches for the individual
+    extension types, which release the extensions and determine their
+    memory consumption appropriately. The extension types are stored
+    as (void*)(intptr_t)type. The size of the spectra is derived from
+    the ARF of the specified catalog. */
+struct SimputCacheIndex* newSimputExttypeBuffer(int* const status);
+struct SimputCacheIndex* newSimputMIdpSpecBuffer(const long capacity,
+						 int* const status);
+struct SimputCacheIndex* newSimputSpecBuffer(const long capacity,
+					     const SimputCtlg* const cat,
+					     int* const status);
+struct SimputCacheIndex* newSimputPSDBuffer(const long capacity,
+					    int* const status);
+struct SimputCacheIndex* newSimputImgBuffer(const long capacity,
+					    int* const status);
+struct SimputCacheIndex* newSimputPhListBuffer(const long capacity,
+					       int* const status);
 
 
 SimputSpec* newSimputSpec(int* const status);
 void freeSimputSpec(SimputSpec** const spec);
 
 
-struct SimputSpecBuffer* newSimputSpecBuffer(int* const status);
-void freeSimputSpecBuffer(struct SimputSpecBuffer** sb);
-SimputSpec* searchSimputSpecBuffer(void* buffer,
-				   const char* const filename);
-void insertSimputSpecBuffer(void** buffer,
-			    SimputSpec* const spec,
-			    int* const status);
+struct SimputSrcResolved* newSimputSrcResolved(int* const status);
+void freeSimputSrcResolved(struct SimputSrcResolved** res);
+
+
+/** Create a light curve buffer. The capacity applies to the light
+    curves loaded from files, the PSD capacity to the ones generated
+    from PSDs. */
+struct SimputLCBuffer* newSimputLCBuffer(const long capacity,
+					 const long psdcapacity,
+					 int* const status);
+void freeSimputLCBuffer(struct SimputLCBuffer** sb, int* const status);
+
+
+/** Create a manager for the specified memory budget [bytes]. If the
+    budget is negative, it is taken from the environment variable
+    SIMPUT_CACHE_BUDGET (unlimited if not set). */
+struct SimputCacheManager* newSimputCacheManager(const long budget,
+						 int* const status);
+void freeSimputCacheManager(struct SimputCacheManager** mgr);
+/** Register a cache with the manager. The memory budget applies to
+    the cache from now on. */
+void registerSimputCacheIndex(struct SimputCacheManager* const mgr,
+			      struct SimputCacheIndex* const ci,
+			      int* const status);
+/** Remove a cache from its manager. */
+void unregisterSimputCacheIndex(struct SimputCacheIndex* const ci);
+/** Release the least recently used extensions of all registered
+    caches, until the occupied memory together with the specified
+    additional amount [bytes] is within the budget. */
+void reduceSimputCacheManager(struct SimputCacheManager* const mgr,
+			      const long nbytes,
+			      int* const status);
+/** Register a cache of the catalog with its manager, which is created
+    if necessary. Caches of a shared catalog and of per-thread
+    contexts are not registered, since they are accessed by several
+    threads. */
+void manageSimputCtlgCache(SimputCtlg* const cat,
+			   void* const buffer,
+			   int* const status);
+
 
-struct SimputLCBuffer* newSimputLCBuffer(int* const status);
-void freeSimputLCBuffer(struct SimputLCBuffer** sb);
+struct SimputFFTWBuffer* newSimputFFTWBuffer(int* const status);
+void freeSimputFFTWBuffer(struct SimputFFTWBuffer** fb);
 
 
-struct SimputPSDBuffer* newSimputPSDBuffer(int* const status);
-void freeSimputPSDBuffer(struct SimputPSDBuffer** sb);
+void freeSimputARFGrid(struct SimputARFGrid** ag);
 
 
-struct SimputImgBuffer* newSimputImgBuffer(int* const status);
-void freeSimputImgBuffer(struct SimputImgBuffer** sb);
+void freeSimputLCRateTable(struct SimputLCRateTable** rt);
 
 
-struct SimputPhListBuffer* newSimputPhListBuffer(int* const status);
-void freeSimputPhListBuffer(struct SimputPhListBuffer** pb, int* const status);
+struct SimputLCSpecTable* newSimputLCSpecTable(const long nbins,
+					       int* const status);
+void freeSimputLCSpecTable(struct SimputLCSpecTable** st);
+
+
+/** Create the cache of spectral distributions on disk. By default the
+    directory is taken from the environment variable
+    SIMPUT_SPEC_CACHE. */
+struct SimputSpecDiskCache* newSimputSpecDiskCache(int* const status);
+/** Close the cache file and unmap its contents. The directory is
+    kept. */
+void closeSimputSpecDiskCache(struct SimputSpecDiskCache* const sc,
+			      int* const status);
+void freeSimputSpecDiskCache(struct SimputSpecDiskCache** sc,
+			     int* const status);
+
+
+struct SimputSrcRndStreams* newSimputSrcRndStreams(const unsigned long long seed,
+						   int* const status);
+void freeSimputSrcRndStreams(struct SimputSrcRndStreams** ss,
+			     int* const status);
+
+
+/** Create a matrix of spectra, which is referred to by the calling
+    routine. This reference has to be released with
+    releaseSimputMIdpSpecMatrix. */
+struct SimputMIdpSpecMatrix* newSimputMIdpSpecMatrix(const long nspec,
+						     const long nentries,
+						     int* const status);
+void releaseSimputMIdpSpecMatrix(struct SimputMIdpSpecMatrix** sm);
+/** Let the spectrum refer to the specified row of the matrix and to
+    the common energy grid. */
+void setSimputMIdpSpecMatrixRow(SimputMIdpSpec* const spec,
+				struct SimputMIdpSpecMatrix* const sm,
+				const long row);
+
+
+struct SimputPhotonQueue* newSimputPhotonQueue(const long nsrcs,
+					       int* const status);
+void freeSimputPhotonQueue(struct SimputPhotonQueue** pq);
 
 /** Determine a random number between 0 and 1 with the specified
     random number generator. */
 double getRndNum(int* const status);
 
+/** Fill the array with n random numbers between 0 and 1. The numbers
+    are taken from the same sequence as those returned by getRndNum. */
+void getRndNumBlock(double* const rnd, const long n, int* const status);
+
+/** Determine a random number between 0 and 1 for a catalog. A
+    per-thread context uses its own random number stream, while all
+    other catalogs use the generator specified by setSimputRndGen. */
+double getSimputCtlgRndNum(const SimputCtlg* const cat, int* const status);
+
+/** Fill the array with n random numbers between 0 and 1 for a
+    catalog (see getSimputCtlgRndNum). */
+void getSimputCtlgRndNumBlock(const SimputCtlg* const cat,
+			      double* const rnd,
+			      const long n,
+			      int* const status);
+
+
+/** Return the catalog holding the buffers, which are shared by a
+    catalog and its per-thread contexts. For a catalog, which is not a
+    context, this is the catalog itself. */
+SimputCtlg* getSimputCtlgCore(const SimputCtlg* const cat);
+
+/** Return 1 if the buffers of the catalog are shared with per-thread
+    contexts, and 0 otherwise. */
+int isSimputCtlgShared(const SimputCtlg* const cat);
+
+/** Lock and unlock the buffers shared by a catalog and its per-thread
+    contexts. The lock is recursive. If the catalog does not have any
+    contexts, these routines do nothing. */
+void lockSimputCtlg(const SimputCtlg* const cat);
+void unlockSimputCtlg(const SimputCtlg* const cat);
+
+/** Return the identifier of a reference in the table of references
+    of the catalog, which is shared with the per-thread contexts. If
+    the reference is not contained yet, it is inserted. In case of an
+    error the return value is -1. */
+long getSimputCtlgRefId(SimputCtlg* const cat,
+			const char* const ref,
+			int* const status);
+
+/** Return the copy of a string contained in the table of references
+    of the catalog. If the string is not contained yet, it is
+    inserted. */
+char* internSimputCtlgRef(SimputCtlg* const cat,
+			  const char* const ref,
+			  int* const status);
+
 
 #endif /* COMMON_H */
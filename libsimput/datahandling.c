@@ -20,13 +20,29 @@
                        Erlangen-Nuernberg
 */
 
+#include <fcntl.h>
 #include <float.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "common.h"
 
 
 /** Random number generator. */
 static double(*static_rndgen)(int* const)=NULL;
 
+/** Generator for blocks of random numbers. */
+static void(*static_rndgenblock)(double* const, const long, int* const)=NULL;
+
+/** Random numbers obtained from the block generator, which have not
+    been returned by getRndNum yet. */
+static double static_rndbuffer[SIMPUT_RND_BLOCKSIZE];
+static long static_rndbufferpos=0, static_rndbufferlen=0;
+
+/** State of the built-in generator selected by setSimputRndSeed. */
+static struct SimputRndStream static_rndstream;
+
 
 void setSimputARF(SimputCtlg* const cat, struct ARF* const arf)
 {
@@ -47,6 +63,21 @@ void loadSimputARF(SimputCtlg* const cat, char* const filename, int* const statu
 }
 
 
+void setSimputSpecSampling(SimputCtlg* const cat,
+			   const int method,
+			   int* const status)
+{
+  if ((SIMPUT_SAMPLING_CDF!=method) && (SIMPUT_SAMPLING_ALIAS!=method)) {
+    char msg[SIMPUT_MAXSTR];
+    sprintf(msg, "invalid method (%d) for drawing photon energies", method);
+    SIMPUT_ERROR(msg);
+    *status=EXIT_FAILURE;
+    return;
+  }
+  cat->specsampling=method;
+}
+
+
 /** Use the C rand() function to determine a random number between 0
     and 1. */
 static double getCRand(int* const status)
@@ -60,614 +91,2015 @@ static double getCRand(int* const status)
 }
 
 
-void setSimputRndGen(double(*rndgen)(int* const))
+void setSimputImgSampling(SimputCtlg* const cat,
+			  const int method,
+			  int* const status)
 {
-  static_rndgen=rndgen;
+  if ((SIMPUT_SAMPLING_CDF!=method) && (SIMPUT_SAMPLING_ALIAS!=method)) {
+    char msg[SIMPUT_MAXSTR];
+    sprintf(msg, "invalid method (%d) for drawing photon positions", method);
+    SIMPUT_ERROR(msg);
+    *status=EXIT_FAILURE;
+    return;
+  }
+  cat->imgsampling=method;
 }
 
 
-/** Determine a random number between 0 and 1 with the specified
-    random number generator. */
-double getRndNum(int* const status)
+void setSimputPSDExposure(SimputCtlg* const cat,
+			  const double exposure,
+			  int* const status)
 {
-  // Check if a random number generator has been set.
-  if (NULL==static_rndgen) {
-    // If not use the C rand() generator as default.
-    SIMPUT_WARNING("use C rand() as default since no random number generator "
-		   "is specified");
+  if (exposure<0.) {
+    SIMPUT_ERROR("exposure for light curves generated from PSDs "
+		 "must not be negative");
+    *status=EXIT_FAILURE;
+    return;
+  }
+  cat->psdexposure=exposure;
+}
 
-    // Initialize random seed.
-    srand(time(NULL));
 
-    setSimputRndGen(getCRand);
+void setSimputPSDSegment(SimputCtlg* const cat,
+			 const double segment,
+			 int* const status)
+{
+  if (segment<0.) {
+    SIMPUT_ERROR("segment length for light curves generated from PSDs "
+		 "must not be negative");
+    *status=EXIT_FAILURE;
+    return;
   }
-
-  // Obtain a random number.
-  return(static_rndgen(status));
+  cat->psdsegment=segment;
 }
 
-// Check that CUNIT is set to "deg". Otherwise there will be a conflict
-// between CRVAL [deg] and CDELT [different unit].
-static void check_wcs_unit_degree(const struct wcsprm* wcs, int* const status) {
-	if (((0 != strcmp(wcs->cunit[0], "deg     "))
-			&& (0 != strcmp(wcs->cunit[0], "degree  "))
-			&& (0 != strcmp(wcs->cunit[0], "deg"))
-			&& (0 != strcmp(wcs->cunit[0], "degree")))
-			|| ((0 != strcmp(wcs->cunit[1], "deg     "))
-					&& (0 != strcmp(wcs->cunit[1], "degree  "))
-					&& (0 != strcmp(wcs->cunit[1], "deg"))
-					&& (0 != strcmp(wcs->cunit[1], "degree")))) {
-		*status = EXIT_FAILURE;
-		char msg[SIMPUT_MAXSTR];
-		sprintf(msg,
-				"units of image coordinates are '%s' and '%s' (must be 'deg')",
-				wcs->cunit[0], wcs->cunit[1]);
-		SIMPUT_ERROR(msg);
-		// break;
-	}
-}
 
+/** Return the number of extensions released from a cache so far. */
+static long getSimputCacheIndexNEvicted(const void* const buffer)
+{
+  if (NULL==buffer) {
+    return(0);
+  }
+  return(((const struct SimputCacheIndex*)buffer)->nevicted);
+}
 
 
-SimputSrc* getSimputSrc(SimputCtlg* const cf,
-			const long row,
-			int* const status)
+/** Add the statistics of a cache. */
+static void addSimputCacheStats(SimputCacheStats* const stats,
+				const void* const buffer)
 {
-  // Maximum number of sources in the cache.
-  const long maxsrcs=1000000;
+  const struct SimputCacheIndex* ci=(const struct SimputCacheIndex*)buffer;
+  if (NULL==ci) {
+    return;
+  }
+  stats->hits     +=ci->nhits;
+  stats->misses   +=ci->nmisses;
+  stats->evictions+=ci->nevicted;
+  stats->nentries +=ci->nentries;
+  stats->nbytes   +=ci->nbytes;
+}
 
-  // Check if the source catalog contains a source buffer.
-  if (NULL==cf->srcbuff) {
-    cf->srcbuff=newSimputSrcBuffer(status);
-    CHECK_STATUS_RET(*status, NULL);
+
+/** Apply the capacity to an existing cache. */
+static void setSimputCacheIndexCapacity(void* const buffer,
+					const long capacity)
+{
+  if (NULL!=buffer) {
+    ((struct SimputCacheIndex*)buffer)->capacity=capacity;
   }
+}
 
-  // Convert the void* pointer to the source buffer into the right
-  // format.
-  struct SimputSrcBuffer* sb=(struct SimputSrcBuffer*)cf->srcbuff;
 
-  // Allocate memory for the cache.
-  if (NULL==sb->rowmap) {
-    sb->rowmap=(long*)malloc(cf->nentries*sizeof(long));
-    CHECK_NULL_RET(sb->rowmap, *status,
-		   "memory allocation for row map failed", NULL);
-    long jj;
-    for (jj=0; jj<cf->nentries; jj++) {
-      sb->rowmap[jj]=-1;
+void setSimputCacheCapacity(SimputCtlg* const cat,
+			    const int exttype,
+			    const long capacity,
+			    int* const status)
+{
+  if ((exttype<EXTTYPE_MIDPSPEC) || (exttype>EXTTYPE_PSD)) {
+    char msg[SIMPUT_MAXSTR];
+    sprintf(msg, "invalid extension type (%d) for cache capacity", exttype);
+    SIMPUT_ERROR(msg);
+    *status=EXIT_FAILURE;
+    return;
+  }
+  // Apart from light curves, up to two extensions of the same type
+  // are used at once, e.g., for the interpolation between spectra.
+  if ((capacity<0) || ((1==capacity) && (EXTTYPE_LC!=exttype))) {
+    char msg[SIMPUT_MAXSTR];
+    sprintf(msg, "invalid cache capacity (%ld)", capacity);
+    SIMPUT_ERROR(msg);
+    *status=EXIT_FAILURE;
+    return;
+  }
+  cat->cachecap[exttype]=capacity;
+
+  // Buffers, which exist already, are reduced to the new capacity,
+  // when the next extension is inserted.
+  switch (exttype) {
+  case EXTTYPE_MIDPSPEC:
+    setSimputCacheIndexCapacity(cat->midpspecbuff, capacity);
+    setSimputCacheIndexCapacity(cat->specbuff, capacity);
+    break;
+  case EXTTYPE_IMAGE:
+    setSimputCacheIndexCapacity(cat->imgbuff, capacity);
+    break;
+  case EXTTYPE_PHLIST:
+    setSimputCacheIndexCapacity(cat->phlistbuff, capacity);
+    break;
+  case EXTTYPE_LC:
+    if (NULL!=cat->lcbuff) {
+      setSimputCacheIndexCapacity(((struct SimputLCBuffer*)cat->lcbuff)->lcs,
+				  capacity);
     }
+    break;
+  case EXTTYPE_PSD:
+    setSimputCacheIndexCapacity(cat->psdbuff, capacity);
+    if (NULL!=cat->lcbuff) {
+      setSimputCacheIndexCapacity(((struct SimputLCBuffer*)cat->lcbuff)->psdlcs,
+				  capacity);
+    }
+    break;
   }
+}
 
-  // Check if the cache already exists or whether this routine is
-  // called for the first time.
-  if (NULL==sb->srcs) {
-    sb->srcs=(SimputSrc**)malloc(maxsrcs*sizeof(SimputSrc*));
-    CHECK_NULL_RET(sb->srcs, *status,
-		   "memory allocation for source cache failed", NULL);
+
+void setSimputCacheBudget(SimputCtlg* const cat,
+			  const long budget,
+			  int* const status)
+{
+  if (budget<0) {
+    SIMPUT_ERROR("memory budget of the internal buffers must not be "
+		 "negative");
+    *status=EXIT_FAILURE;
+    return;
   }
-  if (NULL==sb->rownums) {
-    sb->rownums=(long*)malloc(maxsrcs*sizeof(long));
-    CHECK_NULL_RET(sb->rownums, *status,
-		   "memory allocation for array of row numbers failed", NULL);
+
+  if (NULL==cat->cachemgr) {
+    cat->cachemgr=newSimputCacheManager(budget, status);
+    CHECK_STATUS_VOID(*status);
   }
+  struct SimputCacheManager* mgr=(struct SimputCacheManager*)cat->cachemgr;
+  mgr->budget=budget;
 
-  // Check if the specified source index (row number) is valid.
-  if ((row<=0) || (row>cf->nentries)) {
-    SIMPUT_ERROR("invalid row number");
-    return(NULL);
+  // Release extensions exceeding the new budget. Extensions of a
+  // shared catalog are never released.
+  if (!isSimputCtlgShared(cat)) {
+    reduceSimputCacheManager(mgr, 0, status);
+    CHECK_STATUS_VOID(*status);
   }
+}
 
-  // Check if the requested row is already available in the cache.
-  if (sb->rowmap[row-1]>0) {
-    return(sb->srcs[sb->rowmap[row-1]]);
+
+void setSimputPhListMaxMemRows(SimputCtlg* const cat,
+			       const long nrows,
+			       int* const status)
+{
+  if (nrows<0) {
+    SIMPUT_ERROR("maximum number of rows of photon lists kept in memory "
+		 "must not be negative");
+    *status=EXIT_FAILURE;
+    return;
   }
+  cat->phlistmaxmemrows=nrows;
+}
 
-  // The requested source is not contained in the cache.
-  // Therefore we must load it from the FITS file.
 
-  // Check if the cache is already full.
-  if (sb->nsrcs<maxsrcs) {
-    sb->csrc = sb->nsrcs;
-    sb->nsrcs++;
-  } else {
-    sb->csrc++;
-    if (sb->csrc>=maxsrcs) {
-      sb->csrc=0;
-    }
-    // Destroy the source that is currently stored at this place
-    // in the cache.
-    freeSimputSrc(&(sb->srcs[sb->csrc]));
-    sb->rowmap[sb->rownums[sb->csrc]-1] = -1;
-    sb->rownums[sb->csrc] = 0;
+void getSimputCacheStats(SimputCtlg* const cat,
+			 const int exttype,
+			 SimputCacheStats* const stats,
+			 int* const status)
+{
+  if ((exttype<EXTTYPE_NONE) || (exttype>EXTTYPE_PSD)) {
+    char msg[SIMPUT_MAXSTR];
+    sprintf(msg, "invalid extension type (%d) for cache statistics", exttype);
+    SIMPUT_ERROR(msg);
+    *status=EXIT_FAILURE;
+    return;
   }
 
-  // Load the source from the FITS file.
-  sb->srcs[sb->csrc]=loadSimputSrc(cf, row, status);
-  CHECK_STATUS_RET(*status, sb->srcs[sb->csrc]);
-  sb->rownums[sb->csrc]=row;
-  sb->rowmap[row-1]=sb->csrc;
+  stats->hits     =0;
+  stats->misses   =0;
+  stats->evictions=0;
+  stats->nentries =0;
+  stats->nbytes   =0;
+
+  // The photon lists and the light curves generated from PSDs belong
+  // to the catalog or per-thread context itself, while the other
+  // buffers are shared.
+  if ((EXTTYPE_NONE==exttype) || (EXTTYPE_PHLIST==exttype)) {
+    addSimputCacheStats(stats, cat->phlistbuff);
+  }
+  if (((EXTTYPE_NONE==exttype) || (EXTTYPE_LC==exttype)) &&
+      (NULL!=cat->lcbuff)) {
+    addSimputCacheStats(stats, ((struct SimputLCBuffer*)cat->lcbuff)->psdlcs);
+  }
 
-  return(sb->srcs[sb->csrc]);
+  lockSimputCtlg(cat);
+  SimputCtlg* core=getSimputCtlgCore(cat);
+  if ((EXTTYPE_NONE==exttype) || (EXTTYPE_MIDPSPEC==exttype)) {
+    addSimputCacheStats(stats, core->midpspecbuff);
+    addSimputCacheStats(stats, core->specbuff);
+  }
+  if ((EXTTYPE_NONE==exttype) || (EXTTYPE_IMAGE==exttype)) {
+    addSimputCacheStats(stats, core->imgbuff);
+  }
+  if (((EXTTYPE_NONE==exttype) || (EXTTYPE_LC==exttype)) &&
+      (NULL!=core->lcbuff)) {
+    addSimputCacheStats(stats, ((struct SimputLCBuffer*)core->lcbuff)->lcs);
+  }
+  if ((EXTTYPE_NONE==exttype) || (EXTTYPE_PSD==exttype)) {
+    addSimputCacheStats(stats, core->psdbuff);
+  }
+  unlockSimputCtlg(cat);
 }
 
 
-static void getSrcTimeRef(SimputCtlg* const cat,
-			  const SimputSrc* const src,
-			  char* const timeref)
+/** Return the FFTW buffer of the catalog. If it does not exist yet,
+    it is created. */
+static struct SimputFFTWBuffer* getSimputFFTWBuffer(SimputCtlg* const cat,
+						    int* const status)
 {
-  // Initialize with an empty string.
-  strcpy(timeref, "");
-
-  // Determine the reference to the timing extension.
-  if (NULL==src->timing) {
-    strcpy(timeref, "");
-  } else if ((0==strlen(src->timing)) ||
-	     (0==strcmp(src->timing, "NULL")) ||
-	     (0==strcmp(src->timing, " "))) {
-    strcpy(timeref, "");
-  } else {
-    if ('['==src->timing[0]) {
-      strcpy(timeref, cat->filepath);
-      strcat(timeref, cat->filename);
-    } else {
-      if ('/'!=src->timing[0]) {
-	strcpy(timeref, cat->filepath);
-      } else {
-	strcpy(timeref, "");
-      }
-    }
-    strcat(timeref, src->timing);
+  if (NULL==cat->fftwbuff) {
+    cat->fftwbuff=newSimputFFTWBuffer(status);
+    CHECK_STATUS_RET(*status, NULL);
   }
+  return((struct SimputFFTWBuffer*)cat->fftwbuff);
 }
 
 
-static void gauss_rndgen(double* const x, double* const y, int* const status)
+void setSimputFFTWWisdom(SimputCtlg* const cat,
+			 const char* const filename,
+			 int* const status)
 {
-  double sqrt_2rho=sqrt(-log(getRndNum(status))*2.);
-  CHECK_STATUS_VOID(*status);
-  double phi=getRndNum(status)*2.*M_PI;
+  struct SimputFFTWBuffer* fb=getSimputFFTWBuffer(cat, status);
   CHECK_STATUS_VOID(*status);
 
-  *x=sqrt_2rho * cos(phi);
-  *y=sqrt_2rho * sin(phi);
+  if (NULL!=fb->wisdomfile) {
+    free(fb->wisdomfile);
+    fb->wisdomfile=NULL;
+  }
+  fb->wisdomloaded=0;
+
+  if ((NULL!=filename) && (strlen(filename)>0)) {
+    fb->wisdomfile=(char*)malloc((strlen(filename)+1)*sizeof(char));
+    CHECK_NULL_VOID(fb->wisdomfile, *status,
+		    "memory allocation for file name failed");
+    strcpy(fb->wisdomfile, filename);
+  }
 }
 
 
-static SimputPSD* getSimputPSD(SimputCtlg* const cat,
-			       char* const filename,
-			       int* const status)
+/** Return the cache of spectral distributions on disk. If it does not
+    exist yet, it is created. */
+static struct SimputSpecDiskCache* getSimputSpecDiskCache(SimputCtlg* const cat,
+							  int* const status)
 {
-  const long maxpsds=100;
-
-  // Check if the source catalog contains a PSD buffer.
-  if (NULL==cat->psdbuff) {
-    cat->psdbuff=newSimputPSDBuffer(status);
+  if (NULL==cat->speccache) {
+    cat->speccache=newSimputSpecDiskCache(status);
     CHECK_STATUS_RET(*status, NULL);
   }
+  return((struct SimputSpecDiskCache*)cat->speccache);
+}
 
-  // Convert the void* pointer to the PSD buffer into the right
-  // format.
-  struct SimputPSDBuffer* sb=(struct SimputPSDBuffer*)cat->psdbuff;
 
-  // In case there are no PSDs available at all, allocate
-  // memory for the array (storage for PSDs).
-  if (NULL==sb->psds) {
-    sb->psds=(SimputPSD**)malloc(maxpsds*sizeof(SimputPSD*));
-    CHECK_NULL_RET(sb->psds, *status,
-		   "memory allocation for PSD buffer failed", NULL);
+void setSimputSpecCache(SimputCtlg* const cat,
+			const char* const dirname,
+			int* const status)
+{
+  lockSimputCtlg(cat);
+  SimputCtlg* core=getSimputCtlgCore(cat);
+
+  do { // Error handling loop.
+    struct SimputSpecDiskCache* sc=getSimputSpecDiskCache(core, status);
+    CHECK_STATUS_BREAK(*status);
+
+    closeSimputSpecDiskCache(sc, status);
+    CHECK_STATUS_BREAK(*status);
+    if (NULL!=sc->dirname) {
+      free(sc->dirname);
+      sc->dirname=NULL;
+    }
+
+    if ((NULL!=dirname) && (strlen(dirname)>0)) {
+      sc->dirname=(char*)malloc((strlen(dirname)+1)*sizeof(char));
+      CHECK_NULL_BREAK(sc->dirname, *status,
+		       "memory allocation for directory name failed");
+      strcpy(sc->dirname, dirname);
+    }
+  } while(0); // END of error handling loop.
+
+  unlockSimputCtlg(cat);
+}
+
+
+/** Return an FFTW plan for the halfcomplex to real transform of the
+    specified length together with its aligned input and output
+    buffers. If nthreads is greater than 1, the transform is
+    parallelized with the FFTW threads, which must have been
+    initialized before. The plans are kept in the FFTW buffer of the
+    catalog and re-used for subsequent transforms of the same length
+    and number of threads. */
+static fftw_plan getSimputFFTWPlanUnlocked(SimputCtlg* const cat,
+				   const long length,
+				   const int nthreads,
+				   double** const in,
+				   double** const out,
+				   int* const status)
+{
+  const long maxplans=4;
+
+  struct SimputFFTWBuffer* fb=getSimputFFTWBuffer(cat, status);
+  CHECK_STATUS_RET(*status, NULL);
+
+  // In case there are no plans available at all, allocate memory
+  // for the arrays.
+  if (NULL==fb->plans) {
+    fb->length=(long*)malloc(maxplans*sizeof(long));
+    CHECK_NULL_RET(fb->length, *status,
+		   "memory allocation for FFTW buffer failed", NULL);
+    fb->nthreads=(int*)malloc(maxplans*sizeof(int));
+    CHECK_NULL_RET(fb->nthreads, *status,
+		   "memory allocation for FFTW buffer failed", NULL);
+    fb->plans=(fftw_plan*)malloc(maxplans*sizeof(fftw_plan));
+    CHECK_NULL_RET(fb->plans, *status,
+		   "memory allocation for FFTW buffer failed", NULL);
+    fb->in=(double**)malloc(maxplans*sizeof(double*));
+    CHECK_NULL_RET(fb->in, *status,
+		   "memory allocation for FFTW buffer failed", NULL);
+    fb->out=(double**)malloc(maxplans*sizeof(double*));
+    CHECK_NULL_RET(fb->out, *status,
+		   "memory allocation for FFTW buffer failed", NULL);
   }
 
-  // Search if the requested PSD is available in the storage.
-  long ii;
-  for (ii=0; ii<sb->npsds; ii++) {
-    // Check if the PSD is equivalent to the requested one.
-    if (0==strcmp(sb->psds[ii]->fileref, filename)) {
-      // If yes, return the PSD.
-      return(sb->psds[ii]);
+  // Search if a plan for the requested length and number of threads
+  // is available.
+  long ii, unused=-1;
+  for (ii=0; ii<fb->nplans; ii++) {
+    if ((fb->length[ii]==length) && (fb->nthreads[ii]==nthreads)) {
+      *in =fb->in[ii];
+      *out=fb->out[ii];
+      return(fb->plans[ii]);
+    }
+    if (fb->length[ii]<0) {
+      unused=ii;
     }
   }
 
-  // The requested PSD is not contained in the storage.
-  // Therefore we must load it from the specified location.
-  if (sb->npsds>=maxpsds) {
-    SIMPUT_ERROR("too many PSDs in the internal storage");
+  // Determine the position in the cache for the new plan. Plans
+  // of a shared catalog might be in use by other threads and are
+  // therefore never released.
+  if (unused>=0) {
+    fb->cplan=unused;
+  } else if (fb->nplans<maxplans) {
+    fb->cplan=fb->nplans;
+    fb->nplans++;
+  } else if (isSimputCtlgShared(cat)) {
+    long* length=(long*)realloc(fb->length, (fb->nplans+1)*sizeof(long));
+    CHECK_NULL_RET(length, *status,
+		   "memory allocation for FFTW buffer failed", NULL);
+    fb->length=length;
+    int* nthreadsbuff=(int*)realloc(fb->nthreads, (fb->nplans+1)*sizeof(int));
+    CHECK_NULL_RET(nthreadsbuff, *status,
+		   "memory allocation for FFTW buffer failed", NULL);
+    fb->nthreads=nthreadsbuff;
+    fftw_plan* plans=
+      (fftw_plan*)realloc(fb->plans, (fb->nplans+1)*sizeof(fftw_plan));
+    CHECK_NULL_RET(plans, *status,
+		   "memory allocation for FFTW buffer failed", NULL);
+    fb->plans=plans;
+    double** in=(double**)realloc(fb->in, (fb->nplans+1)*sizeof(double*));
+    CHECK_NULL_RET(in, *status,
+		   "memory allocation for FFTW buffer failed", NULL);
+    fb->in=in;
+    double** out=(double**)realloc(fb->out, (fb->nplans+1)*sizeof(double*));
+    CHECK_NULL_RET(out, *status,
+		   "memory allocation for FFTW buffer failed", NULL);
+    fb->out=out;
+    fb->cplan=fb->nplans;
+    fb->nplans++;
+  } else {
+    fb->cplan++;
+    if (fb->cplan>=maxplans) {
+      fb->cplan=0;
+    }
+    // Release the plan that is currently stored at this place.
+    fftw_destroy_plan(fb->plans[fb->cplan]);
+    fftw_free(fb->in[fb->cplan]);
+    fftw_free(fb->out[fb->cplan]);
+  }
+  ii=fb->cplan;
+
+  // Allocate the data structures required by the fftw routines.
+  fb->in[ii] =(double*)fftw_malloc(sizeof(double)*length);
+  fb->out[ii]=(double*)fftw_malloc(sizeof(double)*length);
+  if ((NULL==fb->in[ii]) || (NULL==fb->out[ii])) {
+    if (NULL!=fb->in[ii]) fftw_free(fb->in[ii]);
+    if (NULL!=fb->out[ii]) fftw_free(fb->out[ii]);
+    // Mark the slot as unused. A previous plan at this position has
+    // already been released.
+    fb->length[ii]=-1;
+    fb->plans[ii] =NULL;
+    fb->in[ii]    =NULL;
+    fb->out[ii]   =NULL;
+    SIMPUT_ERROR("memory allocation for fftw data structures failed");
     *status=EXIT_FAILURE;
     return(NULL);
   }
 
-  // Load the PSD from the file.
-  sb->psds[sb->npsds]=loadSimputPSD(filename, status);
-  CHECK_STATUS_RET(*status, sb->psds[sb->npsds]);
-  sb->npsds++;
+  // Create the plan. If a wisdom file is specified, the plan is
+  // measured and the wisdom is stored for later runs. Note that
+  // measuring overwrites the buffers.
+  unsigned int flags=FFTW_ESTIMATE;
+  if (NULL!=fb->wisdomfile) {
+    if (0==fb->wisdomloaded) {
+      // A missing wisdom file is not an error. It is created below.
+      fftw_import_wisdom_from_filename(fb->wisdomfile);
+      fb->wisdomloaded=1;
+    }
+    flags=FFTW_MEASURE;
+  }
+  if (nthreads>1) {
+    fftw_plan_with_nthreads(nthreads);
+  }
+  fb->plans[ii]=fftw_plan_r2r_1d(length, fb->in[ii], fb->out[ii],
+				 FFTW_HC2R, flags);
+  if (nthreads>1) {
+    fftw_plan_with_nthreads(1);
+  }
+  fb->length[ii]  =length;
+  fb->nthreads[ii]=nthreads;
+  if (NULL!=fb->wisdomfile) {
+    if (0==fftw_export_wisdom_to_filename(fb->wisdomfile)) {
+      char msg[SIMPUT_MAXSTR];
+      sprintf(msg, "could not export FFTW wisdom to file '%s'",
+	      fb->wisdomfile);
+      SIMPUT_WARNING(msg);
+    }
+  }
 
-  return(sb->psds[sb->npsds-1]);
+  *in =fb->in[ii];
+  *out=fb->out[ii];
+  return(fb->plans[ii]);
 }
 
 
-static inline double getLCTime(const SimputLC* const lc,
-			       const long kk,
-			       const long long nperiods,
-			       const double mjdref)
+/** Return an FFTW plan from the cache of the catalog (see
+    getSimputFFTWPlanUnlocked). The cache is shared with the per-thread
+    contexts of the catalog, which have to use their own buffers
+    instead of the returned ones. */
+static fftw_plan getSimputFFTWPlan(SimputCtlg* const cat,
+				   const long length,
+				   const int nthreads,
+				   double** const in,
+				   double** const out,
+				   int* const status)
 {
-  if (NULL!=lc->time) {
-    // Non-periodic light curve.
-    return(lc->time[kk]+lc->timezero+(lc->mjdref-mjdref)*24.*3600.);
-  } else {
-    // Periodic light curve.
-    long double phase=lc->phase[kk]-lc->phase0+nperiods;
-    if (fabs(lc->dperiod)<1.e-20) {
-      return(phase*lc->period);
-    } else {
-      return((double)((expm1l(phase*lc->dperiod))*lc->period/lc->dperiod
-		      +lc->timezero+(lc->mjdref-mjdref)*24.*3600.));
-    }
-  }
+  lockSimputCtlg(cat);
+  fftw_plan plan=getSimputFFTWPlanUnlocked(getSimputCtlgCore(cat), length,
+					   nthreads, in, out, status);
+  unlockSimputCtlg(cat);
+  return(plan);
 }
 
 
-/** Gives the reference time of the begining of our real light curve,
-    referenced to the begininf of the loaded light curve, which may
-    contain extra entries to consider a full period in the
-    calculations. */
-static inline double getRefTime0(const SimputLC* const lc)
+void setSimputRndGen(double(*rndgen)(int* const))
 {
-  // First we check wether the phase of the first entry
-  // in the lc corresponds to phase 0.0
-  if (lc->phase[0]==0.0){
-    return 0.;
-  } else {
-    // In this case, the spectrum of phase 0 is not given, so an extra
-    // entry corresponding to the last entry given by the usera has
-    // previously been added at the beginning of thw light-curve.
-    // This extra entry has negative phase, so the time between this entry
-    // and the phase 0.0 can be calculated as:
-    return (1+lc->phase[0])*lc->period;
-  }
+  static_rndgen=rndgen;
+  static_rndgenblock=NULL;
+  static_rndbufferpos=0;
+  static_rndbufferlen=0;
 }
 
 
-/** Determine the index of the bin of the light curve that corresponds
-    to the specified time. For periodic light curves the function
-    stores the number of periods since the specified origin of the
-    light curve in the parameter nperiods. */
-static inline long getLCBin(const SimputLC* const lc,
-			    const double time,
-			    const double mjdref,
-			    long long* nperiods,
-			    int* const status)
+void setSimputRndGenBlock(void(*rndgenblock)(double* const,
+					     const long,
+					     int* const))
 {
-  // Check if the value of MJDREF is negative. This indicates
-  // that the spectrum referred to in the first bin of the light curve
-  // is requested in order to calculate the source count rate.
-  if (mjdref<0.) {
-    return(0);
-  }
+  static_rndgenblock=rndgenblock;
+  static_rndbufferpos=0;
+  static_rndbufferlen=0;
+}
 
-  // Check if the light curve is periodic or not.
-  if (NULL!=lc->time) {
-    // Non-periodic light curve.
-    *nperiods=0;
 
-    // Check if the requested time is within the covered interval.
-    double t0=getLCTime(lc, 0, 0, mjdref);
-    double t1=getLCTime(lc, lc->nentries-1, 0, mjdref);
-    if ((time<t0) || (time>=t1)) {
-      char msg[SIMPUT_MAXSTR];
-      sprintf(msg, "requested time (%lf MJD) is outside the "
-	      "interval covered by the light curve '%s' (%lf to %lf MJD)",
-	      time/24./3600.+mjdref, lc->fileref, t0/24./3600., t1/24./3600.);
-      SIMPUT_ERROR(msg);
-      *status=EXIT_FAILURE;
-      return(0);
+/** Determine a random number between 0 and 1 with the specified
+    random number generator. */
+double getRndNum(int* const status)
+{
+  // If only a block generator has been set, take the number from
+  // the buffer.
+  if ((NULL==static_rndgen) && (NULL!=static_rndgenblock)) {
+    if (static_rndbufferpos>=static_rndbufferlen) {
+      static_rndgenblock(static_rndbuffer, SIMPUT_RND_BLOCKSIZE, status);
+      CHECK_STATUS_RET(*status, 0.);
+      static_rndbufferpos=0;
+      static_rndbufferlen=SIMPUT_RND_BLOCKSIZE;
     }
+    return(static_rndbuffer[static_rndbufferpos++]);
+  }
 
-  } else {
-    // Periodic light curve.
-    // Make a first guess on the number of passed periods.
-    // In some cases the first entry in the lc does not correspond to the
-    // phase 0.0, so it's time is <0.0 and an extra term has to be added
-    // to set the start at 0.0:
-    double dt=time-(getLCTime(lc, 0, 0, mjdref)+getRefTime0(lc));
-    double phase;
-    if (fabs(lc->dperiod)<1.e-20) {
-      phase=lc->phase0+dt/lc->period;
-    } else {
-      phase=lc->phase0+log(1.+dt*lc->dperiod/lc->period)/lc->dperiod;
-    }
-    *nperiods=(long long)phase;
+  // Check if a random number generator has been set.
+  if (NULL==static_rndgen) {
+    // If not use the C rand() generator as default.
+    SIMPUT_WARNING("use C rand() as default since no random number generator "
+		   "is specified");
 
-    // Correct the first guess such that the requested time lies within the
-    // covered period. Deviations with respect to the first guess can
-    // introduced by a \dot{P} (DPERIOD).
-    while (getLCTime(lc, 0, (*nperiods)+1, mjdref)+getRefTime0(lc) <= time) {
-      (*nperiods)++;
-    }
-    while (getLCTime(lc, 0, *nperiods, mjdref)+getRefTime0(lc) > time) {
-      (*nperiods)--;
-    }
-  }
+    // Initialize random seed.
+    srand(time(NULL));
 
-  // Determine the index of the light curve bin (using binary search).
-  long lower=0, upper=lc->nentries-2, mid;
-  while (upper>lower) {
-    mid=(lower+upper)/2;
-    if (getLCTime(lc, mid+1, *nperiods, mjdref) < time) {
-      lower=mid+1;
-    } else {
-      upper=mid;
-    }
+    setSimputRndGen(getCRand);
   }
 
-  return(lower);
+  // Obtain a random number.
+  return(static_rndgen(status));
 }
 
 
-static SimputLC* getSimputLC(SimputCtlg* const cat,
-			     const SimputSrc* const src,
-			     char* const filename,
-			     const double prevtime,
-			     const double mjdref,
-			     int* const status)
+/** Initialize an independent random number stream for the specified
+    seed and stream number. The state is obtained from the SplitMix64
+    generator. */
+static void initSimputRndStream(struct SimputRndStream* const rs,
+				const unsigned long long seed,
+				const unsigned long long stream)
 {
-  SimputLC* lc=NULL;
+  uint64_t x=(uint64_t)seed ^ ((uint64_t)stream*0x9E3779B97F4A7C15ULL);
+  int ii;
+  for (ii=0; ii<4; ii++) {
+    x+=0x9E3779B97F4A7C15ULL;
+    uint64_t z=x;
+    z=(z ^ (z>>30))*0xBF58476D1CE4E5B9ULL;
+    z=(z ^ (z>>27))*0x94D049BB133111EBULL;
+    rs->s[ii]=z ^ (z>>31);
+  }
+}
 
-  // Check if the SimputLC is contained in the internal cache.
-  const long maxlcs=1;
 
-  // Check if the source catalog contains a light curve buffer.
-  if (NULL==cat->lcbuff) {
-    cat->lcbuff=newSimputLCBuffer(status);
-    CHECK_STATUS_RET(*status, NULL);
-  }
+/** Return a random number in the interval (0,1) from the specified
+    stream (xoshiro256++ generator). */
+static double getSimputRndStreamNum(struct SimputRndStream* const rs)
+{
+  uint64_t* s=rs->s;
+  uint64_t sum=s[0]+s[3];
+  uint64_t result=((sum<<23) | (sum>>41))+s[0];
+  uint64_t t=s[1]<<17;
+  s[2]^=s[0];
+  s[3]^=s[1];
+  s[1]^=s[2];
+  s[0]^=s[3];
+  s[2]^=t;
+  s[3]=(s[3]<<45) | (s[3]>>19);
+
+  return(((double)(result>>11)+0.5)*(1./9007199254740992.));
+}
 
-  // Convert the void* pointer to the light curve buffer into
-  // the right format.
-  struct SimputLCBuffer* lb=(struct SimputLCBuffer*)cat->lcbuff;
 
-  // In case there are no light curves available at all, allocate
-  // memory for the array (storage for images).
-  if (NULL==lb->lcs) {
-    lb->lcs=(SimputLC**)malloc(maxlcs*sizeof(SimputLC*));
-    CHECK_NULL_RET(lb->lcs, *status,
-		   "memory allocation for light curves failed", NULL);
+/** Return the random number stream used by the catalog: the stream
+    of the current source in case of per-source streams, otherwise
+    the stream of a per-thread context, or NULL if the global
+    generator is used. */
+static struct SimputRndStream* getSimputCtlgRndStream(const SimputCtlg* const cat)
+{
+  struct SimputSrcRndStreams* ss=(struct SimputSrcRndStreams*)cat->srcrndstreams;
+  if ((NULL!=ss) && (NULL!=ss->current)) {
+    return(ss->current);
   }
+  return((struct SimputRndStream*)cat->rndstream);
+}
 
-  // Search if the requested light curve is available in the storage.
-  long ii;
-  for (ii=0; ii<lb->nlcs; ii++) {
-    // Check if the light curve is equivalent to the requested one.
-    if (0==strcmp(lb->lcs[ii]->fileref, filename)) {
-      // For a light curve created from a PSD, we also have to check,
-      // whether this is the source associated to this light curve.
-      if (lb->lcs[ii]->src_id>0) {
-	// Check if the SRC_IDs agree.
-	if (lb->lcs[ii]->src_id==src->src_id) {
-	  // We have a light curve which has been produced from a PSD.
-	  // Check if the requested time is covered by the light curve.
-	  if (prevtime<getLCTime(lb->lcs[ii], lb->lcs[ii]->nentries-1,
-				 0, mjdref)) {
-	    return(lb->lcs[ii]);
-	  }
-	  // If not, we have to produce a new light curve from the PSD.
-	}
-      } else {
-	// This light curve is loaded from a file and can be re-used
-	// for different sources.
-	return(lb->lcs[ii]);
-      }
-    }
+
+double getSimputCtlgRndNum(const SimputCtlg* const cat, int* const status)
+{
+  struct SimputRndStream* rs=getSimputCtlgRndStream(cat);
+  if (NULL!=rs) {
+    return(getSimputRndStreamNum(rs));
   }
+  return(getRndNum(status));
+}
 
 
-  // If the LC is not contained in the cache, load it either from
-  // a file or create it from a SimputPSD.
-  int timetype=getSimputExtType(cat, filename, status);
-  CHECK_STATUS_RET(*status, lc);
+void getRndNumBlock(double* const rnd, const long n, int* const status)
+{
+  long ii=0;
+  if (NULL!=static_rndgenblock) {
+    // Numbers remaining in the buffer come first in the sequence.
+    while ((ii<n) && (static_rndbufferpos<static_rndbufferlen)) {
+      rnd[ii++]=static_rndbuffer[static_rndbufferpos++];
+    }
+    if (ii<n) {
+      static_rndgenblock(rnd+ii, n-ii, status);
+    }
+    return;
+  }
 
-  if (EXTTYPE_LC==timetype) {
-    // Load directly from file.
-    lc=loadSimputLC(filename, status);
-    CHECK_STATUS_RET(*status, lc);
+  // Without a block generator, the numbers are obtained individually.
+  for (; ii<n; ii++) {
+    rnd[ii]=getRndNum(status);
+    CHECK_STATUS_VOID(*status);
+  }
+}
 
-  } else {
-    // Create the SimputLC from a SimputPSD.
 
-    // Buffer for Fourier transform.
-    float* power=NULL;
-    double *fftw_in=NULL, *fftw_out=NULL;
+/** Fill the array with n random numbers in the interval (0,1) from
+    the specified stream. */
+static void getSimputRndStreamBlock(struct SimputRndStream* const rs,
+				    double* const rnd,
+				    const long n)
+{
+  long ii;
+  for (ii=0; ii<n; ii++) {
+    rnd[ii]=getSimputRndStreamNum(rs);
+  }
+}
 
-    // Length of the PSD for the FFT, which is obtained by
-    // interpolation of the input PSD.
-    const long psdlen=100000000;
 
-    do { // Error handling loop.
+void getSimputCtlgRndNumBlock(const SimputCtlg* const cat,
+			      double* const rnd,
+			      const long n,
+			      int* const status)
+{
+  struct SimputRndStream* rs=getSimputCtlgRndStream(cat);
+  if (NULL!=rs) {
+    getSimputRndStreamBlock(rs, rnd, n);
+    return;
+  }
+  getRndNumBlock(rnd, n, status);
+}
 
-      SimputPSD* psd=getSimputPSD(cat, filename, status);
-      CHECK_STATUS_BREAK(*status);
 
-      // Get an empty SimputLC data structure.
-      lc=newSimputLC(status);
-      CHECK_STATUS_BREAK(*status);
+void setSimputSrcRndSeed(SimputCtlg* const cat,
+			 const unsigned long seed,
+			 int* const status)
+{
+  freeSimputSrcRndStreams((struct SimputSrcRndStreams**)&(cat->srcrndstreams),
+			  status);
+  CHECK_STATUS_VOID(*status);
 
-      // Set the MJDREF.
-      lc->mjdref=mjdref;
+  // The seed is modified, such that the streams differ from those
+  // used for the light curves in loadCacheAllSimputPSDLC.
+  cat->srcrndstreams=
+    newSimputSrcRndStreams((unsigned long long)seed ^ 0x6A09E667F3BCC909ULL,
+			   status);
+}
 
-      // Allocate memory for the light curve.
-      lc->nentries=2*psdlen;
-      lc->time    =(double*)malloc(lc->nentries*sizeof(double));
-      CHECK_NULL_BREAK(lc->time, *status,
-		       "memory allocation for K&R light curve failed");
-      lc->flux    =(float*)malloc(lc->nentries*sizeof(float));
-      CHECK_NULL_BREAK(lc->flux, *status,
-		       "memory allocation for K&R light curve failed");
 
-      // Set the time bins of the light curve.
-      lc->timezero=prevtime;
-      long ii;
-      double dt=1./(2.*psd->frequency[psd->nentries-1]);
-      for (ii=0; ii<lc->nentries; ii++) {
-	lc->time[ii]=ii*dt;
-      }
-
-      // Interpolate the PSD to a uniform frequency grid.
-      // The PSD is given in Miyamoto normalization. In order to get the RMS
-      // right, we have to multiply each bin with df (delta frequency).
-      power=(float*)malloc(psdlen*sizeof(float));
-      CHECK_NULL_BREAK(power, *status,
-		       "memory allocation for PSD buffer failed");
-
-      // Check that the PSD is positive.
-      long jj;
-      for (jj=0; jj<psd->nentries; jj++) {
-	if (psd->power[jj]<=0.0) {
-	  SIMPUT_ERROR("PSD may only have positive entries");
-	  *status=EXIT_FAILURE;
-	  break;
-	}
-      }
-      CHECK_STATUS_RET(*status, lc);
+/** Select the random number stream of the specified source, if the
+    catalog uses per-source streams. */
+static void selectSimputSrcRndStream(SimputCtlg* const cat,
+				     const SimputSrc* const src,
+				     int* const status)
+{
+  struct SimputSrcRndStreams* ss=(struct SimputSrcRndStreams*)cat->srcrndstreams;
+  if (NULL==ss) return;
+
+  struct SimputRndStream* rs=
+    (struct SimputRndStream*)searchSimputCacheIndex(ss->streams, src->src_id);
+  if (NULL==rs) {
+    rs=(struct SimputRndStream*)malloc(sizeof(struct SimputRndStream));
+    CHECK_NULL_VOID(rs, *status,
+		    "memory allocation for random number stream failed");
+    initSimputRndStream(rs, ss->seed, (unsigned long long)src->src_id);
+    insertSimputCacheIndex(ss->streams, src->src_id, rs, 0, status);
+    if (EXIT_SUCCESS!=*status) {
+      free(rs);
+      return;
+    }
+  }
+  ss->current=rs;
+}
 
-      float delta_f=psd->frequency[psd->nentries-1]/psdlen;
-      jj=0;
-      for (ii=0; ii<psdlen; ii++) {
-	float frequency=(ii+1)*delta_f;
-	while((frequency>psd->frequency[jj]) &&
-	      (jj<psd->nentries-1)) {
-	  jj++;
-	}
-	if (jj==0) {
-	  power[ii]=0.;
-	  /* frequency/psd->frequency[jj]*
-	     psd->power[jj]*
-	     delta_f; */
-	} else {
-	  power[ii]=
-	    (psd->power[jj-1]+
-	     (frequency-psd->frequency[jj-1])/
-	     (psd->frequency[jj]-psd->frequency[jj-1])*
-	     (psd->power[jj]-psd->power[jj-1]))*
-	    delta_f;
-	}
-      }
 
-      // Allocate the data structures required by the fftw routines.
-      fftw_in =(double*)fftw_malloc(sizeof(double)*lc->nentries);
-      CHECK_NULL_BREAK(fftw_in, *status, "memory allocation for fftw "
-		       "data structure (fftw_in) failed");
-      fftw_out=(double*)fftw_malloc(sizeof(double)*lc->nentries);
-      CHECK_NULL_BREAK(fftw_out, *status, "memory allocation for fftw "
-		       "data structure (fftw_out) failed");
-
-      // Apply the algorithm introduced by Timmer & Koenig (1995).
-      double randr, randi;
-      lc->fluxscal=1.; // Set Fluxscal to 1.
-      gauss_rndgen(&randr, &randi, status);
-      CHECK_STATUS_RET(*status, lc);
-      fftw_in[0]     =1.;
-      fftw_in[psdlen]=randi*sqrt(power[psdlen-1]);
-      for (ii=1; ii<psdlen; ii++) {
-	gauss_rndgen(&randr, &randi, status);
-	CHECK_STATUS_RET(*status, lc);
-	REAL(fftw_in, ii)              =randr*0.5*sqrt(power[ii-1]);
-	IMAG(fftw_in, ii, lc->nentries)=randi*0.5*sqrt(power[ii-1]);
-      }
-
-      // Perform the inverse Fourier transformation.
-      fftw_plan iplan=fftw_plan_r2r_1d(lc->nentries, fftw_in, fftw_out,
-				       FFTW_HC2R, FFTW_ESTIMATE);
-      fftw_execute(iplan);
-      fftw_destroy_plan(iplan);
-
-      // Determine the normalized rates from the FFT.
-      for (ii=0; ii<lc->nentries; ii++) {
-	lc->flux[ii]=(float)fftw_out[ii] /* *requ_rms/act_rms */;
-
-	// Avoid negative fluxes (no physical meaning):
-	if (lc->flux[ii]<0.) {
-	  lc->flux[ii]=0.;
-	}
-      }
+/** Individual random numbers from the built-in generator. */
+static double getBuiltinRnd(int* const status)
+{
+  return(getSimputRndStreamNum(&static_rndstream));
 
-      // This light curve has been generated for this
-      // particular source.
-      lc->src_id=src->src_id;
+  // Status variable is not needed.
+  (void)(*status);
+}
 
-      // Store the file reference to the timing extension for later
-      // comparisons.
-      lc->fileref=
-	(char*)malloc((strlen(filename)+1)*sizeof(char));
-      CHECK_NULL_RET(lc->fileref, *status,
-		     "memory allocation for file reference failed",
-		     lc);
-      strcpy(lc->fileref, filename);
 
-    } while(0); // END of error handling loop.
+/** Blocks of random numbers from the built-in generator. */
+static void getBuiltinRndBlock(double* const rnd,
+			       const long n,
+			       int* const status)
+{
+  getSimputRndStreamBlock(&static_rndstream, rnd, n);
 
-    // Release allocated memory.
-    if (NULL!=power) free(power);
-    if (NULL!=fftw_in) fftw_free(fftw_in);
-    if (NULL!=fftw_out) fftw_free(fftw_out);
+  // Status variable is not needed.
+  (void)(*status);
+}
 
-  }
 
-  // Check if there is still space left in the internal cache.
-  if (lb->nlcs<maxlcs) {
-    lb->clc=lb->nlcs;
-    lb->nlcs++;
-  } else {
-    lb->clc++;
-    if (lb->clc>=maxlcs) {
-      lb->clc=0;
-    }
-    // Release the SimputLC that is currently stored at this place
-    // in the cache.
-    freeSimputLC(&(lb->lcs[lb->clc]));
-  }
+void setSimputRndSeed(const unsigned long seed)
+{
+  // Use a stream number different from those of the per-thread
+  // contexts, such that a context with the same seed does not
+  // reproduce the same sequence.
+  initSimputRndStream(&static_rndstream, seed, ~0ULL);
+  setSimputRndGen(getBuiltinRnd);
+  setSimputRndGenBlock(getBuiltinRndBlock);
+}
 
-  // Store the SimputLC in the internal cache.
-  lb->lcs[lb->clc]=lc;
 
-  return(lb->lcs[lb->clc]);
+// Check that CUNIT is set to "deg". Otherwise there will be a conflict
+// between CRVAL [deg] and CDELT [different unit].
+static void check_wcs_unit_degree(const struct wcsprm* wcs, int* const status) {
+	if (((0 != strcmp(wcs->cunit[0], "deg     "))
+			&& (0 != strcmp(wcs->cunit[0], "degree  "))
+			&& (0 != strcmp(wcs->cunit[0], "deg"))
+			&& (0 != strcmp(wcs->cunit[0], "degree")))
+			|| ((0 != strcmp(wcs->cunit[1], "deg     "))
+					&& (0 != strcmp(wcs->cunit[1], "degree  "))
+					&& (0 != strcmp(wcs->cunit[1], "deg"))
+					&& (0 != strcmp(wcs->cunit[1], "degree")))) {
+		*status = EXIT_FAILURE;
+		char msg[SIMPUT_MAXSTR];
+		sprintf(msg,
+				"units of image coordinates are '%s' and '%s' (must be 'deg')",
+				wcs->cunit[0], wcs->cunit[1]);
+		SIMPUT_ERROR(msg);
+		// break;
+	}
 }
 
 
-void getSimputSrcSpecRef(SimputCtlg* const cat,
-			 const SimputSrc* const src,
-			 const double prevtime,
-			 const double mjdref,
-			 char* const specref,
-			 int* const status)
+
+SimputSrc* getSimputSrc(SimputCtlg* const cat,
+			const long row,
+			int* const status)
 {
-  // Initialize with an empty string.
-  strcpy(specref, "");
+  // Maximum number of sources in the cache.
+  const long maxsrcs=1000000;
 
-  // Determine the timing extension.
-  char timeref[SIMPUT_MAXSTR];
-  getSrcTimeRef(cat, src, timeref);
-  CHECK_STATUS_VOID(*status);
+  // The sources are shared with the per-thread contexts of the
+  // catalog. All of them are loaded, when the first context is
+  // created. Afterwards the buffer is not modified any more.
+  SimputCtlg* const cf=getSimputCtlgCore(cat);
 
-  int timetype=getSimputExtType(cat, timeref, status);
-  CHECK_STATUS_VOID(*status);
+  // Check if the source catalog contains a source buffer.
+  if (NULL==cf->srcbuff) {
+    cf->srcbuff=newSimputSrcBuffer(status);
+    CHECK_STATUS_RET(*status, NULL);
+  }
 
-  if (EXTTYPE_LC==timetype) {
-    // Get the respective light curve.
-    SimputLC* lc=getSimputLC(cat, src, timeref, prevtime, mjdref, status);
-    CHECK_STATUS_VOID(*status);
+  // Convert the void* pointer to the source buffer into the right
+  // format.
+  struct SimputSrcBuffer* sb=(struct SimputSrcBuffer*)cf->srcbuff;
 
-    // Check if there is a spectrum column in the light curve.
-    if (NULL!=lc->spectrum) {
-      // Determine the current light curve bin.
-      long long nperiods;
-      long bin=getLCBin(lc, prevtime, mjdref, &nperiods, status);
-      CHECK_STATUS_VOID(*status);
+  // If all sources have been loaded at once, they are obtained from
+  // the source table.
+  if (NULL!=sb->table) {
+    if ((row<=0) || (row>sb->ntable)) {
+      SIMPUT_ERROR("invalid row number");
+      return(NULL);
+    }
+    return(&(sb->table[row-1]));
+  }
 
-      // Check if a spectrum is defined in this light curve bin.
-      if ((0==strcmp(lc->spectrum[bin], "NULL")) ||
-	  (0==strcmp(lc->spectrum[bin], " ")) ||
-	  (0==strlen(lc->spectrum[bin]))) {
-	SIMPUT_ERROR("in the current implementation light curves "
-		     "must not contain blank entries in a given "
-		     "spectrum column");
-	*status=EXIT_FAILURE;
+  // Allocate memory for the cache.
+  if (NULL==sb->rowmap) {
+    sb->rowmap=(long*)malloc(cf->nentries*sizeof(long));
+    CHECK_NULL_RET(sb->rowmap, *status,
+		   "memory allocation for row map failed", NULL);
+    long jj;
+    for (jj=0; jj<cf->nentries; jj++) {
+      sb->rowmap[jj]=-1;
+    }
+  }
+
+  // Check if the cache already exists or whether this routine is
+  // called for the first time.
+  if (NULL==sb->srcs) {
+    sb->srcs=(SimputSrc**)malloc(maxsrcs*sizeof(SimputSrc*));
+    CHECK_NULL_RET(sb->srcs, *status,
+		   "memory allocation for source cache failed", NULL);
+  }
+  if (NULL==sb->rownums) {
+    sb->rownums=(long*)malloc(maxsrcs*sizeof(long));
+    CHECK_NULL_RET(sb->rownums, *status,
+		   "memory allocation for array of row numbers failed", NULL);
+  }
+
+  // Check if the specified source index (row number) is valid.
+  if ((row<=0) || (row>cf->nentries)) {
+    SIMPUT_ERROR("invalid row number");
+    return(NULL);
+  }
+
+  // Check if the requested row is already available in the cache.
+  if (sb->rowmap[row-1]>=0) {
+    return(sb->srcs[sb->rowmap[row-1]]);
+  }
+
+  // The requested source is not contained in the cache.
+  // Therefore we must load it from the FITS file.
+
+  // Check if the cache is already full. Sources of a shared catalog
+  // might be in use by other threads and cannot be released.
+  if (sb->nsrcs<maxsrcs) {
+    sb->csrc = sb->nsrcs;
+    sb->nsrcs++;
+  } else if (isSimputCtlgShared(cf)) {
+    SIMPUT_ERROR("too many sources in catalog with per-thread contexts");
+    *status=EXIT_FAILURE;
+    return(NULL);
+  } else {
+    sb->csrc++;
+    if (sb->csrc>=maxsrcs) {
+      sb->csrc=0;
+    }
+    // Destroy the source that is currently stored at this place
+    // in the cache.
+    freeSimputSrc(&(sb->srcs[sb->csrc]));
+    sb->rowmap[sb->rownums[sb->csrc]-1] = -1;
+    sb->rownums[sb->csrc] = 0;
+  }
+
+  // Load the source from the FITS file.
+  sb->srcs[sb->csrc]=loadSimputSrc(cf, row, status);
+  CHECK_STATUS_RET(*status, sb->srcs[sb->csrc]);
+  sb->rownums[sb->csrc]=row;
+  sb->rowmap[row-1]=sb->csrc;
+
+  return(sb->srcs[sb->csrc]);
+}
+
+
+static void getSrcTimeRef(SimputCtlg* const cat,
+			  const SimputSrc* const src,
+			  char* const timeref)
+{
+  // Initialize with an empty string.
+  strcpy(timeref, "");
+
+  // Determine the reference to the timing extension.
+  if (NULL==src->timing) {
+    strcpy(timeref, "");
+  } else if ((0==strlen(src->timing)) ||
+	     (0==strcmp(src->timing, "NULL")) ||
+	     (0==strcmp(src->timing, " "))) {
+    strcpy(timeref, "");
+  } else {
+    if ('['==src->timing[0]) {
+      strcpy(timeref, cat->filepath);
+      strcat(timeref, cat->filename);
+    } else {
+      if ('/'!=src->timing[0]) {
+	strcpy(timeref, cat->filepath);
+      } else {
+	strcpy(timeref, "");
+      }
+    }
+    strcat(timeref, src->timing);
+  }
+}
+
+
+/** Transform n pairs of uniformly distributed random numbers into
+    pairs of normally distributed numbers (x,y) with the Box-Muller
+    method. The array rnd contains 2*n numbers. */
+static void gaussRndBlock(const double* const rnd,
+			  double* const x,
+			  double* const y,
+			  const long n)
+{
+  long ii;
+  for (ii=0; ii<n; ii++) {
+    double sqrt_2rho=sqrt(-log(rnd[2*ii])*2.);
+    double phi=rnd[2*ii+1]*2.*M_PI;
+    x[ii]=sqrt_2rho * cos(phi);
+    y[ii]=sqrt_2rho * sin(phi);
+  }
+}
+
+
+static SimputPSD* getSimputPSDUnlocked(SimputCtlg* const cat,
+				       char* const filename,
+				       int* const status)
+{
+  // Check if the source catalog contains a PSD buffer.
+  if (NULL==cat->psdbuff) {
+    cat->psdbuff=newSimputPSDBuffer(cat->cachecap[EXTTYPE_PSD], status);
+    CHECK_STATUS_RET(*status, NULL);
+  }
+
+  // Search if the requested PSD is available in the storage.
+  long refid=getSimputCtlgRefId(cat, filename, status);
+  CHECK_STATUS_RET(*status, NULL);
+  SimputPSD* psd=
+    (SimputPSD*)searchSimputCacheIndex(cat->psdbuff, refid);
+  if (NULL!=psd) {
+    return(psd);
+  }
+
+  // The requested PSD is not contained in the storage.
+  // Therefore we must load it from the specified location.
+  psd=loadSimputPSD(filename, status);
+  CHECK_STATUS_RET(*status, psd);
+  psd->refid=refid;
+
+  // Store the PSD in the buffer. PSDs of a shared catalog might be
+  // in use by other threads and are therefore never released.
+  manageSimputCtlgCache(cat, cat->psdbuff, status);
+  if (EXIT_SUCCESS==*status) {
+    insertSimputCacheIndex(cat->psdbuff, refid, psd,
+			   !isSimputCtlgShared(cat), status);
+  }
+  if (EXIT_SUCCESS!=*status) {
+    freeSimputPSD(&psd);
+  }
+
+  return(psd);
+}
+
+
+/** Return the requested PSD from the buffer shared by the catalog
+    and its per-thread contexts. */
+static SimputPSD* getSimputPSD(SimputCtlg* const cat,
+			       char* const filename,
+			       int* const status)
+{
+  lockSimputCtlg(cat);
+  SimputPSD* psd=getSimputPSDUnlocked(getSimputCtlgCore(cat), filename, status);
+  unlockSimputCtlg(cat);
+  return(psd);
+}
+
+
+/** Return the time value of the specified bin of a non-periodic
+    light curve, which is either stored in the time array or given by
+    the uniform time grid. */
+static inline double getLCTimeValue(const SimputLC* const lc,
+				    const long kk)
+{
+  if (NULL!=lc->time) {
+    return(lc->time[kk]);
+  }
+  return(kk*lc->timestep);
+}
+
+
+static inline double getLCTime(const SimputLC* const lc,
+			       const long kk,
+			       const long long nperiods,
+			       const double mjdref)
+{
+  if (NULL==lc->phase) {
+    // Non-periodic light curve.
+    return(getLCTimeValue(lc, kk)+lc->timezero+(lc->mjdref-mjdref)*24.*3600.);
+  } else {
+    // Periodic light curve.
+    long double phase=lc->phase[kk]-lc->phase0+nperiods;
+    if (fabs(lc->dperiod)<1.e-20) {
+      return(phase*lc->period);
+    } else {
+      return((double)((expm1l(phase*lc->dperiod))*lc->period/lc->dperiod
+		      +lc->timezero+(lc->mjdref-mjdref)*24.*3600.));
+    }
+  }
+}
+
+
+/** Gives the reference time of the begining of our real light curve,
+    referenced to the begininf of the loaded light curve, which may
+    contain extra entries to consider a full period in the
+    calculations. */
+static inline double getRefTime0(const SimputLC* const lc)
+{
+  // First we check wether the phase of the first entry
+  // in the lc corresponds to phase 0.0
+  if (lc->phase[0]==0.0){
+    return 0.;
+  } else {
+    // In this case, the spectrum of phase 0 is not given, so an extra
+    // entry corresponding to the last entry given by the usera has
+    // previously been added at the beginning of thw light-curve.
+    // This extra entry has negative phase, so the time between this entry
+    // and the phase 0.0 can be calculated as:
+    return (1+lc->phase[0])*lc->period;
+  }
+}
+
+
+/** Determine the index of the bin of the light curve that corresponds
+    to the specified time. For periodic light curves the function
+    stores the number of periods since the specified origin of the
+    light curve in the parameter nperiods. */
+static inline long getLCBin(const SimputLC* const lc,
+			    const double time,
+			    const double mjdref,
+			    long long* nperiods,
+			    int* const status)
+{
+  // Check if the value of MJDREF is negative. This indicates
+  // that the spectrum referred to in the first bin of the light curve
+  // is requested in order to calculate the source count rate.
+  if (mjdref<0.) {
+    return(0);
+  }
+
+  // Check if the light curve is periodic or not.
+  if (NULL==lc->phase) {
+    // Non-periodic light curve.
+    *nperiods=0;
+
+    // Check if the requested time is within the covered interval.
+    double t0=getLCTime(lc, 0, 0, mjdref);
+    double t1=getLCTime(lc, lc->nentries-1, 0, mjdref);
+    if ((time<t0) || (time>=t1)) {
+      char msg[SIMPUT_MAXSTR];
+      sprintf(msg, "requested time (%lf MJD) is outside the "
+	      "interval covered by the light curve '%s' (%lf to %lf MJD)",
+	      time/24./3600.+mjdref, lc->fileref, t0/24./3600., t1/24./3600.);
+      SIMPUT_ERROR(msg);
+      *status=EXIT_FAILURE;
+      return(0);
+    }
+
+    // For a uniform time grid, the bin can be determined directly.
+    // The estimate is corrected for rounding errors, such that the
+    // result agrees with the binary search.
+    if (lc->timestep>0.) {
+      long kk=(long)((time-t0)/lc->timestep);
+      kk=MIN(MAX(kk, 0), lc->nentries-2);
+      while ((kk>0) && (getLCTime(lc, kk, 0, mjdref)>=time)) {
+	kk--;
+      }
+      while ((kk<lc->nentries-2) && (getLCTime(lc, kk+1, 0, mjdref)<time)) {
+	kk++;
+      }
+      return(kk);
+    }
+
+  } else {
+    // Periodic light curve.
+    // Make a first guess on the number of passed periods.
+    // In some cases the first entry in the lc does not correspond to the
+    // phase 0.0, so it's time is <0.0 and an extra term has to be added
+    // to set the start at 0.0:
+    double dt=time-(getLCTime(lc, 0, 0, mjdref)+getRefTime0(lc));
+    double phase;
+    if (fabs(lc->dperiod)<1.e-20) {
+      phase=lc->phase0+dt/lc->period;
+    } else {
+      phase=lc->phase0+log(1.+dt*lc->dperiod/lc->period)/lc->dperiod;
+    }
+    *nperiods=(long long)phase;
+
+    // Correct the first guess such that the requested time lies within the
+    // covered period. Deviations with respect to the first guess can
+    // introduced by a \dot{P} (DPERIOD).
+    while (getLCTime(lc, 0, (*nperiods)+1, mjdref)+getRefTime0(lc) <= time) {
+      (*nperiods)++;
+    }
+    while (getLCTime(lc, 0, *nperiods, mjdref)+getRefTime0(lc) > time) {
+      (*nperiods)--;
+    }
+  }
+
+  // Determine the index of the light curve bin (using binary search).
+  long lower=0, upper=lc->nentries-2, mid;
+  while (upper>lower) {
+    mid=(lower+upper)/2;
+    if (getLCTime(lc, mid+1, *nperiods, mjdref) < time) {
+      lower=mid+1;
+    } else {
+      upper=mid;
+    }
+  }
+
+  return(lower);
+}
+
+
+/** Return the table of the integrated flux of the light curve. If it
+    does not exist yet, it is created. The table is based on the
+    same bin boundaries as getLCTime, but determined relative to the
+    beginning of the light curve or of period 0 respectively. */
+static struct SimputLCRateTable* getSimputLCRateTable(SimputLC* const lc,
+						       int* const status)
+{
+  if (NULL!=lc->ratetable) {
+    return((struct SimputLCRateTable*)lc->ratetable);
+  }
+
+  struct SimputLCRateTable* rt=
+    (struct SimputLCRateTable*)malloc(sizeof(struct SimputLCRateTable));
+  CHECK_NULL_RET(rt, *status,
+		 "memory allocation for SimputLCRateTable failed", NULL);
+  rt->nbins   =lc->nentries-1;
+  rt->periodic=(NULL!=lc->phase);
+  rt->dscale  =0.;
+  if ((0!=rt->periodic) && (fabs(lc->dperiod)>=1.e-20)) {
+    rt->dscale=lc->dperiod;
+  }
+  rt->cumflux=(double*)malloc(lc->nentries*sizeof(double));
+  if (NULL==rt->cumflux) {
+    freeSimputLCRateTable(&rt);
+    SIMPUT_ERROR("memory allocation for SimputLCRateTable failed");
+    *status=EXIT_FAILURE;
+    return(NULL);
+  }
+
+  // Integrate the piece-wise linear flux over the bins.
+  rt->cumflux[0]=0.;
+  long kk;
+  for (kk=0; kk<rt->nbins; kk++) {
+    double stepwidth;
+    if (0==rt->periodic) {
+      stepwidth=getLCTimeValue(lc, kk+1)-getLCTimeValue(lc, kk);
+    } else if (0.==rt->dscale) {
+      stepwidth=(lc->phase[kk+1]-lc->phase[kk])*lc->period;
+    } else {
+      long double phase0=lc->phase[kk]-lc->phase0;
+      long double phase1=lc->phase[kk+1]-lc->phase0;
+      stepwidth=(double)((expm1l(phase1*lc->dperiod)-
+			  expm1l(phase0*lc->dperiod))*
+			 lc->period/lc->dperiod);
+    }
+    rt->cumflux[kk+1]=rt->cumflux[kk]+
+      0.5*(lc->flux[kk]+lc->flux[kk+1])/lc->fluxscal*stepwidth;
+  }
+
+  lc->ratetable=rt;
+  return(rt);
+}
+
+
+/** Return the factor, by which the bin integrals of a periodic light
+    curve are scaled in the specified period, and the integral over
+    all periods from period 0 up to the beginning of the specified
+    period in units of the integral over period 0. */
+static inline void getLCRateTablePeriod(const struct SimputLCRateTable* const rt,
+					const long long nperiods,
+					double* const scale,
+					double* const periods)
+{
+  if (0.==rt->dscale) {
+    *scale=1.;
+    *periods=(double)nperiods;
+  } else {
+    *scale=exp(nperiods*rt->dscale);
+    *periods=expm1(nperiods*rt->dscale)/expm1(rt->dscale);
+  }
+}
+
+
+/** Determine the bin of the light curve, in which the integrated flux
+    starting at the beginning of the bin kk in period nperiods reaches
+    the specified value [s]. The bin and period are returned in kk and
+    nperiods, the remaining integral from the beginning of the bin in
+    remaining. The function returns 1, if the value is not reached
+    before the end of a non-periodic light curve. In that case
+    remaining contains the excess over the end of the light curve. */
+static int findLCRateTable(const struct SimputLCRateTable* const rt,
+			   long* const kk,
+			   long long* const nperiods,
+			   double* const remaining)
+{
+  const double* const cumflux=rt->cumflux;
+  const double total=cumflux[rt->nbins];
+
+  // Target value of the integral in units of period 0.
+  double scale=1., periods=0.;
+  if (0!=rt->periodic) {
+    getLCRateTablePeriod(rt, *nperiods, &scale, &periods);
+  }
+  double target=cumflux[*kk]+(*remaining)/scale;
+
+  if (0==rt->periodic) {
+    if (target>=total) {
+      *remaining=target-total;
+      return(1);
+    }
+  } else {
+    // Determine the period. The first guess might be wrong due to
+    // rounding errors.
+    if (!(total>0.)) return(1);
+    double absolute=periods*total+target*scale;
+    if (0.!=rt->dscale) {
+      double arg=absolute/total*expm1(rt->dscale);
+      if (arg<=-1.) {
+	// The period decreases such that the integral over all
+	// remaining periods is smaller than required.
+	return(1);
+      }
+      *nperiods=(long long)floor(log1p(arg)/rt->dscale);
+    } else {
+      *nperiods=(long long)floor(absolute/total);
+    }
+    getLCRateTablePeriod(rt, *nperiods, &scale, &periods);
+    while (absolute<periods*total) {
+      (*nperiods)--;
+      getLCRateTablePeriod(rt, *nperiods, &scale, &periods);
+    }
+    double nextscale, nextperiods;
+    getLCRateTablePeriod(rt, (*nperiods)+1, &nextscale, &nextperiods);
+    while (absolute>=nextperiods*total) {
+      (*nperiods)++;
+      scale=nextscale;
+      periods=nextperiods;
+      getLCRateTablePeriod(rt, (*nperiods)+1, &nextscale, &nextperiods);
+    }
+    target=(absolute-periods*total)/scale;
+  }
+
+  // Binary search for the last bin starting below the target.
+  long lower=0, upper=rt->nbins-1, mid;
+  while (upper>lower) {
+    mid=(lower+upper+1)/2;
+    if (cumflux[mid]<=target) {
+      lower=mid;
+    } else {
+      upper=mid-1;
+    }
+  }
+  *kk=lower;
+  *remaining=MAX(target-cumflux[lower], 0.)*scale;
+  return(0);
+}
+
+
+/** Flags of the warnings issued by getPSDLength (see
+    SimputCtlg.psdwarnings). */
+#define PSDWARN_UNCONSTRAINED (1)
+#define PSDWARN_TRUNCATED (2)
+
+
+/** Determine the number of frequency bins used for the generation of
+    a light curve from the PSD according to Timmer & Koenig (1995). The
+    resulting light curve has twice as many bins with a width of
+    1/(2*fmax) and covers psdlen/fmax seconds. This interval must
+    include the lowest frequency of the PSD and the exposure or segment
+    length specified for the catalog. The length is rounded up to the
+    next power of 2 for the FFT. A warning is issued once, if the
+    length is neither constrained by the exposure or segment length
+    nor by a positive lowest frequency, or if it has to be truncated
+    to the maximum size. */
+static long getPSDLength(const SimputCtlg* const cat,
+			 const SimputPSD* const psd)
+{
+  const long minpsdlen=1024;
+  const long maxpsdlen=67108864;
+
+  double fmin=psd->frequency[0];
+  double fmax=psd->frequency[psd->nentries-1];
+
+  double duration=cat->psdexposure;
+  if (cat->psdsegment>0.) {
+    duration=cat->psdsegment;
+  }
+  if ((fmin>0.) && (duration<1./fmin)) {
+    duration=1./fmin;
+  }
+
+  long psdlen=minpsdlen;
+  while ((psdlen<maxpsdlen) && (psdlen<duration*fmax)) {
+    psdlen*=2;
+  }
+
+  // Each warning is issued only once for the catalog and its
+  // per-thread contexts.
+  lockSimputCtlg(cat);
+  SimputCtlg* core=getSimputCtlgCore(cat);
+  if ((duration<=0.) && (0==(core->psdwarnings&PSDWARN_UNCONSTRAINED))) {
+    char msg[SIMPUT_MAXSTR];
+    sprintf(msg, "length of light curves generated from PSD '%s' is "
+	    "neither constrained by the exposure (see setSimputPSDExposure) "
+	    "nor by the lowest frequency; each realization covers only "
+	    "%.3es and low-frequency power is lost", psd->fileref,
+	    psdlen/fmax);
+    SIMPUT_WARNING(msg);
+    core->psdwarnings|=PSDWARN_UNCONSTRAINED;
+  }
+  if ((psdlen<duration*fmax) && (0==(core->psdwarnings&PSDWARN_TRUNCATED))) {
+    char msg[SIMPUT_MAXSTR];
+    sprintf(msg, "light curves generated from PSD '%s' are truncated to "
+	    "%ld bins (%.3es instead of %.3es); use setSimputPSDSegment "
+	    "to cover longer intervals", psd->fileref, 2*psdlen,
+	    psdlen/fmax, duration);
+    SIMPUT_WARNING(msg);
+    core->psdwarnings|=PSDWARN_TRUNCATED;
+  }
+  unlockSimputCtlg(cat);
+
+  return(psdlen);
+}
+
+
+/** Generate a light curve from the PSD according to the algorithm of
+    Timmer & Koenig (1995). The realization has 2*psdlen bins, the
+    last noverlap of which are not part of the light curve, but are
+    blended into the beginning of the subsequent segment. If prevlc
+    is given, the new light curve continues it. The inverse FFT is
+    performed with the given plan on the buffers fftw_in and fftw_out.
+    The Gaussian random numbers are obtained from the stream rs or, if
+    rs is NULL, from the random number generator of the library. */
+static SimputLC* genSimputPSDLC(const SimputPSD* const psd,
+				const long psdlen,
+				const long noverlap,
+				const SimputLC* prevlc,
+				const double prevtime,
+				const double mjdref,
+				const long src_id,
+				const char* const filename,
+				const fftw_plan iplan,
+				double* const fftw_in,
+				double* const fftw_out,
+				struct SimputRndStream* const rs,
+				int* const status)
+{
+  SimputLC* lc=NULL;
+
+  // Buffer for Fourier transform.
+  float* power=NULL;
+
+  do { // Error handling loop.
+
+    // Check that the PSD is positive.
+    long jj;
+    for (jj=0; jj<psd->nentries; jj++) {
+      if (psd->power[jj]<=0.0) {
+	SIMPUT_ERROR("PSD may only have positive entries");
+	*status=EXIT_FAILURE;
+	break;
+      }
+    }
+    CHECK_STATUS_BREAK(*status);
+
+    // Get an empty SimputLC data structure.
+    lc=newSimputLC(status);
+    CHECK_STATUS_BREAK(*status);
+
+    // Set the MJDREF.
+    lc->mjdref=mjdref;
+
+    // Allocate memory for the light curve. The flux array also
+    // holds the overlap bins. The time bins form a uniform grid, such
+    // that no time array is required.
+    lc->nentries=2*psdlen-noverlap;
+    lc->flux    =(float*)malloc(2*psdlen*sizeof(float));
+    CHECK_NULL_BREAK(lc->flux, *status,
+		     "memory allocation for K&R light curve failed");
+
+    // In segmented mode, the new light curve continues the previous
+    // one for this source, unless the requested time is outside the
+    // range, which can be covered by the new segment.
+    if ((0==noverlap) || (NULL==prevlc) ||
+	(prevlc->nentries!=lc->nentries) ||
+	(prevlc->mjdref!=mjdref)) {
+      prevlc=NULL;
+    }
+
+    // Set the time bins of the light curve.
+    long ii;
+    lc->timestep=1./(2.*psd->frequency[psd->nentries-1]);
+    if (NULL!=prevlc) {
+      lc->timezero=prevlc->timezero+getLCTimeValue(prevlc, prevlc->nentries-1);
+      if ((prevtime<lc->timezero) ||
+	  (prevtime>=lc->timezero+getLCTimeValue(lc, lc->nentries-1))) {
+	prevlc=NULL;
+      }
+    }
+    if (NULL==prevlc) {
+      lc->timezero=prevtime;
+    }
+
+    // Interpolate the PSD to a uniform frequency grid.
+    // The PSD is given in Miyamoto normalization. In order to get the RMS
+    // right, we have to multiply each bin with df (delta frequency).
+    power=(float*)malloc(psdlen*sizeof(float));
+    CHECK_NULL_BREAK(power, *status,
+		     "memory allocation for PSD buffer failed");
+
+    float delta_f=psd->frequency[psd->nentries-1]/psdlen;
+    jj=0;
+    for (ii=0; ii<psdlen; ii++) {
+      float frequency=(ii+1)*delta_f;
+      while((frequency>psd->frequency[jj]) &&
+	    (jj<psd->nentries-1)) {
+	jj++;
+      }
+      if (jj==0) {
+	power[ii]=0.;
+	/* frequency/psd->frequency[jj]*
+	   psd->power[jj]*
+	   delta_f; */
+      } else {
+	power[ii]=
+	  (psd->power[jj-1]+
+	   (frequency-psd->frequency[jj-1])/
+	   (psd->frequency[jj]-psd->frequency[jj-1])*
+	   (psd->power[jj]-psd->power[jj-1]))*
+	  delta_f;
+      }
+    }
+
+    // Apply the algorithm introduced by Timmer & Koenig (1995).
+    // The Gaussian random numbers are generated in blocks.
+    double rnd[2*SIMPUT_RND_BLOCKSIZE];
+    double randr[SIMPUT_RND_BLOCKSIZE], randi[SIMPUT_RND_BLOCKSIZE];
+    lc->fluxscal=1.; // Set Fluxscal to 1.
+    fftw_in[0]=1.;
+    for (ii=0; ii<psdlen; ii+=SIMPUT_RND_BLOCKSIZE) {
+      long nblock=MIN(SIMPUT_RND_BLOCKSIZE, psdlen-ii);
+      if (NULL==rs) {
+	getRndNumBlock(rnd, 2*nblock, status);
+	CHECK_STATUS_BREAK(*status);
+      } else {
+	getSimputRndStreamBlock(rs, rnd, 2*nblock);
+      }
+      gaussRndBlock(rnd, randr, randi, nblock);
+
+      for (jj=0; jj<nblock; jj++) {
+	long kk=ii+jj;
+	if (0==kk) {
+	  fftw_in[psdlen]=randi[jj]*sqrt(power[psdlen-1]);
+	} else {
+	  REAL(fftw_in, kk)          =randr[jj]*0.5*sqrt(power[kk-1]);
+	  IMAG(fftw_in, kk, 2*psdlen)=randi[jj]*0.5*sqrt(power[kk-1]);
+	}
+      }
+    }
+    CHECK_STATUS_BREAK(*status);
+
+    // Perform the inverse Fourier transformation.
+    fftw_execute_r2r(iplan, fftw_in, fftw_out);
+
+    // Determine the normalized rates from the FFT.
+    for (ii=0; ii<2*psdlen; ii++) {
+      lc->flux[ii]=(float)fftw_out[ii] /* *requ_rms/act_rms */;
+
+      // Avoid negative fluxes (no physical meaning):
+      if (lc->flux[ii]<0.) {
+	lc->flux[ii]=0.;
+      }
+    }
+
+    // Blend the overlap bins of the previous segment into the
+    // beginning of the new one. The first bin coincides with the
+    // last bin of the previous light curve.
+    if (NULL!=prevlc) {
+      for (ii=0; ii<noverlap; ii++) {
+	float weight=(float)ii/(float)noverlap;
+	lc->flux[ii]=
+	  (1.-weight)*prevlc->flux[prevlc->nentries-1+ii]+
+	  weight*lc->flux[ii];
+      }
+    }
+
+    // This light curve has been generated for this
+    // particular source.
+    lc->src_id=src_id;
+
+    // Store the file reference to the timing extension for later
+    // comparisons.
+    lc->fileref=
+      (char*)malloc((strlen(filename)+1)*sizeof(char));
+    CHECK_NULL_BREAK(lc->fileref, *status,
+		     "memory allocation for file reference failed");
+    strcpy(lc->fileref, filename);
+
+  } while(0); // END of error handling loop.
+
+  // Release allocated memory.
+  if (NULL!=power) free(power);
+
+  if (EXIT_SUCCESS!=*status) {
+    freeSimputLC(&lc);
+  }
+
+  return(lc);
+}
+
+
+/** Return the number of light curves released from the light curve
+    buffer so far. References to light curves obtained before the last
+    release may be invalid. */
+static long getSimputLCBufferNReleased(const void* const buffer)
+{
+  const struct SimputLCBuffer* lb=(const struct SimputLCBuffer*)buffer;
+  return(getSimputCacheIndexNEvicted(lb->lcs)+
+	 getSimputCacheIndexNEvicted(lb->psdlcs));
+}
+
+
+/** Store a light curve generated from a PSD in the light curve
+    buffer of the catalog or per-thread context. A previous light
+    curve of the same source is released. The light curves are
+    subject to the capacity for PSDs and to the memory budget of the
+    catalog. In contrast to the light curves loaded from files
+    they are not shared with other threads and can therefore always
+    be released. The light curve is released on failure. */
+static void storeSimputPSDLC(SimputCtlg* const cat,
+			     struct SimputLCBuffer* const lb,
+			     SimputLC* lc,
+			     int* const status)
+{
+  removeSimputCacheIndex(lb->psdlcs, lc->src_id, status);
+  if (EXIT_SUCCESS==*status) {
+    manageSimputCtlgCache(cat, lb->psdlcs, status);
+  }
+  if (EXIT_SUCCESS==*status) {
+    insertSimputCacheIndex(lb->psdlcs, lc->src_id, lc, 1, status);
+  }
+  if (EXIT_SUCCESS!=*status) {
+    freeSimputLC(&lc);
+  }
+}
+
+
+/** Return the light curve generated from the PSD for the specified
+    source, which covers the requested time. If no such light curve
+    is available, a new one is generated. */
+static SimputLC* getSimputPSDLC(SimputCtlg* const cat,
+				struct SimputLCBuffer* const lb,
+				const SimputSrc* const src,
+				char* const filename,
+				const double prevtime,
+				const double mjdref,
+				int* const status)
+{
+  // Light curve previously generated from the PSD for this source,
+  // which is continued by the new segment in segmented mode.
+  SimputLC* prevlc=NULL;
+
+  long refid=getSimputCtlgRefId(cat, filename, status);
+  CHECK_STATUS_RET(*status, NULL);
+  // The light curve is marked as most recently used, such that it
+  // is kept while the PSD is loaded.
+  SimputLC* storedlc=
+    (SimputLC*)searchSimputCacheIndex(lb->psdlcs, src->src_id);
+  if ((NULL!=storedlc) && (refid==storedlc->refid)) {
+    prevlc=storedlc;
+  }
+
+  if (NULL!=prevlc) {
+    // Check if the requested time is covered by the light curve.
+    if ((prevtime>=getLCTime(prevlc, 0, 0, mjdref)) &&
+	(prevtime<getLCTime(prevlc, prevlc->nentries-1, 0, mjdref))) {
+      return(prevlc);
+    }
+    // If not, we have to produce a new light curve from the PSD.
+  }
+
+  SimputPSD* psd=getSimputPSD(cat, filename, status);
+  CHECK_STATUS_RET(*status, NULL);
+
+  // Length of the PSD for the FFT, which is obtained by
+  // interpolation of the input PSD.
+  const long psdlen=getPSDLength(cat, psd);
+
+  // Number of bins at the end of the realization, which are not
+  // part of the light curve itself, but are blended into the
+  // beginning of the subsequent segment.
+  long noverlap=0;
+  if (cat->psdsegment>0.) {
+    noverlap=psdlen/4;
+  }
+
+  // Get the plan and the data structures required by the fftw
+  // routines from the cache. A per-thread context uses its own
+  // buffers, since the cached ones belong to the catalog.
+  double *fftw_in=NULL, *fftw_out=NULL;
+  fftw_plan iplan=getSimputFFTWPlan(cat, 2*psdlen, 1, &fftw_in, &fftw_out,
+				    status);
+  CHECK_STATUS_RET(*status, NULL);
+  if (NULL!=cat->core) {
+    fftw_in =(double*)fftw_malloc(sizeof(double)*2*psdlen);
+    fftw_out=(double*)fftw_malloc(sizeof(double)*2*psdlen);
+    if ((NULL==fftw_in) || (NULL==fftw_out)) {
+      if (NULL!=fftw_in) fftw_free(fftw_in);
+      if (NULL!=fftw_out) fftw_free(fftw_out);
+      SIMPUT_ERROR("memory allocation for fftw data structures failed");
+      *status=EXIT_FAILURE;
+      return(NULL);
+    }
+  }
+
+  SimputLC* lc=genSimputPSDLC(psd, psdlen, noverlap, prevlc, prevtime,
+			      mjdref, src->src_id, filename,
+			      iplan, fftw_in, fftw_out,
+			      getSimputCtlgRndStream(cat), status);
+  if (NULL!=cat->core) {
+    fftw_free(fftw_in);
+    fftw_free(fftw_out);
+  }
+  CHECK_STATUS_RET(*status, NULL);
+  lc->refid=refid;
+
+  storeSimputPSDLC(cat, lb, lc, status);
+  CHECK_STATUS_RET(*status, NULL);
+
+  return(lc);
+}
+
+
+/** Return a light curve loaded from a file from the buffer of the
+    catalog. If the light curve is not contained in the buffer, it is
+    loaded. If the reference points to a PSD, the return value is
+    NULL. */
+static SimputLC* getSimputFileLCUnlocked(SimputCtlg* const cat,
+					 char* const filename,
+					 int* const status)
+{
+  // Check if the source catalog contains a light curve buffer.
+  if (NULL==cat->lcbuff) {
+    cat->lcbuff=newSimputLCBuffer(cat->cachecap[EXTTYPE_LC],
+				  cat->cachecap[EXTTYPE_PSD], status);
+    CHECK_STATUS_RET(*status, NULL);
+  }
+
+  // Convert the void* pointer to the light curve buffer into
+  // the right format.
+  struct SimputLCBuffer* lb=(struct SimputLCBuffer*)cat->lcbuff;
+
+  // Search if the requested light curve is available in the storage.
+  // Light curves loaded from a file can be re-used for different
+  // sources.
+  long refid=getSimputCtlgRefId(cat, filename, status);
+  CHECK_STATUS_RET(*status, NULL);
+  SimputLC* lc=(SimputLC*)searchSimputCacheIndex(lb->lcs, refid);
+  if (NULL!=lc) {
+    return(lc);
+  }
+
+  // If the LC is not contained in the cache, check whether it has
+  // to be loaded from a file or created from a SimputPSD.
+  int timetype=getSimputExtType(cat, filename, status);
+  CHECK_STATUS_RET(*status, lc);
+  if (EXTTYPE_PSD==timetype) {
+    return(NULL);
+  }
+
+  // Load directly from file.
+  lc=loadSimputLC(filename, status);
+  CHECK_STATUS_RET(*status, lc);
+  lc->refid=refid;
+
+  // Light curves loaded from a file might be shared by several
+  // threads. Therefore the table for drawing photon times is set up
+  // right away.
+  getSimputLCRateTable(lc, status);
+  CHECK_STATUS_RET(*status, lc);
+
+  // Store the SimputLC in the internal cache. Light curves of a
+  // shared catalog might be in use by other threads and are
+  // therefore never released.
+  manageSimputCtlgCache(cat, lb->lcs, status);
+  CHECK_STATUS_RET(*status, lc);
+  insertSimputCacheIndex(lb->lcs, refid, lc, !isSimputCtlgShared(cat),
+			 status);
+  if (EXIT_SUCCESS!=*status) {
+    freeSimputLC(&lc);
+  }
+
+  return(lc);
+}
+
+
+static SimputLC* getSimputLC(SimputCtlg* const cat,
+			     const SimputSrc* const src,
+			     char* const filename,
+			     const double prevtime,
+			     const double mjdref,
+			     int* const status)
+{
+  // Light curves loaded from a file are shared with the per-thread
+  // contexts of the catalog.
+  lockSimputCtlg(cat);
+  SimputLC* lc=getSimputFileLCUnlocked(getSimputCtlgCore(cat), filename,
+				       status);
+  unlockSimputCtlg(cat);
+  CHECK_STATUS_RET(*status, lc);
+  if (NULL!=lc) {
+    return(lc);
+  }
+
+  // Light curves generated from a PSD are specific for each source
+  // and are kept separately in the buffer of the catalog or
+  // per-thread context. They use the random number stream of the
+  // source, if available.
+  selectSimputSrcRndStream(cat, src, status);
+  CHECK_STATUS_RET(*status, NULL);
+  if (NULL==cat->lcbuff) {
+    cat->lcbuff=newSimputLCBuffer(cat->cachecap[EXTTYPE_LC],
+				  cat->cachecap[EXTTYPE_PSD], status);
+    CHECK_STATUS_RET(*status, NULL);
+  }
+  return(getSimputPSDLC(cat, (struct SimputLCBuffer*)cat->lcbuff, src,
+			filename, prevtime, mjdref, status));
+}
+
+
+/** Job for the generation of a light curve from a PSD. */
+struct SimputPSDLCJob {
+  long src_id;
+  char fileref[SIMPUT_MAXSTR];
+  long refid; // Identifier of the file reference.
+  SimputPSD* psd;
+  long psdlen;
+  SimputLC* lc; // Generated light curve.
+};
+
+
+/** Jobs and common parameters shared by the worker threads
+    generating light curves from PSDs. */
+struct SimputPSDLCPool {
+  struct SimputPSDLCJob* jobs;
+  long njobs;
+  long next; // Index of the next job to be processed.
+  pthread_mutex_t mutex;
+
+  fftw_plan iplan; // Plan for the common length of the jobs.
+  int segmented;
+  double tstart, mjdref;
+  unsigned long seed;
+
+  int status;
+};
+
+
+/** Compare two light curve jobs by the length of the PSD. */
+static int cmpSimputPSDLCJob(const void* a, const void* b)
+{
+  const struct SimputPSDLCJob* ja=(const struct SimputPSDLCJob*)a;
+  const struct SimputPSDLCJob* jb=(const struct SimputPSDLCJob*)b;
+  if (ja->psdlen!=jb->psdlen) {
+    return((ja->psdlen<jb->psdlen) ? -1 : 1);
+  }
+  return((ja->src_id<jb->src_id) ? -1 : (ja->src_id>jb->src_id));
+}
+
+
+/** Worker thread processing the jobs of the pool. Each light curve
+    uses its own random number stream, which is determined by the
+    seed and the SRC_ID. Therefore the result does not depend on the
+    number of threads. */
+static void* genSimputPSDLCWorker(void* arg)
+{
+  struct SimputPSDLCPool* pool=(struct SimputPSDLCPool*)arg;
+  int status=EXIT_SUCCESS;
+
+  // Buffers for the Fourier transform.
+  double *fftw_in=NULL, *fftw_out=NULL;
+
+  do { // Error handling loop.
+
+    long length=2*pool->jobs[0].psdlen;
+    fftw_in =(double*)fftw_malloc(sizeof(double)*length);
+    CHECK_NULL_BREAK(fftw_in, status, "memory allocation for fftw "
+		     "data structure (fftw_in) failed");
+    fftw_out=(double*)fftw_malloc(sizeof(double)*length);
+    CHECK_NULL_BREAK(fftw_out, status, "memory allocation for fftw "
+		     "data structure (fftw_out) failed");
+
+    while (1) {
+      // Get the next job.
+      pthread_mutex_lock(&pool->mutex);
+      long idx=pool->next;
+      pool->next++;
+      int poolstatus=pool->status;
+      pthread_mutex_unlock(&pool->mutex);
+      if ((idx>=pool->njobs) || (EXIT_SUCCESS!=poolstatus)) break;
+
+      struct SimputPSDLCJob* job=&(pool->jobs[idx]);
+      long noverlap=0;
+      if (0!=pool->segmented) {
+	noverlap=job->psdlen/4;
+      }
+
+      struct SimputRndStream rs;
+      initSimputRndStream(&rs, pool->seed, (unsigned long long)job->src_id);
+
+      job->lc=genSimputPSDLC(job->psd, job->psdlen, noverlap, NULL,
+			     pool->tstart, pool->mjdref, job->src_id,
+			     job->fileref, pool->iplan, fftw_in, fftw_out,
+			     &rs, &status);
+      CHECK_STATUS_BREAK(status);
+      job->lc->refid=job->refid;
+    }
+
+  } while(0); // END of error handling loop.
+
+  // Release allocated memory.
+  if (NULL!=fftw_in) fftw_free(fftw_in);
+  if (NULL!=fftw_out) fftw_free(fftw_out);
+
+  if (EXIT_SUCCESS!=status) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->status=status;
+    pthread_mutex_unlock(&pool->mutex);
+  }
+
+  return(NULL);
+}
+
+
+void loadCacheAllSimputPSDLC(SimputCtlg* const cat,
+			     const double tstart,
+			     const double mjdref,
+			     const unsigned long seed,
+			     const int nthreads,
+			     int* const status)
+{
+  struct SimputPSDLCJob* jobs=NULL;
+  long njobs=0, ii;
+  pthread_t* threads=NULL;
+
+  do { // Error handling loop.
+
+    if (nthreads<1) {
+      SIMPUT_ERROR("number of threads must be positive");
+      *status=EXIT_FAILURE;
+      break;
+    }
+
+    // Check if the source catalog contains a light curve buffer.
+    if (NULL==cat->lcbuff) {
+      cat->lcbuff=newSimputLCBuffer(cat->cachecap[EXTTYPE_LC],
+				    cat->cachecap[EXTTYPE_PSD], status);
+      CHECK_STATUS_BREAK(*status);
+    }
+    struct SimputLCBuffer* lb=(struct SimputLCBuffer*)cat->lcbuff;
+
+    // Collect all sources with a PSD as timing extension. The
+    // extensions are loaded in the calling thread.
+    long npsdevicted=
+      getSimputCacheIndexNEvicted(getSimputCtlgCore(cat)->psdbuff);
+    jobs=(struct SimputPSDLCJob*)
+      malloc(cat->nentries*sizeof(struct SimputPSDLCJob));
+    CHECK_NULL_BREAK(jobs, *status,
+		     "memory allocation for light curve jobs failed");
+
+    for (ii=0; ii<cat->nentries; ii++) {
+      SimputSrc* src=getSimputSrc(cat, ii+1, status);
+      CHECK_STATUS_BREAK(*status);
+
+      char timeref[SIMPUT_MAXSTR];
+      getSrcTimeRef(cat, src, timeref);
+      if ('\0'==timeref[0]) continue;
+
+      int timetype=getSimputExtType(cat, timeref, status);
+      CHECK_STATUS_BREAK(*status);
+      if (EXTTYPE_PSD!=timetype) continue;
+
+      struct SimputPSDLCJob* job=&(jobs[njobs]);
+      job->src_id=src->src_id;
+      strcpy(job->fileref, timeref);
+      job->refid=getSimputCtlgRefId(cat, timeref, status);
+      CHECK_STATUS_BREAK(*status);
+      job->psd=getSimputPSD(cat, timeref, status);
+      CHECK_STATUS_BREAK(*status);
+      job->psdlen=getPSDLength(cat, job->psd);
+      job->lc=NULL;
+      njobs++;
+    }
+    CHECK_STATUS_BREAK(*status);
+
+    // The PSDs referred to by the jobs must still be available.
+    if (getSimputCacheIndexNEvicted(getSimputCtlgCore(cat)->psdbuff)!=
+	npsdevicted) {
+      SIMPUT_ERROR("capacity of the PSD buffer is too small for "
+		   "generating all light curves at once");
+      *status=EXIT_FAILURE;
+      break;
+    }
+    if (0==njobs) break;
+
+    // Process the jobs in groups sharing the same FFT length.
+    qsort(jobs, njobs, sizeof(struct SimputPSDLCJob), cmpSimputPSDLCJob);
+
+    threads=(pthread_t*)malloc(nthreads*sizeof(pthread_t));
+    CHECK_NULL_BREAK(threads, *status,
+		     "memory allocation for threads failed");
+
+    long first=0;
+    while (first<njobs) {
+      long last=first+1;
+      while ((last<njobs) && (jobs[last].psdlen==jobs[first].psdlen)) {
+	last++;
+      }
+
+      // If there are less sources than threads, the individual
+      // transforms are parallelized by FFTW.
+      int nworkers=nthreads;
+      if (last-first<nworkers) {
+	nworkers=(int)(last-first);
+      }
+      int planthreads=nthreads/nworkers;
+      if (planthreads>1) {
+	if (0==fftw_init_threads()) {
+	  SIMPUT_ERROR("initialization of FFTW threads failed");
+	  *status=EXIT_FAILURE;
+	  break;
+	}
+      }
+
+      // The plan is created in the calling thread, since the FFTW
+      // planner is not thread-safe.
+      struct SimputPSDLCPool pool;
+      double *fftw_in=NULL, *fftw_out=NULL;
+      pool.iplan=getSimputFFTWPlan(cat, 2*jobs[first].psdlen, planthreads,
+				   &fftw_in, &fftw_out, status);
+      CHECK_STATUS_BREAK(*status);
+
+      pool.jobs     =&(jobs[first]);
+      pool.njobs    =last-first;
+      pool.next     =0;
+      pool.segmented=(cat->psdsegment>0.);
+      pool.tstart   =tstart;
+      pool.mjdref   =mjdref;
+      pool.seed     =seed;
+      pool.status   =EXIT_SUCCESS;
+      pthread_mutex_init(&pool.mutex, NULL);
+
+      int nstarted=0;
+      for (nstarted=0; nstarted<nworkers; nstarted++) {
+	if (0!=pthread_create(&(threads[nstarted]), NULL,
+			      genSimputPSDLCWorker, &pool)) {
+	  SIMPUT_ERROR("creation of thread failed");
+	  pthread_mutex_lock(&pool.mutex);
+	  pool.status=EXIT_FAILURE;
+	  pthread_mutex_unlock(&pool.mutex);
+	  break;
+	}
+      }
+      int jj;
+      for (jj=0; jj<nstarted; jj++) {
+	pthread_join(threads[jj], NULL);
+      }
+      pthread_mutex_destroy(&pool.mutex);
+      *status=pool.status;
+      CHECK_STATUS_BREAK(*status);
+
+      first=last;
+    }
+    CHECK_STATUS_BREAK(*status);
+
+    // Store the light curves in the buffer. If their number exceeds
+    // the capacity for PSDs or the memory budget, the least
+    // recently generated ones are released again.
+    for (ii=0; ii<njobs; ii++) {
+      SimputLC* lc=jobs[ii].lc;
+      jobs[ii].lc=NULL;
+      storeSimputPSDLC(cat, lb, lc, status);
+      CHECK_STATUS_BREAK(*status);
+    }
+    CHECK_STATUS_BREAK(*status);
+
+  } while(0); // END of error handling loop.
+
+  // Release allocated memory.
+  if (NULL!=jobs) {
+    for (ii=0; ii<njobs; ii++) {
+      if (NULL!=jobs[ii].lc) {
+	freeSimputLC(&(jobs[ii].lc));
+      }
+    }
+    free(jobs);
+  }
+  if (NULL!=threads) free(threads);
+}
+
+
+void getSimputSrcSpecRef(SimputCtlg* const cat,
+			 const SimputSrc* const src,
+			 const double prevtime,
+			 const double mjdref,
+			 char* const specref,
+			 int* const status)
+{
+  // Initialize with an empty string.
+  strcpy(specref, "");
+
+  // Determine the timing extension.
+  char timeref[SIMPUT_MAXSTR];
+  getSrcTimeRef(cat, src, timeref);
+  CHECK_STATUS_VOID(*status);
+
+  int timetype=getSimputExtType(cat, timeref, status);
+  CHECK_STATUS_VOID(*status);
+
+  if (EXTTYPE_LC==timetype) {
+    // Get the respective light curve.
+    SimputLC* lc=getSimputLC(cat, src, timeref, prevtime, mjdref, status);
+    CHECK_STATUS_VOID(*status);
+
+    // Check if there is a spectrum column in the light curve.
+    if (NULL!=lc->spectrum) {
+      // Determine the current light curve bin.
+      long long nperiods;
+      long bin=getLCBin(lc, prevtime, mjdref, &nperiods, status);
+      CHECK_STATUS_VOID(*status);
+
+      // Check if a spectrum is defined in this light curve bin.
+      if ((0==strcmp(lc->spectrum[bin], "NULL")) ||
+	  (0==strcmp(lc->spectrum[bin], " ")) ||
+	  (0==strlen(lc->spectrum[bin]))) {
+	SIMPUT_ERROR("in the current implementation light curves "
+		     "must not contain blank entries in a given "
+		     "spectrum column");
+	*status=EXIT_FAILURE;
 	return;
       }
 
@@ -702,402 +2134,1342 @@ void getSimputSrcSpecRef(SimputCtlg* const cat,
       return;
     }
 
-    strcpy(specref, src->spectrum);
+    strcpy(specref, src->spectrum);
+
+    // Set path and file name if missing.
+    if ('['==specref[0]) {
+      char buffer[SIMPUT_MAXSTR];
+      strcpy(buffer, cat->filepath);
+      strcat(buffer, cat->filename);
+      strcat(buffer, specref);
+      strcpy(specref, buffer);
+    } else {
+      if ('/'!=specref[0]) {
+	char buffer[SIMPUT_MAXSTR];
+	strcpy(buffer, cat->filepath);
+	strcat(buffer, specref);
+	strcpy(specref, buffer);
+      }
+    }
+  }
+}
+
+void getSimputSrcSpecRefNext(SimputCtlg* const cat,
+			     const SimputSrc* const src,
+			     const double prevtime,
+			     const double mjdref,
+			     char* const specref,
+			     int* const status)
+{
+  // Initialize with an empty string.
+  strcpy(specref, "");
+
+  // Determine the timing extension.
+  char timeref[SIMPUT_MAXSTR];
+  getSrcTimeRef(cat, src, timeref);
+  CHECK_STATUS_VOID(*status);
+
+  int timetype=getSimputExtType(cat, timeref, status);
+  CHECK_STATUS_VOID(*status);
+
+  if (EXTTYPE_LC==timetype) {
+    // Get the respective light curve.
+    SimputLC* lc=getSimputLC(cat, src, timeref, prevtime, mjdref, status);
+    CHECK_STATUS_VOID(*status);
+
+    // Check if there is a spectrum column in the light curve.
+    if (NULL!=lc->spectrum) {
+      // Determine the current light curve bin.
+      long long nperiods;
+      long bin=getLCBin(lc, prevtime, mjdref, &nperiods, status);
+      CHECK_STATUS_VOID(*status);
+
+      // Check if a spectrum is defined in the next light curve bin.
+      if ((0==strcmp(lc->spectrum[bin+1], "NULL")) ||
+          (0==strcmp(lc->spectrum[bin+1], " ")) ||
+          (0==strlen(lc->spectrum[bin+1]))) {
+        SIMPUT_ERROR("in the current implementation light curves "
+                     "must not contain blank entries in a given "
+                     "spectrum column");
+        *status=EXIT_FAILURE;
+        return;
+      }
+
+      // Copy the reference to the next spectrum.
+      strcpy(specref, lc->spectrum[bin+1]);
+
+      // Determine the relative location with respect to the
+      // location of the light curve.
+      if ('['==specref[0]) {
+        char* firstbrack=strchr(timeref, '[');
+        strcpy(firstbrack, specref);
+        strcpy(specref, timeref);
+      } else if (('/'!=specref[0])&&(NULL!=strchr(timeref, '/'))) {
+        char* lastslash=strrchr(timeref, '/');
+        lastslash++;
+        strcpy(lastslash, specref);
+        strcpy(specref, timeref);
+      }
+
+      return;
+    }
+  }
+  else{
+    // If this function is being executed, a light curve is
+    // supposed to exist in the simput cataloge. If no
+    // light curve is avaliable there is an error somewhere:
+    SIMPUT_ERROR("There is no light curve with a spectrum "
+		 " column avaliable");
+    *status=EXIT_FAILURE;
+    return;
+  }
+}
+
+
+static void getSrcImagRef(SimputCtlg* const cat,
+			  const SimputSrc* const src,
+			  const double prevtime,
+			  const double mjdref,
+			  char* const imagref,
+			  int* const status)
+{
+  // Initialize with an empty string.
+  strcpy(imagref, "");
+
+  // Determine the timing extension.
+  char timeref[SIMPUT_MAXSTR];
+  getSrcTimeRef(cat, src, timeref);
+  CHECK_STATUS_VOID(*status);
+
+  int timetype=getSimputExtType(cat, timeref, status);
+  CHECK_STATUS_VOID(*status);
+
+  if (EXTTYPE_LC==timetype) {
+    // Get the respective light curve.
+    SimputLC* lc=getSimputLC(cat, src, timeref, prevtime, mjdref, status);
+    CHECK_STATUS_VOID(*status);
+
+    // Check if there is an image column in the light curve.
+    if (NULL!=lc->image) {
+      // Determine the current light curve bin.
+      long long nperiods;
+      long bin=getLCBin(lc, prevtime, mjdref, &nperiods, status);
+      CHECK_STATUS_VOID(*status);
+
+      // Check if an image is defined in this light curve bin.
+      if ((0==strcmp(lc->image[bin], "NULL")) ||
+	  (0==strcmp(lc->image[bin], " ")) ||
+	  (0==strlen(lc->image[bin]))) {
+	SIMPUT_ERROR("in the current implementation light curves "
+		     "must not contain blank entries in a given "
+		     "image column");
+	*status=EXIT_FAILURE;
+	return;
+      }
+
+      // Copy the reference to the image.
+      strcpy(imagref, lc->image[bin]);
+
+      // Determine the relative location with respect to the
+      // location of the light curve.
+      if ('['==imagref[0]) {
+	char* firstbrack=strchr(timeref, '[');
+	strcpy(firstbrack, imagref);
+	strcpy(imagref, timeref);
+      } else if (('/'!=imagref[0])&&(NULL!=strchr(timeref, '/'))) {
+	char* lastslash=strrchr(timeref, '/');
+	lastslash++;
+	strcpy(lastslash, imagref);
+	strcpy(imagref, timeref);
+      }
+
+      return;
+    }
+  }
+
+  // If no light curve extension with an image column is given,
+  // determine the spectrum reference directly from the source
+  // description.
+  if (NULL!=src->image) {
+    // Check if this is a valid HDU reference.
+    if ((0==strcmp(src->image, "NULL")) ||
+	(0==strcmp(src->image, " ")) ||
+	(0==strlen(src->image))) {
+      return;
+    }
+
+    strcpy(imagref, src->image);
 
     // Set path and file name if missing.
-    if ('['==specref[0]) {
+    if ('['==imagref[0]) {
       char buffer[SIMPUT_MAXSTR];
       strcpy(buffer, cat->filepath);
       strcat(buffer, cat->filename);
-      strcat(buffer, specref);
-      strcpy(specref, buffer);
+      strcat(buffer, imagref);
+      strcpy(imagref, buffer);
     } else {
-      if ('/'!=specref[0]) {
+      if ('/'!=imagref[0]) {
 	char buffer[SIMPUT_MAXSTR];
 	strcpy(buffer, cat->filepath);
-	strcat(buffer, specref);
-	strcpy(specref, buffer);
+	strcat(buffer, imagref);
+	strcpy(imagref, buffer);
       }
     }
   }
 }
 
-void getSimputSrcSpecRefNext(SimputCtlg* const cat,
-			     const SimputSrc* const src,
-			     const double prevtime,
-			     const double mjdref,
-			     char* const specref,
-			     int* const status)
+
+static SimputMIdpSpec* getSimputMIdpSpecUnlocked(SimputCtlg* const cat,
+						 const char* const filename,
+						 int* const status)
 {
-  // Initialize with an empty string.
-  strcpy(specref, "");
+  // Search if the spectrum is available in the buffer.
+  long refid=getSimputCtlgRefId(cat, filename, status);
+  CHECK_STATUS_RET(*status, NULL);
+  SimputMIdpSpec* spec=
+    (SimputMIdpSpec*)searchSimputCacheIndex(cat->midpspecbuff, refid);
+  if (NULL!=spec) {
+    return(spec);
+  }
 
-  // Determine the timing extension.
-  char timeref[SIMPUT_MAXSTR];
-  getSrcTimeRef(cat, src, timeref);
-  CHECK_STATUS_VOID(*status);
+  // The required spectrum is not contained in the buffer.
+  // Therefore it must be loaded from the specified location.
 
-  int timetype=getSimputExtType(cat, timeref, status);
-  CHECK_STATUS_VOID(*status);
+  // Load the mission-independent spectrum.
+  spec=loadSimputMIdpSpec(filename, status);
+  CHECK_STATUS_RET(*status, spec);
+  spec->refid=refid;
+
+  // Insert the spectrum into the buffer. Spectra of a shared catalog
+  // might be in use by other threads and are therefore never
+  // released.
+  if (NULL==cat->midpspecbuff) {
+    cat->midpspecbuff=
+      newSimputMIdpSpecBuffer(cat->cachecap[EXTTYPE_MIDPSPEC], status);
+  }
+  if (EXIT_SUCCESS==*status) {
+    manageSimputCtlgCache(cat, cat->midpspecbuff, status);
+  }
+  if (EXIT_SUCCESS==*status) {
+    insertSimputCacheIndex(cat->midpspecbuff, refid, spec,
+			   !isSimputCtlgShared(cat), status);
+  }
+  if (EXIT_SUCCESS!=*status) {
+    freeSimputMIdpSpec(&spec);
+  }
 
-  if (EXTTYPE_LC==timetype) {
-    // Get the respective light curve.
-    SimputLC* lc=getSimputLC(cat, src, timeref, prevtime, mjdref, status);
-    CHECK_STATUS_VOID(*status);
+  return(spec);
+}
 
-    // Check if there is a spectrum column in the light curve.
-    if (NULL!=lc->spectrum) {
-      // Determine the current light curve bin.
-      long long nperiods;
-      long bin=getLCBin(lc, prevtime, mjdref, &nperiods, status);
-      CHECK_STATUS_VOID(*status);
 
-      // Check if a spectrum is defined in the next light curve bin.
-      if ((0==strcmp(lc->spectrum[bin+1], "NULL")) ||
-          (0==strcmp(lc->spectrum[bin+1], " ")) ||
-          (0==strlen(lc->spectrum[bin+1]))) {
-        SIMPUT_ERROR("in the current implementation light curves "
-                     "must not contain blank entries in a given "
-                     "spectrum column");
-        *status=EXIT_FAILURE;
-        return;
+/** Return the requested mission-independent spectrum from the buffer
+    shared by the catalog and its per-thread contexts. */
+static SimputMIdpSpec* getSimputMIdpSpec(SimputCtlg* const cat,
+					 const char* const filename,
+					 int* const status)
+{
+  lockSimputCtlg(cat);
+  SimputMIdpSpec* spec=
+    getSimputMIdpSpecUnlocked(getSimputCtlgCore(cat), filename, status);
+  unlockSimputCtlg(cat);
+  return(spec);
+}
+
+
+SimputMIdpSpec* getSimputSrcMIdpSpec(SimputCtlg* const cat,
+				     const SimputSrc* const src,
+				     const double prevtime,
+				     const double mjdref,
+				     int* const status)
+{
+  char specref[SIMPUT_MAXSTR];
+  getSimputSrcSpecRef(cat, src, prevtime, mjdref, specref, status);
+  CHECK_STATUS_RET(*status, 0);
+
+  int spectype=getSimputExtType(cat, specref, status);
+  CHECK_STATUS_RET(*status, 0);
+
+  if (EXTTYPE_MIDPSPEC==spectype) {
+    // Determine the spectrum.
+    SimputMIdpSpec* spec=getSimputMIdpSpec(cat, specref, status);
+    CHECK_STATUS_RET(*status, 0);
+
+    return(spec);
+
+  } else {
+    SIMPUT_ERROR("source does not refer to a mission-independent spectrum");
+    *status=EXIT_FAILURE;
+    return(NULL);
+  }
+}
+
+
+static inline void getMIdpSpecEbounds(const SimputMIdpSpec* const spec,
+				      const long idx,
+				      float* const emin,
+				      float* const emax)
+{
+  // Determine the lower boundary.
+  if (idx>0) {
+    *emin=0.5*(spec->energy[idx]+spec->energy[idx-1]);
+  } else {
+    *emin=spec->energy[idx];
+  }
+
+  // Determine the upper boundary.
+  if (idx<spec->nentries-1) {
+    *emax=0.5*(spec->energy[idx+1]+spec->energy[idx]);
+  } else {
+    *emax=spec->energy[idx];
+  }
+}
+
+
+/** Set up an alias table for a cumulative distribution with the
+    specified number of bins (Walker's alias method in the formulation
+    of Vose, 1991). For each bin the table contains the probability
+    to keep the bin and the index of the alternative bin. */
+static void buildAliasTable(const double* const cdf,
+			    const long nbins,
+			    double** const aliasprob,
+			    long** const alias,
+			    int* const status)
+{
+  long* small=NULL;
+  long* large=NULL;
+
+  do { // Error handling loop.
+    *aliasprob=(double*)malloc(nbins*sizeof(double));
+    CHECK_NULL_BREAK(*aliasprob, *status,
+		     "memory allocation for alias table failed");
+    *alias=(long*)malloc(nbins*sizeof(long));
+    CHECK_NULL_BREAK(*alias, *status,
+		     "memory allocation for alias table failed");
+    small=(long*)malloc(nbins*sizeof(long));
+    CHECK_NULL_BREAK(small, *status,
+		     "memory allocation for alias table failed");
+    large=(long*)malloc(nbins*sizeof(long));
+    CHECK_NULL_BREAK(large, *status,
+		     "memory allocation for alias table failed");
+
+    double* prob=*aliasprob;
+    long* alt=*alias;
+
+    // Scale the probabilities of the individual bins such that
+    // their mean value is 1.
+    long ii, nsmall=0, nlarge=0;
+    double total=cdf[nbins-1];
+    for (ii=0; ii<nbins; ii++) {
+      double binprob=cdf[ii];
+      if (ii>0) {
+	binprob-=cdf[ii-1];
+      }
+      if (total>0.) {
+	prob[ii]=binprob*nbins/total;
+      } else {
+	prob[ii]=1.;
+      }
+      alt[ii]=ii;
+      if (prob[ii]<1.) {
+	small[nsmall++]=ii;
+      } else {
+	large[nlarge++]=ii;
       }
+    }
 
-      // Copy the reference to the next spectrum.
-      strcpy(specref, lc->spectrum[bin+1]);
+    // Fill up the bins with a probability below the mean value
+    // with the excess of the bins above.
+    while ((nsmall>0) && (nlarge>0)) {
+      long ss=small[--nsmall];
+      long ll=large[--nlarge];
+      alt[ss]=ll;
+      prob[ll]-=1.-prob[ss];
+      if (prob[ll]<1.) {
+	small[nsmall++]=ll;
+      } else {
+	large[nlarge++]=ll;
+      }
+    }
+
+    // Remaining bins differ from the mean value only due to
+    // rounding errors.
+    while (nlarge>0) {
+      prob[large[--nlarge]]=1.;
+    }
+    while (nsmall>0) {
+      prob[small[--nsmall]]=1.;
+    }
+
+  } while(0); // END of error handling loop.
+
+  // Release memory.
+  if (NULL!=small) free(small);
+  if (NULL!=large) free(large);
+}
+
+
+/** Draw a bin from an alias table using a single random number in
+    the interval [0,1). The integer part of the scaled random number
+    selects a bin, the fractional part decides between the bin and
+    its alias. */
+static inline long drawAliasTable(const double* const aliasprob,
+				  const long* const alias,
+				  const long nbins,
+				  const double rnd)
+{
+  double x=rnd*nbins;
+  long bin=MIN((long)x, nbins-1);
+  if (x-bin>=aliasprob[bin]) {
+    bin=alias[bin];
+  }
+  return(bin);
+}
+
+
+/** Check whether the energy grid of the mission-independent spectrum
+    agrees with the given energy grid. Spectra loaded together usually
+    refer to the same array. */
+static int isSimputMIdpSpecGrid(const SimputMIdpSpec* const spec,
+				const long nentries,
+				const float* const energy)
+{
+  return((spec->nentries==nentries) &&
+	 ((0==nentries) || (spec->energy==energy) ||
+	  (0==memcmp(spec->energy, energy, nentries*sizeof(float)))));
+}
+
+
+/** Determine the weights for the convolution of mission-independent
+    spectra, which are defined on the same energy grid as the given
+    spectrum, with the ARF. The overlap of the spectral points with
+    the ARF bins is determined in the same way and in the same order
+    as in the former point-by-point convolution, such that the
+    resulting distributions are identical. */
+static struct SimputARFGrid* newSimputARFGrid(const struct ARF* const arf,
+					      const SimputMIdpSpec* const midpspec,
+					      int* const status)
+{
+  struct SimputARFGrid* ag=
+    (struct SimputARFGrid*)malloc(sizeof(struct SimputARFGrid));
+  CHECK_NULL_RET(ag, *status,
+		 "memory allocation for SimputARFGrid failed", ag);
+
+  ag->arf     =(struct ARF*)arf;
+  ag->nentries=midpspec->nentries;
+  ag->energy  =NULL;
+  ag->first   =NULL;
+  ag->offset  =NULL;
+  ag->weight  =NULL;
+  ag->partial =0;
+
+  do { // Error handling loop.
+    const long nbins=arf->NumberEnergyBins;
+
+    ag->energy=(float*)malloc((midpspec->nentries+1)*sizeof(float));
+    CHECK_NULL_BREAK(ag->energy, *status,
+		     "memory allocation for SimputARFGrid failed");
+    ag->first=(long*)malloc(nbins*sizeof(long));
+    CHECK_NULL_BREAK(ag->first, *status,
+		     "memory allocation for SimputARFGrid failed");
+    ag->offset=(long*)malloc((nbins+1)*sizeof(long));
+    CHECK_NULL_BREAK(ag->offset, *status,
+		     "memory allocation for SimputARFGrid failed");
+    // The spectral points contributing to subsequent ARF bins overlap
+    // by at most one point.
+    ag->weight=(float*)malloc((nbins+midpspec->nentries)*sizeof(float));
+    CHECK_NULL_BREAK(ag->weight, *status,
+		     "memory allocation for SimputARFGrid failed");
+    if (midpspec->nentries>0) {
+      memcpy(ag->energy, midpspec->energy,
+	     midpspec->nentries*sizeof(float));
+    }
+
+    // Loop over all bins of the ARF.
+    long ii, jj=0, nweights=0;
+    for (ii=0; ii<nbins; ii++) {
+      ag->offset[ii]=nweights;
+      ag->first[ii]=jj;
+
+      // Lower boundary of the current bin.
+      float lo=arf->LowEnergy[ii];
+
+      // Loop over all spectral points within the ARF bin.
+      int finished=0;
+      do {
+	// Determine the next spectral point.
+	float spec_emin=0., spec_emax=0.;
+	for ( ; jj<midpspec->nentries; jj++) {
+	  getMIdpSpecEbounds(midpspec, jj, &spec_emin, &spec_emax);
+	  if (spec_emax>lo) break;
+	}
+
+	// Check special cases.
+	if ((0==jj) && (spec_emin>arf->LowEnergy[ii])) {
+	  ag->partial=1;
+	  if (spec_emin>arf->HighEnergy[ii]) break;
+
+	} else if (jj==midpspec->nentries) {
+	  ag->partial=1;
+	  break;
+	}
+
+	// Upper boundary of the current bin.
+	float hi;
+	if (spec_emax<=arf->HighEnergy[ii]) {
+	  hi=spec_emax;
+	} else {
+	  hi=arf->HighEnergy[ii];
+	  finished=1;
+	}
+
+	// Points skipped within the bin have zero width and
+	// obtain a weight of 0.
+	if (ag->offset[ii]==nweights) {
+	  ag->first[ii]=jj;
+	}
+	while (ag->first[ii]+nweights-ag->offset[ii]<jj) {
+	  ag->weight[nweights++]=0.;
+	}
+	ag->weight[nweights++]=(hi-lo)*arf->EffArea[ii];
+
+	// Increase the lower boundary.
+	lo=hi;
+
+      } while (0==finished);
+    } // Loop over all ARF bins.
+    ag->offset[nbins]=nweights;
+
+  } while(0); // END of error handling loop.
+
+  if (EXIT_SUCCESS!=*status) {
+    freeSimputARFGrid(&ag);
+  }
+
+  return(ag);
+}
+
+
+/** Return the convolution weights for the energy grid of the given
+    mission-independent spectrum. The weights for the most recently
+    used grid are kept in the catalog. */
+static struct SimputARFGrid* getSimputARFGrid(SimputCtlg* const cat,
+					      const SimputMIdpSpec* const midpspec,
+					      int* const status)
+{
+  struct SimputARFGrid* ag=(struct SimputARFGrid*)cat->arfgrid;
+  if ((NULL!=ag) && (ag->arf==cat->arf) &&
+      (isSimputMIdpSpecGrid(midpspec, ag->nentries, ag->energy))) {
+    return(ag);
+  }
+
+  freeSimputARFGrid((struct SimputARFGrid**)&(cat->arfgrid));
+  cat->arfgrid=newSimputARFGrid(cat->arf, midpspec, status);
+  return((struct SimputARFGrid*)cat->arfgrid);
+}
+
+
+/** Convolve the given mission-independent spectra with the
+    instrument ARF. The spectra must be defined on the same energy
+    grid. The products of this process are the spectral probability
+    distributions binned to the energy grid of the ARF. The spectra
+    are processed in blocks, such that the inner loop runs over the
+    spectra of a block and can be vectorized by the compiler. On
+    error, the spectra, which have already been created, are
+    returned and must be released by the calling routine. */
+static void convSimputMIdpSpecsWithARF(SimputCtlg* const cat,
+				       SimputMIdpSpec** const midpspecs,
+				       const long nspecs,
+				       SimputSpec** const specs,
+				       int* const status)
+{
+  float* flux=NULL;
+  double* sum=NULL;
+
+  long ss;
+  for (ss=0; ss<nspecs; ss++) {
+    specs[ss]=NULL;
+  }
+  if (nspecs<1) return;
+
+  do { // Error handling loop.
+    // Check if the ARF is defined.
+    CHECK_NULL_BREAK(cat->arf, *status, "instrument ARF undefined");
+    const long nbins=cat->arf->NumberEnergyBins;
+
+    struct SimputARFGrid* ag=getSimputARFGrid(cat, midpspecs[0], status);
+    CHECK_STATUS_BREAK(*status);
+
+    long blocksize=MIN(nspecs, SIMPUT_CONV_BLOCKSIZE);
+    sum=(double*)malloc(blocksize*sizeof(double));
+    CHECK_NULL_BREAK(sum, *status,
+		     "memory allocation for spectral distribution failed");
+    if (blocksize>1) {
+      flux=(float*)malloc(ag->nentries*blocksize*sizeof(float));
+      CHECK_NULL_BREAK(flux, *status,
+		       "memory allocation for spectral distribution failed");
+    }
+
+    // Loop over all blocks of spectra.
+    long start;
+    for (start=0; start<nspecs; start+=blocksize) {
+      long nn=MIN(blocksize, nspecs-start);
+      SimputMIdpSpec** const mspecs=&(midpspecs[start]);
+      SimputSpec** const bspecs=&(specs[start]);
+
+      // Allocate memory.
+      for (ss=0; ss<nn; ss++) {
+	assert(isSimputMIdpSpecGrid(mspecs[ss], ag->nentries, ag->energy));
+	bspecs[ss]=newSimputSpec(status);
+	CHECK_STATUS_BREAK(*status);
+	bspecs[ss]->distribution=(double*)malloc(nbins*sizeof(double));
+	CHECK_NULL_BREAK(bspecs[ss]->distribution, *status,
+			 "memory allocation for spectral distribution failed");
+      }
+      CHECK_STATUS_BREAK(*status);
+
+      // Arrange the flux densities of the block such that the values
+      // of the individual spectra at the same energy are adjacent.
+      const float* bflux;
+      if (nn>1) {
+	long jj;
+	for (jj=0; jj<ag->nentries; jj++) {
+	  for (ss=0; ss<nn; ss++) {
+	    flux[jj*nn+ss]=mspecs[ss]->fluxdensity[jj];
+	  }
+	}
+	bflux=flux;
+      } else {
+	bflux=mspecs[0]->fluxdensity;
+      }
+
+      // Loop over all bins of the ARF.
+      long ii;
+      for (ii=0; ii<nbins; ii++) {
+	for (ss=0; ss<nn; ss++) {
+	  sum[ss]=0.;
+	}
+
+	// Add the contributions of the spectral points within the bin.
+	long kk, jj=ag->first[ii];
+	for (kk=ag->offset[ii]; kk<ag->offset[ii+1]; kk++, jj++) {
+	  const float weight=ag->weight[kk];
+	  const float* const fd=&(bflux[jj*nn]);
+	  for (ss=0; ss<nn; ss++) {
+	    sum[ss]+=weight*fd[ss];
+	  }
+	}
+
+	// Create the spectral distribution function
+	// normalized to the total photon number [photons].
+	if (ii>0) {
+	  for (ss=0; ss<nn; ss++) {
+	    bspecs[ss]->distribution[ii]=
+	      sum[ss]+bspecs[ss]->distribution[ii-1];
+	  }
+	} else {
+	  for (ss=0; ss<nn; ss++) {
+	    bspecs[ss]->distribution[ii]=sum[ss];
+	  }
+	}
+      } // Loop over all ARF bins.
+
+      for (ss=0; ss<nn; ss++) {
+	if (0!=ag->partial) {
+	  char msg[SIMPUT_MAXSTR];
+	  sprintf(msg, "the spectrum '%s' does not cover the "
+		  "full energy range of the ARF", mspecs[ss]->fileref);
+	  SIMPUT_WARNING(msg);
+	}
+
+	// Set up the alias table, if required.
+	if (SIMPUT_SAMPLING_ALIAS==cat->specsampling) {
+	  buildAliasTable(bspecs[ss]->distribution, nbins,
+			  &bspecs[ss]->aliasprob, &bspecs[ss]->alias, status);
+	  CHECK_STATUS_BREAK(*status);
+	}
+
+	// Copy the file reference to the spectrum for later comparisons.
+	bspecs[ss]->fileref=
+	  (char*)malloc((strlen(mspecs[ss]->fileref)+1)*sizeof(char));
+	CHECK_NULL_BREAK(bspecs[ss]->fileref, *status,
+			 "memory allocation for file reference failed");
+	strcpy(bspecs[ss]->fileref, mspecs[ss]->fileref);
+	bspecs[ss]->refid=mspecs[ss]->refid;
+      }
+      CHECK_STATUS_BREAK(*status);
+    } // Loop over all blocks of spectra.
+
+  } while(0); // END of error handling loop.
+
+  // Release memory.
+  if (NULL!=flux) free(flux);
+  if (NULL!=sum) free(sum);
+}
+
+
+/** Convolve the given mission-independent spectrum with the
+    instrument ARF. The product of this process is the spectral
+    probability distribution binned to the energy grid of the ARF. */
+static SimputSpec* convSimputMIdpSpecWithARF(SimputCtlg* const cat,
+					     SimputMIdpSpec* const midpspec,
+					     int* const status)
+{
+  SimputMIdpSpec* midpspecs[1]={ midpspec };
+  SimputSpec* spec=NULL;
+  convSimputMIdpSpecsWithARF(cat, midpspecs, 1, &spec, status);
+  return(spec);
+}
+
+
+/** Length of the header of a file caching spectral distributions
+    [bytes]. */
+#define SPECDISK_HEADERLEN (24)
+/** Length of the fixed part of a record [bytes]. */
+#define SPECDISK_RECHEADERLEN (48)
+/** Magic string identifying a file caching spectral distributions. */
+static const char specdisk_magic[8]={'S','I','M','P','S','P','C','2'};
+
+
+/** Round up to a multiple of 8 bytes. */
+static inline int64_t alignSpecDisk(const int64_t len)
+{
+  return((len+7)&~(int64_t)7);
+}
 
-      // Determine the relative location with respect to the
-      // location of the light curve.
-      if ('['==specref[0]) {
-        char* firstbrack=strchr(timeref, '[');
-        strcpy(firstbrack, specref);
-        strcpy(specref, timeref);
-      } else if (('/'!=specref[0])&&(NULL!=strchr(timeref, '/'))) {
-        char* lastslash=strrchr(timeref, '/');
-        lastslash++;
-        strcpy(lastslash, specref);
-        strcpy(specref, timeref);
-      }
 
-      return;
-    }
+/** Determine a hash of the contents of the ARF (64 bit FNV-1a). */
+static uint64_t hashSimputARF(const struct ARF* const arf)
+{
+  uint64_t hash=UINT64_C(0xcbf29ce484222325);
+  const float* arrays[3]={ arf->LowEnergy, arf->HighEnergy, arf->EffArea };
+  long nbins=arf->NumberEnergyBins;
+  long ii;
+  size_t jj;
+  for (jj=0; jj<sizeof(nbins); jj++) {
+    hash=(hash^((const unsigned char*)&nbins)[jj])*UINT64_C(0x100000001b3);
   }
-  else{
-    // If this function is being executed, a light curve is
-    // supposed to exist in the simput cataloge. If no
-    // light curve is avaliable there is an error somewhere:
-    SIMPUT_ERROR("There is no light curve with a spectrum "
-		 " column avaliable");
-    *status=EXIT_FAILURE;
-    return;
+  for (ii=0; ii<3; ii++) {
+    const unsigned char* data=(const unsigned char*)arrays[ii];
+    for (jj=0; jj<nbins*sizeof(float); jj++) {
+      hash=(hash^data[jj])*UINT64_C(0x100000001b3);
+    }
   }
+  return(hash);
 }
 
 
-static void getSrcImagRef(SimputCtlg* const cat,
-			  const SimputSrc* const src,
-			  const double prevtime,
-			  const double mjdref,
-			  char* const imagref,
-			  int* const status)
+/** Determine the modification time (seconds and nanoseconds), the
+    size, and the inode number of the FITS file, which the specified
+    reference to a mission-independent spectrum refers to. A record
+    of the cache is only valid, if all of them agree, since the
+    modification time alone might not change, if the file is
+    rewritten within the resolution of the file system or replaced by
+    a copy. The result of the last query is kept, since usually many
+    spectra are contained in the same file. The return value is 1 on
+    success and 0 if the file cannot be accessed. */
+static int statSimputSpecDiskCache(struct SimputSpecDiskCache* const sc,
+				   const char* const fileref,
+				   int64_t* const stat4)
 {
-  // Initialize with an empty string.
-  strcpy(imagref, "");
+  char rootname[SIMPUT_MAXSTR];
+  int status=EXIT_SUCCESS;
+  if (strlen(fileref)>=SIMPUT_MAXSTR) return(0);
+  fits_parse_rootname((char*)fileref, rootname, &status);
+  if (EXIT_SUCCESS!=status) return(0);
+
+  if ((0==sc->statvalid) || (0!=strcmp(sc->statfile, rootname))) {
+    struct stat st;
+    if (0!=stat(rootname, &st)) return(0);
+    strcpy(sc->statfile, rootname);
+    sc->statvals[0]=(int64_t)st.st_mtime;
+#ifdef __APPLE__
+    sc->statvals[1]=(int64_t)st.st_mtimespec.tv_nsec;
+#else
+    sc->statvals[1]=(int64_t)st.st_mtim.tv_nsec;
+#endif
+    sc->statvals[2]=(int64_t)st.st_size;
+    sc->statvals[3]=(int64_t)st.st_ino;
+    sc->statvalid=1;
+  }
+  memcpy(stat4, sc->statvals, sizeof(sc->statvals));
+  return(1);
+}
 
-  // Determine the timing extension.
-  char timeref[SIMPUT_MAXSTR];
-  getSrcTimeRef(cat, src, timeref);
-  CHECK_STATUS_VOID(*status);
 
-  int timetype=getSimputExtType(cat, timeref, status);
-  CHECK_STATUS_VOID(*status);
+/** Stop using the cache file after a problem, which is reported as a
+    warning. The simulation continues without the cache. */
+static void failSimputSpecDiskCache(struct SimputSpecDiskCache* const sc,
+				    const char* const reason)
+{
+  char msg[SIMPUT_MAXSTR];
+  snprintf(msg, SIMPUT_MAXSTR, "%s spectrum cache file '%s', "
+	   "continue without it", reason, sc->filename);
+  SIMPUT_WARNING(msg);
+  if (sc->fd>=0) {
+    close(sc->fd);
+    sc->fd=-1;
+  }
+  sc->failed=1;
+}
 
-  if (EXTTYPE_LC==timetype) {
-    // Get the respective light curve.
-    SimputLC* lc=getSimputLC(cat, src, timeref, prevtime, mjdref, status);
-    CHECK_STATUS_VOID(*status);
 
-    // Check if there is an image column in the light curve.
-    if (NULL!=lc->image) {
-      // Determine the current light curve bin.
-      long long nperiods;
-      long bin=getLCBin(lc, prevtime, mjdref, &nperiods, status);
-      CHECK_STATUS_VOID(*status);
+/** Open the cache file for the current ARF of the catalog, if it is
+    not open yet. The contents of the file are mapped into memory and
+    the records, which are still valid, are indexed. The return value
+    is the cache or NULL if no cache is used. */
+static struct SimputSpecDiskCache* openSimputSpecDiskCache(SimputCtlg* const cat,
+							   int* const status)
+{
+  struct SimputSpecDiskCache* sc=getSimputSpecDiskCache(cat, status);
+  CHECK_STATUS_RET(*status, NULL);
+  if ((NULL==sc->dirname) || (NULL==cat->arf)) return(NULL);
+  if ((sc->arf==cat->arf) && (NULL!=sc->filename)) {
+    return((0==sc->failed) ? sc : NULL);
+  }
 
-      // Check if an image is defined in this light curve bin.
-      if ((0==strcmp(lc->image[bin], "NULL")) ||
-	  (0==strcmp(lc->image[bin], " ")) ||
-	  (0==strlen(lc->image[bin]))) {
-	SIMPUT_ERROR("in the current implementation light curves "
-		     "must not contain blank entries in a given "
-		     "image column");
-	*status=EXIT_FAILURE;
-	return;
-      }
+  // The cache file refers to a different ARF.
+  closeSimputSpecDiskCache(sc, status);
+  CHECK_STATUS_RET(*status, NULL);
+  sc->arf=cat->arf;
+  const uint64_t arfhash=hashSimputARF(cat->arf);
+  const int64_t nbins=cat->arf->NumberEnergyBins;
 
-      // Copy the reference to the image.
-      strcpy(imagref, lc->image[bin]);
+  sc->filename=(char*)malloc((strlen(sc->dirname)+40)*sizeof(char));
+  CHECK_NULL_RET(sc->filename, *status,
+		 "memory allocation for file name failed", NULL);
+  sprintf(sc->filename, "%s/simput_spec2_%016llx.cache", sc->dirname,
+	  (unsigned long long)arfhash);
 
-      // Determine the relative location with respect to the
-      // location of the light curve.
-      if ('['==imagref[0]) {
-	char* firstbrack=strchr(timeref, '[');
-	strcpy(firstbrack, imagref);
-	strcpy(imagref, timeref);
-      } else if (('/'!=imagref[0])&&(NULL!=strchr(timeref, '/'))) {
-	char* lastslash=strrchr(timeref, '/');
-	lastslash++;
-	strcpy(lastslash, imagref);
-	strcpy(imagref, timeref);
-      }
+  sc->records=newSimputCacheIndex(0, NULL, status);
+  CHECK_STATUS_RET(*status, NULL);
 
-      return;
+  // Create the file with its header, unless it exists already.
+  sc->fd=open(sc->filename, O_RDWR|O_CREAT|O_EXCL|O_APPEND, 0644);
+  if (sc->fd>=0) {
+    char header[SPECDISK_HEADERLEN];
+    memcpy(header, specdisk_magic, 8);
+    memcpy(header+8, &arfhash, 8);
+    memcpy(header+16, &nbins, 8);
+    if (SPECDISK_HEADERLEN!=write(sc->fd, header, SPECDISK_HEADERLEN)) {
+      failSimputSpecDiskCache(sc, "could not write to");
+      return(NULL);
     }
+    return(sc);
   }
 
-  // If no light curve extension with an image column is given,
-  // determine the spectrum reference directly from the source
-  // description.
-  if (NULL!=src->image) {
-    // Check if this is a valid HDU reference.
-    if ((0==strcmp(src->image, "NULL")) ||
-	(0==strcmp(src->image, " ")) ||
-	(0==strlen(src->image))) {
-      return;
-    }
-
-    strcpy(imagref, src->image);
+  sc->fd=open(sc->filename, O_RDWR|O_APPEND);
+  if (sc->fd<0) {
+    failSimputSpecDiskCache(sc, "could not open");
+    return(NULL);
+  }
+  struct stat st;
+  if ((0!=fstat(sc->fd, &st)) || (st.st_size<SPECDISK_HEADERLEN)) {
+    failSimputSpecDiskCache(sc, "could not access");
+    return(NULL);
+  }
+  sc->map=mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, sc->fd, 0);
+  if (MAP_FAILED==sc->map) {
+    sc->map=NULL;
+    failSimputSpecDiskCache(sc, "could not map");
+    return(NULL);
+  }
+  sc->mapsize=st.st_size;
+
+  // Check the header.
+  const char* const data=(const char*)sc->map;
+  uint64_t filehash;
+  int64_t filenbins;
+  memcpy(&filehash, data+8, 8);
+  memcpy(&filenbins, data+16, 8);
+  if ((0!=memcmp(data, specdisk_magic, 8)) || (filehash!=arfhash) ||
+      (filenbins!=nbins)) {
+    failSimputSpecDiskCache(sc, "invalid header in");
+    return(NULL);
+  }
 
-    // Set path and file name if missing.
-    if ('['==imagref[0]) {
-      char buffer[SIMPUT_MAXSTR];
-      strcpy(buffer, cat->filepath);
-      strcat(buffer, cat->filename);
-      strcat(buffer, imagref);
-      strcpy(imagref, buffer);
-    } else {
-      if ('/'!=imagref[0]) {
-	char buffer[SIMPUT_MAXSTR];
-	strcpy(buffer, cat->filepath);
-	strcat(buffer, imagref);
-	strcpy(imagref, buffer);
+  // Index the records. A record, which has been stored for a
+  // modified FITS file, is ignored. An incomplete record at the end
+  // of the file, e.g., after an interrupted run, is ignored, too.
+  int64_t pos=SPECDISK_HEADERLEN;
+  while ((int64_t)sc->mapsize-pos>=SPECDISK_RECHEADERLEN) {
+    int64_t rec[6];
+    memcpy(rec, data+pos, SPECDISK_RECHEADERLEN);
+    if ((rec[5]<=0) || (rec[0]>(int64_t)sc->mapsize-pos) ||
+	(rec[0]!=SPECDISK_RECHEADERLEN+alignSpecDisk(rec[5])+
+	 nbins*(int64_t)sizeof(double))) {
+      break;
+    }
+    const char* const fileref=data+pos+SPECDISK_RECHEADERLEN;
+    if ('\0'!=fileref[rec[5]-1]) break;
+
+    int64_t stat4[4];
+    if (statSimputSpecDiskCache(sc, fileref, stat4) &&
+	(0==memcmp(stat4, &rec[1], sizeof(stat4)))) {
+      long refid=getSimputCtlgRefId(cat, fileref, status);
+      CHECK_STATUS_RET(*status, NULL);
+      if (!containsSimputCacheIndex(sc->records, refid)) {
+	insertSimputCacheIndex(sc->records, refid, (void*)(data+pos), 0,
+			       status);
+	CHECK_STATUS_RET(*status, NULL);
       }
     }
+    pos+=rec[0];
   }
+
+  return(sc);
 }
 
 
-static SimputMIdpSpec* getSimputMIdpSpec(SimputCtlg* const cat,
+/** Return the spectral distribution with the specified reference
+    identifier from the cache on disk or NULL if it is not
+    available. */
+static SimputSpec* loadSimputSpecDiskCache(SimputCtlg* const cat,
+					   const long refid,
+					   int* const status)
+{
+  struct SimputSpecDiskCache* sc=openSimputSpecDiskCache(cat, status);
+  if ((NULL==sc) || !containsSimputCacheIndex(sc->records, refid)) {
+    return(NULL);
+  }
+  const char* const rec=(const char*)searchSimputCacheIndex(sc->records, refid);
+  if (NULL==rec) return(NULL);
+
+  int64_t reflen;
+  memcpy(&reflen, rec+40, 8);
+  const char* const fileref=rec+SPECDISK_RECHEADERLEN;
+  const long nbins=cat->arf->NumberEnergyBins;
+
+  SimputSpec* spec=newSimputSpec(status);
+  CHECK_STATUS_RET(*status, spec);
+  spec->distribution=(double*)malloc(nbins*sizeof(double));
+  CHECK_NULL_RET(spec->distribution, *status,
+		 "memory allocation for spectral distribution failed", spec);
+  memcpy(spec->distribution, fileref+alignSpecDisk(reflen),
+	 nbins*sizeof(double));
+
+  // Set up the alias table, if required.
+  if (SIMPUT_SAMPLING_ALIAS==cat->specsampling) {
+    buildAliasTable(spec->distribution, nbins,
+		    &spec->aliasprob, &spec->alias, status);
+    CHECK_STATUS_RET(*status, spec);
+  }
+
+  spec->fileref=(char*)malloc((strlen(fileref)+1)*sizeof(char));
+  CHECK_NULL_RET(spec->fileref, *status,
+		 "memory allocation for file reference failed", spec);
+  strcpy(spec->fileref, fileref);
+  spec->refid=refid;
+
+  return(spec);
+}
+
+
+/** Append the spectral distribution to the cache on disk, unless it
+    is contained already. */
+static void storeSimputSpecDiskCache(SimputCtlg* const cat,
+				     const SimputSpec* const spec,
+				     int* const status)
+{
+  struct SimputSpecDiskCache* sc=openSimputSpecDiskCache(cat, status);
+  if ((NULL==sc) || containsSimputCacheIndex(sc->records, spec->refid)) {
+    return;
+  }
+
+  int64_t rec[6];
+  if (!statSimputSpecDiskCache(sc, spec->fileref, &rec[1])) {
+    return;
+  }
+  const int64_t nbins=cat->arf->NumberEnergyBins;
+  rec[5]=strlen(spec->fileref)+1;
+  rec[0]=SPECDISK_RECHEADERLEN+alignSpecDisk(rec[5])+
+    nbins*(int64_t)sizeof(double);
+
+  // The record is written at once, such that records of different
+  // processes using the same file are not interleaved.
+  char* buffer=(char*)calloc(rec[0], sizeof(char));
+  CHECK_NULL_VOID(buffer, *status, "memory allocation for record failed");
+  memcpy(buffer, rec, SPECDISK_RECHEADERLEN);
+  memcpy(buffer+SPECDISK_RECHEADERLEN, spec->fileref, rec[5]);
+  memcpy(buffer+SPECDISK_RECHEADERLEN+alignSpecDisk(rec[5]),
+	 spec->distribution, nbins*sizeof(double));
+  ssize_t nwritten=write(sc->fd, buffer, rec[0]);
+  free(buffer);
+  if (nwritten!=rec[0]) {
+    failSimputSpecDiskCache(sc, "could not write to");
+    return;
+  }
+
+  insertSimputCacheIndex(sc->records, spec->refid, NULL, 0, status);
+}
+
+
+static SimputSpec* getSimputSpecUnlocked(SimputCtlg* const cat,
 					 const char* const filename,
 					 int* const status)
 {
   // Search if the spectrum is available in the buffer.
-  SimputMIdpSpec* spec=
-    searchSimputMIdpSpecBuffer(cat->midpspecbuff, filename);
+  long refid=getSimputCtlgRefId(cat, filename, status);
+  CHECK_STATUS_RET(*status, NULL);
+  SimputSpec* spec=(SimputSpec*)searchSimputCacheIndex(cat->specbuff, refid);
   if (NULL!=spec) {
     return(spec);
   }
 
   // The required spectrum is not contained in the buffer.
-  // Therefore it must be loaded from the specified location.
-
-  // Load the mission-independent spectrum.
-  spec=loadSimputMIdpSpec(filename, status);
+  // Therefore we must take it from the cache on disk or determine
+  // it from the referred mission-independent spectrum and store it
+  // in the buffer.
+  spec=loadSimputSpecDiskCache(cat, refid, status);
   CHECK_STATUS_RET(*status, spec);
+  if (NULL==spec) {
+    // Obtain the mission-independent spectrum.
+    SimputMIdpSpec* midpspec=getSimputMIdpSpec(cat, filename, status);
+    CHECK_STATUS_RET(*status, NULL);
 
-  // Insert the spectrum into the buffer.
-  insertSimputMIdpSpecBuffer(&(cat->midpspecbuff), spec, status);
-  CHECK_STATUS_RET(*status, spec);
+    // Convolve it with the ARF.
+    spec=convSimputMIdpSpecWithARF(cat, midpspec, status);
+    CHECK_STATUS_RET(*status, spec);
+
+    storeSimputSpecDiskCache(cat, spec, status);
+    CHECK_STATUS_RET(*status, spec);
+  }
+
+  // Insert the spectrum into the buffer. Spectra of a shared catalog
+  // might be in use by other threads and are therefore never
+  // released.
+  if (NULL==cat->specbuff) {
+    cat->specbuff=
+      newSimputSpecBuffer(cat->cachecap[EXTTYPE_MIDPSPEC], cat, status);
+  }
+  if (EXIT_SUCCESS==*status) {
+    manageSimputCtlgCache(cat, cat->specbuff, status);
+  }
+  if (EXIT_SUCCESS==*status) {
+    insertSimputCacheIndex(cat->specbuff, refid, spec,
+			   !isSimputCtlgShared(cat), status);
+  }
+  if (EXIT_SUCCESS!=*status) {
+    freeSimputSpec(&spec);
+  }
 
   return(spec);
 }
 
 
-SimputMIdpSpec* getSimputSrcMIdpSpec(SimputCtlg* const cat,
-				     const SimputSrc* const src,
-				     const double prevtime,
-				     const double mjdref,
-				     int* const status)
+/** Return the requested spectral distribution from the buffer shared
+    by the catalog and its per-thread contexts. For a shared catalog
+    the alias table is set up before the spectrum is returned, since
+    it must not be modified while it is used by other threads. */
+static SimputSpec* getSimputSpec(SimputCtlg* const cat,
+				 const char* const filename,
+				 int* const status)
 {
-  char specref[SIMPUT_MAXSTR];
-  getSimputSrcSpecRef(cat, src, prevtime, mjdref, specref, status);
-  CHECK_STATUS_RET(*status, 0);
+  lockSimputCtlg(cat);
+  SimputCtlg* core=getSimputCtlgCore(cat);
+  SimputSpec* spec=getSimputSpecUnlocked(core, filename, status);
+  if ((EXIT_SUCCESS==*status) && isSimputCtlgShared(core) &&
+      (SIMPUT_SAMPLING_ALIAS==core->specsampling) && (NULL==spec->alias)) {
+    buildAliasTable(spec->distribution, core->arf->NumberEnergyBins,
+		    &spec->aliasprob, &spec->alias, status);
+  }
+  unlockSimputCtlg(cat);
+  return(spec);
+}
 
-  int spectype=getSimputExtType(cat, specref, status);
-  CHECK_STATUS_RET(*status, 0);
 
-  if (EXTTYPE_MIDPSPEC==spectype) {
-    // Determine the spectrum.
-    SimputMIdpSpec* spec=getSimputMIdpSpec(cat, specref, status);
-    CHECK_STATUS_RET(*status, 0);
+/** Determine the reference to an extension given in a bin of a light
+    curve relative to the location of the light curve. */
+static void getLCBinRef(const char* const timeref,
+			const char* const binref,
+			char* const ref)
+{
+  if ('['==binref[0]) {
+    strcpy(ref, timeref);
+    char* firstbrack=strchr(ref, '[');
+    if (NULL!=firstbrack) {
+      strcpy(firstbrack, binref);
+    } else {
+      strcat(ref, binref);
+    }
+  } else if (('/'!=binref[0]) && (NULL!=strchr(timeref, '/'))) {
+    strcpy(ref, timeref);
+    char* lastslash=strrchr(ref, '/');
+    strcpy(lastslash+1, binref);
+  } else {
+    strcpy(ref, binref);
+  }
+}
 
-    return(spec);
 
-  } else {
-    SIMPUT_ERROR("source does not refer to a mission-independent spectrum");
-    *status=EXIT_FAILURE;
+/** Set up the table of the spectra in the bins of a light curve
+    with a SPECTRUM column. Blank entries are only reported as an
+    error, when the respective bin is used. */
+static struct SimputLCSpecTable* newSimputLCSpecTableForLC(SimputCtlg* const cat,
+							   const SimputLC* const lc,
+							   const char* const timeref,
+							   int* const status)
+{
+  struct SimputLCSpecTable* st=newSimputLCSpecTable(lc->nentries, status);
+  CHECK_STATUS_RET(*status, NULL);
+
+  long ii;
+  for (ii=0; ii<lc->nentries; ii++) {
+    // Resolve the reference to the spectrum and determine its type.
+    if ((0!=strcmp(lc->spectrum[ii], "NULL")) &&
+	(0!=strcmp(lc->spectrum[ii], " ")) &&
+	(0!=strlen(lc->spectrum[ii]))) {
+      char ref[SIMPUT_MAXSTR];
+      getLCBinRef(timeref, lc->spectrum[ii], ref);
+      st->ref[ii]=internSimputCtlgRef(cat, ref, status);
+      CHECK_STATUS_BREAK(*status);
+      st->type[ii]=getSimputExtType(cat, st->ref[ii], status);
+      CHECK_STATUS_BREAK(*status);
+    }
+
+    // Time of the bin used for the interpolation between the spectra.
+    if (NULL!=lc->phase) {
+      st->time[ii]=lc->phase[ii]*lc->period;
+    } else {
+      st->time[ii]=getLCTimeValue(lc, ii);
+    }
+  }
+  if (EXIT_SUCCESS!=*status) {
+    freeSimputLCSpecTable(&st);
     return(NULL);
   }
+
+  for (ii=0; ii<lc->nentries-1; ii++) {
+    st->rwidth[ii]=1./(st->time[ii+1]-st->time[ii]);
+  }
+  st->rwidth[lc->nentries-1]=0.;
+
+  return(st);
 }
 
 
-static inline void getMIdpSpecEbounds(const SimputMIdpSpec* const spec,
-				      const long idx,
-				      float* const emin,
-				      float* const emax)
+/** Return the table of the spectra in the bins of a light curve with
+    a SPECTRUM column. If it does not exist yet, it is created. The
+    tables of the light curves of a shared catalog are set up, when
+    the first per-thread context is created. */
+static struct SimputLCSpecTable* getSimputLCSpecTable(SimputCtlg* const cat,
+						      SimputLC* const lc,
+						      const char* const timeref,
+						      int* const status)
 {
-  // Determine the lower boundary.
-  if (idx>0) {
-    *emin=0.5*(spec->energy[idx]+spec->energy[idx-1]);
-  } else {
-    *emin=spec->energy[idx];
+  if (NULL!=lc->spectable) {
+    return((struct SimputLCSpecTable*)lc->spectable);
   }
 
-  // Determine the upper boundary.
-  if (idx<spec->nentries-1) {
-    *emax=0.5*(spec->energy[idx+1]+spec->energy[idx]);
-  } else {
-    *emax=spec->energy[idx];
+  lockSimputCtlg(cat);
+  if (NULL==lc->spectable) {
+    lc->spectable=newSimputLCSpecTableForLC(cat, lc, timeref, status);
   }
+  unlockSimputCtlg(cat);
+  return((struct SimputLCSpecTable*)lc->spectable);
 }
 
 
-/** Convolve the given mission-independent spectrum with the
-    instrument ARF. The product of this process is the spectral
-    probability distribution binned to the energy grid of the ARF. */
-static SimputSpec* convSimputMIdpSpecWithARF(SimputCtlg* const cat,
-					     SimputMIdpSpec* const midpspec,
-					     int* const status)
+/** Reset the spectral distributions in the table, if spectra have
+    been released from the buffer of the catalog since they were
+    obtained. */
+static void updateLCSpecTableEvicted(const SimputCtlg* const cat,
+				     struct SimputLCSpecTable* const st)
 {
-  SimputSpec* spec=NULL;
-  // Check if the ARF is defined.
-  CHECK_NULL_RET(cat->arf, *status, "instrument ARF undefined", spec);
-
-  // Allocate memory.
-  spec=newSimputSpec(status);
-  CHECK_STATUS_RET(*status, spec);
-  spec->distribution=
-    (double*)malloc(cat->arf->NumberEnergyBins*sizeof(double));
-  CHECK_NULL_RET(spec->distribution, *status,
-		 "memory allocation for spectral distribution failed", spec);
+  long evicted=getSimputCacheIndexNEvicted(getSimputCtlgCore(cat)->specbuff);
+  if (evicted==st->evicted) {
+    return;
+  }
 
-  // Loop over all bins of the ARF.
-  long ii, jj=0;
-  int warning_printed=0; // Flag whether warning has been printed.
-  for (ii=0; ii<cat->arf->NumberEnergyBins; ii++) {
-    // Initialize with 0.
-    spec->distribution[ii]=0.;
-
-    // Lower boundary of the current bin.
-    float lo=cat->arf->LowEnergy[ii];
-
-    // Loop over all spectral points within the ARF bin.
-    int finished=0;
-    do {
-      // Determine the next spectral point.
-      float spec_emin=0., spec_emax=0.;
-      for ( ; jj<midpspec->nentries; jj++) {
-	getMIdpSpecEbounds(midpspec, jj, &spec_emin, &spec_emax);
-	if (spec_emax>lo) break;
-      }
-
-      // Check special cases.
-      if ((0==jj) && (spec_emin>cat->arf->LowEnergy[ii])) {
-	if (0==warning_printed) {
-	  char msg[SIMPUT_MAXSTR];
-	  sprintf(msg, "the spectrum '%s' does not cover the "
-		  "full energy range of the ARF", midpspec->fileref);
-	  SIMPUT_WARNING(msg);
-	  warning_printed=1;
-	}
-	if (spec_emin>cat->arf->HighEnergy[ii]) break;
+  long ii;
+  for (ii=0; ii<st->nbins; ii++) {
+    st->spec[ii]=NULL;
+  }
+  st->evicted=evicted;
+}
 
-      } else if (jj==midpspec->nentries) {
-	if (0==warning_printed) {
-	  char msg[SIMPUT_MAXSTR];
-	  sprintf(msg, "the spectrum '%s' does not cover the "
-		  "full energy range of the ARF", midpspec->fileref);
-	  SIMPUT_WARNING(msg);
-	  warning_printed=1;
-	}
-	break;
-      }
 
-      // Upper boundary of the current bin.
-      float hi;
-      if (spec_emax<=cat->arf->HighEnergy[ii]) {
-	hi=spec_emax;
-      } else {
-	hi=cat->arf->HighEnergy[ii];
-	finished=1;
-      }
+/** Return the spectral distribution referred to in the specified bin
+    of the table. If it has not been obtained yet, it is taken from
+    the buffer of the catalog. */
+static SimputSpec* getLCSpecTableSpec(SimputCtlg* const cat,
+				      struct SimputLCSpecTable* const st,
+				      const long bin,
+				      int* const status)
+{
+  // The buffer of a shared catalog never releases spectra.
+  if (!isSimputCtlgShared(cat)) {
+    updateLCSpecTableEvicted(cat, st);
+  }
+  if (NULL!=st->spec[bin]) {
+    return(st->spec[bin]);
+  }
 
-      // Add to the spectral probability density.
-      spec->distribution[ii]+=
-	(hi-lo)*cat->arf->EffArea[ii]*midpspec->fluxdensity[jj];
+  if (NULL==st->ref[bin]) {
+    SIMPUT_ERROR("in the current implementation light curves "
+		 "must not contain blank entries in a given "
+		 "spectrum column");
+    *status=EXIT_FAILURE;
+    return(NULL);
+  }
 
-      // Increase the lower boundary.
-      lo=hi;
+  lockSimputCtlg(cat);
+  SimputSpec* spec=getSimputSpec(cat, st->ref[bin], status);
+  if (EXIT_SUCCESS==*status) {
+    // Other spectra might have been released in the meantime.
+    updateLCSpecTableEvicted(cat, st);
+    st->spec[bin]=spec;
+  }
+  unlockSimputCtlg(cat);
+  return(spec);
+}
 
-    } while (0==finished);
 
-    // Create the spectral distribution function
-    // normalized to the total photon number [photons].
-    if (ii>0) {
-      spec->distribution[ii]+=spec->distribution[ii-1];
-    }
-  } // Loop over all ARF bins.
+/** Obtain the spectral distributions referred to in the specified bin
+    of the table and in the following one. */
+static void getLCSpecTablePair(SimputCtlg* const cat,
+			       struct SimputLCSpecTable* const st,
+			       const long bin,
+			       SimputSpec** const spec,
+			       SimputSpec** const spec_next,
+			       int* const status)
+{
+  *spec=getLCSpecTableSpec(cat, st, bin, status);
+  CHECK_STATUS_VOID(*status);
+  *spec_next=getLCSpecTableSpec(cat, st, bin+1, status);
+  CHECK_STATUS_VOID(*status);
 
+  // If the first spectrum has been released, when the second one was
+  // obtained, both are obtained again from the buffer. As the most
+  // recently used spectra they are kept.
+  if (st->spec[bin]!=*spec) {
+    *spec=getSimputSpec(cat, st->ref[bin], status);
+    CHECK_STATUS_VOID(*status);
+    *spec_next=getSimputSpec(cat, st->ref[bin+1], status);
+    CHECK_STATUS_VOID(*status);
+  }
+}
 
-  // Copy the file reference to the spectrum for later comparisons.
-  spec->fileref=
-    (char*)malloc((strlen(midpspec->fileref)+1)*sizeof(char));
-  CHECK_NULL_RET(spec->fileref, *status,
-		 "memory allocation for file reference failed",
-		 spec);
-  strcpy(spec->fileref, midpspec->fileref);
 
-  return(spec);
+/** Order mission-independent spectra by their energy grids. */
+static int cmpSimputMIdpSpecGrid(const void* const a, const void* const b)
+{
+  const SimputMIdpSpec* const sa=*(const SimputMIdpSpec* const*)a;
+  const SimputMIdpSpec* const sb=*(const SimputMIdpSpec* const*)b;
+  if (sa->nentries!=sb->nentries) {
+    return((sa->nentries<sb->nentries) ? -1 : 1);
+  }
+  if ((0==sa->nentries) || (sa->energy==sb->energy)) {
+    return(0);
+  }
+  return(memcmp(sa->energy, sb->energy, sa->nentries*sizeof(float)));
 }
 
 
-static SimputSpec* getSimputSpec(SimputCtlg* const cat,
-				 const char* const filename,
-				 int* const status)
+void loadCacheAllSimputSpec(SimputCtlg* const cat, int* const status)
 {
-  // Search if the spectrum is available in the buffer.
-  SimputSpec* spec=searchSimputSpecBuffer(cat->specbuff, filename);
-  if (NULL!=spec) {
-    return(spec);
-  }
+  SimputMIdpSpec** midpspecs=NULL;
+  SimputSpec** specs=NULL;
+  long nspecs=0, ii;
 
-  // The required spectrum is not contained in the buffer.
-  // Therefore we must determine it from the referred mission-
-  // independent spectrum and store it in the buffer.
+  lockSimputCtlg(cat);
+  SimputCtlg* core=getSimputCtlgCore(cat);
 
-  // Obtain the mission-independent spectrum.
-  SimputMIdpSpec* midpspec=getSimputMIdpSpec(cat, filename, status);
-  CHECK_STATUS_RET(*status, NULL);
+  do { // Error handling loop.
+    struct SimputCacheIndex* mb=(struct SimputCacheIndex*)core->midpspecbuff;
+    if ((NULL==mb) || (0==mb->nentries)) break;
+
+    midpspecs=(SimputMIdpSpec**)malloc(mb->nentries*sizeof(SimputMIdpSpec*));
+    CHECK_NULL_BREAK(midpspecs, *status,
+		     "memory allocation for spectra failed");
+    specs=(SimputSpec**)malloc(mb->nentries*sizeof(SimputSpec*));
+    CHECK_NULL_BREAK(specs, *status,
+		     "memory allocation for spectra failed");
+
+    // Collect the mission-independent spectra, which have not been
+    // convolved with the ARF yet. Spectral distributions available
+    // from the cache on disk are used directly.
+    long idx, npending=0;
+    for (idx=mb->first; idx>=0; idx=mb->entries[idx].next) {
+      long refid=mb->entries[idx].refid;
+      if (containsSimputCacheIndex(core->specbuff, refid)) continue;
+      SimputSpec* spec=loadSimputSpecDiskCache(core, refid, status);
+      CHECK_STATUS_BREAK(*status);
+      if (NULL!=spec) {
+	specs[nspecs++]=spec;
+      } else {
+	midpspecs[npending++]=(SimputMIdpSpec*)mb->entries[idx].obj;
+      }
+    }
+    CHECK_STATUS_BREAK(*status);
+    long nfound=nspecs;
+    for (ii=0; ii<npending; ii++) {
+      specs[nspecs++]=NULL;
+    }
+    if (0==nspecs) break;
+
+    // Convolve the spectra defined on the same energy grid together.
+    qsort(midpspecs, npending, sizeof(SimputMIdpSpec*), cmpSimputMIdpSpecGrid);
+    long start=0;
+    while (start<npending) {
+      long end=start+1;
+      while ((end<npending) &&
+	     (0==cmpSimputMIdpSpecGrid(&(midpspecs[start]), &(midpspecs[end])))) {
+	end++;
+      }
+      convSimputMIdpSpecsWithARF(core, &(midpspecs[start]), end-start,
+				 &(specs[nfound+start]), status);
+      CHECK_STATUS_BREAK(*status);
+      start=end;
+    }
+    CHECK_STATUS_BREAK(*status);
+    for (ii=nfound; ii<nspecs; ii++) {
+      storeSimputSpecDiskCache(core, specs[ii], status);
+      CHECK_STATUS_BREAK(*status);
+    }
+    CHECK_STATUS_BREAK(*status);
 
-  // Convolve it with the ARF.
-  spec=convSimputMIdpSpecWithARF(cat, midpspec, status);
-  CHECK_STATUS_RET(*status, spec);
+    // Insert the spectra into the buffer. Spectra of a shared catalog
+    // might be in use by other threads and are therefore never
+    // released.
+    if (NULL==core->specbuff) {
+      core->specbuff=
+	newSimputSpecBuffer(core->cachecap[EXTTYPE_MIDPSPEC], core, status);
+      CHECK_STATUS_BREAK(*status);
+    }
+    manageSimputCtlgCache(core, core->specbuff, status);
+    CHECK_STATUS_BREAK(*status);
+    for (ii=0; ii<nspecs; ii++) {
+      insertSimputCacheIndex(core->specbuff, specs[ii]->refid, specs[ii],
+			     !isSimputCtlgShared(core), status);
+      CHECK_STATUS_BREAK(*status);
+      specs[ii]=NULL;
+    }
+    CHECK_STATUS_BREAK(*status);
 
-  // Insert the spectrum into the buffer.
-  insertSimputSpecBuffer(&(cat->specbuff), spec, status);
-  CHECK_STATUS_RET(*status, spec);
+  } while(0); // END of error handling loop.
 
-  return(spec);
+  unlockSimputCtlg(cat);
+
+  // Release memory.
+  if (NULL!=specs) {
+    for (ii=0; ii<nspecs; ii++) {
+      freeSimputSpec(&(specs[ii]));
+    }
+    free(specs);
+  }
+  if (NULL!=midpspecs) free(midpspecs);
 }
 
 
-static inline double rndexp(const double avgdist, int* const status)
+static inline double rndexp(const SimputCtlg* const cat,
+			    const double avgdist,
+			    int* const status)
 {
   assert(avgdist>0.);
 
   double rand;
   do {
-    rand=getRndNum(status);
+    rand=getSimputCtlgRndNum(cat, status);
     CHECK_STATUS_RET(*status, 0.);
     assert(rand>=0.);
   } while (rand==0.);
@@ -1106,58 +3478,105 @@ static inline double rndexp(const double avgdist, int* const status)
 }
 
 
+/** Set up the tables required to draw pixels from an image with the
+    specified method. */
+static void buildSimputImgTables(SimputImg* const img,
+				 const int method,
+				 int* const status)
+{
+  long npixels=img->naxis1*img->naxis2;
+  long ii, jj;
+
+  // Copy the distribution function to a contiguous buffer, unless the
+  // columns already refer to one.
+  if (NULL==img->cdf) {
+    img->cdf=(double*)malloc(npixels*sizeof(double));
+    CHECK_NULL_VOID(img->cdf, *status,
+		    "memory allocation for image distribution failed");
+    for (ii=0; ii<img->naxis1; ii++) {
+      for (jj=0; jj<img->naxis2; jj++) {
+	img->cdf[ii*img->naxis2+jj]=img->dist[ii][jj];
+      }
+    }
+  }
+
+  if (NULL==img->cdfx) {
+    img->cdfx=(double*)malloc(img->naxis1*sizeof(double));
+    CHECK_NULL_VOID(img->cdfx, *status,
+		    "memory allocation for image distribution failed");
+    for (ii=0; ii<img->naxis1; ii++) {
+      img->cdfx[ii]=img->cdf[ii*img->naxis2+img->naxis2-1];
+    }
+  }
+
+  if ((SIMPUT_SAMPLING_ALIAS==method) && (NULL==img->alias)) {
+    buildAliasTable(img->cdf, npixels, &img->aliasprob, &img->alias, status);
+    CHECK_STATUS_VOID(*status);
+  }
+}
+
+
 /** Return the requested image. Keeps a certain number of images in an
     internal storage. If the requested image is not located in the
     internal storage, it is loaded from the reference given in the
     source catalog. */
-static SimputImg* getSimputImg(SimputCtlg* const cat,
-			       char* const filename,
-			       int* const status)
+static SimputImg* getSimputImgUnlocked(SimputCtlg* const cat,
+				       char* const filename,
+				       int* const status)
 {
-  const long maximgs=1000;
-
   // Check if the source catalog contains an image buffer.
   if (NULL==cat->imgbuff) {
-    cat->imgbuff=newSimputImgBuffer(status);
+    cat->imgbuff=newSimputImgBuffer(cat->cachecap[EXTTYPE_IMAGE], status);
     CHECK_STATUS_RET(*status, NULL);
   }
 
-  // Convert the void* pointer to the image buffer into the right
-  // format.
-  struct SimputImgBuffer* sb=(struct SimputImgBuffer*)cat->imgbuff;
-
-  // In case there are no images available at all, allocate
-  // memory for the array (storage for images).
-  if (NULL==sb->imgs) {
-    sb->imgs=(SimputImg**)malloc(maximgs*sizeof(SimputImg*));
-    CHECK_NULL_RET(sb->imgs, *status,
-		   "memory allocation for images failed", NULL);
-  }
-
   // Search if the requested image is available in the storage.
-  long ii;
-  for (ii=0; ii<sb->nimgs; ii++) {
-    // Check if the image is equivalent to the requested one.
-    if (0==strcmp(sb->imgs[ii]->fileref, filename)) {
-      // If yes, return the image.
-      return(sb->imgs[ii]);
-    }
+  long refid=getSimputCtlgRefId(cat, filename, status);
+  CHECK_STATUS_RET(*status, NULL);
+  SimputImg* img=(SimputImg*)searchSimputCacheIndex(cat->imgbuff, refid);
+  if (NULL!=img) {
+    return(img);
   }
 
   // The requested image is not contained in the storage.
   // Therefore we must load it from the specified location.
-  if (sb->nimgs>=maximgs) {
-    SIMPUT_ERROR("too many images (>1000) in the internal storage");
-    *status=EXIT_FAILURE;
-    return(NULL);
+  img=loadSimputImg(filename, status);
+  CHECK_STATUS_RET(*status, img);
+  img->refid=refid;
+
+  // Store the image in the buffer. Images of a shared catalog might
+  // be in use by other threads and are therefore never released.
+  manageSimputCtlgCache(cat, cat->imgbuff, status);
+  if (EXIT_SUCCESS==*status) {
+    insertSimputCacheIndex(cat->imgbuff, refid, img,
+			   !isSimputCtlgShared(cat), status);
+  }
+  if (EXIT_SUCCESS!=*status) {
+    freeSimputImg(&img);
   }
 
-  // Load the image from the file.
-  sb->imgs[sb->nimgs]=loadSimputImg(filename, status);
-  CHECK_STATUS_RET(*status, sb->imgs[sb->nimgs]);
-  sb->nimgs++;
+  return(img);
+}
+
 
-  return(sb->imgs[sb->nimgs-1]);
+/** Return the requested image from the buffer shared by the catalog
+    and its per-thread contexts. For a shared catalog the tables for
+    drawing pixels are set up before the image is returned, since they
+    must not be modified while they are used by other threads. */
+static SimputImg* getSimputImg(SimputCtlg* const cat,
+			       char* const filename,
+			       int* const status)
+{
+  lockSimputCtlg(cat);
+  SimputCtlg* core=getSimputCtlgCore(cat);
+  SimputImg* img=getSimputImgUnlocked(core, filename, status);
+  if ((EXIT_SUCCESS==*status) && isSimputCtlgShared(core) &&
+      ((NULL==img->cdfx) ||
+       ((SIMPUT_SAMPLING_ALIAS==core->imgsampling) && (NULL==img->alias)))) {
+    buildSimputImgTables(img, core->imgsampling, status);
+  }
+  unlockSimputCtlg(cat);
+  return(img);
 }
 
 
@@ -1196,6 +3615,34 @@ void simput_s2p(struct wcsprm* const wcs,
 }
 
 
+/** Transform pixel coordinates to RA and Dec ([rad]). In contrast
+    to p2s, the units of the WCS are not checked. */
+inline static void wcsPix2Sky(struct wcsprm* const wcs,
+			      const double px,
+			      const double py,
+			      double* sx,
+			      double* sy,
+			      int* const status)
+{
+  double pixcrd[2]={ px, py };
+  double imgcrd[2], world[2];
+  double phi, theta;
+
+  // Perform the transform using WCSlib.
+  int retval=wcsp2s(wcs, 1, 2, pixcrd, imgcrd, &phi, &theta, world, status);
+  CHECK_STATUS_VOID(*status);
+  if (0!=retval) {
+    *status=EXIT_FAILURE;
+    SIMPUT_ERROR("WCS transformation failed");
+    return;
+  }
+
+  // Convert to [rad].
+  *sx=world[0]*M_PI/180.;
+  *sy=world[1]*M_PI/180.;
+}
+
+
 inline static void p2s(struct wcsprm* const wcs,
 		const double px,
 		const double py,
@@ -1203,10 +3650,6 @@ inline static void p2s(struct wcsprm* const wcs,
 		double* sy,
 		int* const status)
 {
-  double pixcrd[2]={ px, py };
-  double imgcrd[2], world[2];
-  double phi, theta;
-
   // If CUNIT is set to 'degree', change this to 'deg'.
   // Otherwise the WCSlib will not work properly.
   if (0==strcmp(wcs->cunit[0], "degree  ")) {
@@ -1216,83 +3659,487 @@ inline static void p2s(struct wcsprm* const wcs,
     strcpy(wcs->cunit[1], "deg");
   }
 
-  // Perform the transform using WCSlib.
-  int retval=wcsp2s(wcs, 1, 2, pixcrd, imgcrd, &phi, &theta, world, status);
-  CHECK_STATUS_VOID(*status);
-  if (0!=retval) {
-    *status=EXIT_FAILURE;
-    SIMPUT_ERROR("WCS transformation failed");
+  wcsPix2Sky(wcs, px, py, sx, sy, status);
+}
+
+// make the p2s function publicly available
+void simput_p2s(struct wcsprm* const wcs,
+		const double px,
+		const double py,
+		double* sx,
+		double* sy,
+		int* const status)
+{
+	p2s(wcs,px,py,sx,sy,status);
+}
+
+/** Return the requested photon lists. Keeps a certain number of
+    photon lists in an internal storage. If the requested photon list
+    is not located in the internal storage, it is obtained from the
+    reference given in the source catalog. */
+static SimputPhList* getSimputPhList(SimputCtlg* const cat,
+				     char* const filename,
+				     int* const status)
+{
+  // Check if the source catalog contains a photon list buffer.
+  if (NULL==cat->phlistbuff) {
+    cat->phlistbuff=
+      newSimputPhListBuffer(cat->cachecap[EXTTYPE_PHLIST], status);
+    CHECK_STATUS_RET(*status, NULL);
+  }
+
+  // Search if the requested photon list is available in the storage.
+  long refid=getSimputCtlgRefId(cat, filename, status);
+  CHECK_STATUS_RET(*status, NULL);
+  SimputPhList* phl=
+    (SimputPhList*)searchSimputCacheIndex(cat->phlistbuff, refid);
+  if (NULL!=phl) {
+    return(phl);
+  }
+
+  // The requested photon list is not contained in the storage.
+  // Therefore we must open it from the specified location.
+  phl=openSimputPhList(filename, READONLY, status);
+  CHECK_STATUS_RET(*status, phl);
+  phl->refid=refid;
+
+  // Store the photon list in the buffer. Each per-thread context has
+  // its own photon lists, which are not referred to by the resolved
+  // references of the sources. Therefore they can always be released.
+  // Columns shared with other contexts (see getSimputPhListBuffRow)
+  // are kept by the catalog.
+  manageSimputCtlgCache(cat, cat->phlistbuff, status);
+  if (EXIT_SUCCESS==*status) {
+    insertSimputCacheIndex(cat->phlistbuff, refid, phl, 1, status);
+  }
+  if (EXIT_SUCCESS!=*status) {
+    int status2=EXIT_SUCCESS;
+    freeSimputPhList(&phl, &status2);
+  }
+
+  return(phl);
+}
+
+
+/** Determine whether the photon list is kept in memory completely.
+    This is the case for photon lists with up to the number of rows
+    set by setSimputPhListMaxMemRows, if their columns fit into the
+    memory budget of the catalog. The decision is made only once for
+    each photon list. */
+static int isSimputPhListInMemory(const SimputCtlg* const cat,
+				  SimputPhList* const phl,
+				  int* const status)
+{
+  if (phl->inmem>=0) {
+    return(phl->inmem);
+  }
+
+  phl->inmem=0;
+  if (phl->nphs>getSimputCtlgCore(cat)->phlistmaxmemrows) {
+    return(0);
+  }
+
+  // Make room for the columns within the memory budget. The photon
+  // list itself is marked as used before, such that it is not
+  // released.
+  struct SimputCacheIndex* ci=(struct SimputCacheIndex*)cat->phlistbuff;
+  if ((NULL!=ci) && (NULL!=ci->mgr) && (ci->mgr->budget>0)) {
+    long rowsize=sizeof(float)+2*sizeof(double);
+    if (phl->ctime>0) rowsize+=sizeof(double);
+    long nbytes=phl->nphs*rowsize;
+    searchSimputCacheIndex(ci, phl->refid);
+    reduceSimputCacheManager(ci->mgr, nbytes, status);
+    CHECK_STATUS_RET(*status, 0);
+    if (ci->mgr->nbytes+nbytes>ci->mgr->budget) {
+      return(0);
+    }
+  }
+
+  phl->inmem=1;
+  return(1);
+}
+
+
+/** Allocate the in-memory buffer of a photon list for the specified
+    number of rows. */
+static void allocSimputPhListBuff(SimputPhList* const phl,
+				  const long nrows,
+				  int* const status)
+{
+  phl->maxbuffrows=nrows;
+  phl->benergy=(float*)malloc(phl->maxbuffrows*sizeof(float));
+  CHECK_NULL_VOID(phl->benergy, *status,
+		  "memory allocation for photon list buffer failed");
+  phl->bra=(double*)malloc(phl->maxbuffrows*sizeof(double));
+  CHECK_NULL_VOID(phl->bra, *status,
+		  "memory allocation for photon list buffer failed");
+  phl->bdec=(double*)malloc(phl->maxbuffrows*sizeof(double));
+  CHECK_NULL_VOID(phl->bdec, *status,
+		  "memory allocation for photon list buffer failed");
+  if (phl->ctime>0) {
+    phl->btime=(double*)malloc(phl->maxbuffrows*sizeof(double));
+    CHECK_NULL_VOID(phl->btime, *status,
+		    "memory allocation for photon list buffer failed");
+  }
+}
+
+
+/** Read the block of rows starting at the specified row (numbering
+    starts at 1) into the in-memory buffer of the photon list. If the
+    buffer covers the whole photon list, all rows are read. */
+static void readSimputPhListBuff(SimputPhList* const phl,
+				 const long row,
+				 int* const status)
+{
+  long firstrow=(phl->maxbuffrows>=phl->nphs) ? 1 : row;
+  long nrows=MIN(phl->maxbuffrows, phl->nphs-firstrow+1);
+  phl->nbuffrows=0;
+
+  int anynul=0;
+  fits_read_col(phl->fptr, TFLOAT, phl->cenergy, firstrow, 1, nrows,
+		NULL, phl->benergy, &anynul, status);
+  if (EXIT_SUCCESS!=*status) {
+    SIMPUT_ERROR("failed reading energy from photon list");
+    return;
+  }
+  fits_read_col(phl->fptr, TDOUBLE, phl->cra, firstrow, 1, nrows,
+		NULL, phl->bra, &anynul, status);
+  if (EXIT_SUCCESS!=*status) {
+    SIMPUT_ERROR("failed reading right ascension from photon list");
+    return;
+  }
+  fits_read_col(phl->fptr, TDOUBLE, phl->cdec, firstrow, 1, nrows,
+		NULL, phl->bdec, &anynul, status);
+  if (EXIT_SUCCESS!=*status) {
+    SIMPUT_ERROR("failed reading declination from photon list");
+    return;
+  }
+  if (phl->ctime>0) {
+    fits_read_col(phl->fptr, TDOUBLE, phl->ctime, firstrow, 1, nrows,
+		  NULL, phl->btime, &anynul, status);
+    if (EXIT_SUCCESS!=*status) {
+      SIMPUT_ERROR("failed reading time from photon list");
+      return;
+    }
+  }
+
+  // Apply the unit conversion factors.
+  long ii;
+  for (ii=0; ii<nrows; ii++) {
+    phl->benergy[ii]*=phl->fenergy;
+    phl->bra[ii]    *=phl->fra;
+    phl->bdec[ii]   *=phl->fdec;
+  }
+  if (phl->ctime>0) {
+    for (ii=0; ii<nrows; ii++) {
+      phl->btime[ii]*=phl->ftime;
+    }
+  }
+
+  phl->buffrow  =firstrow;
+  phl->nbuffrows=nrows;
+}
+
+
+/** Return the photon list of a shared catalog holding the in-memory
+    columns for the specified photon list. The columns are loaded
+    when the photon list is requested for the first time and are not
+    modified afterwards. The catalog must be locked. */
+static SimputPhList* getSimputPhListShared(SimputCtlg* const core,
+					   const SimputPhList* const phl,
+					   int* const status)
+{
+  if (NULL==core->phlistshared) {
+    core->phlistshared=newSimputPhListBuffer(0, status);
+    CHECK_STATUS_RET(*status, NULL);
+  }
+
+  SimputPhList* shl=
+    (SimputPhList*)searchSimputCacheIndex(core->phlistshared, phl->refid);
+  if (NULL!=shl) {
+    return(shl);
+  }
+
+  shl=openSimputPhList(phl->fileref, READONLY, status);
+  CHECK_STATUS_RET(*status, NULL);
+  shl->refid=phl->refid;
+  shl->inmem=1;
+
+  do { // Beginning of error handling loop.
+    allocSimputPhListBuff(shl, MAX(shl->nphs, 1), status);
+    CHECK_STATUS_BREAK(*status);
+    readSimputPhListBuff(shl, 1, status);
+    CHECK_STATUS_BREAK(*status);
+    insertSimputCacheIndex(core->phlistshared, shl->refid, shl, 0, status);
+    CHECK_STATUS_BREAK(*status);
+  } while(0); // END of error handling loop.
+
+  if (EXIT_SUCCESS!=*status) {
+    int status2=EXIT_SUCCESS;
+    freeSimputPhList(&shl, &status2);
+  }
+
+  return(shl);
+}
+
+
+/** Make sure that the specified row of the photon list (numbering
+    starts at 1) is contained in the in-memory buffer and return its
+    index within the buffer. Photon lists, which are kept in memory
+    completely (see isSimputPhListInMemory), are loaded at once. In a
+    shared catalog, their columns are loaded only once and are shared
+    by the photon lists of the catalog and all per-thread contexts,
+    while the cursors are specific for each of them. Otherwise a block
+    of SIMPUT_PHLIST_BLOCKROWS rows starting at the requested row is
+    read, which serves subsequent sequential access. */
+static long getSimputPhListBuffRow(const SimputCtlg* const cat,
+				   SimputPhList* const phl,
+				   const long row,
+				   int* const status)
+{
+  // Check if the requested row is already contained in the buffer.
+  if ((row>=phl->buffrow) && (row<phl->buffrow+phl->nbuffrows)) {
+    return(row-phl->buffrow);
+  }
+
+  // Allocate memory for the buffer.
+  if (0==phl->maxbuffrows) {
+    int inmem=isSimputPhListInMemory(cat, phl, status);
+    CHECK_STATUS_RET(*status, 0);
+    if ((0!=inmem) && (isSimputCtlgShared(cat))) {
+      lockSimputCtlg(cat);
+      SimputPhList* shl=
+	getSimputPhListShared(getSimputCtlgCore(cat), phl, status);
+      if (EXIT_SUCCESS==*status) {
+	phl->shared     =shl;
+	phl->benergy    =shl->benergy;
+	phl->bra        =shl->bra;
+	phl->bdec       =shl->bdec;
+	phl->btime      =shl->btime;
+	phl->maxbuffrows=shl->maxbuffrows;
+	phl->buffrow    =shl->buffrow;
+	phl->nbuffrows  =shl->nbuffrows;
+      }
+      unlockSimputCtlg(cat);
+      CHECK_STATUS_RET(*status, 0);
+      return(row-phl->buffrow);
+    }
+
+    allocSimputPhListBuff(phl, (0!=inmem) ? MAX(phl->nphs, 1) :
+			  SIMPUT_PHLIST_BLOCKROWS, status);
+    CHECK_STATUS_RET(*status, 0);
+  }
+
+  // Read the block of rows from the file.
+  readSimputPhListBuff(phl, row, status);
+  CHECK_STATUS_RET(*status, 0);
+
+  return(row-phl->buffrow);
+}
+
+
+/** Check whether the photon times are sorted in ascending order. For
+    photon lists, which are not kept in memory completely, the time
+    column is read in blocks and the sparse time index is set up at
+    the same time. */
+static void checkSimputPhListTimeSorted(const SimputCtlg* const cat,
+					SimputPhList* const phl,
+					int* const status)
+{
+  if (phl->tsorted>=0) return;
+
+  int inmem=isSimputPhListInMemory(cat, phl, status);
+  CHECK_STATUS_VOID(*status);
+  if (0!=inmem) {
+    getSimputPhListBuffRow(cat, phl, 1, status);
+    CHECK_STATUS_VOID(*status);
+    long ii;
+    for (ii=1; ii<phl->nphs; ii++) {
+      if (phl->btime[ii]<phl->btime[ii-1]) break;
+    }
+    phl->tsorted=(ii>=phl->nphs) ? 1 : 0;
+    return;
+  }
+
+  long ntindex=(phl->nphs-1)/SIMPUT_PHLIST_INDEXSTEP+1;
+  double* tindex=NULL;
+  double* buffer=NULL;
+  int sorted=1;
+
+  do { // Beginning of error handling loop.
+
+    tindex=(double*)malloc(ntindex*sizeof(double));
+    CHECK_NULL_BREAK(tindex, *status,
+		     "memory allocation for photon list time index failed");
+    buffer=(double*)malloc(SIMPUT_PHLIST_BLOCKROWS*sizeof(double));
+    CHECK_NULL_BREAK(buffer, *status,
+		     "memory allocation for photon list time index failed");
+
+    double last=0.;
+    long row;
+    for (row=1; (row<=phl->nphs) && (1==sorted); row+=SIMPUT_PHLIST_BLOCKROWS) {
+      long nrows=MIN(SIMPUT_PHLIST_BLOCKROWS, phl->nphs-row+1);
+      int anynul=0;
+      fits_read_col(phl->fptr, TDOUBLE, phl->ctime, row, 1, nrows,
+		    NULL, buffer, &anynul, status);
+      if (EXIT_SUCCESS!=*status) {
+	SIMPUT_ERROR("failed reading time from photon list");
+	break;
+      }
+
+      long ii;
+      for (ii=0; ii<nrows; ii++) {
+	double time=buffer[ii]*phl->ftime;
+	if ((row+ii>1) && (time<last)) {
+	  sorted=0;
+	  break;
+	}
+	last=time;
+	if (0==(row+ii-1)%SIMPUT_PHLIST_INDEXSTEP) {
+	  tindex[(row+ii-1)/SIMPUT_PHLIST_INDEXSTEP]=time;
+	}
+      }
+    }
+    CHECK_STATUS_BREAK(*status);
+
+  } while(0); // END of error handling loop.
+
+  if (NULL!=buffer) {
+    free(buffer);
+  }
+  if ((EXIT_SUCCESS!=*status) || (0==sorted)) {
+    if (NULL!=tindex) {
+      free(tindex);
+    }
+    if (EXIT_SUCCESS==*status) {
+      phl->tsorted=0;
+    }
     return;
   }
 
-  // Convert to [rad].
-  *sx=world[0]*M_PI/180.;
-  *sy=world[1]*M_PI/180.;
+  phl->tindex =tindex;
+  phl->ntindex=ntindex;
+  phl->tsorted=1;
 }
 
-// make the p2s function publicly available
-void simput_p2s(struct wcsprm* const wcs,
-		const double px,
-		const double py,
-		double* sx,
-		double* sy,
-		int* const status)
+
+/** Check whether a photon time from the list is earlier than the
+    specified time with respect to the given MJDREF. */
+static inline int isSimputPhListTimeBefore(const SimputPhList* const phl,
+					   const double phltime,
+					   const double time,
+					   const double mjdref)
 {
-	p2s(wcs,px,py,sx,sy,status);
+  return(phltime+phl->timezero+(phl->mjdref-mjdref)*24.*3600.<time);
 }
 
-/** Return the requested photon lists. Keeps a certain number of
-    photon lists in an internal storage. If the requested photon list
-    is not located in the internal storage, it is obtained from the
-    reference given in the source catalog. */
-static SimputPhList* getSimputPhList(SimputCtlg* const cat,
-				     char* const filename,
-				     int* const status)
+
+/** Move the current row of a photon list with sorted times forward
+    to the row before the first photon, which is not earlier than the
+    specified time. The search uses the sparse time index and
+    bisection within the buffered block of rows. */
+static void seekSimputPhListTime(const SimputCtlg* const cat,
+				 SimputPhList* const phl,
+				 const double prevtime,
+				 const double mjdref,
+				 int* const status)
 {
-  const long maxphls=100;
+  assert(1==phl->tsorted);
+
+  // Range of rows [lower,upper), which contains the first photon not
+  // earlier than the specified time. upper=nphs+1 means that there is
+  // no such photon.
+  long lower=1, upper=phl->nphs+1;
+  if (NULL!=phl->tindex) {
+    // Find the first index entry not earlier than the specified time.
+    long lo=0, hi=phl->ntindex, mid;
+    while (hi>lo) {
+      mid=(lo+hi)/2;
+      if (isSimputPhListTimeBefore(phl, phl->tindex[mid], prevtime, mjdref)) {
+	lo=mid+1;
+      } else {
+	hi=mid;
+      }
+    }
+    if (lo>0) {
+      lower=(lo-1)*SIMPUT_PHLIST_INDEXSTEP+2;
+    }
+    upper=MIN(lo*SIMPUT_PHLIST_INDEXSTEP+1, phl->nphs+1);
+  }
+  lower=MAX(lower, phl->currrow+1);
+  if (lower>=upper) {
+    phl->currrow=MAX(phl->currrow, upper-1);
+    return;
+  }
 
-  // Check if the source catalog contains a photon list buffer.
-  if (NULL==cat->phlistbuff) {
-    cat->phlistbuff=newSimputPhListBuffer(status);
-    CHECK_STATUS_RET(*status, NULL);
+  // Load the block of rows starting at the lower boundary. It covers
+  // the whole range, since the distance between the index entries
+  // does not exceed the block size.
+  getSimputPhListBuffRow(cat, phl, lower, status);
+  CHECK_STATUS_VOID(*status);
+  while (upper>lower) {
+    long mid=(lower+upper)/2;
+    long buffrow=getSimputPhListBuffRow(cat, phl, mid, status);
+    CHECK_STATUS_VOID(*status);
+    if (isSimputPhListTimeBefore(phl, phl->btime[buffrow], prevtime, mjdref)) {
+      lower=mid+1;
+    } else {
+      upper=mid;
+    }
   }
+  phl->currrow=lower-1;
+}
 
-  // Convert the void* pointer to the photon list buffer into the right
-  // format.
-  struct SimputPhListBuffer* pb=(struct SimputPhListBuffer*)cat->phlistbuff;
 
-  // In case there are no photon lists available at all, allocate
-  // memory for the array (storage for photon lists).
-  if (NULL==pb->phls) {
-    pb->phls=(SimputPhList**)malloc(maxphls*sizeof(SimputPhList*));
-    CHECK_NULL_RET(pb->phls, *status,
-		   "memory allocation for photon lists failed", NULL);
+/** Set up the alias table over the rows of a photon list, which is
+    kept in memory completely, using the instrument ARF at the photon
+    energies as weights. If the columns are shared, the alias table is
+    set up for the photon list holding them and shared as well. */
+static void buildSimputPhListAliasTable(const SimputCtlg* const cat,
+					SimputPhList* const phl,
+					int* const status)
+{
+  if (NULL!=phl->alias) return;
+
+  // Make sure that the photon list is loaded.
+  assert(1==phl->inmem);
+  getSimputPhListBuffRow(cat, phl, 1, status);
+  CHECK_STATUS_VOID(*status);
+
+  if (NULL!=phl->shared) {
+    SimputPhList* shl=(SimputPhList*)phl->shared;
+    lockSimputCtlg(cat);
+    buildSimputPhListAliasTable(getSimputCtlgCore(cat), shl, status);
+    phl->aliasprob=shl->aliasprob;
+    phl->alias    =shl->alias;
+    unlockSimputCtlg(cat);
+    return;
   }
 
-  // Search if the requested photon list is available in the storage.
+  // Determine the cumulative distribution of the ARF values.
+  double* cdf=(double*)malloc(phl->nphs*sizeof(double));
+  CHECK_NULL_VOID(cdf, *status,
+		  "memory allocation for photon list distribution failed");
+
+  double sum=0.;
   long ii;
-  for (ii=0; ii<pb->nphls; ii++) {
-    // Check if the photon list is equivalent to the requested one.
-    if (0==strcmp(pb->phls[ii]->fileref, filename)) {
-      // If yes, return the photon list.
-      return(pb->phls[ii]);
+  for (ii=0; ii<phl->nphs; ii++) {
+    // Determine the ARF value for the photon energy.
+    long upper=cat->arf->NumberEnergyBins-1, lower=0, mid;
+    while (upper>lower) {
+      mid=(lower+upper)/2;
+      if (cat->arf->HighEnergy[mid]<phl->benergy[ii]) {
+	lower=mid+1;
+      } else {
+	upper=mid;
+      }
     }
+    sum+=cat->arf->EffArea[lower];
+    cdf[ii]=sum;
   }
 
-  // The requested photon list is not contained in the storage.
-  // Therefore we must open it from the specified location.
-  if (pb->nphls>=maxphls) {
-    SIMPUT_ERROR("too many photon lists in the internal storage");
-    *status=EXIT_FAILURE;
-    return(NULL);
-  }
-
-  // Open the photon list from the file.
-  pb->phls[pb->nphls]=openSimputPhList(filename, READONLY, status);
-  CHECK_STATUS_RET(*status, pb->phls[pb->nphls]);
-  pb->nphls++;
-
-  return(pb->phls[pb->nphls-1]);
+  buildAliasTable(cdf, phl->nphs, &phl->aliasprob, &phl->alias, status);
+  free(cdf);
 }
 
 
@@ -1325,11 +4172,13 @@ float getSimputMIdpSpecBandFlux(SimputMIdpSpec* const spec,
 }
 
 
-float getSimputPhotonRate(SimputCtlg* const cat,
-			  SimputSrc* const src,
-			  const double prevtime,
-			  const double mjdref,
-			  int* const status)
+/** Determine the photon rate of a source without locking the buffers
+    of the catalog (see getSimputPhotonRate). */
+static float getSimputPhotonRateUnlocked(SimputCtlg* const cat,
+					 SimputSrc* const src,
+					 const double prevtime,
+					 const double mjdref,
+					 int* const status)
 {
   // Check if the photon rate has already been determined before.
   if (NULL==src->phrate) {
@@ -1380,25 +4229,38 @@ float getSimputPhotonRate(SimputCtlg* const cat,
       // with the instrument ARF.
       double refband_flux=0.; // [erg]
       double refnumber=0.; // [photons*cm^2]
+      // Only the energy column is required, which is read in blocks.
+      // If the photon list is already kept in memory completely, the
+      // buffered values are used instead.
       const long buffsize=10000;
+      float buffer[buffsize];
       long ii;
       for (ii=0; ii*buffsize<phl->nphs; ii++) {
-	// Read a block of photons.
-	int anynul=0;
 	long nphs=MIN(buffsize, phl->nphs-(ii*buffsize));
-	float buffer[buffsize];
-	fits_read_col(phl->fptr, TFLOAT, phl->cenergy, ii*buffsize+1,
-		      1, nphs, NULL, buffer, &anynul, status);
-	if (EXIT_SUCCESS!=*status) {
-	  SIMPUT_ERROR("failed reading unit of energy column in photon list");
-	  return(0.);
+	const float* energies;
+	if ((1==phl->buffrow) && (phl->nbuffrows==phl->nphs)) {
+	  energies=&(phl->benergy[ii*buffsize]);
+	} else {
+	  // Read a block of photons.
+	  int anynul=0;
+	  fits_read_col(phl->fptr, TFLOAT, phl->cenergy, ii*buffsize+1,
+			1, nphs, NULL, buffer, &anynul, status);
+	  if (EXIT_SUCCESS!=*status) {
+	    SIMPUT_ERROR("failed reading energy column in photon list");
+	    return(0.);
+	  }
+	  long jj;
+	  for (jj=0; jj<nphs; jj++) {
+	    buffer[jj]*=phl->fenergy;
+	  }
+	  energies=buffer;
 	}
 
 	// Determine the illuminated energy in the
 	// reference energy band.
 	long jj;
 	for (jj=0; jj<nphs; jj++) {
-	  float energy=buffer[jj]*phl->fenergy;
+	  float energy=energies[jj];
 	  if ((energy>=src->e_min)&&(energy<=src->e_max)) {
 	    refband_flux+=energy*keV2erg;
 	  }
@@ -1426,14 +4288,491 @@ float getSimputPhotonRate(SimputCtlg* const cat,
 		     "memory allocation for photon rate buffer failed", 0.);
       *(src->phrate)=src->eflux / refband_flux * refnumber;
 
-    } else {
-      SIMPUT_ERROR("could not find valid spectrum extension");
-      *status=EXIT_FAILURE;
-      return(0.);
+    } else {
+      SIMPUT_ERROR("could not find valid spectrum extension");
+      *status=EXIT_FAILURE;
+      return(0.);
+    }
+  }
+
+  return(*(src->phrate));
+}
+
+
+float getSimputPhotonRate(SimputCtlg* const cat,
+			  SimputSrc* const src,
+			  const double prevtime,
+			  const double mjdref,
+			  int* const status)
+{
+  // In a shared catalog, the photon rates of the sources with
+  // time-independent references are determined when the first
+  // per-thread context is created. For all other sources the rate
+  // is determined under the lock.
+  const struct SimputSrcResolved* res=
+    (const struct SimputSrcResolved*)src->resolved;
+  if (isSimputCtlgShared(cat) && ((NULL==res) || (0!=res->varrefs))) {
+    lockSimputCtlg(cat);
+    float rate=getSimputPhotonRateUnlocked(cat, src, prevtime, mjdref, status);
+    unlockSimputCtlg(cat);
+    return(rate);
+  }
+
+  return(getSimputPhotonRateUnlocked(cat, src, prevtime, mjdref, status));
+}
+
+
+/** Copy a reference string to newly allocated memory. */
+static char* copySrcRef(const char* const ref, int* const status)
+{
+  char* copy=(char*)malloc((strlen(ref)+1)*sizeof(char));
+  CHECK_NULL_RET(copy, *status,
+		 "memory allocation for reference string failed", copy);
+  strcpy(copy, ref);
+  return(copy);
+}
+
+
+/** Determine the resolved references of a source without locking the
+    buffers of the catalog (see getSimputSrcResolved). */
+static struct SimputSrcResolved*
+getSimputSrcResolvedUnlocked(SimputCtlg* const cat,
+			     SimputSrc* const src,
+			     const double prevtime,
+			     const double mjdref,
+			     int* const status)
+{
+  if (NULL!=src->resolved) {
+    return((struct SimputSrcResolved*)src->resolved);
+  }
+
+  struct SimputSrcResolved* res=newSimputSrcResolved(status);
+  CHECK_STATUS_RET(*status, NULL);
+
+  do { // Error handling loop.
+    char ref[SIMPUT_MAXSTR];
+
+    // Determine the timing extension.
+    getSrcTimeRef(cat, src, ref);
+    res->timeref=copySrcRef(ref, status);
+    CHECK_STATUS_BREAK(*status);
+    res->timetype=getSimputExtType(cat, res->timeref, status);
+    CHECK_STATUS_BREAK(*status);
+
+    // Check if the light curve refers to individual spectra or
+    // images in its bins.
+    if (EXTTYPE_LC==res->timetype) {
+      SimputLC* lc=getSimputLC(cat, src, res->timeref, prevtime, mjdref,
+			       status);
+      CHECK_STATUS_BREAK(*status);
+      res->lc=lc;
+      res->lcreleased=
+	getSimputLCBufferNReleased(getSimputCtlgCore(cat)->lcbuff);
+      if ((NULL!=lc->spectrum) || (NULL!=lc->image)) {
+	res->varrefs=1;
+	break;
+      }
+    }
+
+    // Determine the spectrum and the image extension.
+    getSimputSrcSpecRef(cat, src, prevtime, mjdref, ref, status);
+    CHECK_STATUS_BREAK(*status);
+    res->specref=copySrcRef(ref, status);
+    CHECK_STATUS_BREAK(*status);
+    res->spectype=getSimputExtType(cat, res->specref, status);
+    CHECK_STATUS_BREAK(*status);
+
+    getSrcImagRef(cat, src, prevtime, mjdref, ref, status);
+    CHECK_STATUS_BREAK(*status);
+    res->imagref=copySrcRef(ref, status);
+    CHECK_STATUS_BREAK(*status);
+    res->imagtype=getSimputExtType(cat, res->imagref, status);
+    CHECK_STATUS_BREAK(*status);
+
+  } while(0); // END of error handling loop.
+
+  if (EXIT_SUCCESS!=*status) {
+    freeSimputSrcResolved(&res);
+    return(NULL);
+  }
+
+  src->resolved=res;
+  return(res);
+}
+
+
+/** Return the resolved references of a source to its timing,
+    spectrum, and image extensions. On the first call for a particular
+    source the references and their extension types are determined
+    and stored in the source data structure. For the sources of a
+    shared catalog, this is done when the first per-thread context is
+    created. */
+static struct SimputSrcResolved* getSimputSrcResolved(SimputCtlg* const cat,
+						      SimputSrc* const src,
+						      const double prevtime,
+						      const double mjdref,
+						      int* const status)
+{
+  if (NULL!=src->resolved) {
+    return((struct SimputSrcResolved*)src->resolved);
+  }
+
+  lockSimputCtlg(cat);
+  struct SimputSrcResolved* res=
+    getSimputSrcResolvedUnlocked(cat, src, prevtime, mjdref, status);
+  unlockSimputCtlg(cat);
+  return(res);
+}
+
+
+/** Make sure that the photon lists, the spectrum, and the image
+    referred to in the resolved references of a source are still
+    contained in the buffers of the catalog. Otherwise the pointers
+    are reset, such that the extensions are obtained anew. */
+static void updateSrcResolvedEvicted(const SimputCtlg* const cat,
+				     struct SimputSrcResolved* const res)
+{
+  long evicted=
+    getSimputCacheIndexNEvicted(cat->phlistbuff)+
+    getSimputCacheIndexNEvicted(cat->specbuff)+
+    getSimputCacheIndexNEvicted(cat->imgbuff);
+  if (evicted==res->evicted) {
+    return;
+  }
+
+  res->timephl=NULL;
+  res->phl    =NULL;
+  res->spec   =NULL;
+  res->img    =NULL;
+  if (NULL!=res->wcs) {
+    wcsfree(res->wcs);
+    free(res->wcs);
+    res->wcs=NULL;
+  }
+  res->evicted=evicted;
+}
+
+
+/** Same as updateSrcResolvedEvicted for a catalog, which is not
+    shared. The buffers of a shared catalog never release spectra and
+    images, while its photon lists are not stored in the resolved
+    references. */
+static void checkSrcResolvedEvicted(const SimputCtlg* const cat,
+				    struct SimputSrcResolved* const res)
+{
+  if (!isSimputCtlgShared(cat)) {
+    updateSrcResolvedEvicted(cat, res);
+  }
+}
+
+
+/** Make sure that the light curve referred to in the resolved
+    references of a source is still contained in the light curve
+    buffer of the catalog. Otherwise it is obtained anew. */
+static void updateSrcResolvedLC(SimputCtlg* const cat,
+				SimputSrc* const src,
+				struct SimputSrcResolved* const res,
+				const double prevtime,
+				const double mjdref,
+				int* const status)
+{
+  // In a shared catalog, light curves loaded from files are never
+  // released.
+  if ((NULL!=res->lc) &&
+      ((isSimputCtlgShared(cat)) ||
+       (getSimputLCBufferNReleased(cat->lcbuff)==res->lcreleased))) {
+    return;
+  }
+
+  res->lc=getSimputLC(cat, src, res->timeref, prevtime, mjdref, status);
+  CHECK_STATUS_VOID(*status);
+  res->lcreleased=
+    getSimputLCBufferNReleased(getSimputCtlgCore(cat)->lcbuff);
+
+  // The light curve might be allocated at the address of a released
+  // one.
+  res->lccursor.lc=NULL;
+}
+
+
+/** Determine the time of the next photon from a photon list. The
+    function returns 1 if the end of the photon list has been
+    reached. */
+static int getPhListPhotonTime(SimputCtlg* const cat,
+			       SimputSrc* const src,
+			       SimputPhList* const phl,
+			       const double prevtime,
+			       const double mjdref,
+			       double* const nexttime,
+			       int* const status)
+{
+  // Determine the acceptance rate for photons.
+  if (0.==phl->accrate) {
+    // Determine the average photon rate.
+    float avgrate=getSimputPhotonRate(cat, src, prevtime, mjdref, status);
+    CHECK_STATUS_RET(*status, 0);
+
+    // Check if the rate is 0.
+    if (0.==avgrate) {
+      return(1);
+    }
+    assert(avgrate>0.);
+
+    // Acceptance rate.
+    assert(phl->nphs>0);
+    phl->accrate=avgrate *(phl->tstop-phl->tstart)/phl->nphs;
+    assert(phl->accrate>0.);
+
+    // Check if the rate greater than 1. In that case the rate of
+    // photons in the list is too low to fulfill the requested
+    // source flux.
+    if (phl->accrate>1.0) {
+      *status=EXIT_FAILURE;
+      char msg[SIMPUT_MAXSTR];
+      sprintf(msg, "required photon rate (%e) higher than provided "
+	      "by photon list (%e)",
+	      avgrate, phl->nphs/(phl->tstop-phl->tstart));
+      SIMPUT_ERROR(msg);
+      return(0);
+    }
+  }
+
+  // Verify that the time column is present.
+  if (0==phl->ctime) {
+    *status=EXIT_FAILURE;
+    SIMPUT_ERROR("photon list does not contain a time column");
+    return(0);
+  }
+
+  // If the photon times are sorted and the next row is earlier than
+  // the previous photon time, move directly to the first row after
+  // it instead of passing all rows in between.
+  checkSimputPhListTimeSorted(cat, phl, status);
+  CHECK_STATUS_RET(*status, 0);
+  if ((1==phl->tsorted) && (phl->currrow<phl->nphs)) {
+    long buffrow=getSimputPhListBuffRow(cat, phl, phl->currrow+1, status);
+    CHECK_STATUS_RET(*status, 0);
+    if (isSimputPhListTimeBefore(phl, phl->btime[buffrow], prevtime, mjdref)) {
+      seekSimputPhListTime(cat, phl, prevtime, mjdref, status);
+      CHECK_STATUS_RET(*status, 0);
+    }
+  }
+
+  // Select a photon.
+  double rand=0.0;
+  double newtime;
+  do {
+    // Move one row further.
+    phl->currrow++;
+
+    // Check if the end of the list has been reached.
+    if (phl->currrow>phl->nphs) {
+      // No valid photon could be selected.
+      return(1);
+    }
+
+    // Obtain the time from the buffered block of rows.
+    long buffrow=getSimputPhListBuffRow(cat, phl, phl->currrow, status);
+    CHECK_STATUS_RET(*status, 0);
+    newtime=phl->btime[buffrow];
+
+    // Check if the time lies within the requested interval.
+    if (isSimputPhListTimeBefore(phl, newtime, prevtime, mjdref)) {
+      continue;
+    }
+
+    // Determine a random number in order to apply the acceptance rate.
+    rand=getSimputCtlgRndNum(cat, status);
+    CHECK_STATUS_RET(*status, 0);
+
+  } while (rand>=phl->accrate);
+
+  // Successfully produced a photon.
+  *nexttime=newtime;
+  return(0);
+}
+
+
+/** Determine the time offset with respect to the beginning of a light
+    curve bin, at which the integral of the linear flux a*t+b starting
+    at the offset t reaches the specified value. */
+static inline double solveLCBin(const double ak,
+				const double bk,
+				const double stepwidth,
+				const double t,
+				const double integral)
+{
+  double offset;
+  if (fabs(ak*stepwidth)>fabs(bk*1.e-6)) {
+    // Instead of checking if ak = 0., check, whether its product
+    // with the interval length is a very small number in comparison
+    // to b_kk. If ak * stepwidth is much smaller than b_kk, the
+    // rate in the interval can be assumed to be approximately constant.
+    double arg=bk*bk+ak*ak*t*t+2.*ak*t*bk+2.*ak*integral;
+    offset=(-bk+sqrt(MAX(arg, 0.)))/ak;
+  } else if (bk>0.) {
+    offset=t+integral/bk;
+  } else {
+    offset=t;
+  }
+  return(MIN(MAX(offset, t), stepwidth));
+}
+
+
+/** Determine the time of the next photon from a light curve, which
+    is either loaded from a file or created from a PSD. The light
+    curve pointer is updated if a new light curve has to be produced
+    from the PSD. The function returns 1 if the range of the light
+    curve has been exceeded.
+
+    The integral of the flux from the previous to the next photon
+    time is exponentially distributed (Klein & Roberts, 1984). It is
+    passed bin by bin, starting at the position stored in the cursor,
+    if the previous time agrees. If it extends over more than
+    SIMPUT_LC_MAXWALK bins, the next photon time is obtained by
+    inversion of the table of the integrated flux. The cursor can be
+    NULL. */
+static int getLCPhotonTime(SimputCtlg* const cat,
+			   SimputSrc* const src,
+			   char* const timeref,
+			   SimputLC** const lcptr,
+			   struct SimputLCCursor* const cursor,
+			   const float avgrate,
+			   double prevtime,
+			   const double mjdref,
+			   double* const nexttime,
+			   int* const status)
+{
+  SimputLC* lc=*lcptr;
+
+  // A light curve produced from a PSD has to be replaced by a new one,
+  // if it does not cover the requested time any more.
+  if ((lc->src_id>0) &&
+      (prevtime>=getLCTime(lc, lc->nentries-1, 0, mjdref))) {
+    lc=getSimputLC(cat, src, timeref, prevtime, mjdref, status);
+    CHECK_STATUS_RET(*status, 0);
+    *lcptr=lc;
+  }
+
+  // Integral of the flux divided by FLUXSCAL until the next photon.
+  double u=getSimputCtlgRndNum(cat, status);
+  CHECK_STATUS_RET(*status, 0);
+  double remaining=-log(1.-u)/avgrate;
+
+  // Make sure that FLUXSCAL is positive.
+  assert(lc->fluxscal>0.0);
+
+  while (1) {
+    struct SimputLCRateTable* rt=getSimputLCRateTable(lc, status);
+    CHECK_STATUS_RET(*status, 0);
+
+    // Determine the respective index kk of the light curve.
+    long long nperiods=0;
+    long kk;
+    if ((NULL!=cursor) && (cursor->lc==lc) && (cursor->time==prevtime) &&
+	(cursor->mjdref==mjdref)) {
+      kk=cursor->bin;
+      nperiods=cursor->nperiods;
+    } else {
+      kk=getLCBin(lc, prevtime, mjdref, &nperiods, status);
+      CHECK_STATUS_RET(*status, 0);
+    }
+
+    // Pass the bins sequentially.
+    double tk=getLCTime(lc, kk, nperiods, mjdref);
+    double t=prevtime-tk;
+    long nsteps;
+    int end=0;
+    for (nsteps=0; nsteps<SIMPUT_LC_MAXWALK; nsteps++) {
+      double stepwidth=getLCTime(lc, kk+1, nperiods, mjdref)-tk;
+
+      // Make sure that stepwidth is positive.
+      if (stepwidth<=0.0) {
+	*status=EXIT_FAILURE;
+	char msg[SIMPUT_MAXSTR];
+	sprintf(msg, "encountered nonpositive step width (%es) in light curve '%s'",
+		stepwidth, lc->fileref);
+	SIMPUT_ERROR(msg);
+	return(0);
+      }
+
+      double ak=(lc->flux[kk+1]-lc->flux[kk])/lc->fluxscal/stepwidth;
+      double bk=lc->flux[kk]/lc->fluxscal;
+
+      // Integral from the current time to the end of the bin.
+      double integral=bk*(stepwidth-t)+0.5*ak*(stepwidth*stepwidth-t*t);
+      if (remaining<=integral) {
+	*nexttime=tk+solveLCBin(ak, bk, stepwidth, t, remaining);
+	if (NULL!=cursor) {
+	  cursor->lc      =lc;
+	  cursor->time    =*nexttime;
+	  cursor->mjdref  =mjdref;
+	  cursor->nperiods=nperiods;
+	  cursor->bin     =kk;
+	}
+	return(0);
+      }
+      remaining-=MAX(integral, 0.);
+
+      // Move on to the next bin.
+      kk++;
+      if (kk>=lc->nentries-1) {
+	if (NULL==lc->phase) {
+	  end=1;
+	  break;
+	}
+	kk=0;
+	nperiods++;
+      }
+      tk=getLCTime(lc, kk, nperiods, mjdref);
+      t=0.;
+    }
+
+    // Search the bin, in which the integral is reached.
+    if (0==end) {
+      end=findLCRateTable(rt, &kk, &nperiods, &remaining);
+    }
+    if (0==end) {
+      tk=getLCTime(lc, kk, nperiods, mjdref);
+      double stepwidth=getLCTime(lc, kk+1, nperiods, mjdref)-tk;
+      if (stepwidth<=0.0) {
+	*status=EXIT_FAILURE;
+	char msg[SIMPUT_MAXSTR];
+	sprintf(msg, "encountered nonpositive step width (%es) in light curve '%s'",
+		stepwidth, lc->fileref);
+	SIMPUT_ERROR(msg);
+	return(0);
+      }
+      double ak=(lc->flux[kk+1]-lc->flux[kk])/lc->fluxscal/stepwidth;
+      double bk=lc->flux[kk]/lc->fluxscal;
+      *nexttime=tk+solveLCBin(ak, bk, stepwidth, 0., remaining);
+      if (NULL!=cursor) {
+	cursor->lc      =lc;
+	cursor->time    =*nexttime;
+	cursor->mjdref  =mjdref;
+	cursor->nperiods=nperiods;
+	cursor->bin     =kk;
+      }
+      return(0);
+    }
+
+    // If the end of the light curve is reached, check if it has
+    // been produced from a PSD. In that case one can create new one.
+    if ((NULL!=lc->phase) || (lc->src_id<=0)) {
+      break;
     }
+    prevtime=getLCTime(lc, lc->nentries-1, 0, mjdref);
+    lc=getSimputLC(cat, src, timeref, prevtime, mjdref, status);
+    CHECK_STATUS_RET(*status, 0);
+    *lcptr=lc;
   }
 
-  return(*(src->phrate));
+  // The range of the light curve has been exceeded.
+  // So the routine has failed to determine a photon time.
+  if (NULL!=cursor) {
+    cursor->lc=NULL;
+  }
+  return(1);
 }
 
 
@@ -1446,13 +4785,17 @@ int getSimputPhotonTime(SimputCtlg* const cat,
 {
   // Determine the time of the next photon.
 
-  // Determine the reference to the timing extension.
-  char timeref[SIMPUT_MAXSTR];
-  getSrcTimeRef(cat, src, timeref);
+  // Use the random number stream of the source, if available.
+  selectSimputSrcRndStream(cat, src, status);
+  CHECK_STATUS_RET(*status, 0);
+
+  // Determine the references to the extensions of the source.
+  struct SimputSrcResolved* res=
+    getSimputSrcResolved(cat, src, prevtime, mjdref, status);
   CHECK_STATUS_RET(*status, 0);
 
   // Check if a timing extension has been specified.
-  if (0==strlen(timeref)) {
+  if ('\0'==res->timeref[0]) {
     // The source has a constant brightness.
 
     // Determine the average photon rate.
@@ -1467,7 +4810,7 @@ int getSimputPhotonTime(SimputCtlg* const cat,
 
     // Time intervals between subsequent photons are exponentially
     // distributed.
-    *nexttime=prevtime+rndexp((double)1./avgrate, status);
+    *nexttime=prevtime+rndexp(cat, (double)1./avgrate, status);
     CHECK_STATUS_RET(*status, 0);
 
     // Successfully produced a photon.
@@ -1475,703 +4818,1502 @@ int getSimputPhotonTime(SimputCtlg* const cat,
 
   } else {
     // The source has a time-variable brightness.
-    int timetype=getSimputExtType(cat, timeref, status);
-    CHECK_STATUS_RET(*status, 0);
 
     // Check if the extension type of the timing reference.
-    if (EXTTYPE_PHLIST==timetype) {
+    if (EXTTYPE_PHLIST==res->timetype) {
       // The timing reference points to a photon list.
 
-      // Get the photon list.
-      SimputPhList* phl=getSimputPhList(cat, timeref, status);
+      // Get the photon list. In a shared catalog, each thread has
+      // its own photon lists, which are therefore not stored in the
+      // resolved references.
+      checkSrcResolvedEvicted(cat, res);
+      SimputPhList* phl=res->timephl;
+      if (isSimputCtlgShared(cat)) {
+	phl=getSimputPhList(cat, res->timeref, status);
+	CHECK_STATUS_RET(*status, 0);
+      } else if (NULL==phl) {
+	phl=getSimputPhList(cat, res->timeref, status);
+	CHECK_STATUS_RET(*status, 0);
+	res->timephl=phl;
+      }
+
+      return(getPhListPhotonTime(cat, src, phl, prevtime, mjdref,
+				 nexttime, status));
+
+    } else if ((EXTTYPE_LC==res->timetype) || (EXTTYPE_PSD==res->timetype)) {
+      // The timing reference points either to a light curve
+      // or a PSD.
+
+      // Determine the average photon rate.
+      float avgrate=getSimputPhotonRate(cat, src, prevtime, mjdref, status);
       CHECK_STATUS_RET(*status, 0);
 
-      // Determine the acceptance rate for photons.
-      if (0.==phl->accrate) {
-	// Determine the average photon rate.
-	float avgrate=getSimputPhotonRate(cat, src, prevtime, mjdref, status);
+      // Check if the rate is 0.
+      if (0.==avgrate) {
+	return(1);
+      }
+      assert(avgrate>0.);
+
+      // In a shared catalog, the light curves generated from PSDs
+      // are specific for each thread and are therefore not stored
+      // in the resolved references.
+      if ((EXTTYPE_PSD==res->timetype) && (isSimputCtlgShared(cat))) {
+	SimputLC* lc=getSimputLC(cat, src, res->timeref, prevtime, mjdref,
+				 status);
 	CHECK_STATUS_RET(*status, 0);
+	return(getLCPhotonTime(cat, src, res->timeref, &lc, NULL, avgrate,
+			       prevtime, mjdref, nexttime, status));
+      }
+
+      // Get the light curve.
+      updateSrcResolvedLC(cat, src, res, prevtime, mjdref, status);
+      CHECK_STATUS_RET(*status, 0);
+
+      // The resolved references are shared by the threads using a
+      // shared catalog. Therefore the position in the light curve
+      // cannot be kept.
+      struct SimputLCCursor* cursor=NULL;
+      if (!isSimputCtlgShared(cat)) {
+	cursor=&(res->lccursor);
+      }
+      int failed=getLCPhotonTime(cat, src, res->timeref, &res->lc, cursor,
+				 avgrate, prevtime, mjdref, nexttime, status);
+      CHECK_STATUS_RET(*status, 0);
+
+      // The light curve might have been replaced by a new one
+      // created from the PSD.
+      if (!isSimputCtlgShared(cat)) {
+	res->lcreleased=getSimputLCBufferNReleased(cat->lcbuff);
+      }
+
+      return(failed);
+
+    } else {
+      // The timing reference does not point to any of the
+      // above extension types.
+      *status=EXIT_FAILURE;
+      SIMPUT_ERROR("invalid timing extension");
+      return(0);
+    }
+  }
+}
+
+
+/** Increase the counter of the number of randomly drawn photons and
+    check if it exceeds one fifth of the total number of available
+    photons. */
+static void countSimputPhListDraw(SimputPhList* const phl)
+{
+  if (0==(++phl->nrphs) % MAX(phl->nphs/5, 1)) {
+    char msg[SIMPUT_MAXSTR];
+    float ratio=phl->nrphs*1./phl->nphs;
+    sprintf(msg, "ratio of the number of randomly drawn photons (%ld) "
+	    "versus total number of photons (%ld) exceeds %.0lf%%! ",
+	    phl->nrphs, phl->nphs, ratio*100.);
+    if (ratio<1.) {
+      strcat(msg, "Individual photons might be used multiple times");
+    } else {
+      strcat(msg, "Individual photons are used multiple times");
+    }
+    SIMPUT_WARNING(msg);
+  }
+}
 
-	// Check if the rate is 0.
-	if (0.==avgrate) {
-	  return(1);
+
+static void getSimputPhFromPhList(const SimputCtlg* const cat,
+				  SimputPhList* const phl,
+				  float* const energy,
+				  double* const ra,
+				  double* const dec,
+				  int* const status)
+{
+  // Check if we have to read from a particular row in the FITS file,
+  // or if we need to return a randomly selected photon.
+  if (phl->currrow>0) {
+    // Obtain the photon at a particular row from the buffered
+    // block of rows.
+    long buffrow=getSimputPhListBuffRow(cat, phl, phl->currrow, status);
+    CHECK_STATUS_VOID(*status);
+    *energy=phl->benergy[buffrow];
+    *ra    =phl->bra[buffrow];
+    *dec   =phl->bdec[buffrow];
+
+    return;
+
+  }
+
+  int inmem=isSimputPhListInMemory(cat, phl, status);
+  CHECK_STATUS_VOID(*status);
+  if (0!=inmem) {
+    // Randomly select a photon from the list kept in memory. The
+    // alias table accounts for the effective area of the instrument
+    // at the photon energies.
+    buildSimputPhListAliasTable(cat, phl, status);
+    CHECK_STATUS_VOID(*status);
+
+    double rnd=getSimputCtlgRndNum(cat, status);
+    CHECK_STATUS_VOID(*status);
+    long ii=drawAliasTable(phl->aliasprob, phl->alias, phl->nphs, rnd);
+
+    *energy=phl->benergy[ii];
+    *ra    =phl->bra[ii];
+    *dec   =phl->bdec[ii];
+
+    countSimputPhListDraw(phl);
+    return;
+
+  } else {
+    // Randomly select a photon from the file.
+
+    // Determine the maximum value of the instrument ARF.
+    if (0.==phl->refarea) {
+      long kk;
+      for (kk=0; kk<cat->arf->NumberEnergyBins; kk++) {
+	if (cat->arf->EffArea[kk]>phl->refarea) {
+	  phl->refarea=cat->arf->EffArea[kk];
 	}
-	assert(avgrate>0.);
+      }
+    }
 
-	// Acceptance rate.
-	assert(phl->nphs>0);
-	phl->accrate=avgrate *(phl->tstop-phl->tstart)/phl->nphs;
-	assert(phl->accrate>0.);
+    while(1) {
+      // Determine a random photon within the list.
+      long ii=(long)(getSimputCtlgRndNum(cat, status)*phl->nphs);
+      CHECK_STATUS_VOID(*status);
 
-	// Check if the rate greater than 1. In that case the rate of
-	// photons in the list is too low to fulfill the requested
-	// source flux.
-	if (phl->accrate>1.0) {
-	  *status=EXIT_FAILURE;
-	  char msg[SIMPUT_MAXSTR];
-	  sprintf(msg, "required photon rate (%e) higher than provided "
-		  "by photon list (%e)",
-		  avgrate, phl->nphs/(phl->tstop-phl->tstart));
-	  SIMPUT_ERROR(msg);
-	  return(0);
+      // Read the photon energy.
+      int anynul=0;
+      fits_read_col(phl->fptr, TFLOAT, phl->cenergy, ii+1, 1, 1,
+		    NULL, energy, &anynul, status);
+      if (EXIT_SUCCESS!=*status) {
+	SIMPUT_ERROR("failed reading energy from photon list");
+	return;
+      }
+      *energy *=phl->fenergy;
+
+      // Determine the ARF value for the photon energy.
+      long upper=cat->arf->NumberEnergyBins-1, lower=0, mid;
+      while (upper>lower) {
+	mid=(lower+upper)/2;
+	if (cat->arf->HighEnergy[mid]<*energy) {
+	  lower=mid+1;
+	} else {
+	  upper=mid;
 	}
       }
 
-      // Verify that the time column is present.
-      if (0==phl->ctime) {
-	*status=EXIT_FAILURE;
-	SIMPUT_ERROR("photon list does not contain a time column");
-	return(0);
+      // Randomly determine according to the effective area
+      // of the instrument, whether this photon is seen or not.
+      double r=getSimputCtlgRndNum(cat, status);
+      CHECK_STATUS_VOID(*status);
+      if (r<cat->arf->EffArea[lower]/phl->refarea) {
+	// Read the position of the photon.
+	fits_read_col(phl->fptr, TDOUBLE, phl->cra, ii+1, 1, 1,
+		      NULL, ra, &anynul, status);
+	if (EXIT_SUCCESS!=*status) {
+	  SIMPUT_ERROR("failed reading right ascension from photon list");
+	  return;
+	}
+	*ra *=phl->fra;
+
+	fits_read_col(phl->fptr, TDOUBLE, phl->cdec, ii+1, 1, 1,
+		      NULL, dec, &anynul, status);
+	if (EXIT_SUCCESS!=*status) {
+	  SIMPUT_ERROR("failed reading declination from photon list");
+	  return;
+	}
+	*dec *=phl->fdec;
+
+	countSimputPhListDraw(phl);
+	return;
+      }
+    }
+  }
+}
+
+
+/** Transform the position of a photon from a photon list, which is
+    given relative to the reference position, to the position of the
+    source applying IMGSCAL and IMGROTA. */
+static void shiftPhListPhotonCoord(const SimputSrc* const src,
+				   double b_ra,
+				   double b_dec,
+				   double* const ra,
+				   double* const dec)
+{
+  // Apply IMGSCAL.
+  b_ra *=1./src->imgscal*cos(b_dec)/cos(b_dec/src->imgscal);
+  b_dec*=1./src->imgscal;
+
+  // Get a Carteesian coordinate vector for the photon location.
+  Vector p=unit_vector(b_ra, b_dec);
+
+  // Apply IMGROTA by rotation around the x-axis.
+  double cosimgrota=cos(src->imgrota);
+  double sinimgrota=sin(src->imgrota);
+  Vector r;
+  r.x= p.x;
+  r.y= cosimgrota*p.y + sinimgrota*p.z;
+  r.z=-sinimgrota*p.y + cosimgrota*p.z;
+
+  // Rotate the vector towards the source position.
+  double cosra=cos(src->ra);
+  double sinra=sin(src->ra);
+  double cosdec=cos(src->dec);
+  double sindec=sin(src->dec);
+  Vector f;
+  f.x=r.x*cosra*cosdec - r.y*sinra - r.z*cosra*sindec;
+  f.y=r.x*sinra*cosdec + r.y*cosra - r.z*sinra*sindec;
+  f.z=r.x      *sindec +     0.0   + r.z      *cosdec;
+
+  // Determine RA and Dec of the photon.
+  calculate_ra_dec(f, ra, dec);
+}
+
+
+/** Determine the photon energy from the spectral distribution
+    according to the given random number in the interval [0,1]. */
+static float getSpecPhotonEnergy(const SimputCtlg* const cat,
+				 SimputSpec* const spec,
+				 double rnd,
+				 int* const status)
+{
+  long nbins=cat->arf->NumberEnergyBins;
+  long lower;
+
+  if (SIMPUT_SAMPLING_ALIAS==cat->specsampling) {
+    // Set up the alias table, if the method has been selected
+    // after the spectral distribution was created.
+    if (NULL==spec->alias) {
+      buildAliasTable(spec->distribution, nbins,
+		      &spec->aliasprob, &spec->alias, status);
+      CHECK_STATUS_RET(*status, 0.);
+    }
+
+    lower=drawAliasTable(spec->aliasprob, spec->alias, nbins, rnd);
+
+  } else {
+    // Multiply the random number with the total photon rate
+    // (i.e. the spectrum does not have to be normalized).
+    rnd*=spec->distribution[nbins-1];
+
+    // Determine the corresponding point in the spectral
+    // distribution (using binary search).
+    long upper=nbins-1, mid;
+    lower=0;
+    while (upper>lower) {
+      mid=(lower+upper)/2;
+      if (spec->distribution[mid]<rnd) {
+	lower=mid+1;
+      } else {
+	upper=mid;
+      }
+    }
+  }
+
+  // Return the corresponding photon energy.
+  float energy=
+    cat->arf->LowEnergy[lower] +
+    getSimputCtlgRndNum(cat, status)*
+    (cat->arf->HighEnergy[lower]-cat->arf->LowEnergy[lower]);
+  CHECK_STATUS_RET(*status, 0.);
+
+  return(energy);
+}
+
+
+/** Determine the photon energy at the specified time from a light
+    curve with a SPECTRUM column according to the given random number
+    in the interval [0,1]. The spectra of the current and the next
+    bin of the light curve are interpolated linearly. */
+static float getLCSpecPhotonEnergy(SimputCtlg* const cat,
+				   struct SimputLCSpecTable* const st,
+				   const long lcbin,
+				   const double currtime,
+				   double rnd,
+				   int* const status)
+{
+  // Determine the spectra of the current and the next bin of the
+  // light curve.
+  SimputSpec* spec;
+  SimputSpec* spec_next;
+  getLCSpecTablePair(cat, st, lcbin, &spec, &spec_next, status);
+  CHECK_STATUS_RET(*status, 0.);
+
+  // We compute the interpolation factors between the two
+  // spectra from the times of the bins:
+  double af=(st->time[lcbin+1]-currtime)*st->rwidth[lcbin];
+  double bf=1.-af;
+
+  // Multiply the random number with total photon rate
+  // (i.e. the spectrum does not have to be normalized).
+  rnd*=(af*spec->distribution[cat->arf->NumberEnergyBins-1]+
+	bf*spec_next->distribution[cat->arf->NumberEnergyBins-1]);
+
+  // Determine the corresponding point in the spectral
+  // distribution (using binary search).
+  long upper=cat->arf->NumberEnergyBins-1, lower=0, mid;
+  while (upper>lower) {
+    mid=(lower+upper)/2;
+    if ((af*spec->distribution[mid]+bf*spec_next->distribution[mid])<rnd) {
+      lower=mid+1;
+    } else {
+      upper=mid;
+    }
+  }
+
+  // Return the corresponding photon energy.
+  float energy=
+    cat->arf->LowEnergy[lower] +
+    getSimputCtlgRndNum(cat, status)*
+    (cat->arf->HighEnergy[lower]-cat->arf->LowEnergy[lower]);
+  CHECK_STATUS_RET(*status, 0.);
+
+  return(energy);
+}
+
+
+/** Set up the WCS of an image for a particular source. The source
+    position is assigned to the reference point and the scaling is
+    adapted according to IMGSCAL. The wcsprm data structure contained
+    in the image is not modified, since it is used for all sources
+    including the image. The returned data structure has to be
+    released with wcsfree. */
+static void getSrcImgWcs(const SimputImg* const img,
+			 const SimputSrc* const src,
+			 struct wcsprm* const wcs,
+			 int* const status)
+{
+  wcscopy(1, img->wcs, wcs);
+
+  // Set the position to the origin and assign the correct scaling.
+  // TODO: This assumes that the image WCS is equivalent to the
+  // coordinate system used in the catalog!!
+  wcs->crval[0] =src->ra *180./M_PI;
+  wcs->crval[1] =src->dec*180./M_PI;
+  wcs->cdelt[0]*=1./src->imgscal;
+  wcs->cdelt[1]*=1./src->imgscal;
+  wcs->flag=0;
+
+  // Check that CUNIT is set to "deg". Otherwise there will be a conflict
+  // between CRVAL [deg] and CDELT [different unit].
+  // TODO This is not required by the standard.
+  check_wcs_unit_degree(wcs, status);
+  CHECK_STATUS_VOID(*status);
+
+  // If CUNIT is set to 'degree', change this to 'deg'.
+  // Otherwise the WCSlib will not work properly.
+  if (0==strcmp(wcs->cunit[0], "degree  ")) {
+    strcpy(wcs->cunit[0], "deg");
+  }
+  if (0==strcmp(wcs->cunit[1], "degree  ")) {
+    strcpy(wcs->cunit[1], "deg");
+  }
+
+  // Set up the WCS completely. Otherwise it would be set up by the
+  // first transformation, which might be performed concurrently by
+  // several threads using a shared catalog.
+  if (0!=wcsset(wcs)) {
+    SIMPUT_ERROR("initialization of WCS data structure failed");
+    *status=EXIT_FAILURE;
+    return;
+  }
+}
+
+
+/** Determine the direction of origin of a photon from an image using
+    the source-specific WCS obtained from getSrcImgWcs and the cosine
+    and sine of the IMGROTA of the source. */
+static void getImgPhotonCoord(const SimputCtlg* const cat,
+			      SimputImg* const img,
+			      struct wcsprm* const wcs,
+			      const double cosimgrota,
+			      const double sinimgrota,
+			      double* const ra,
+			      double* const dec,
+			      int* const status)
+{
+  // Make sure that the tables for drawing pixels are available.
+  if ((NULL==img->cdfx) ||
+      ((SIMPUT_SAMPLING_ALIAS==cat->imgsampling) && (NULL==img->alias))) {
+    buildSimputImgTables(img, cat->imgsampling, status);
+    CHECK_STATUS_VOID(*status);
+  }
+
+  double rnd=getSimputCtlgRndNum(cat, status);
+  CHECK_STATUS_VOID(*status);
+
+  long xl, yl;
+  if (SIMPUT_SAMPLING_ALIAS==cat->imgsampling) {
+    long pixel=drawAliasTable(img->aliasprob, img->alias,
+			      img->naxis1*img->naxis2, rnd);
+    xl=pixel/img->naxis2;
+    yl=pixel%img->naxis2;
+
+  } else {
+    // Perform a binary search in 2 dimensions.
+    rnd*=img->cdfx[img->naxis1-1];
+
+    // Perform a binary search to obtain the x-coordinate.
+    long high=img->naxis1-1;
+    long mid;
+    xl=0;
+    while (high > xl) {
+      mid=(xl+high)/2;
+      if (img->cdfx[mid] < rnd) {
+	xl=mid+1;
+      } else {
+	high=mid;
+      }
+    }
+
+    // Search for the y coordinate.
+    const double* column=&(img->cdf[xl*img->naxis2]);
+    high=img->naxis2-1;
+    yl=0;
+    while (high > yl) {
+      mid=(yl+high)/2;
+      if (column[mid] < rnd) {
+	yl=mid+1;
+      } else {
+	high=mid;
       }
+    }
+  }
+  // Now xl and yl have pixel positions [long pixel coordinates].
+
+  // Determine floating point pixel positions shifted by 0.5 in
+  // order to match the FITS conventions and with a randomization
+  // over the pixels.
+  double xd=(double)xl + 0.5 + getSimputCtlgRndNum(cat, status);
+  CHECK_STATUS_VOID(*status);
+  double yd=(double)yl + 0.5 + getSimputCtlgRndNum(cat, status);
+  CHECK_STATUS_VOID(*status);
+
+  // Rotate the image (pixel coordinates) by IMGROTA around the
+  // reference point.
+  double xdrot=
+    (xd-wcs->crpix[0])*cosimgrota +
+    (yd-wcs->crpix[1])*sinimgrota + wcs->crpix[0];
+  double ydrot=
+    -(xd-wcs->crpix[0])*sinimgrota +
+     (yd-wcs->crpix[1])*cosimgrota + wcs->crpix[1];
+
+  // Convert the long-valued pixel coordinates to double values,
+  // including a randomization over the pixel and transform from
+  // pixel coordinates to RA and DEC ([rad]) using the  WCS information.
+  wcsPix2Sky(wcs, xdrot, ydrot, ra, dec, status);
+  CHECK_STATUS_VOID(*status);
+
+  // Determine the RA in the interval from [0:2pi).
+  while(*ra>=2.*M_PI) {
+    *ra-=2.*M_PI;
+  }
+  while(*ra<0.) {
+    *ra+=2.*M_PI;
+  }
+}
+
+
+/** Obtain the spectrum and the image of a source with time-independent
+    references and set up the WCS of the image for the source, unless
+    this has been done before. */
+static void loadSrcResolvedSpecImg(SimputCtlg* const cat,
+				   const SimputSrc* const src,
+				   struct SimputSrcResolved* const res,
+				   int* const status)
+{
+  checkSrcResolvedEvicted(cat, res);
+
+  if ((NULL==res->spec) && (EXTTYPE_MIDPSPEC==res->spectype)) {
+    res->spec=getSimputSpec(cat, res->specref, status);
+    CHECK_STATUS_VOID(*status);
+  }
+
+  if ((NULL==res->img) && (EXTTYPE_IMAGE==res->imagtype)) {
+    res->img=getSimputImg(cat, res->imagref, status);
+    CHECK_STATUS_VOID(*status);
+
+    // Set up the WCS of the image for this particular source.
+    res->wcs=(struct wcsprm*)malloc(sizeof(struct wcsprm));
+    CHECK_NULL_VOID(res->wcs, *status,
+		    "memory allocation for WCS data structure failed");
+    res->wcs->flag=-1;
+    getSrcImgWcs(res->img, src, res->wcs, status);
+    CHECK_STATUS_VOID(*status);
+    res->cosimgrota=cos(src->imgrota);
+    res->sinimgrota=sin(src->imgrota);
+  }
+}
+
+
+void getSimputPhotonEnergyCoord(SimputCtlg* const cat,
+				SimputSrc* const src,
+				double currtime,
+				const double mjdref,
+				float* const energy,
+				double* const ra,
+				double* const dec,
+				int* const status)
+{
+  // Determine if we have a Light Curve or a single spectrum is
+  // given:
+
+  // We set a flag indicating wether we have a spectra-based
+  // lightcurve or not:
+  int speclightcurve=0;
 
-      // Select a photon.
-      double rand=0.0;
-      double newtime;
-      do {
-	// Move one row further.
-	phl->currrow++;
+  // Use the random number stream of the source, if available.
+  selectSimputSrcRndStream(cat, src, status);
+  CHECK_STATUS_VOID(*status);
 
-	// Check if the end of the list has been reached.
-	if (phl->currrow>phl->nphs) {
-	  // No valid photon could be selected.
-	  return(1);
-	}
+  // Determine the references to the extensions of the source.
+  struct SimputSrcResolved* res=
+    getSimputSrcResolved(cat, src, currtime, mjdref, status);
+  CHECK_STATUS_VOID(*status);
 
-	// Read the time from the file.
-	int anynul=0;
-	fits_read_col(phl->fptr, TDOUBLE, phl->ctime, phl->currrow, 1, 1,
-		      NULL, &newtime, &anynul, status);
-	if (EXIT_SUCCESS!=*status) {
-	  SIMPUT_ERROR("failed reading time from photon list");
-	  return(0);
-	}
-	newtime*=phl->ftime;
+  // Extension types and references to the spectrum and the image.
+  int spectype, imagtype;
+  char specref[SIMPUT_MAXSTR];
+  char imagref[SIMPUT_MAXSTR];
 
-	// Check if the time lies within the requested interval.
-	if (newtime+phl->timezero+(phl->mjdref-mjdref)*24.*3600.<prevtime) {
-	  continue;
-	}
+  // We declare a light curve for future possible use:
+  SimputLC* lc=NULL;
 
-	// Determine a random number in order to apply the acceptance rate.
-	rand=getRndNum(status);
-	CHECK_STATUS_RET(*status, 0);
+  // Spectra in the bins of a light curve with a SPECTRUM column and
+  // the current bin.
+  struct SimputLCSpecTable* st=NULL;
+  long lcbin=0;
 
-      } while (rand>=phl->accrate);
+  // Photon list, spectrum, and image for this photon.
+  SimputPhList* phl=NULL;
+  SimputSpec* spec=NULL;
+  SimputImg* img=NULL;
+
+  if (0==res->varrefs) {
+    // The references do not depend on time and have been resolved
+    // before.
+    spectype=res->spectype;
+    imagtype=res->imagtype;
+
+    // If the spectrum or the image reference point to a photon list,
+    // determine simultaneously the energy and spatial information.
+    // In a shared catalog, each thread has its own photon lists,
+    // which are therefore not stored in the resolved references.
+    if (isSimputCtlgShared(cat)) {
+      if (EXTTYPE_PHLIST==spectype) {
+	phl=getSimputPhList(cat, res->specref, status);
+      } else if (EXTTYPE_PHLIST==imagtype) {
+	phl=getSimputPhList(cat, res->imagref, status);
+      }
+      CHECK_STATUS_VOID(*status);
+    } else {
+      checkSrcResolvedEvicted(cat, res);
+      if ((NULL==res->phl) && (EXTTYPE_PHLIST==spectype)) {
+	res->phl=getSimputPhList(cat, res->specref, status);
+	CHECK_STATUS_VOID(*status);
+      } else if ((NULL==res->phl) && (EXTTYPE_PHLIST==imagtype)) {
+	char msg[SIMPUT_MAXSTR];
+	sprintf(msg, "Image-based Light curves is a feature not "
+		"fully support right now. We are currently working on it");
+	SIMPUT_WARNING(msg);
+
+	res->phl=getSimputPhList(cat, res->imagref, status);
+	CHECK_STATUS_VOID(*status);
+      }
+      phl=res->phl;
+    }
 
-      // Successfully produced a photon.
-      *nexttime=newtime;
-      return(0);
+    loadSrcResolvedSpecImg(cat, src, res, status);
+    CHECK_STATUS_VOID(*status);
+    spec=res->spec;
+    img=res->img;
 
-    } else if ((EXTTYPE_LC==timetype) || (EXTTYPE_PSD==timetype)) {
-      // The timing reference points either to a light curve
-      // or a PSD.
+  } else {
+    // Get the respective light curve.
+    lc=getSimputLC(cat, src, res->timeref, currtime, mjdref, status);
+    CHECK_STATUS_VOID(*status);
 
-      // Determine the average photon rate.
-      float avgrate=getSimputPhotonRate(cat, src, prevtime, mjdref, status);
-      CHECK_STATUS_RET(*status, 0);
+    // Check if there is a spectrum column in the light curve.
+    if (NULL!=lc->spectrum) {
+      // In this case we should use 2 spectra in each light curve
+      // bin in order to interpolate information from both spectra.
+      speclightcurve=1;
 
-      // Check if the rate is 0.
-      if (0.==avgrate) {
-	return(1);
+      // The references to the spectra are resolved only once for
+      // all bins of the light curve.
+      st=getSimputLCSpecTable(cat, lc, res->timeref, status);
+      CHECK_STATUS_VOID(*status);
+      long long nperiods;
+      lcbin=getLCBin(lc, currtime, mjdref, &nperiods, status);
+      CHECK_STATUS_VOID(*status);
+      assert(lcbin+1 < lc->nentries);
+      if (NULL==st->ref[lcbin]) {
+	SIMPUT_ERROR("in the current implementation light curves "
+		     "must not contain blank entries in a given "
+		     "spectrum column");
+	*status=EXIT_FAILURE;
+	return;
       }
-      assert(avgrate>0.);
+      strcpy(specref, st->ref[lcbin]);
+      spectype=st->type[lcbin];
+    } else {
+      // Determine the reference to the spectrum for the updated
+      // photon arrival time.
+      getSimputSrcSpecRef(cat, src, currtime, mjdref, specref, status);
+      CHECK_STATUS_VOID(*status);
+      spectype=getSimputExtType(cat, specref, status);
+      CHECK_STATUS_VOID(*status);
+    }
 
-      // Get the light curve.
-      SimputLC* lc=getSimputLC(cat, src, timeref, prevtime, mjdref, status);
-      CHECK_STATUS_RET(*status, 0);
+    // Determine the reference to the image for the updated photon
+    // arrival time and its extension type.
+    getSrcImagRef(cat, src, currtime, mjdref, imagref, status);
+    CHECK_STATUS_VOID(*status);
+    imagtype=getSimputExtType(cat, imagref, status);
+    CHECK_STATUS_VOID(*status);
 
-      // Determine the photon time according to the light curve.
-      // The light curve is a piece-wise constant function, so the
-      // general algorithm proposed by Klein & Roberts has to
-      // be applied.
-      // Step 1 in the algorithm.
-      double u=getRndNum(status);
-      CHECK_STATUS_RET(*status, 0);
+    // If the spectrum or the image reference point to a photon list,
+    // determine simultaneously the energy and spatial information.
+    if (EXTTYPE_PHLIST==spectype) {
+      phl=getSimputPhList(cat, specref, status);
+      CHECK_STATUS_VOID(*status);
+    } else if (EXTTYPE_PHLIST==imagtype) {
+      char msg[SIMPUT_MAXSTR];
+      sprintf(msg, "Image-based Light curves is a feature not "
+	      "fully support right now. We are currently working on it");
+      SIMPUT_WARNING(msg);
 
-      // Determine the respective index kk of the light curve.
-      long long nperiods=0;
-      long kk=getLCBin(lc, prevtime, mjdref, &nperiods, status);
-      CHECK_STATUS_RET(*status, 0);
+      phl=getSimputPhList(cat, imagref, status);
+      CHECK_STATUS_VOID(*status);
+    }
 
-      while ((kk<lc->nentries-1)||(lc->src_id>0)) {
+    if ((0==speclightcurve) && (EXTTYPE_MIDPSPEC==spectype)) {
+      spec=getSimputSpec(cat, specref, status);
+      CHECK_STATUS_VOID(*status);
+    }
 
-	// If the end of the light curve is reached, check if it has
-	// been produced from a PSD. In that case one can create new one.
-	if ((kk>=lc->nentries-1)&&(lc->src_id>0)) {
-	  lc=getSimputLC(cat, src, timeref, prevtime, mjdref, status);
-	  CHECK_STATUS_RET(*status, 0);
-	  kk=getLCBin(lc, prevtime, mjdref, &nperiods, status);
-	  CHECK_STATUS_RET(*status, 0);
-	}
+    if (EXTTYPE_IMAGE==imagtype) {
+      img=getSimputImg(cat, imagref, status);
+      CHECK_STATUS_VOID(*status);
+    }
+  }
 
-	// Determine the relative time within the kk-th interval
-	// (i.e., t=0 lies at the beginning of the kk-th interval).
-	double tk=getLCTime(lc, kk, nperiods, mjdref);
-	double t =prevtime-tk;
-	double stepwidth=
-	  getLCTime(lc, kk+1, nperiods, mjdref)-tk;
-
-	// Make sure that FLUXSCAL and stepwidth are positive.
-	assert(lc->fluxscal>0.0);
-	assert(stepwidth>0.0);
-	double ak=(lc->flux[kk+1]-lc->flux[kk])/lc->fluxscal/stepwidth;
-	double bk=lc->flux[kk]/lc->fluxscal;
-
-	// Make sure that stepwidth is positive.
-	if (stepwidth<=0.0) {
-	  *status=EXIT_FAILURE;
-	  char msg[SIMPUT_MAXSTR];
-	  sprintf(msg, "encountered nonpositive step width (%es) in light curve '%s'",
-		  stepwidth, lc->fileref);
-	  SIMPUT_ERROR(msg);
-	  return(0);
-	}
+  if (NULL!=phl) {
+    float b_energy;
+    double b_ra, b_dec;
+    getSimputPhFromPhList(cat, phl, &b_energy, &b_ra, &b_dec, status);
+    CHECK_STATUS_VOID(*status);
 
-	// Step 2 in the algorithm.
-	double uk=1.-exp((-ak/2.*(pow(stepwidth,2.)-pow(t,2.))
-			  -bk*(stepwidth-t))*avgrate);
-
-	// Step 3 in the algorithm.
-	if (u<=uk) {
-	  if (fabs(ak*stepwidth)>fabs(bk*1.e-6)) {
-	    // Instead of checking if ak = 0., check, whether its product
-	    // with the interval length is a very small number in comparison
-	    // to b_kk. If ak * stepwidth is much smaller than b_kk, the
-	    // rate in the interval can be assumed to be approximately constant.
-	    *nexttime=tk+
-	      (-bk+sqrt(pow(bk,2.)+pow(ak*t,2.)+2.*ak*t*bk-2.*ak*log(1.-u)/avgrate))/ak;
-	    return(0);
-
-	  } else { // ak == 0
-	    *nexttime=prevtime-log(1.-u)/(avgrate*bk);
-	    return(0);
-	  }
+    if (EXTTYPE_PHLIST==spectype) {
+      *energy=b_energy;
+    }
+    if (EXTTYPE_PHLIST==imagtype) {
+      // Shift the photon position according to the
+      // RA,Dec values defined for this source in the catalog.
+      shiftPhListPhotonCoord(src, b_ra, b_dec, ra, dec);
+    }
+  }
 
-	} else {
-	  // Step 4 (u > u_k).
-	  u=(u-uk)/(1-uk);
-	  kk++;
-	  if ((kk>=lc->nentries-1)&&(NULL!=lc->phase)) {
-	    kk=0;
-	    nperiods++;
-	  }
-	  prevtime=getLCTime(lc, kk, nperiods, mjdref);
-	}
-      }
-      // END of while (kk < lc->nentries).
 
-      // The range of the light curve has been exceeded.
-      // So the routine has failed to determine a photon time.
-      return(1);
+  // ---
+  // If the spectrum does NOT refer to a photon list, determine the
+  // photon energy from a spectrum.
 
-    } else {
-      // The timing reference does not point to any of the
-      // above extension types.
-      *status=EXIT_FAILURE;
-      SIMPUT_ERROR("invalid timing extension");
-      return(0);
-    }
-  }
-}
+  // Determine if we have a Light Curve or a single spectrum is
+  // given:
 
+  // Get a random number in the interval [0,1].
+  // We will use it afterwards for obtaining the photon energy:
+  double rnd=getSimputCtlgRndNum(cat, status);
+  CHECK_STATUS_VOID(*status);
+  assert(rnd>=0.);
+  assert(rnd<=1.);
 
-static void getSimputPhFromPhList(const SimputCtlg* const cat,
-				  SimputPhList* const phl,
-				  float* const energy,
-				  double* const ra,
-				  double* const dec,
-				  int* const status)
-{
-  // Check if we have to read from a particular row in the FITS file,
-  // or if we need to return a randomly selected photon.
-  if (phl->currrow>0) {
-    // Read a photon from a particular row.
-    int anynul=0;
-    fits_read_col(phl->fptr, TFLOAT, phl->cenergy, phl->currrow, 1, 1,
-		  NULL, energy, &anynul, status);
-    if (EXIT_SUCCESS!=*status) {
-      SIMPUT_ERROR("failed reading energy from photon list");
-      return;
-    }
-    *energy *=phl->fenergy;
+  if (speclightcurve) {
+    // If we have a lightcurve, we take the next spectrum too in
+    // order to perform the interpolation. We first suppose that
+    // all spectra are equally binned:
 
-    fits_read_col(phl->fptr, TDOUBLE, phl->cra, phl->currrow, 1, 1,
-		  NULL, ra, &anynul, status);
-    if (EXIT_SUCCESS!=*status) {
-      SIMPUT_ERROR("failed reading right ascension from photon list");
-      return;
+    if (EXTTYPE_MIDPSPEC==spectype && lc!=NULL) {
+      *energy=getLCSpecPhotonEnergy(cat, st, lcbin, currtime, rnd, status);
+      CHECK_STATUS_VOID(*status);
     }
-    *ra *=phl->fra;
+  } else {
+    // If there is no lightcurve we follow the usual process:
 
-    fits_read_col(phl->fptr, TDOUBLE, phl->cdec, phl->currrow, 1, 1,
-		  NULL, dec, &anynul, status);
-    if (EXIT_SUCCESS!=*status) {
-      SIMPUT_ERROR("failed reading declination from photon list");
-      return;
+    if (NULL!=spec) {
+      *energy=getSpecPhotonEnergy(cat, spec, rnd, status);
+      CHECK_STATUS_VOID(*status);
     }
-    *dec *=phl->fdec;
+  }
 
-    return;
+  // END of determine the photon energy.
+  // ---
 
-  } else {
-    // Randomly select a photon from the file.
 
-    // Determine the maximum value of the instrument ARF.
-    if (0.==phl->refarea) {
-      long kk;
-      for (kk=0; kk<cat->arf->NumberEnergyBins; kk++) {
-	if (cat->arf->EffArea[kk]>phl->refarea) {
-	  phl->refarea=cat->arf->EffArea[kk];
-	}
-      }
-    }
+  // ---
+  // If the image does NOT refer to a photon list, determine the
+  // spatial information.
 
-    while(1) {
-      // Determine a random photon within the list.
-      long ii=(long)(getRndNum(status)*phl->nphs);
+  // Point-like sources.
+  if (EXTTYPE_NONE==imagtype) {
+    *ra =src->ra;
+    *dec=src->dec;
+  }
+
+  // Spatially extended sources.
+  else if (NULL!=img) {
+    // Determine the photon direction from an image.
+    if (0==res->varrefs) {
+      // Use the WCS set up for this source before.
+      getImgPhotonCoord(cat, img, res->wcs, res->cosimgrota, res->sinimgrota,
+			ra, dec, status);
       CHECK_STATUS_VOID(*status);
 
-      // Read the photon energy.
-      int anynul=0;
-      fits_read_col(phl->fptr, TFLOAT, phl->cenergy, ii+1, 1, 1,
-		    NULL, energy, &anynul, status);
-      if (EXIT_SUCCESS!=*status) {
-	SIMPUT_ERROR("failed reading energy from photon list");
-	return;
-      }
-      *energy *=phl->fenergy;
+    } else {
+      struct wcsprm wcs={ .flag=-1 };
 
-      // Determine the ARF value for the photon energy.
-      long upper=cat->arf->NumberEnergyBins-1, lower=0, mid;
-      while (upper>lower) {
-	mid=(lower+upper)/2;
-	if (cat->arf->HighEnergy[mid]<*energy) {
-	  lower=mid+1;
-	} else {
-	  upper=mid;
-	}
-      }
+      do { // Error handling loop.
 
-      // Randomly determine according to the effective area
-      // of the instrument, whether this photon is seen or not.
-      double r=getRndNum(status);
-      CHECK_STATUS_VOID(*status);
-      if (r<cat->arf->EffArea[lower]/phl->refarea) {
-	// Read the position of the photon.
-	fits_read_col(phl->fptr, TDOUBLE, phl->cra, ii+1, 1, 1,
-		      NULL, ra, &anynul, status);
-	if (EXIT_SUCCESS!=*status) {
-	  SIMPUT_ERROR("failed reading right ascension from photon list");
-	  return;
-	}
-	*ra *=phl->fra;
+	// Create a temporary wcsprm data structure, which can be modified
+	// to fit this particular source.
+	getSrcImgWcs(img, src, &wcs, status);
+	CHECK_STATUS_BREAK(*status);
 
-	fits_read_col(phl->fptr, TDOUBLE, phl->cdec, ii+1, 1, 1,
-		      NULL, dec, &anynul, status);
-	if (EXIT_SUCCESS!=*status) {
-	  SIMPUT_ERROR("failed reading declination from photon list");
-	  return;
-	}
-	*dec *=phl->fdec;
+	getImgPhotonCoord(cat, img, &wcs,
+			  cos(src->imgrota), sin(src->imgrota),
+			  ra, dec, status);
+	CHECK_STATUS_BREAK(*status);
 
-	// Increase the counter of the number of returned photons and
-	// check if it exceeds one fifth of the total number of available
-	// photons.
-	if (0==(++phl->nrphs) % (phl->nphs/5)) {
-	  char msg[SIMPUT_MAXSTR];
-	  float ratio=phl->nrphs*1./phl->nphs;
-	  sprintf(msg, "ratio of the number of randomly drawn photons (%ld) "
-		  "versus total number of photons (%ld) exceeds %.0lf%%! ",
-		  phl->nrphs, phl->nphs, ratio*100.);
-	  if (ratio<1.) {
-	    strcat(msg, "Individual photons might be used multiple times");
-	  } else {
-	    strcat(msg, "Individual photons are used multiple times");
-	  }
-	  SIMPUT_WARNING(msg);
-	}
+      } while(0); // END of error handling loop.
 
-	return;
-      }
+      // Release memory.
+      wcsfree(&wcs);
     }
   }
+  // END of determine the photon direction.
+  // ---
+
+  return;
 }
 
 
-void getSimputPhotonEnergyCoord(SimputCtlg* const cat,
-				SimputSrc* const src,
-				double currtime,
-				const double mjdref,
-				float* const energy,
-				double* const ra,
-				double* const dec,
-				int* const status)
+int getSimputPhoton(SimputCtlg* const cat,
+		    SimputSrc* const src,
+		    double prevtime,
+		    const double mjdref,
+		    double* const nexttime,
+		    float* const energy,
+		    double* const ra,
+		    double* const dec,
+		    int* const status)
 {
-  // Determine if we have a Light Curve or a single spectrum is
-  // given:
+  // Determine the time of the next photon.
+  int failed=getSimputPhotonTime(cat, src, prevtime, mjdref, nexttime, status);
+  CHECK_STATUS_RET(*status, failed);
+  if (failed>0) return(failed);
 
-  // We set a flag indicating wether we have a spectra-based
-  // lightcurve or not:
-  int speclightcurve=0;
+  // Determine the energy and the direction of origin of the photon.
+  getSimputPhotonEnergyCoord(cat, src, *nexttime, mjdref,
+			     energy, ra, dec, status);
+  CHECK_STATUS_RET(*status, 0);
+
+  return(0);
+}
+
+
+/** References of a source, which are resolved once for a batch of
+    photons (see getSimputPhotonBatch). The pointers remain valid as
+    long as no extensions are released from the buffers of the
+    catalog. */
+struct SimputPhotonBatchRefs {
+  struct SimputSrcResolved* res;
+
+  // Number of extensions released from the buffers of the catalog at
+  // the time the references have been resolved.
+  long released;
+
+  // Average photon rate.
+  float avgrate;
+
+  // Photon list or light curve providing the photon times and the
+  // position in the light curve (NULL if not used).
+  SimputPhList* timephl;
+  SimputLC** lcptr;
+  SimputLC* lc;
+  struct SimputLCCursor* cursor;
+
+  // Spectra in the bins of a light curve with a SPECTRUM column and
+  // the light curve bin, for which the time-dependent references
+  // below have been resolved (-1 if none).
+  struct SimputLCSpecTable* st;
+  long lcbin;
+
+  // Extension types, photon list, spectrum, and image providing the
+  // energies and directions of the photons.
+  int spectype, imagtype;
+  SimputPhList* phl;
+  SimputSpec* spec;
+  SimputImg* img;
+
+  // WCS of the image adapted to the source as well as cosine and sine
+  // of IMGROTA. For time-dependent references the WCS is set up in
+  // binwcs.
+  struct wcsprm* wcs;
+  struct wcsprm binwcs;
+  double cosimgrota, sinimgrota;
+};
+
+
+/** Return the number of extensions released so far from the buffers
+    of the catalog, whose pointers are kept for a batch of photons. */
+static long getSimputPhotonBatchNReleased(const SimputCtlg* const cat)
+{
+  long released=
+    getSimputCacheIndexNEvicted(cat->phlistbuff)+
+    getSimputCacheIndexNEvicted(cat->specbuff)+
+    getSimputCacheIndexNEvicted(cat->imgbuff);
+  if (NULL!=cat->lcbuff) {
+    released+=getSimputLCBufferNReleased(cat->lcbuff);
+  }
+  return(released);
+}
+
+
+/** Resolve the references of a source for a batch of photons in the
+    same way as getSimputPhotonTime and getSimputPhotonEnergyCoord do
+    for individual photons. If the photon rate is 0, the remaining
+    references are not resolved. The references depending on the bin
+    of a light curve are resolved by
+    resolveSimputPhotonBatchBinRefs. */
+static void resolveSimputPhotonBatchRefs(SimputCtlg* const cat,
+					 SimputSrc* const src,
+					 const double prevtime,
+					 const double mjdref,
+					 struct SimputPhotonBatchRefs* const refs,
+					 int* const status)
+{
+  refs->res    =NULL;
+  refs->avgrate=0.;
+  refs->timephl=NULL;
+  refs->lcptr  =NULL;
+  refs->lc     =NULL;
+  refs->cursor =NULL;
+  refs->st     =NULL;
+  refs->lcbin  =-1;
+  refs->phl    =NULL;
+  refs->spec   =NULL;
+  refs->img    =NULL;
+  refs->wcs    =NULL;
+  refs->released=getSimputPhotonBatchNReleased(cat);
+
+  struct SimputSrcResolved* res=
+    getSimputSrcResolved(cat, src, prevtime, mjdref, status);
+  CHECK_STATUS_VOID(*status);
+  refs->res=res;
 
   // Determine the timing extension.
-  char timeref[SIMPUT_MAXSTR];
-  getSrcTimeRef(cat, src, timeref);
-  CHECK_STATUS_VOID(*status);
+  if (EXTTYPE_PHLIST==res->timetype) {
+    // In a shared catalog, each thread has its own photon lists,
+    // which are therefore not stored in the resolved references.
+    checkSrcResolvedEvicted(cat, res);
+    if (isSimputCtlgShared(cat)) {
+      refs->timephl=getSimputPhList(cat, res->timeref, status);
+      CHECK_STATUS_VOID(*status);
+    } else {
+      if (NULL==res->timephl) {
+	res->timephl=getSimputPhList(cat, res->timeref, status);
+	CHECK_STATUS_VOID(*status);
+      }
+      refs->timephl=res->timephl;
+    }
 
-  int timetype=getSimputExtType(cat, timeref, status);
-  CHECK_STATUS_VOID(*status);
+  } else if (('\0'==res->timeref[0]) || (EXTTYPE_LC==res->timetype) ||
+	     (EXTTYPE_PSD==res->timetype)) {
+    refs->avgrate=getSimputPhotonRate(cat, src, prevtime, mjdref, status);
+    CHECK_STATUS_VOID(*status);
+    if (0.==refs->avgrate) {
+      return;
+    }
+    assert(refs->avgrate>0.);
 
-  // We declare a light curve for future possible use:
-  SimputLC* lc=NULL;
-  if (EXTTYPE_LC==timetype) {
-    // Get the respective light curve.
-    lc=getSimputLC(cat, src, timeref, currtime, mjdref, status);
+    if ((EXTTYPE_PSD==res->timetype) && (isSimputCtlgShared(cat))) {
+      // In a shared catalog, the light curves generated from PSDs
+      // are specific for each thread.
+      refs->lc=getSimputLC(cat, src, res->timeref, prevtime, mjdref, status);
+      CHECK_STATUS_VOID(*status);
+      refs->lcptr=&(refs->lc);
+    } else if ('\0'!=res->timeref[0]) {
+      updateSrcResolvedLC(cat, src, res, prevtime, mjdref, status);
+      CHECK_STATUS_VOID(*status);
+      refs->lcptr=&(res->lc);
+      if (!isSimputCtlgShared(cat)) {
+	refs->cursor=&(res->lccursor);
+      }
+    }
+
+  } else {
+    // The timing reference does not point to any of the
+    // above extension types.
+    *status=EXIT_FAILURE;
+    SIMPUT_ERROR("invalid timing extension");
+    return;
+  }
+
+  // Determine the extensions providing the energies and directions.
+  if (0==res->varrefs) {
+    refs->spectype=res->spectype;
+    refs->imagtype=res->imagtype;
+
+    // If the spectrum or the image reference point to a photon list,
+    // it provides simultaneously the energy and spatial information.
+    if (isSimputCtlgShared(cat)) {
+      if (EXTTYPE_PHLIST==refs->spectype) {
+	refs->phl=getSimputPhList(cat, res->specref, status);
+      } else if (EXTTYPE_PHLIST==refs->imagtype) {
+	refs->phl=getSimputPhList(cat, res->imagref, status);
+      }
+      CHECK_STATUS_VOID(*status);
+    } else {
+      checkSrcResolvedEvicted(cat, res);
+      if ((NULL==res->phl) && (EXTTYPE_PHLIST==refs->spectype)) {
+	res->phl=getSimputPhList(cat, res->specref, status);
+	CHECK_STATUS_VOID(*status);
+      } else if ((NULL==res->phl) && (EXTTYPE_PHLIST==refs->imagtype)) {
+	char msg[SIMPUT_MAXSTR];
+	sprintf(msg, "Image-based Light curves is a feature not "
+		"fully support right now. We are currently working on it");
+	SIMPUT_WARNING(msg);
+
+	res->phl=getSimputPhList(cat, res->imagref, status);
+	CHECK_STATUS_VOID(*status);
+      }
+      refs->phl=res->phl;
+    }
+
+    loadSrcResolvedSpecImg(cat, src, res, status);
     CHECK_STATUS_VOID(*status);
+    refs->spec=res->spec;
+    refs->img =res->img;
+    refs->wcs =res->wcs;
+    refs->cosimgrota=res->cosimgrota;
+    refs->sinimgrota=res->sinimgrota;
 
-    // Check if there is a spectrum column in the light curve.
+  } else {
+    // The references are provided by the light curve used for the
+    // photon times. The spectra in its bins are resolved only once
+    // for all bins.
+    SimputLC* lc=*(refs->lcptr);
     if (NULL!=lc->spectrum) {
-      // In this case we should use 2 spectra in each light curve
-      // bin in order to interpolate information from both spectra.
-      speclightcurve=1;
+      refs->st=getSimputLCSpecTable(cat, lc, res->timeref, status);
+      CHECK_STATUS_VOID(*status);
     }
+    refs->wcs=&(refs->binwcs);
+    refs->cosimgrota=cos(src->imgrota);
+    refs->sinimgrota=sin(src->imgrota);
   }
 
-  // Determine the references to the spectrum and
-  // image for the updated photon arrival time.
+  refs->released=getSimputPhotonBatchNReleased(cat);
+}
+
+
+/** Resolve the references of a source with a light curve referring to
+    individual spectra or images in its bins for the specified bin of
+    the light curve. */
+static void resolveSimputPhotonBatchBinRefs(SimputCtlg* const cat,
+					    SimputSrc* const src,
+					    const long lcbin,
+					    const double currtime,
+					    const double mjdref,
+					    struct SimputPhotonBatchRefs* const refs,
+					    int* const status)
+{
+  refs->lcbin=-1;
+  refs->phl  =NULL;
+  refs->spec =NULL;
+  refs->img  =NULL;
+  wcsfree(&(refs->binwcs));
+  refs->binwcs.flag=-1;
+
+  // Determine the reference to the spectrum.
   char specref[SIMPUT_MAXSTR];
-  getSimputSrcSpecRef(cat, src, currtime, mjdref, specref, status);
-  CHECK_STATUS_VOID(*status);
+  if (NULL!=refs->st) {
+    if (NULL==refs->st->ref[lcbin]) {
+      SIMPUT_ERROR("in the current implementation light curves "
+		   "must not contain blank entries in a given "
+		   "spectrum column");
+      *status=EXIT_FAILURE;
+      return;
+    }
+    strcpy(specref, refs->st->ref[lcbin]);
+    refs->spectype=refs->st->type[lcbin];
+  } else {
+    getSimputSrcSpecRef(cat, src, currtime, mjdref, specref, status);
+    CHECK_STATUS_VOID(*status);
+    refs->spectype=getSimputExtType(cat, specref, status);
+    CHECK_STATUS_VOID(*status);
+  }
+
+  // Determine the reference to the image.
   char imagref[SIMPUT_MAXSTR];
   getSrcImagRef(cat, src, currtime, mjdref, imagref, status);
   CHECK_STATUS_VOID(*status);
-
-
-  // Determine the extension type of the spectrum and the image
-  // reference.
-  int spectype=getSimputExtType(cat, specref, status);
-  CHECK_STATUS_VOID(*status);
-  int imagtype=getSimputExtType(cat, imagref, status);
+  refs->imagtype=getSimputExtType(cat, imagref, status);
   CHECK_STATUS_VOID(*status);
 
-
   // If the spectrum or the image reference point to a photon list,
-  // determine simultaneously the energy and spatial information.
-  SimputPhList* phl=NULL;
-  if (EXTTYPE_PHLIST==spectype) {
-    phl=getSimputPhList(cat, specref, status);
+  // it provides simultaneously the energy and spatial information.
+  if (EXTTYPE_PHLIST==refs->spectype) {
+    refs->phl=getSimputPhList(cat, specref, status);
     CHECK_STATUS_VOID(*status);
-  } else if (EXTTYPE_PHLIST==imagtype) {
+  } else if (EXTTYPE_PHLIST==refs->imagtype) {
     char msg[SIMPUT_MAXSTR];
     sprintf(msg, "Image-based Light curves is a feature not "
 	    "fully support right now. We are currently working on it");
     SIMPUT_WARNING(msg);
 
-    phl=getSimputPhList(cat, imagref, status);
+    refs->phl=getSimputPhList(cat, imagref, status);
     CHECK_STATUS_VOID(*status);
   }
-  if (NULL!=phl) {
-    float b_energy;
-    double b_ra, b_dec;
-    getSimputPhFromPhList(cat, phl, &b_energy, &b_ra, &b_dec, status);
+
+  if ((NULL==refs->st) && (EXTTYPE_MIDPSPEC==refs->spectype)) {
+    refs->spec=getSimputSpec(cat, specref, status);
     CHECK_STATUS_VOID(*status);
+  }
 
-    if (EXTTYPE_PHLIST==spectype) {
-      *energy=b_energy;
-    }
-    if (EXTTYPE_PHLIST==imagtype) {
-      // Shift the photon position according to the
-      // RA,Dec values defined for this source in the catalog.
+  if (EXTTYPE_IMAGE==refs->imagtype) {
+    refs->img=getSimputImg(cat, imagref, status);
+    CHECK_STATUS_VOID(*status);
 
-      // Apply IMGSCAL.
-      b_ra *=1./src->imgscal*cos(b_dec)/cos(b_dec/src->imgscal);
-      b_dec*=1./src->imgscal;
+    // Set up the WCS of the image for this particular source.
+    getSrcImgWcs(refs->img, src, &(refs->binwcs), status);
+    CHECK_STATUS_VOID(*status);
+  }
 
-      // Get a Carteesian coordinate vector for the photon location.
-      Vector p=unit_vector(b_ra, b_dec);
+  refs->lcbin=lcbin;
+}
 
-      // Apply IMGROTA by rotation around the x-axis.
-      double cosimgrota=cos(src->imgrota);
-      double sinimgrota=sin(src->imgrota);
-      Vector r;
-      r.x= p.x;
-      r.y= cosimgrota*p.y + sinimgrota*p.z;
-      r.z=-sinimgrota*p.y + cosimgrota*p.z;
 
-      // Rotate the vector towards the source position.
-      double cosra=cos(src->ra);
-      double sinra=sin(src->ra);
-      double cosdec=cos(src->dec);
-      double sindec=sin(src->dec);
-      Vector f;
-      f.x=r.x*cosra*cosdec - r.y*sinra - r.z*cosra*sindec;
-      f.y=r.x*sinra*cosdec + r.y*cosra - r.z*sinra*sindec;
-      f.z=r.x      *sindec +     0.0   + r.z      *cosdec;
+long getSimputPhotonBatch(SimputCtlg* const cat,
+			  SimputSrc* const src,
+			  double prevtime,
+			  const double mjdref,
+			  const long nphotons,
+			  double* const time,
+			  float* const energy,
+			  double* const ra,
+			  double* const dec,
+			  int* const status)
+{
+  // Use the random number stream of the source, if available.
+  selectSimputSrcRndStream(cat, src, status);
+  CHECK_STATUS_RET(*status, 0);
 
-      // Determine RA and Dec of the photon.
-      calculate_ra_dec(f, ra, dec);
+  // The references to the extensions of the source are resolved
+  // once for the whole batch. They are only resolved anew, if
+  // extensions have been released from the buffers of the catalog in
+  // the meantime.
+  struct SimputPhotonBatchRefs refs={ .binwcs={ .flag=-1 } };
+  resolveSimputPhotonBatchRefs(cat, src, prevtime, mjdref, &refs, status);
+
+  long nn;
+  for (nn=0; (nn<nphotons) && (EXIT_SUCCESS==*status); nn++) {
+    if (getSimputPhotonBatchNReleased(cat)!=refs.released) {
+      resolveSimputPhotonBatchRefs(cat, src, prevtime, mjdref, &refs, status);
+      CHECK_STATUS_BREAK(*status);
     }
-  }
+    struct SimputSrcResolved* res=refs.res;
+
+    // Determine the time of the next photon.
+    int failed=0;
+    if (NULL!=refs.timephl) {
+      failed=getPhListPhotonTime(cat, src, refs.timephl, prevtime, mjdref,
+				 &time[nn], status);
+    } else if (0.==refs.avgrate) {
+      failed=1;
+    } else if (NULL!=refs.lcptr) {
+      failed=getLCPhotonTime(cat, src, res->timeref, refs.lcptr,
+			     refs.cursor, refs.avgrate, prevtime, mjdref,
+			     &time[nn], status);
+
+      // The light curve might have been replaced by a new one
+      // created from the PSD.
+      if ((EXIT_SUCCESS==*status) && (!isSimputCtlgShared(cat))) {
+	res->lcreleased=getSimputLCBufferNReleased(cat->lcbuff);
+      }
+    } else {
+      // Time intervals between subsequent photons are exponentially
+      // distributed.
+      time[nn]=prevtime+rndexp(cat, (double)1./refs.avgrate, status);
+    }
+    CHECK_STATUS_BREAK(*status);
+    if (failed>0) break;
 
+    // Determine the references for the current bin of a light curve
+    // referring to individual spectra or images.
+    double currtime=time[nn];
+    if (0!=res->varrefs) {
+      long long nperiods;
+      long lcbin=getLCBin(*(refs.lcptr), currtime, mjdref, &nperiods, status);
+      CHECK_STATUS_BREAK(*status);
+      assert(lcbin+1 < (*(refs.lcptr))->nentries);
+      if (lcbin!=refs.lcbin) {
+	resolveSimputPhotonBatchBinRefs(cat, src, lcbin, currtime, mjdref,
+					&refs, status);
+	CHECK_STATUS_BREAK(*status);
+      }
+    }
 
-  // ---
-  // If the spectrum does NOT refer to a photon list, determine the
-  // photon energy from a spectrum.
+    // Determine the energy and the direction of origin of the photon.
+    if (NULL!=refs.phl) {
+      float b_energy;
+      double b_ra, b_dec;
+      getSimputPhFromPhList(cat, refs.phl, &b_energy, &b_ra, &b_dec, status);
+      CHECK_STATUS_BREAK(*status);
 
-  // Determine if we have a Light Curve or a single spectrum is
-  // given:
+      if (EXTTYPE_PHLIST==refs.spectype) {
+	energy[nn]=b_energy;
+      }
+      if (EXTTYPE_PHLIST==refs.imagtype) {
+	shiftPhListPhotonCoord(src, b_ra, b_dec, &ra[nn], &dec[nn]);
+      }
+    }
 
-  // Get a random number in the interval [0,1].
-  // We will use it afterwards for obtaining the photon energy:
-  double rnd=getRndNum(status);
-  CHECK_STATUS_VOID(*status);
-  assert(rnd>=0.);
-  assert(rnd<=1.);
+    double rnd=getSimputCtlgRndNum(cat, status);
+    CHECK_STATUS_BREAK(*status);
+    if (NULL!=refs.st) {
+      if (EXTTYPE_MIDPSPEC==refs.spectype) {
+	energy[nn]=getLCSpecPhotonEnergy(cat, refs.st, refs.lcbin, currtime,
+					 rnd, status);
+	CHECK_STATUS_BREAK(*status);
+      }
+    } else if (NULL!=refs.spec) {
+      energy[nn]=getSpecPhotonEnergy(cat, refs.spec, rnd, status);
+      CHECK_STATUS_BREAK(*status);
+    }
 
-  if (speclightcurve) {
-    // If we have a lightcurve, we take the next spectrum too in
-    // order to perform the interpolation. We first suppose that
-    // all spectra are equally binned:
+    if (EXTTYPE_NONE==refs.imagtype) {
+      ra[nn] =src->ra;
+      dec[nn]=src->dec;
+    } else if (NULL!=refs.img) {
+      getImgPhotonCoord(cat, refs.img, refs.wcs, refs.cosimgrota,
+			refs.sinimgrota, &ra[nn], &dec[nn], status);
+      CHECK_STATUS_BREAK(*status);
+    }
 
-    if (EXTTYPE_MIDPSPEC==spectype && lc!=NULL) {
-      //We first determine the second spectrum name:
-      char specref_next[SIMPUT_MAXSTR];
-      getSimputSrcSpecRefNext(cat, src, currtime, mjdref, specref_next, status);
-      CHECK_STATUS_VOID(*status);
+    prevtime=time[nn];
+  }
 
-      // Determine the spectra.
-      SimputSpec* spec=getSimputSpec(cat, specref, status);
-      SimputSpec* spec_next=getSimputSpec(cat, specref_next, status);
-      CHECK_STATUS_VOID(*status);
+  wcsfree(&(refs.binwcs));
 
-      // We determine the interpolation factors between the
-      // two spectra. For this purppose, we need the time of
-      //previous and next phases:
-      long long nperiods;
-      long bin_prev_spec=getLCBin(lc, currtime, mjdref, &nperiods, status);
-      long bin_next_spec=bin_prev_spec+1;
-           CHECK_STATUS_VOID(*status);
-      assert(bin_next_spec < lc->nentries);
-
-      double time_prev_spec = -1;
-      double time_next_spec = -1;
-
-      if (lc->time != NULL){
-    	  time_prev_spec=lc->time[bin_prev_spec];
-    	  time_next_spec=lc->time[bin_next_spec];
-      } else if (lc->phase != NULL){
-    	  time_prev_spec=lc->phase[bin_prev_spec]*lc->period;
-    	  time_next_spec=lc->phase[bin_next_spec]*lc->period;
-      } else {
-    	  SIMPUT_ERROR(" failure to load spectrum for light curve: no phase or light curve information given\n");
-      }
+  return(nn);
+}
 
 
-      // We declare and compute the interpolation factors:
-      double af=(time_next_spec-currtime)/(time_next_spec-time_prev_spec);
-      double bf=1.-af;
+/** Prepare a catalog for the use with per-thread contexts. All
+    sources are loaded and their references are resolved, such that
+    the shared buffers are not modified any more, when photons are
+    produced from sources with time-independent references. */
+static void prepareSimputCtlgShared(SimputCtlg* const cat,
+				    int* const status)
+{
+  // Create the recursive mutex protecting the shared buffers.
+  pthread_mutex_t* mutex=(pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
+  CHECK_NULL_VOID(mutex, *status, "memory allocation for mutex failed");
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  int rc=pthread_mutex_init(mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+  if (0!=rc) {
+    free(mutex);
+    SIMPUT_ERROR("initialization of mutex failed");
+    *status=EXIT_FAILURE;
+    return;
+  }
+  cat->mutex=mutex;
+
+  // The photon lists and the light curves generated from PSDs of the
+  // catalog are not shared, but are released irrespective of the
+  // state of the catalog. Therefore they must not
+  // be subject to the common memory budget any more, which might
+  // release shared extensions.
+  if (NULL!=cat->phlistbuff) {
+    unregisterSimputCacheIndex((struct SimputCacheIndex*)cat->phlistbuff);
+  }
+  if (NULL!=cat->lcbuff) {
+    unregisterSimputCacheIndex(((struct SimputLCBuffer*)cat->lcbuff)->psdlcs);
+  }
 
-      // Multiply the random number with total photon rate
-      // (i.e. the spectrum does not have to be normalized).
-      rnd*=(af*spec->distribution[cat->arf->NumberEnergyBins-1]+
-	    bf*spec_next->distribution[cat->arf->NumberEnergyBins-1]);
+  // The light curve buffer of the catalog holds the shared light
+  // curves loaded from files, but also the light curves generated
+  // from PSDs for the catalog itself. Therefore it must exist
+  // before any per-thread context is used.
+  if (NULL==cat->lcbuff) {
+    cat->lcbuff=newSimputLCBuffer(cat->cachecap[EXTTYPE_LC],
+				  cat->cachecap[EXTTYPE_PSD], status);
+    CHECK_STATUS_VOID(*status);
+  }
 
-      // Determine the corresponding point in the spectral
-      // distribution (using binary search).
-      long upper=cat->arf->NumberEnergyBins-1, lower=0, mid;
-      while (upper>lower) {
-        mid=(lower+upper)/2;
-        if ((af*spec->distribution[mid]+bf*spec_next->distribution[mid])<rnd) {
-          lower=mid+1;
-        } else {
-          upper=mid;
-        }
-      }
+  // Load all sources at once. They are not modified any more
+  // afterwards.
+  loadCacheAllSimputSrc(cat, status);
+  CHECK_STATUS_VOID(*status);
 
-      // Return the corresponding photon energy.
-      *energy=
-        cat->arf->LowEnergy[lower] +
-        getRndNum(status)*
-        (cat->arf->HighEnergy[lower]-cat->arf->LowEnergy[lower]);
-      CHECK_STATUS_VOID(*status);
-    }
-  } else {
-    // If there is no lightcurve we follow the usual process:
+  long ii, jj;
+  for (ii=0; ii<cat->nentries; ii++) {
+    SimputSrc* src=getSimputSrc(cat, ii+1, status);
+    CHECK_STATUS_VOID(*status);
 
-    if (EXTTYPE_MIDPSPEC==spectype) {
-      // Determine the spectrum.
-      SimputSpec* spec=getSimputSpec(cat, specref, status);
-      CHECK_STATUS_VOID(*status);
+    struct SimputSrcResolved* res=
+      getSimputSrcResolved(cat, src, 0., 0., status);
+    CHECK_STATUS_VOID(*status);
 
-      // Multiply the random number with the total photon rate
-      // (i.e. the spectrum does not have to be normalized).
-      rnd*=spec->distribution[cat->arf->NumberEnergyBins-1];
+    // Light curves loaded from files are not released from now on.
+    // Make sure that the referenced one is still available.
+    if (EXTTYPE_LC==res->timetype) {
+      struct SimputLCBuffer* lb=(struct SimputLCBuffer*)cat->lcbuff;
+      if ((NULL==res->lc) ||
+	  (getSimputLCBufferNReleased(lb)!=res->lcreleased)) {
+	res->lc=getSimputLC(cat, src, res->timeref, 0., 0., status);
+	CHECK_STATUS_VOID(*status);
+	res->lcreleased=getSimputLCBufferNReleased(lb);
+      }
 
-      // Determine the corresponding point in the spectral
-      // distribution (using binary search).
-      long upper=cat->arf->NumberEnergyBins-1, lower=0, mid;
-      while (upper>lower) {
-	mid=(lower+upper)/2;
-	if (spec->distribution[mid]<rnd) {
-	  lower=mid+1;
-	} else {
-	  upper=mid;
+      // Obtain the spectra in all bins of a light curve with a
+      // SPECTRUM column, such that its table is not modified any
+      // more. Spectra might have been released from the buffer
+      // before the catalog became shared.
+      if ((NULL!=res->lc) && (NULL!=res->lc->spectrum)) {
+	struct SimputLCSpecTable* st=
+	  getSimputLCSpecTable(cat, res->lc, res->timeref, status);
+	CHECK_STATUS_VOID(*status);
+	updateLCSpecTableEvicted(cat, st);
+	for (jj=0; jj<st->nbins; jj++) {
+	  if (EXTTYPE_MIDPSPEC==st->type[jj]) {
+	    getLCSpecTableSpec(cat, st, jj, status);
+	    CHECK_STATUS_VOID(*status);
+	  }
 	}
       }
+    }
 
-      // Return the corresponding photon energy.
-      *energy=
-	cat->arf->LowEnergy[lower] +
-	getRndNum(status)*
-	(cat->arf->HighEnergy[lower]-cat->arf->LowEnergy[lower]);
+    // The spectra and images of sources with time-dependent
+    // references are obtained when they are needed.
+    if (0!=res->varrefs) continue;
+
+    // Extensions might have been released from the buffers before
+    // the catalog became shared.
+    updateSrcResolvedEvicted(cat, res);
+    loadSrcResolvedSpecImg(cat, src, res, status);
+    CHECK_STATUS_VOID(*status);
+
+    // Set up the tables for drawing photons, if the spectrum or the
+    // image has been loaded before.
+    if (NULL!=res->spec) {
+      getSimputSpec(cat, res->specref, status);
+      CHECK_STATUS_VOID(*status);
+    }
+    if (NULL!=res->img) {
+      getSimputImg(cat, res->imagref, status);
       CHECK_STATUS_VOID(*status);
     }
-  }
 
-  // END of determine the photon energy.
-  // ---
+    getSimputPhotonRate(cat, src, 0., 0., status);
+    CHECK_STATUS_VOID(*status);
+  }
+}
 
 
-  // ---
-  // If the image does NOT refer to a photon list, determine the
-  // spatial information.
+SimputCtlg* newSimputCtlgContext(SimputCtlg* const cat,
+				 const unsigned long seed,
+				 int* const status)
+{
+  // A context of a context shares the buffers of the same catalog.
+  SimputCtlg* core=getSimputCtlgCore(cat);
 
-  // Point-like sources.
-  if (EXTTYPE_NONE==imagtype) {
-    *ra =src->ra;
-    *dec=src->dec;
+  // On the first call, prepare the catalog to be shared.
+  if (NULL==core->mutex) {
+    prepareSimputCtlgShared(core, status);
+    CHECK_STATUS_RET(*status, NULL);
   }
 
-  // Spatially extended sources.
-  else if (EXTTYPE_IMAGE==imagtype) {
-    // Determine the photon direction from an image.
-    struct wcsprm wcs={ .flag=-1 };
+  SimputCtlg* ctx=newSimputCtlg(status);
+  CHECK_STATUS_RET(*status, ctx);
 
-    do { // Error handling loop.
+  do { // Error handling loop.
 
-      // Determine the image.
-      SimputImg* img=getSimputImg(cat, imagref, status);
-      CHECK_STATUS_BREAK(*status);
+    // Take over the description of the catalog and its settings.
+    // The buffers are accessed via the catalog.
+    *ctx=*core;
+    ctx->fptr        =NULL;
+    ctx->filepath    =NULL;
+    ctx->filename    =NULL;
+    ctx->srcbuff     =NULL;
+    ctx->extbuff     =NULL;
+    ctx->midpspecbuff=NULL;
+    ctx->phlistbuff  =NULL;
+    ctx->lcbuff      =NULL;
+    ctx->psdbuff     =NULL;
+    ctx->fftwbuff    =NULL;
+    ctx->imgbuff     =NULL;
+    ctx->specbuff    =NULL;
+    ctx->arfgrid     =NULL;
+    ctx->speccache   =NULL;
+    ctx->phqueue     =NULL;
+    ctx->mutex       =NULL;
+    ctx->rndstream   =NULL;
+    ctx->srcrndstreams=NULL;
+    ctx->cachemgr    =NULL;
+    ctx->phlistshared=NULL;
+    ctx->core        =core;
+
+    if (NULL!=core->filepath) {
+      ctx->filepath=
+	(char*)malloc((strlen(core->filepath)+1)*sizeof(char));
+      CHECK_NULL_BREAK(ctx->filepath, *status,
+		       "memory allocation for file path failed");
+      strcpy(ctx->filepath, core->filepath);
+    }
+    if (NULL!=core->filename) {
+      ctx->filename=
+	(char*)malloc((strlen(core->filename)+1)*sizeof(char));
+      CHECK_NULL_BREAK(ctx->filename, *status,
+		       "memory allocation for file name failed");
+      strcpy(ctx->filename, core->filename);
+    }
 
-      // Perform a binary search in 2 dimensions.
-      double rnd=getRndNum(status)*img->dist[img->naxis1-1][img->naxis2-1];
-      CHECK_STATUS_BREAK(*status);
+    // Independent random number stream of the context.
+    struct SimputRndStream* rs=
+      (struct SimputRndStream*)malloc(sizeof(struct SimputRndStream));
+    CHECK_NULL_BREAK(rs, *status,
+		     "memory allocation for random number stream failed");
+    initSimputRndStream(rs, seed, 0);
+    ctx->rndstream=rs;
 
-      // Perform a binary search to obtain the x-coordinate.
-      long high=img->naxis1-1;
-      long xl  =0;
-      long mid;
-      long ymax=img->naxis2-1;
-      while (high > xl) {
-	mid=(xl+high)/2;
-	if (img->dist[mid][ymax] < rnd) {
-	  xl=mid+1;
-	} else {
-	  high=mid;
-	}
-      }
+  } while(0); // END of error handling loop.
 
-      // Search for the y coordinate.
-      high=img->naxis2-1;
-      long yl=0;
-      while (high > yl) {
-	mid=(yl+high)/2;
-	if (img->dist[xl][mid] < rnd) {
-	  yl=mid+1;
-	} else {
-	  high=mid;
-	}
-      }
-      // Now xl and yl have pixel positions [long pixel coordinates].
+  if (EXIT_SUCCESS!=*status) {
+    int status2=EXIT_SUCCESS;
+    freeSimputCtlg(&ctx, &status2);
+  }
 
-      // Create a temporary wcsprm data structure, which can be modified
-      // to fit this particular source. The wcsprm data structure contained
-      // in the image should not be modified, since it is used for all
-      // sources including the image.
-      wcscopy(1, img->wcs, &wcs);
+  return(ctx);
+}
 
-      // Set the position to the origin and assign the correct scaling.
-      // TODO: This assumes that the image WCS is equivalent to the
-      // coordinate system used in the catalog!!
-      wcs.crval[0] =src->ra *180./M_PI;
-      wcs.crval[1] =src->dec*180./M_PI;
-      wcs.cdelt[0]*=1./src->imgscal;
-      wcs.cdelt[1]*=1./src->imgscal;
-      wcs.flag=0;
-
-      // Check that CUNIT is set to "deg". Otherwise there will be a conflict
-      // between CRVAL [deg] and CDELT [different unit].
-      // TODO This is not required by the standard.
-	  check_wcs_unit_degree(&wcs, status);
-	  CHECK_STATUS_BREAK(*status);
 
+static inline int phqueueLess(const SimputPhoton* const photons,
+			      const long a, const long b)
+{
+  // Photons with equal time are ordered by the source index in order
+  // to obtain the same sequence as a linear scan over all sources.
+  if (photons[a].time<photons[b].time) return(1);
+  if (photons[a].time>photons[b].time) return(0);
+  return(a<b);
+}
 
-      // Determine floating point pixel positions shifted by 0.5 in
-      // order to match the FITS conventions and with a randomization
-      // over the pixels.
-      double xd=(double)xl + 0.5 + getRndNum(status);
-      CHECK_STATUS_BREAK(*status);
-      double yd=(double)yl + 0.5 + getRndNum(status);
-      CHECK_STATUS_BREAK(*status);
 
-      // Rotate the image (pixel coordinates) by IMGROTA around the
-      // reference point.
-      double xdrot=
-	(xd-wcs.crpix[0])*cos(src->imgrota) +
-	(yd-wcs.crpix[1])*sin(src->imgrota) + wcs.crpix[0];
-      double ydrot=
-	-(xd-wcs.crpix[0])*sin(src->imgrota) +
-	 (yd-wcs.crpix[1])*cos(src->imgrota) + wcs.crpix[1];
-
-      // Convert the long-valued pixel coordinates to double values,
-      // including a randomization over the pixel and transform from
-      // pixel coordinates to RA and DEC ([rad]) using the  WCS information.
-      p2s(&wcs, xdrot, ydrot, ra, dec, status);
-      CHECK_STATUS_BREAK(*status);
+static inline void phqueueSwap(struct SimputPhotonQueue* const pq,
+			       const long ii, const long jj)
+{
+  long buffer=pq->heap[ii];
+  pq->heap[ii]=pq->heap[jj];
+  pq->heap[jj]=buffer;
+  pq->pos[pq->heap[ii]]=ii;
+  pq->pos[pq->heap[jj]]=jj;
+}
 
-      // Determine the RA in the interval from [0:2pi).
-      while(*ra>=2.*M_PI) {
-	*ra-=2.*M_PI;
-      }
-      while(*ra<0.) {
-	*ra+=2.*M_PI;
-      }
 
-    } while(0); // END of error handling loop.
+static void phqueueSiftUp(struct SimputPhotonQueue* const pq, long ii)
+{
+  while (ii>0) {
+    long parent=(ii-1)/2;
+    if (!phqueueLess(pq->photons, pq->heap[ii], pq->heap[parent])) break;
+    phqueueSwap(pq, ii, parent);
+    ii=parent;
+  }
+}
+
 
-    // Release memory.
-    wcsfree(&wcs);
+static void phqueueSiftDown(struct SimputPhotonQueue* const pq, long ii)
+{
+  while (1) {
+    long min=ii;
+    long left=2*ii+1;
+    long right=left+1;
+    if ((left<pq->nheap) &&
+	(phqueueLess(pq->photons, pq->heap[left], pq->heap[min]))) {
+      min=left;
+    }
+    if ((right<pq->nheap) &&
+	(phqueueLess(pq->photons, pq->heap[right], pq->heap[min]))) {
+      min=right;
+    }
+    if (min==ii) break;
+    phqueueSwap(pq, ii, min);
+    ii=min;
   }
-  // END of determine the photon direction.
-  // ---
+}
 
-  return;
+
+/** Bring the position of the source with the specified index
+    (starting at 0) in the priority queue up to date with its
+    pre-computed photon. Sources that cannot produce any further
+    photons are removed from the queue. */
+static void updateSimputPhotonQueue(struct SimputPhotonQueue* const pq,
+				    const long index)
+{
+  long ii=pq->pos[index];
+
+  if (0!=pq->photons[index].lightcurve_status) {
+    // Remove the source from the heap.
+    if (ii<0) return;
+    pq->nheap--;
+    if (ii!=pq->nheap) {
+      phqueueSwap(pq, ii, pq->nheap);
+    }
+    pq->pos[index]=-1;
+    if (ii<pq->nheap) {
+      long moved=pq->heap[ii];
+      phqueueSiftUp(pq, ii);
+      phqueueSiftDown(pq, pq->pos[moved]);
+    }
+    return;
+  }
+
+  if (ii<0) {
+    // Insert the source into the heap.
+    ii=pq->nheap++;
+    pq->heap[ii]=index;
+    pq->pos[index]=ii;
+    phqueueSiftUp(pq, ii);
+  } else {
+    phqueueSiftUp(pq, ii);
+    phqueueSiftDown(pq, pq->pos[index]);
+  }
 }
 
 
-int getSimputPhoton(SimputCtlg* const cat,
-		    SimputSrc* const src,
-		    double prevtime,
-		    const double mjdref,
-		    double* const nexttime,
-		    float* const energy,
-		    double* const ra,
-		    double* const dec,
-		    int* const status)
+/** Set up the priority queue of the catalog for the specified array
+    of pre-computed photons. */
+static void buildSimputPhotonQueue(SimputCtlg* const cat,
+				   SimputPhoton* const next_photons,
+				   int* const status)
 {
-  // Determine the time of the next photon.
-  int failed=getSimputPhotonTime(cat, src, prevtime, mjdref, nexttime, status);
-  CHECK_STATUS_RET(*status, failed);
-  if (failed>0) return(failed);
+  long ii, n_sources=getSimputCtlgNSources(cat);
 
-  // Determine the energy and the direction of origin of the photon.
-  getSimputPhotonEnergyCoord(cat, src, *nexttime, mjdref,
-			     energy, ra, dec, status);
-  CHECK_STATUS_RET(*status, 0);
+  freeSimputPhotonQueue((struct SimputPhotonQueue**)&(cat->phqueue));
+  struct SimputPhotonQueue* pq=newSimputPhotonQueue(n_sources, status);
+  CHECK_STATUS_VOID(*status);
+  pq->photons=next_photons;
+  cat->phqueue=pq;
 
-  return(0);
+  for (ii=0; ii<n_sources; ii++) {
+    updateSimputPhotonQueue(pq, ii);
+  }
 }
 
+
 int precompute_photon (SimputCtlg *cat, long sourcenumber,
 		       double mjdref, double prevtime,
 		       SimputPhoton *next_photons,
@@ -2200,6 +6342,12 @@ int precompute_photon (SimputCtlg *cat, long sourcenumber,
   next_photons[sourcenumber-1].dec = dec;
   next_photons[sourcenumber-1].lightcurve_status = lightcurve_status;
   next_photons[sourcenumber-1].polarization = 0;
+
+  // Keep the priority queue in sync with the new photon.
+  struct SimputPhotonQueue* pq=(struct SimputPhotonQueue*)cat->phqueue;
+  if ((NULL!=pq) && (pq->photons==next_photons)) {
+    updateSimputPhotonQueue(pq, sourcenumber-1);
+  }
   return 0;
 }
 
@@ -2211,6 +6359,9 @@ SimputPhoton* startSimputPhotonAnySource(SimputCtlg* const cat,
   long ii, n_sources;
   n_sources = getSimputCtlgNSources(cat);
 
+  // Discard the priority queue of a previous run.
+  freeSimputPhotonQueue((struct SimputPhotonQueue**)&(cat->phqueue));
+
   SimputPhoton* next_photons = malloc(n_sources * sizeof(*next_photons));
   CHECK_NULL_RET(next_photons, *status,
 		 "memory allocation for photon cache failed", NULL);
@@ -2218,6 +6369,11 @@ SimputPhoton* startSimputPhotonAnySource(SimputCtlg* const cat,
     precompute_photon(cat, ii, mjdref, 0., next_photons, status);
     CHECK_STATUS_RET(*status, NULL);
   }
+
+  // Sort the pre-computed photons into the priority queue.
+  buildSimputPhotonQueue(cat, next_photons, status);
+  CHECK_STATUS_RET(*status, NULL);
+
   return next_photons;
 }
 
@@ -2233,10 +6389,8 @@ int getSimputPhotonAnySource(SimputCtlg* const cat,
 			     long* const source_index,
 			     int* const status)
 {
-  long ii, n_sources, next_index;
-  long number_valid_photons = 0;
-  double min_time = DBL_MAX;
-  n_sources = getSimputCtlgNSources(cat);
+  long next_index;
+  long n_sources = getSimputCtlgNSources(cat);
 
   if (n_sources < 1){
     return 1;
@@ -2245,17 +6399,20 @@ int getSimputPhotonAnySource(SimputCtlg* const cat,
   CHECK_NULL_RET(next_photons, *status,
 		   "next_photons has not been initialized", 1);
 
-  // From the list of pre-generated photons, find the next one
-  for (ii=0; ii < n_sources; ii++) {
-    if ((next_photons[ii].time < min_time) && (next_photons[ii].lightcurve_status == 0)){
-      min_time = next_photons[ii].time;
-      next_index = ii;
-      number_valid_photons++;
-    }
+  // If the priority queue does not belong to the given array of
+  // pre-computed photons, set it up from scratch.
+  struct SimputPhotonQueue* pq=(struct SimputPhotonQueue*)cat->phqueue;
+  if ((NULL==pq) || (pq->photons!=next_photons)) {
+    buildSimputPhotonQueue(cat, next_photons, status);
+    CHECK_STATUS_RET(*status, 1);
+    pq=(struct SimputPhotonQueue*)cat->phqueue;
   }
-  if (number_valid_photons == 0){
+
+  // The next photon is at the top of the queue.
+  if (pq->nheap == 0){
     return 1;
   }
+  next_index = pq->heap[0];
 
   *time = next_photons[next_index].time;
   *energy = next_photons[next_index].energy;
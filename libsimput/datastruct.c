@@ -20,6 +20,9 @@
                        Erlangen-Nuernberg
 */
 
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "common.h"
 
 
@@ -48,6 +51,8 @@ SimputSrc* newSimputSrc(int* const status)
   entry->img_ident=NULL;
   entry->timing_ident=NULL;
 
+  entry->resolved=NULL;
+
   return(entry);
 }
 
@@ -125,12 +130,32 @@ void free_uniqueSimputident(uniqueSimputident *ident){
 	}	return;
 }
 
+/** Release the elements of a SimputSrc apart from the strings. */
+static void clearSimputSrc(SimputSrc* const src)
+{
+  if (NULL!=src->phrate) {
+    free(src->phrate);
+  }
+  if (NULL!=src->spec_ident) {
+    free_uniqueSimputident(src->spec_ident);
+    free(src->spec_ident);
+  }
+  if (NULL!=src->img_ident) {
+    free_uniqueSimputident(src->img_ident);
+    free(src->img_ident);
+  }
+  if (NULL!=src->timing_ident) {
+    free_uniqueSimputident(src->timing_ident);
+    free(src->timing_ident);
+  }
+  if (NULL!=src->resolved) {
+    freeSimputSrcResolved((struct SimputSrcResolved**)&(src->resolved));
+  }
+}
+
 void freeSimputSrc(SimputSrc** const src)
 {
   if (NULL!=*src) {
-    if (NULL!=(*src)->phrate) {
-      free((*src)->phrate);
-    }
     if (NULL!=(*src)->src_name) {
       free((*src)->src_name);
     }
@@ -143,18 +168,7 @@ void freeSimputSrc(SimputSrc** const src)
     if (NULL!=(*src)->timing) {
       free((*src)->timing);
     }
-    if (NULL!=(*src)->spec_ident) {
-    	free_uniqueSimputident((*src)->spec_ident);
-    	free((*src)->spec_ident);
-    }
-    if (NULL!=(*src)->img_ident) {
-    	free_uniqueSimputident((*src)->img_ident);
-    	free((*src)->img_ident);
-    }
-    if (NULL!=(*src)->timing_ident) {
-    	free_uniqueSimputident((*src)->timing_ident);
-    	free((*src)->timing_ident);
-    }
+    clearSimputSrc(*src);
 
     free(*src);
     *src=NULL;
@@ -175,6 +189,8 @@ struct SimputSrcBuffer* newSimputSrcBuffer(int* const status)
   srcbuff->srcs   =NULL;
   srcbuff->rownums=NULL;
   srcbuff->rowmap =NULL;
+  srcbuff->ntable =0;
+  srcbuff->table  =NULL;
 
   return(srcbuff);
 }
@@ -196,12 +212,156 @@ void freeSimputSrcBuffer(struct SimputSrcBuffer** sb)
     if (NULL!=(*sb)->rowmap) {
       free((*sb)->rowmap);
     }
+    if (NULL!=(*sb)->table) {
+      // The strings of the sources in the table are released
+      // together with the table of references of the catalog.
+      long ii;
+      for (ii=0; ii<(*sb)->ntable; ii++) {
+	clearSimputSrc(&((*sb)->table[ii]));
+      }
+      free((*sb)->table);
+    }
     free(*sb);
     *sb=NULL;
   }
 }
 
 
+struct SimputStrPool* newSimputStrPool(int* const status)
+{
+  struct SimputStrPool* sp=
+    (struct SimputStrPool*)malloc(sizeof(struct SimputStrPool));
+  CHECK_NULL_RET(sp, *status,
+		 "memory allocation for SimputStrPool failed", sp);
+
+  sp->nstrs    =0;
+  sp->strs     =NULL;
+  sp->nslots   =0;
+  sp->slots    =NULL;
+  sp->nblocks  =0;
+  sp->blocks   =NULL;
+  sp->blockpos =NULL;
+  sp->blockfree=0;
+
+  return(sp);
+}
+
+
+void freeSimputStrPool(struct SimputStrPool** sp)
+{
+  if (NULL!=*sp) {
+    if (NULL!=(*sp)->strs) {
+      free((*sp)->strs);
+    }
+    if (NULL!=(*sp)->slots) {
+      free((*sp)->slots);
+    }
+    if (NULL!=(*sp)->blocks) {
+      long ii;
+      for (ii=0; ii<(*sp)->nblocks; ii++) {
+	free((*sp)->blocks[ii]);
+      }
+      free((*sp)->blocks);
+    }
+    free(*sp);
+    *sp=NULL;
+  }
+}
+
+
+/** FNV-1a hash of a string. */
+static unsigned long hashSimputStr(const char* const str)
+{
+  unsigned long hash=2166136261UL;
+  const unsigned char* c;
+  for (c=(const unsigned char*)str; '\0'!=*c; c++) {
+    hash^=*c;
+    hash*=16777619UL;
+  }
+  return(hash);
+}
+
+
+long internSimputStrPoolId(struct SimputStrPool* const sp,
+			   const char* const str,
+			   int* const status)
+{
+  // Enlarge the hash table, if it is more than half full.
+  if (2*(sp->nstrs+1)>sp->nslots) {
+    long nslots=MAX(2*sp->nslots, 1024);
+    long* slots=(long*)malloc(nslots*sizeof(long));
+    CHECK_NULL_RET(slots, *status,
+		   "memory allocation for string pool failed", -1);
+    char** strs=(char**)realloc(sp->strs, nslots/2*sizeof(char*));
+    if (NULL==strs) free(slots);
+    CHECK_NULL_RET(strs, *status,
+		   "memory allocation for string pool failed", -1);
+    sp->strs=strs;
+
+    long ii;
+    for (ii=0; ii<nslots; ii++) {
+      slots[ii]=-1;
+    }
+    for (ii=0; ii<sp->nstrs; ii++) {
+      long jj=hashSimputStr(sp->strs[ii]) & (nslots-1);
+      while (slots[jj]>=0) {
+	jj=(jj+1) & (nslots-1);
+      }
+      slots[jj]=ii;
+    }
+    if (NULL!=sp->slots) free(sp->slots);
+    sp->slots =slots;
+    sp->nslots=nslots;
+  }
+
+  // Search for the string.
+  long jj=hashSimputStr(str) & (sp->nslots-1);
+  while (sp->slots[jj]>=0) {
+    if (0==strcmp(sp->strs[sp->slots[jj]], str)) {
+      return(sp->slots[jj]);
+    }
+    jj=(jj+1) & (sp->nslots-1);
+  }
+
+  // Append the string to the last memory block. Strings longer than
+  // the default block size get a block of their own.
+  long len=strlen(str)+1;
+  if (len>sp->blockfree) {
+    char** blocks=(char**)realloc(sp->blocks,
+				  (sp->nblocks+1)*sizeof(char*));
+    CHECK_NULL_RET(blocks, *status,
+		   "memory allocation for string pool failed", -1);
+    sp->blocks=blocks;
+    long blocksize=MAX(len, SIMPUT_STRPOOL_BLOCKSIZE);
+    sp->blocks[sp->nblocks]=(char*)malloc(blocksize*sizeof(char));
+    CHECK_NULL_RET(sp->blocks[sp->nblocks], *status,
+		   "memory allocation for string pool failed", -1);
+    sp->blockpos =sp->blocks[sp->nblocks];
+    sp->blockfree=blocksize;
+    sp->nblocks++;
+  }
+  strcpy(sp->blockpos, str);
+  sp->strs[sp->nstrs]=sp->blockpos;
+  sp->blockpos +=len;
+  sp->blockfree-=len;
+
+  sp->slots[jj]=sp->nstrs;
+  sp->nstrs++;
+
+  return(sp->nstrs-1);
+}
+
+
+char* internSimputStrPool(struct SimputStrPool* const sp,
+			  const char* const str,
+			  int* const status)
+{
+  long id=internSimputStrPoolId(sp, str, status);
+  CHECK_STATUS_RET(*status, NULL);
+  return(sp->strs[id]);
+}
+
+
 SimputCtlg* newSimputCtlg(int* const status)
 {
   SimputCtlg* cat=
@@ -237,10 +397,49 @@ SimputCtlg* newSimputCtlg(int* const status)
   cat->phlistbuff  =NULL;
   cat->lcbuff   =NULL;
   cat->psdbuff  =NULL;
+  cat->fftwbuff =NULL;
   cat->imgbuff  =NULL;
   cat->specbuff =NULL;
+  cat->arfgrid  =NULL;
+  cat->speccache=NULL;
   cat->extbuff  =NULL;
+  cat->phqueue  =NULL;
   cat->arf      =NULL;
+  cat->specsampling=SIMPUT_SAMPLING_CDF;
+  cat->imgsampling =SIMPUT_SAMPLING_CDF;
+  cat->psdexposure =0.;
+  cat->psdsegment  =0.;
+  cat->psdwarnings =0;
+  cat->cachecap[EXTTYPE_NONE]    =0;
+  cat->cachecap[EXTTYPE_MIDPSPEC]=SIMPUT_CACHECAP_MIDPSPEC;
+  cat->cachecap[EXTTYPE_IMAGE]   =SIMPUT_CACHECAP_IMAGE;
+  cat->cachecap[EXTTYPE_PHLIST]  =SIMPUT_CACHECAP_PHLIST;
+  cat->cachecap[EXTTYPE_LC]      =SIMPUT_CACHECAP_LC;
+  cat->cachecap[EXTTYPE_PSD]     =SIMPUT_CACHECAP_PSD;
+  cat->phlistmaxmemrows=SIMPUT_PHLIST_MAXMEMROWS;
+  cat->core     =NULL;
+  cat->mutex    =NULL;
+  cat->rndstream=NULL;
+  cat->srcrndstreams=NULL;
+  cat->refpool  =NULL;
+  cat->cachemgr =NULL;
+  cat->phlistshared=NULL;
+
+  // Check whether the maximum number of rows of photon lists kept in
+  // memory is specified in the environment.
+  char* envrows=getenv(SIMPUT_PHLIST_MAXMEMROWS_ENVVAR);
+  if ((NULL!=envrows) && (strlen(envrows)>0)) {
+    char* end=NULL;
+    long value=strtol(envrows, &end, 10);
+    if ((end==envrows) || (*end!='\0') || (value<0)) {
+      char msg[SIMPUT_MAXSTR];
+      sprintf(msg, "invalid value of %s ignored",
+	      SIMPUT_PHLIST_MAXMEMROWS_ENVVAR);
+      SIMPUT_WARNING(msg);
+    } else {
+      cat->phlistmaxmemrows=value;
+    }
+  }
 
   return(cat);
 }
@@ -263,25 +462,69 @@ void freeSimputCtlg(SimputCtlg** const cat,
       freeSimputSrcBuffer((struct SimputSrcBuffer**)&((*cat)->srcbuff));
     }
     if (NULL!=(*cat)->midpspecbuff) {
-      freeSimputMIdpSpecBuffer((struct SimputMIdpSpecBuffer**)&((*cat)->midpspecbuff));
+      freeSimputCacheIndex((struct SimputCacheIndex**)&((*cat)->midpspecbuff),
+			   status);
     }
     if (NULL!=(*cat)->phlistbuff) {
-      freeSimputPhListBuffer((struct SimputPhListBuffer**)&((*cat)->phlistbuff), status);
+      freeSimputCacheIndex((struct SimputCacheIndex**)&((*cat)->phlistbuff),
+			   status);
+    }
+    if (NULL!=(*cat)->phlistshared) {
+      freeSimputCacheIndex((struct SimputCacheIndex**)&((*cat)->phlistshared),
+			   status);
     }
     if (NULL!=(*cat)->lcbuff) {
-      freeSimputLCBuffer((struct SimputLCBuffer**)&((*cat)->lcbuff));
+      freeSimputLCBuffer((struct SimputLCBuffer**)&((*cat)->lcbuff), status);
     }
     if (NULL!=(*cat)->psdbuff) {
-      freeSimputPSDBuffer((struct SimputPSDBuffer**)&((*cat)->psdbuff));
+      freeSimputCacheIndex((struct SimputCacheIndex**)&((*cat)->psdbuff),
+			   status);
+    }
+    if (NULL!=(*cat)->fftwbuff) {
+      freeSimputFFTWBuffer((struct SimputFFTWBuffer**)&((*cat)->fftwbuff));
     }
     if (NULL!=(*cat)->imgbuff) {
-      freeSimputImgBuffer((struct SimputImgBuffer**)&((*cat)->imgbuff));
+      freeSimputCacheIndex((struct SimputCacheIndex**)&((*cat)->imgbuff),
+			   status);
     }
     if (NULL!=(*cat)->specbuff) {
-      freeSimputSpecBuffer((struct SimputSpecBuffer**)&((*cat)->specbuff));
+      freeSimputCacheIndex((struct SimputCacheIndex**)&((*cat)->specbuff),
+			   status);
+    }
+    if (NULL!=(*cat)->arfgrid) {
+      freeSimputARFGrid((struct SimputARFGrid**)&((*cat)->arfgrid));
+    }
+    if (NULL!=(*cat)->speccache) {
+      freeSimputSpecDiskCache((struct SimputSpecDiskCache**)&((*cat)->speccache),
+			      status);
     }
     if (NULL!=(*cat)->extbuff) {
-      freeSimputExttypeBuffer((struct SimputExttypeBuffer**)&((*cat)->extbuff));
+      freeSimputCacheIndex((struct SimputCacheIndex**)&((*cat)->extbuff),
+			   status);
+    }
+    if (NULL!=(*cat)->phqueue) {
+      freeSimputPhotonQueue((struct SimputPhotonQueue**)&((*cat)->phqueue));
+    }
+    if (NULL!=(*cat)->rndstream) {
+      free((*cat)->rndstream);
+    }
+    if (NULL!=(*cat)->srcrndstreams) {
+      freeSimputSrcRndStreams((struct SimputSrcRndStreams**)
+			      &((*cat)->srcrndstreams), status);
+    }
+    if (NULL!=(*cat)->mutex) {
+      pthread_mutex_destroy((pthread_mutex_t*)(*cat)->mutex);
+      free((*cat)->mutex);
+    }
+    // The manager of the memory budget must be released after the
+    // buffers, which are registered with it.
+    if (NULL!=(*cat)->cachemgr) {
+      freeSimputCacheManager((struct SimputCacheManager**)&((*cat)->cachemgr));
+    }
+    // The table of references must be released after the buffers,
+    // since the sources in the source buffer use its strings.
+    if (NULL!=(*cat)->refpool) {
+      freeSimputStrPool((struct SimputStrPool**)&((*cat)->refpool));
     }
     free(*cat);
     *cat=NULL;
@@ -295,324 +538,675 @@ long getSimputCtlgNSources(const SimputCtlg* const cat)
 }
 
 
-struct SimputExttypeBuffer* newSimputExttypeBuffer(int* const status)
+SimputCtlg* getSimputCtlgCore(const SimputCtlg* const cat)
 {
-  struct SimputExttypeBuffer *extbuff=
-    (struct SimputExttypeBuffer*)malloc(sizeof(struct SimputExttypeBuffer));
-
-  CHECK_NULL_RET(extbuff, *status,
-		 "memory allocation for SimputExttypeBuffer failed", extbuff);
+  if (NULL!=cat->core) {
+    return((SimputCtlg*)cat->core);
+  } else {
+    return((SimputCtlg*)cat);
+  }
+}
 
-  extbuff->type   =EXTTYPE_NONE;
-  extbuff->fileref=NULL;
-  extbuff->left   =NULL;
-  extbuff->right  =NULL;
 
-  return(extbuff);
+int isSimputCtlgShared(const SimputCtlg* const cat)
+{
+  return(NULL!=getSimputCtlgCore(cat)->mutex);
 }
 
 
-void freeSimputExttypeBuffer(struct SimputExttypeBuffer** eb)
+void lockSimputCtlg(const SimputCtlg* const cat)
 {
-  if (NULL!=*eb) {
-    if (NULL!=(*eb)->fileref) {
-      free((*eb)->fileref);
-    }
-    if (NULL!=(*eb)->left) {
-      freeSimputExttypeBuffer(&((*eb)->left));
-    }
-    if (NULL!=(*eb)->right) {
-      freeSimputExttypeBuffer(&((*eb)->right));
-    }
-    free(*eb);
-    *eb=NULL;
+  SimputCtlg* core=getSimputCtlgCore(cat);
+  if (NULL!=core->mutex) {
+    pthread_mutex_lock((pthread_mutex_t*)core->mutex);
   }
 }
 
 
-int searchSimputExttypeBuffer(void* buffer, const char* const filename)
+void unlockSimputCtlg(const SimputCtlg* const cat)
 {
-  struct SimputExttypeBuffer* eb=(struct SimputExttypeBuffer*)buffer;
-
-  // Check if this is a leaf.
-  if (NULL==eb) {
-    return(EXTTYPE_NONE);
+  SimputCtlg* core=getSimputCtlgCore(cat);
+  if (NULL!=core->mutex) {
+    pthread_mutex_unlock((pthread_mutex_t*)core->mutex);
   }
+}
 
-  // Compare with the current type.
-  int cmp=strcmp(filename, eb->fileref);
-  if (0==cmp) {
-    return(eb->type);
-  } else if (cmp<0) {
-    return(searchSimputExttypeBuffer(eb->left, filename));
-  } else {
-    return(searchSimputExttypeBuffer(eb->right, filename));
+
+long getSimputCtlgRefId(SimputCtlg* const cat,
+			const char* const ref,
+			int* const status)
+{
+  long id=-1;
+  lockSimputCtlg(cat);
+  SimputCtlg* core=getSimputCtlgCore(cat);
+  if (NULL==core->refpool) {
+    core->refpool=newSimputStrPool(status);
+  }
+  if (EXIT_SUCCESS==*status) {
+    id=internSimputStrPoolId((struct SimputStrPool*)core->refpool, ref, status);
   }
+  unlockSimputCtlg(cat);
+  return(id);
 }
 
 
-void insertSimputExttypeBuffer(void** buffer,
-			       const char* const filename,
-			       const int type,
-			       int* const status)
+char* internSimputCtlgRef(SimputCtlg* const cat,
+			  const char* const ref,
+			  int* const status)
 {
-  struct SimputExttypeBuffer** eb=(struct SimputExttypeBuffer**)buffer;
-
-  // Check if this is a leaf.
-  if (NULL==*eb) {
-    // Insert the extension type here.
-    *eb=newSimputExttypeBuffer(status);
-    CHECK_STATUS_VOID(*status);
-    (*eb)->fileref=(char*)malloc((strlen(filename)+1)*sizeof(char));
-    CHECK_NULL_VOID((*eb)->fileref, *status,
-		    "memory allocation for file reference failed");
-    strcpy((*eb)->fileref, filename);
-    (*eb)->type=type;
-  } else if (strcmp(filename, (*eb)->fileref) < 0){
-    insertSimputExttypeBuffer((void**)&((*eb)->left), filename, type, status);
-    CHECK_STATUS_VOID(*status);
-  } else {
-    insertSimputExttypeBuffer((void**)&((*eb)->right), filename, type, status);
-    CHECK_STATUS_VOID(*status);
+  // The array of strings may be re-allocated by a concurrent
+  // insertion. Therefore it is accessed under the lock.
+  char* str=NULL;
+  lockSimputCtlg(cat);
+  long id=getSimputCtlgRefId(cat, ref, status);
+  if (EXIT_SUCCESS==*status) {
+    str=((struct SimputStrPool*)getSimputCtlgCore(cat)->refpool)->strs[id];
   }
+  unlockSimputCtlg(cat);
+  return(str);
 }
 
 
-SimputMIdpSpec* newSimputMIdpSpec(int* const status)
+struct SimputCacheIndex* newSimputCacheIndex(const long capacity,
+					     void (*release)(void*, int* const),
+					     int* const status)
 {
-  SimputMIdpSpec* spec=
-    (SimputMIdpSpec*)malloc(sizeof(SimputMIdpSpec));
-  CHECK_NULL_RET(spec, *status,
-		 "memory allocation for SimputMIdpSpec failed", spec);
-
-  // Initialize elements.
-  spec->nentries   =0;
-  spec->energy     =NULL;
-  spec->fluxdensity=NULL;
-  spec->name       =NULL;
-  spec->fileref    =NULL;
+  struct SimputCacheIndex* ci=
+    (struct SimputCacheIndex*)malloc(sizeof(struct SimputCacheIndex));
+  CHECK_NULL_RET(ci, *status,
+		 "memory allocation for SimputCacheIndex failed", ci);
+
+  ci->nentries=0;
+  ci->capacity=capacity;
+  ci->nalloc  =0;
+  ci->entries =NULL;
+  ci->freeentry=-1;
+  ci->slotbits=4;
+  ci->slots   =NULL;
+  ci->first   =-1;
+  ci->last    =-1;
+  ci->nevicted=0;
+  ci->nhits   =0;
+  ci->nmisses =0;
+  ci->release =release;
+  ci->size    =NULL;
+  ci->sizearg =NULL;
+  ci->nbytes  =0;
+  ci->minentries=0;
+  ci->mgr     =NULL;
+
+  ci->slots=(long*)malloc((1L<<ci->slotbits)*sizeof(long));
+  if (NULL==ci->slots) {
+    freeSimputCacheIndex(&ci, status);
+    SIMPUT_ERROR("memory allocation for SimputCacheIndex failed");
+    *status=EXIT_FAILURE;
+    return(ci);
+  }
+  long ii;
+  for (ii=0; ii<(1L<<ci->slotbits); ii++) {
+    ci->slots[ii]=-1;
+  }
 
-  return(spec);
+  return(ci);
 }
 
 
-void freeSimputMIdpSpec(SimputMIdpSpec** spec)
+void freeSimputCacheIndex(struct SimputCacheIndex** const ci,
+			  int* const status)
 {
-  if (NULL!=*spec) {
-    if (NULL!=(*spec)->energy) {
-      free((*spec)->energy);
+  if (NULL!=*ci) {
+    unregisterSimputCacheIndex(*ci);
+    if (NULL!=(*ci)->release) {
+      long ii;
+      for (ii=(*ci)->first; ii>=0; ii=(*ci)->entries[ii].next) {
+	(*ci)->release((*ci)->entries[ii].obj, status);
+      }
     }
-    if (NULL!=(*spec)->fluxdensity) {
-      free((*spec)->fluxdensity);
+    if (NULL!=(*ci)->entries) {
+      free((*ci)->entries);
     }
-    if (NULL!=(*spec)->name) {
-      free((*spec)->name);
+    if (NULL!=(*ci)->slots) {
+      free((*ci)->slots);
     }
-    if (NULL!=(*spec)->fileref) {
-      free((*spec)->fileref);
+    free(*ci);
+    *ci=NULL;
+  }
+}
+
+
+/** Return the slot of the hash table, where the search for the
+    specified identifier starts (Fibonacci hashing). */
+static inline long getSimputCacheIndexHome(const struct SimputCacheIndex* const ci,
+					   const long refid)
+{
+  return((long)(((uint64_t)refid*UINT64_C(0x9E3779B97F4A7C15))
+		>>(64-ci->slotbits)));
+}
+
+
+/** Return the slot of the hash table, which refers to the entry with
+    the specified identifier, or -1 if there is no such entry. */
+static long findSimputCacheIndexSlot(const struct SimputCacheIndex* const ci,
+				     const long refid)
+{
+  const long mask=(1L<<ci->slotbits)-1;
+  long slot=getSimputCacheIndexHome(ci, refid);
+  while (ci->slots[slot]>=0) {
+    if (refid==ci->entries[ci->slots[slot]].refid) {
+      return(slot);
     }
-    free(*spec);
-    *spec=NULL;
+    slot=(slot+1)&mask;
   }
+  return(-1);
 }
 
 
-void getSimputMIdpSpecVal(const SimputMIdpSpec* const spec,
-			  const long row,
-			  float* const energy,
-			  float* const fluxdensity,
-			  int* const status)
+/** Remove an entry from the list ordered by the time of the last
+    access. */
+static void unlinkSimputCacheEntry(struct SimputCacheIndex* const ci,
+				   const long idx)
 {
-  if (row>=spec->nentries) {
-    *status=EXIT_FAILURE;
-    SIMPUT_ERROR("row number exceeds number of bins in spectrum");
-    return;
+  struct SimputCacheEntry* entry=&(ci->entries[idx]);
+  if (entry->prev>=0) {
+    ci->entries[entry->prev].next=entry->next;
+  } else {
+    ci->first=entry->next;
   }
+  if (entry->next>=0) {
+    ci->entries[entry->next].prev=entry->prev;
+  } else {
+    ci->last=entry->prev;
+  }
+}
 
-  *energy     =spec->energy[row];
-  *fluxdensity=spec->fluxdensity[row];
+
+/** Insert an entry at the beginning of the list ordered by the time
+    of the last access. */
+static void linkSimputCacheEntry(struct SimputCacheIndex* const ci,
+				 const long idx)
+{
+  ci->entries[idx].prev=-1;
+  ci->entries[idx].next=ci->first;
+  if (ci->first>=0) {
+    ci->entries[ci->first].prev=idx;
+  } else {
+    ci->last=idx;
+  }
+  ci->first=idx;
 }
 
 
-struct SimputMIdpSpecBuffer* newSimputMIdpSpecBuffer(int* const status)
+/** Mark an entry as accessed and update the memory occupied by the
+    extension. */
+static void touchSimputCacheEntry(struct SimputCacheIndex* const ci,
+				  const long idx)
 {
-  struct SimputMIdpSpecBuffer *specbuff=
-    (struct SimputMIdpSpecBuffer*)malloc(sizeof(struct SimputMIdpSpecBuffer));
+  struct SimputCacheEntry* entry=&(ci->entries[idx]);
+  if (NULL!=ci->size) {
+    long size=ci->size(entry->obj, ci->sizearg);
+    ci->nbytes+=size-entry->size;
+    if (NULL!=ci->mgr) {
+      ci->mgr->nbytes+=size-entry->size;
+    }
+    entry->size=size;
+  }
+  if (NULL!=ci->mgr) {
+    entry->stamp=++(ci->mgr->clock);
+  }
+}
 
-  CHECK_NULL_RET(specbuff, *status,
-		 "memory allocation for SimputMIdpSpecBuffer failed", specbuff);
 
-  specbuff->spectrum=NULL;
-  specbuff->left    =NULL;
-  specbuff->right   =NULL;
+/** Release the specified entry of the cache. The entries following
+    it in its probe sequence are moved backwards, such that no
+    tombstones are required. */
+static void releaseSimputCacheEntry(struct SimputCacheIndex* const ci,
+				    const long slot0,
+				    int* const status)
+{
+  const long mask=(1L<<ci->slotbits)-1;
+  long slot=slot0;
+  long idx=ci->slots[slot];
+
+  long next=slot;
+  while (1) {
+    next=(next+1)&mask;
+    if (ci->slots[next]<0) break;
+    long home=getSimputCacheIndexHome(ci, ci->entries[ci->slots[next]].refid);
+    // Move the entry into the free slot, unless its home lies
+    // cyclically between the free slot and its current slot.
+    if (((next>slot) && ((home<=slot) || (home>next))) ||
+	((next<slot) && ((home<=slot) && (home>next)))) {
+      ci->slots[slot]=ci->slots[next];
+      slot=next;
+    }
+  }
+  ci->slots[slot]=-1;
 
-  return(specbuff);
+  unlinkSimputCacheEntry(ci, idx);
+  ci->nbytes-=ci->entries[idx].size;
+  if (NULL!=ci->mgr) {
+    ci->mgr->nbytes-=ci->entries[idx].size;
+  }
+  if (NULL!=ci->release) {
+    ci->release(ci->entries[idx].obj, status);
+  }
+  ci->entries[idx].obj =NULL;
+  ci->entries[idx].next=ci->freeentry;
+  ci->freeentry=idx;
+  ci->nentries--;
+  ci->nevicted++;
 }
 
 
-void freeSimputMIdpSpecBuffer(struct SimputMIdpSpecBuffer** sb)
+/** Release the least recently used entry of the cache. */
+static void evictSimputCacheIndex(struct SimputCacheIndex* const ci,
+				  int* const status)
 {
-  if (NULL!=*sb) {
-    if (NULL!=(*sb)->spectrum) {
-      freeSimputMIdpSpec(&((*sb)->spectrum));
-    }
-    if (NULL!=(*sb)->left) {
-      freeSimputMIdpSpecBuffer(&((*sb)->left));
-    }
-    if (NULL!=(*sb)->right) {
-      freeSimputMIdpSpecBuffer(&((*sb)->right));
-    }
-    free(*sb);
-    *sb=NULL;
+  long slot=findSimputCacheIndexSlot(ci, ci->entries[ci->last].refid);
+  assert(slot>=0);
+  releaseSimputCacheEntry(ci, slot, status);
+}
+
+
+void removeSimputCacheIndex(struct SimputCacheIndex* const ci,
+			    const long refid,
+			    int* const status)
+{
+  if (NULL==ci) {
+    return;
+  }
+  long slot=findSimputCacheIndexSlot(ci, refid);
+  if (slot>=0) {
+    releaseSimputCacheEntry(ci, slot, status);
   }
 }
 
 
-SimputMIdpSpec* searchSimputMIdpSpecBuffer(void* buffer,
-					   const char* const filename)
+void* searchSimputCacheIndex(struct SimputCacheIndex* const ci,
+			     const long refid)
 {
-  struct SimputMIdpSpecBuffer* sb=(struct SimputMIdpSpecBuffer*)buffer;
+  if (NULL==ci) {
+    return(NULL);
+  }
 
-  // Check if this is a leaf.
-  if (NULL==sb) {
+  long slot=findSimputCacheIndexSlot(ci, refid);
+  if (slot<0) {
+    ci->nmisses++;
     return(NULL);
   }
+  ci->nhits++;
 
-  // Compare with the current spectrum.
-  int cmp=strcmp(filename, sb->spectrum->fileref);
-  if (0==cmp) {
-    return(sb->spectrum);
-  } else if (cmp<0) {
-    return(searchSimputMIdpSpecBuffer(sb->left, filename));
-  } else {
-    return(searchSimputMIdpSpecBuffer(sb->right, filename));
+  // Mark the entry as most recently used.
+  long idx=ci->slots[slot];
+  if (idx!=ci->first) {
+    unlinkSimputCacheEntry(ci, idx);
+    linkSimputCacheEntry(ci, idx);
   }
+  touchSimputCacheEntry(ci, idx);
+  return(ci->entries[idx].obj);
 }
 
 
-void insertSimputMIdpSpecBuffer(void** buffer,
-				SimputMIdpSpec* const spec,
-				int* const status)
+int containsSimputCacheIndex(const struct SimputCacheIndex* const ci,
+			     const long refid)
 {
-  struct SimputMIdpSpecBuffer** sb=(struct SimputMIdpSpecBuffer**)buffer;
+  if (NULL==ci) {
+    return(0);
+  }
+  return(findSimputCacheIndexSlot(ci, refid)>=0);
+}
 
-  // Check if this is a leaf.
-  if (NULL==*sb) {
-    *sb=newSimputMIdpSpecBuffer(status);
-    CHECK_STATUS_VOID(*status);
-    (*sb)->spectrum=spec;
-  } else if (strcmp(spec->fileref, (*sb)->spectrum->fileref) < 0){
-    insertSimputMIdpSpecBuffer((void**)&((*sb)->left), spec, status);
+
+void insertSimputCacheIndex(struct SimputCacheIndex* const ci,
+			    const long refid,
+			    void* const obj,
+			    const int evict,
+			    int* const status)
+{
+  assert(findSimputCacheIndexSlot(ci, refid)<0);
+
+  // Release the least recently used entries, if the capacity or the
+  // memory budget is exhausted.
+  if ((0!=evict) && (ci->capacity>0)) {
+    while ((ci->nentries>=ci->capacity) && (ci->last>=0)) {
+      evictSimputCacheIndex(ci, status);
+      CHECK_STATUS_VOID(*status);
+    }
+  }
+  if ((0!=evict) && (NULL!=ci->mgr)) {
+    long size=0;
+    if (NULL!=ci->size) {
+      size=ci->size(obj, ci->sizearg);
+    }
+    reduceSimputCacheManager(ci->mgr, size, status);
     CHECK_STATUS_VOID(*status);
+  }
+
+  // Enlarge the hash table such that at most half of the slots
+  // are occupied.
+  if (2*(ci->nentries+1)>(1L<<ci->slotbits)) {
+    long nslots=1L<<(ci->slotbits+1);
+    long* slots=(long*)malloc(nslots*sizeof(long));
+    CHECK_NULL_VOID(slots, *status,
+		    "memory allocation for SimputCacheIndex failed");
+    free(ci->slots);
+    ci->slots=slots;
+    ci->slotbits++;
+    long ii;
+    for (ii=0; ii<nslots; ii++) {
+      ci->slots[ii]=-1;
+    }
+    for (ii=ci->first; ii>=0; ii=ci->entries[ii].next) {
+      long slot=getSimputCacheIndexHome(ci, ci->entries[ii].refid);
+      while (ci->slots[slot]>=0) {
+	slot=(slot+1)&(nslots-1);
+      }
+      ci->slots[slot]=ii;
+    }
+  }
+
+  // Obtain an unused entry.
+  long idx=ci->freeentry;
+  if (idx>=0) {
+    ci->freeentry=ci->entries[idx].next;
   } else {
-    insertSimputMIdpSpecBuffer((void**)&((*sb)->right), spec, status);
-    CHECK_STATUS_VOID(*status);
+    if (ci->nalloc<=ci->nentries) {
+      long nalloc=(ci->nalloc>0) ? 2*ci->nalloc : 16;
+      struct SimputCacheEntry* entries=(struct SimputCacheEntry*)
+	realloc(ci->entries, nalloc*sizeof(struct SimputCacheEntry));
+      CHECK_NULL_VOID(entries, *status,
+		      "memory allocation for SimputCacheIndex failed");
+      ci->entries=entries;
+      ci->nalloc =nalloc;
+    }
+    idx=ci->nentries;
   }
+  ci->entries[idx].refid=refid;
+  ci->entries[idx].obj  =obj;
+  ci->entries[idx].size =0;
+  ci->entries[idx].stamp=0;
+  linkSimputCacheEntry(ci, idx);
+  touchSimputCacheEntry(ci, idx);
+  ci->nentries++;
+
+  long slot=getSimputCacheIndexHome(ci, refid);
+  while (ci->slots[slot]>=0) {
+    slot=(slot+1)&((1L<<ci->slotbits)-1);
+  }
+  ci->slots[slot]=idx;
 }
 
 
-static long MIdpSpecPartition(SimputMIdpSpec** const spectra,
-			      const long left, const long right,
-			      const long pivotIndex)
+struct SimputCacheManager* newSimputCacheManager(const long budget,
+						 int* const status)
 {
-  // Move pivot to end.
-  SimputMIdpSpec* buffer;
-  buffer=spectra[pivotIndex];
-  spectra[pivotIndex]=spectra[right];
-  spectra[right]=buffer;
-
-  long storeIndex=left;
-  long ii;
-  for (ii=left; ii<right; ii++) { // left ≤ i < right
-    if (strcmp(spectra[ii]->fileref, spectra[right]->fileref)<0) {
-      if (ii>storeIndex) {
-	buffer=spectra[storeIndex];
-	spectra[storeIndex]=spectra[ii];
-	spectra[ii]=buffer;
+  struct SimputCacheManager* mgr=
+    (struct SimputCacheManager*)malloc(sizeof(struct SimputCacheManager));
+  CHECK_NULL_RET(mgr, *status,
+		 "memory allocation for SimputCacheManager failed", mgr);
+
+  mgr->budget  =budget;
+  mgr->nbytes  =0;
+  mgr->clock   =0;
+  mgr->nindices=0;
+
+  // Check whether a budget is specified in the environment.
+  if (budget<0) {
+    mgr->budget=0;
+    char* envbudget=getenv(SIMPUT_CACHE_BUDGET_ENVVAR);
+    if ((NULL!=envbudget) && (strlen(envbudget)>0)) {
+      char* end=NULL;
+      double value=strtod(envbudget, &end);
+      if ((*end=='k') || (*end=='K')) {
+	value*=1024.;
+	end++;
+      } else if (*end=='M') {
+	value*=1024.*1024.;
+	end++;
+      } else if (*end=='G') {
+	value*=1024.*1024.*1024.;
+	end++;
+      }
+      if ((end==envbudget) || (*end!='\0') || (value<0.)) {
+	char msg[SIMPUT_MAXSTR];
+	sprintf(msg, "invalid value of %s ignored", SIMPUT_CACHE_BUDGET_ENVVAR);
+	SIMPUT_WARNING(msg);
+      } else {
+	mgr->budget=(long)value;
       }
-      storeIndex++;
     }
   }
 
-  // Move pivot to its final place
-  buffer=spectra[storeIndex];
-  spectra[storeIndex]=spectra[right];
-  spectra[right]=buffer;
+  return(mgr);
+}
+
 
-  return(storeIndex);
+void freeSimputCacheManager(struct SimputCacheManager** mgr)
+{
+  if (NULL!=*mgr) {
+    // Caches, which are still registered, are detached.
+    int ii;
+    for (ii=0; ii<(*mgr)->nindices; ii++) {
+      (*mgr)->indices[ii]->mgr=NULL;
+    }
+    free(*mgr);
+    *mgr=NULL;
+  }
 }
 
 
-static void quicksortMIdpSpec(SimputMIdpSpec** const spectra,
-			      const long left,
-			      const long right)
+void registerSimputCacheIndex(struct SimputCacheManager* const mgr,
+			      struct SimputCacheIndex* const ci,
+			      int* const status)
 {
-  if (right>left) {
-    // Select a pivot index (e.g. pivotIndex := left+(right-left)/2)
-    int pivotIndex=left+(right-left)/2;
-    int pivotNewIndex=MIdpSpecPartition(spectra, left, right, pivotIndex);
-    quicksortMIdpSpec(spectra, left, pivotNewIndex-1);
-    quicksortMIdpSpec(spectra, pivotNewIndex+1, right);
+  assert(NULL==ci->mgr);
+  if (mgr->nindices>=SIMPUT_CACHEMGR_MAXINDICES) {
+    SIMPUT_ERROR("too many caches registered with SimputCacheManager");
+    *status=EXIT_FAILURE;
+    return;
+  }
+  mgr->indices[mgr->nindices++]=ci;
+  ci->mgr=mgr;
+  mgr->nbytes+=ci->nbytes;
+
+  // Assign time stamps to the entries in the order of their last
+  // access.
+  long ii;
+  for (ii=ci->last; ii>=0; ii=ci->entries[ii].prev) {
+    ci->entries[ii].stamp=++(mgr->clock);
   }
 }
 
 
-void buildSimputMIdpSpecBuffer(void** buffer,
-			       SimputMIdpSpec** const spectra,
-			       const long nspectra,
-			       const int sorted,
-			       int* const status)
+void unregisterSimputCacheIndex(struct SimputCacheIndex* const ci)
 {
-  struct SimputMIdpSpecBuffer** sb=(struct SimputMIdpSpecBuffer**)buffer;
+  struct SimputCacheManager* mgr=ci->mgr;
+  if (NULL==mgr) {
+    return;
+  }
+  int ii;
+  for (ii=0; ii<mgr->nindices; ii++) {
+    if (mgr->indices[ii]==ci) {
+      mgr->indices[ii]=mgr->indices[mgr->nindices-1];
+      mgr->nindices--;
+      break;
+    }
+  }
+  mgr->nbytes-=ci->nbytes;
+  ci->mgr=NULL;
+}
 
-  // The binary tree must be empty.
-  assert(*sb==NULL);
 
-  // Sort the spectra according to their fileref's.
-  if (0==sorted) {
-    quicksortMIdpSpec(spectra, 0, nspectra-1);
+void reduceSimputCacheManager(struct SimputCacheManager* const mgr,
+			      const long nbytes,
+			      int* const status)
+{
+  if (mgr->budget<=0) {
+    return;
   }
 
-  // Determine the median.
-  long median=(long)nspectra/2;
+  // The most recently used extensions might have grown since their
+  // last access, e.g., by tables set up for drawing photons.
+  int ii;
+  for (ii=0; ii<mgr->nindices; ii++) {
+    struct SimputCacheIndex* ci=mgr->indices[ii];
+    if ((ci->first>=0) && (NULL!=ci->size)) {
+      long size=ci->size(ci->entries[ci->first].obj, ci->sizearg);
+      ci->nbytes+=size-ci->entries[ci->first].size;
+      mgr->nbytes+=size-ci->entries[ci->first].size;
+      ci->entries[ci->first].size=size;
+    }
+  }
 
-  // Insert the median element at the current node.
-  *sb=newSimputMIdpSpecBuffer(status);
-  CHECK_STATUS_VOID(*status);
-  (*sb)->spectrum=spectra[median];
+  while (mgr->nbytes+nbytes>mgr->budget) {
+    // Find the least recently used extension among all caches.
+    struct SimputCacheIndex* lru=NULL;
+    for (ii=0; ii<mgr->nindices; ii++) {
+      struct SimputCacheIndex* ci=mgr->indices[ii];
+      if ((ci->nentries<=ci->minentries) || (0==ci->nbytes)) continue;
+      if ((NULL==lru) ||
+	  (ci->entries[ci->last].stamp<lru->entries[lru->last].stamp)) {
+	lru=ci;
+      }
+    }
+    if (NULL==lru) break;
 
-  if (median>0) {
-    buildSimputMIdpSpecBuffer((void**)&((*sb)->left), spectra, median, 1, status);
+    evictSimputCacheIndex(lru, status);
     CHECK_STATUS_VOID(*status);
   }
+}
+
+
+/** Return the memory occupied by a string [bytes]. */
+static long sizeSimputStr(const char* const str)
+{
+  return((NULL==str) ? 0 : (long)strlen(str)+1);
+}
+
+
+void manageSimputCtlgCache(SimputCtlg* const cat,
+			   void* const buffer,
+			   int* const status)
+{
+  struct SimputCacheIndex* ci=(struct SimputCacheIndex*)buffer;
+  if ((NULL==ci) || (NULL!=ci->mgr) || (NULL!=cat->core) ||
+      isSimputCtlgShared(cat)) {
+    return;
+  }
 
-  if (median<nspectra-1) {
-    buildSimputMIdpSpecBuffer((void**)&((*sb)->right), &(spectra[median+1]),
-			      nspectra-1-median, 1, status);
+  if (NULL==cat->cachemgr) {
+    cat->cachemgr=newSimputCacheManager(-1, status);
     CHECK_STATUS_VOID(*status);
   }
+  registerSimputCacheIndex((struct SimputCacheManager*)cat->cachemgr, ci,
+			   status);
 }
 
 
-SimputSpec* newSimputSpec(int* const status)
+struct SimputCacheIndex* newSimputExttypeBuffer(int* const status)
 {
-  SimputSpec* spec=(SimputSpec*)malloc(sizeof(SimputSpec));
+  // The extension types are small and are never released.
+  return(newSimputCacheIndex(0, NULL, status));
+}
+
+
+SimputMIdpSpec* newSimputMIdpSpec(int* const status)
+{
+  SimputMIdpSpec* spec=
+    (SimputMIdpSpec*)malloc(sizeof(SimputMIdpSpec));
   CHECK_NULL_RET(spec, *status,
-		 "memory allocation for SimputSpec failed", spec);
+		 "memory allocation for SimputMIdpSpec failed", spec);
 
   // Initialize elements.
-  spec->distribution=NULL;
-  spec->fileref     =NULL;
+  spec->nentries   =0;
+  spec->energy     =NULL;
+  spec->fluxdensity=NULL;
+  spec->matrix     =NULL;
+  spec->name       =NULL;
+  spec->fileref    =NULL;
+  spec->refid      =-1;
 
   return(spec);
 }
 
 
-void freeSimputSpec(SimputSpec** const spec)
+struct SimputMIdpSpecMatrix* newSimputMIdpSpecMatrix(const long nspec,
+						     const long nentries,
+						     int* const status)
+{
+  struct SimputMIdpSpecMatrix* sm=(struct SimputMIdpSpecMatrix*)
+    malloc(sizeof(struct SimputMIdpSpecMatrix));
+  CHECK_NULL_RET(sm, *status,
+		 "memory allocation for SimputMIdpSpecMatrix failed", sm);
+
+  sm->nspec      =nspec;
+  sm->nentries   =nentries;
+  sm->nrefs      =1;
+  sm->energy     =(float*)malloc((nentries+1)*sizeof(float));
+  sm->fluxdensity=(float*)malloc((nspec*nentries+1)*sizeof(float));
+  if ((NULL==sm->energy) || (NULL==sm->fluxdensity)) {
+    if (NULL!=sm->energy) free(sm->energy);
+    if (NULL!=sm->fluxdensity) free(sm->fluxdensity);
+    free(sm);
+    SIMPUT_ERROR("memory allocation for SimputMIdpSpecMatrix failed");
+    *status=EXIT_FAILURE;
+    return(NULL);
+  }
+
+  return(sm);
+}
+
+
+void releaseSimputMIdpSpecMatrix(struct SimputMIdpSpecMatrix** sm)
+{
+  if (NULL!=*sm) {
+    if (0==--(*sm)->nrefs) {
+      free((*sm)->energy);
+      free((*sm)->fluxdensity);
+      free(*sm);
+    }
+    *sm=NULL;
+  }
+}
+
+
+void setSimputMIdpSpecMatrixRow(SimputMIdpSpec* const spec,
+				struct SimputMIdpSpecMatrix* const sm,
+				const long row)
+{
+  assert(NULL==spec->matrix);
+  assert((row>=0) && (row<sm->nspec));
+  spec->nentries   =sm->nentries;
+  spec->energy     =sm->energy;
+  spec->fluxdensity=&(sm->fluxdensity[row*sm->nentries]);
+  spec->matrix     =sm;
+  sm->nrefs++;
+}
+
+
+void freeSimputMIdpSpec(SimputMIdpSpec** spec)
 {
   if (NULL!=*spec) {
-    if (NULL!=(*spec)->distribution) {
-      free((*spec)->distribution);
+    struct SimputMIdpSpecMatrix* sm=
+      (struct SimputMIdpSpecMatrix*)(*spec)->matrix;
+    if (NULL!=sm) {
+      // The flux densities and usually also the energy grid are part
+      // of the matrix, which is released together with the last
+      // spectrum referring to it.
+      if ((NULL!=(*spec)->energy) && ((*spec)->energy!=sm->energy)) {
+	free((*spec)->energy);
+      }
+      releaseSimputMIdpSpecMatrix(&sm);
+    } else {
+      if (NULL!=(*spec)->energy) {
+	free((*spec)->energy);
+      }
+      if (NULL!=(*spec)->fluxdensity) {
+	free((*spec)->fluxdensity);
+      }
+    }
+    if (NULL!=(*spec)->name) {
+      free((*spec)->name);
     }
     if (NULL!=(*spec)->fileref) {
       free((*spec)->fileref);
@@ -623,80 +1217,137 @@ void freeSimputSpec(SimputSpec** const spec)
 }
 
 
-struct SimputSpecBuffer* newSimputSpecBuffer(int* const status)
+static void releaseSimputMIdpSpec(void* obj, int* const status)
 {
-  struct SimputSpecBuffer *specbuff=
-    (struct SimputSpecBuffer*)malloc(sizeof(struct SimputSpecBuffer));
+  SimputMIdpSpec* spec=(SimputMIdpSpec*)obj;
+  freeSimputMIdpSpec(&spec);
+  (void)(*status);
+}
+
 
-  CHECK_NULL_RET(specbuff, *status,
-		 "memory allocation for SimputSpecBuffer failed", specbuff);
+static long sizeSimputMIdpSpec(const void* const obj,
+			       const void* const arg)
+{
+  const SimputMIdpSpec* spec=(const SimputMIdpSpec*)obj;
+  const struct SimputMIdpSpecMatrix* sm=
+    (const struct SimputMIdpSpecMatrix*)spec->matrix;
+  (void)arg;
+  // Spectra, which are part of a matrix, share the energy grid.
+  long nbytes=(long)sizeof(SimputMIdpSpec)+spec->nentries*(long)sizeof(float);
+  if ((NULL!=sm) && (spec->energy==sm->energy)) {
+    nbytes+=(spec->nentries*(long)sizeof(float)+
+	     (long)sizeof(struct SimputMIdpSpecMatrix))/sm->nspec;
+  } else {
+    nbytes+=spec->nentries*(long)sizeof(float);
+  }
+  return(nbytes+sizeSimputStr(spec->name)+sizeSimputStr(spec->fileref));
+}
 
-  specbuff->spectrum=NULL;
-  specbuff->left    =NULL;
-  specbuff->right   =NULL;
 
-  return(specbuff);
+struct SimputCacheIndex* newSimputMIdpSpecBuffer(const long capacity,
+						 int* const status)
+{
+  struct SimputCacheIndex* ci=
+    newSimputCacheIndex(capacity, releaseSimputMIdpSpec, status);
+  CHECK_STATUS_RET(*status, ci);
+  ci->size      =sizeSimputMIdpSpec;
+  ci->sizearg   =NULL;
+  ci->minentries=2;
+  return(ci);
 }
 
 
-void freeSimputSpecBuffer(struct SimputSpecBuffer** sb)
+void getSimputMIdpSpecVal(const SimputMIdpSpec* const spec,
+			  const long row,
+			  float* const energy,
+			  float* const fluxdensity,
+			  int* const status)
 {
-  if (NULL!=*sb) {
-    if (NULL!=(*sb)->spectrum) {
-      freeSimputSpec(&((*sb)->spectrum));
+  if (row>=spec->nentries) {
+    *status=EXIT_FAILURE;
+    SIMPUT_ERROR("row number exceeds number of bins in spectrum");
+    return;
+  }
+
+  *energy     =spec->energy[row];
+  *fluxdensity=spec->fluxdensity[row];
+}
+
+
+SimputSpec* newSimputSpec(int* const status)
+{
+  SimputSpec* spec=(SimputSpec*)malloc(sizeof(SimputSpec));
+  CHECK_NULL_RET(spec, *status,
+		 "memory allocation for SimputSpec failed", spec);
+
+  // Initialize elements.
+  spec->distribution=NULL;
+  spec->aliasprob   =NULL;
+  spec->alias       =NULL;
+  spec->fileref     =NULL;
+  spec->refid       =-1;
+
+  return(spec);
+}
+
+
+void freeSimputSpec(SimputSpec** const spec)
+{
+  if (NULL!=*spec) {
+    if (NULL!=(*spec)->distribution) {
+      free((*spec)->distribution);
     }
-    if (NULL!=(*sb)->left) {
-      freeSimputSpecBuffer(&((*sb)->left));
+    if (NULL!=(*spec)->aliasprob) {
+      free((*spec)->aliasprob);
     }
-    if (NULL!=(*sb)->right) {
-      freeSimputSpecBuffer(&((*sb)->right));
+    if (NULL!=(*spec)->alias) {
+      free((*spec)->alias);
     }
-    free(*sb);
-    *sb=NULL;
+    if (NULL!=(*spec)->fileref) {
+      free((*spec)->fileref);
+    }
+    free(*spec);
+    *spec=NULL;
   }
 }
 
 
-SimputSpec* searchSimputSpecBuffer(void* buffer,
-				   const char* const filename)
+static void releaseSimputSpec(void* obj, int* const status)
 {
-  struct SimputSpecBuffer* sb=(struct SimputSpecBuffer*)buffer;
+  SimputSpec* spec=(SimputSpec*)obj;
+  freeSimputSpec(&spec);
+  (void)(*status);
+}
 
-  // Check if this is a leaf.
-  if (NULL==sb) {
-    return(NULL);
-  }
 
-  // Compare with the current spectrum.
-  int cmp=strcmp(filename, sb->spectrum->fileref);
-  if (0==cmp) {
-    return(sb->spectrum);
-  } else if (cmp<0) {
-    return(searchSimputSpecBuffer(sb->left, filename));
-  } else {
-    return(searchSimputSpecBuffer(sb->right, filename));
+static long sizeSimputSpec(const void* const obj,
+			   const void* const arg)
+{
+  const SimputSpec* spec=(const SimputSpec*)obj;
+  const SimputCtlg* cat=(const SimputCtlg*)arg;
+  long nbins=(NULL!=cat->arf) ? cat->arf->NumberEnergyBins : 0;
+  long size=(long)sizeof(SimputSpec)+sizeSimputStr(spec->fileref);
+  if (NULL!=spec->distribution) {
+    size+=nbins*(long)sizeof(double);
   }
+  if (NULL!=spec->alias) {
+    size+=nbins*(long)(sizeof(double)+sizeof(long));
+  }
+  return(size);
 }
 
 
-void insertSimputSpecBuffer(void** buffer,
-			    SimputSpec* const spec,
-			    int* const status)
+struct SimputCacheIndex* newSimputSpecBuffer(const long capacity,
+					     const SimputCtlg* const cat,
+					     int* const status)
 {
-  struct SimputSpecBuffer** sb=(struct SimputSpecBuffer**)buffer;
-
-  // Check if this is a leaf.
-  if (NULL==*sb) {
-    *sb=newSimputSpecBuffer(status);
-    CHECK_STATUS_VOID(*status);
-    (*sb)->spectrum=spec;
-  } else if (strcmp(spec->fileref, (*sb)->spectrum->fileref) < 0){
-    insertSimputSpecBuffer((void**)&((*sb)->left), spec, status);
-    CHECK_STATUS_VOID(*status);
-  } else {
-    insertSimputSpecBuffer((void**)&((*sb)->right), spec, status);
-    CHECK_STATUS_VOID(*status);
-  }
+  struct SimputCacheIndex* ci=
+    newSimputCacheIndex(capacity, releaseSimputSpec, status);
+  CHECK_STATUS_RET(*status, ci);
+  ci->size      =sizeSimputSpec;
+  ci->sizearg   =cat;
+  ci->minentries=2;
+  return(ci);
 }
 
 
@@ -709,6 +1360,7 @@ SimputLC* newSimputLC(int* const status)
   // Initialize elements.
   lc->nentries=0;
   lc->time    =NULL;
+  lc->timestep=0.;
   lc->phase   =NULL;
   lc->flux    =NULL;
   lc->spectrum=NULL;
@@ -721,6 +1373,9 @@ SimputLC* newSimputLC(int* const status)
   lc->fluxscal=1.;
   lc->src_id  =0;
   lc->fileref =NULL;
+  lc->refid   =-1;
+  lc->ratetable=NULL;
+  lc->spectable=NULL;
 
   lc->spec_ident=NULL;
   lc->img_ident=NULL;
@@ -790,13 +1445,176 @@ void freeSimputLC(SimputLC** const lc)
 		if (NULL!=(*lc)->fileref) {
 			free((*lc)->fileref);
 		}
+		if (NULL!=(*lc)->ratetable) {
+			freeSimputLCRateTable((struct SimputLCRateTable**)&((*lc)->ratetable));
+		}
+		if (NULL!=(*lc)->spectable) {
+			freeSimputLCSpecTable((struct SimputLCSpecTable**)&((*lc)->spectable));
+		}
 		free(*lc);
 		*lc=NULL;
 	}
 }
 
 
-struct SimputLCBuffer* newSimputLCBuffer(int* const status)
+void freeSimputLCRateTable(struct SimputLCRateTable** rt)
+{
+  if (NULL!=*rt) {
+    if (NULL!=(*rt)->cumflux) {
+      free((*rt)->cumflux);
+    }
+    free(*rt);
+    *rt=NULL;
+  }
+}
+
+
+struct SimputLCSpecTable* newSimputLCSpecTable(const long nbins,
+					       int* const status)
+{
+  struct SimputLCSpecTable* st=
+    (struct SimputLCSpecTable*)malloc(sizeof(struct SimputLCSpecTable));
+  CHECK_NULL_RET(st, *status,
+		 "memory allocation for SimputLCSpecTable failed", st);
+
+  st->nbins  =nbins;
+  st->evicted=0;
+  st->ref    =(char**)malloc(nbins*sizeof(char*));
+  st->type   =(int*)malloc(nbins*sizeof(int));
+  st->spec   =(SimputSpec**)malloc(nbins*sizeof(SimputSpec*));
+  st->time   =(double*)malloc(nbins*sizeof(double));
+  st->rwidth =(double*)malloc(nbins*sizeof(double));
+  if ((NULL==st->ref) || (NULL==st->type) || (NULL==st->spec) ||
+      (NULL==st->time) || (NULL==st->rwidth)) {
+    freeSimputLCSpecTable(&st);
+    SIMPUT_ERROR("memory allocation for SimputLCSpecTable failed");
+    *status=EXIT_FAILURE;
+    return(NULL);
+  }
+
+  long ii;
+  for (ii=0; ii<nbins; ii++) {
+    st->ref[ii] =NULL;
+    st->type[ii]=EXTTYPE_NONE;
+    st->spec[ii]=NULL;
+  }
+
+  return(st);
+}
+
+
+void freeSimputLCSpecTable(struct SimputLCSpecTable** st)
+{
+  if (NULL!=*st) {
+    // The references and the spectra belong to the catalog.
+    if (NULL!=(*st)->ref) {
+      free((*st)->ref);
+    }
+    if (NULL!=(*st)->type) {
+      free((*st)->type);
+    }
+    if (NULL!=(*st)->spec) {
+      free((*st)->spec);
+    }
+    if (NULL!=(*st)->time) {
+      free((*st)->time);
+    }
+    if (NULL!=(*st)->rwidth) {
+      free((*st)->rwidth);
+    }
+    free(*st);
+    *st=NULL;
+  }
+}
+
+
+struct SimputSrcResolved* newSimputSrcResolved(int* const status)
+{
+  struct SimputSrcResolved* res=
+    (struct SimputSrcResolved*)malloc(sizeof(struct SimputSrcResolved));
+  CHECK_NULL_RET(res, *status,
+		 "memory allocation for SimputSrcResolved failed", res);
+
+  res->timetype  =EXTTYPE_NONE;
+  res->spectype  =EXTTYPE_NONE;
+  res->imagtype  =EXTTYPE_NONE;
+  res->timeref   =NULL;
+  res->specref   =NULL;
+  res->imagref   =NULL;
+  res->varrefs   =0;
+  res->lc        =NULL;
+  res->lcreleased=0;
+  res->lccursor.lc=NULL;
+  res->timephl   =NULL;
+  res->phl       =NULL;
+  res->spec      =NULL;
+  res->img       =NULL;
+  res->evicted   =0;
+  res->wcs       =NULL;
+  res->cosimgrota=1.;
+  res->sinimgrota=0.;
+
+  return(res);
+}
+
+
+void freeSimputSrcResolved(struct SimputSrcResolved** res)
+{
+  if (NULL!=*res) {
+    // The extensions are owned by the catalog buffers. Only the
+    // references have to be released.
+    if (NULL!=(*res)->timeref) {
+      free((*res)->timeref);
+    }
+    if (NULL!=(*res)->specref) {
+      free((*res)->specref);
+    }
+    if (NULL!=(*res)->imagref) {
+      free((*res)->imagref);
+    }
+    if (NULL!=(*res)->wcs) {
+      wcsfree((*res)->wcs);
+      free((*res)->wcs);
+    }
+    free(*res);
+    *res=NULL;
+  }
+}
+
+
+static void releaseSimputLC(void* obj, int* const status)
+{
+  SimputLC* lc=(SimputLC*)obj;
+  freeSimputLC(&lc);
+  (void)(*status);
+}
+
+
+static long sizeSimputLC(const void* const obj,
+			 const void* const arg)
+{
+  const SimputLC* lc=(const SimputLC*)obj;
+  (void)arg;
+  long size=(long)sizeof(SimputLC)+sizeSimputStr(lc->fileref);
+  if (NULL!=lc->time) size+=lc->nentries*(long)sizeof(double);
+  if (NULL!=lc->phase) size+=lc->nentries*(long)sizeof(double);
+  if (NULL!=lc->flux) size+=lc->nentries*(long)sizeof(float);
+  // The references to spectra and images in the individual bins are
+  // only accounted for by their pointers, since the size must be
+  // determined quickly.
+  if (NULL!=lc->spectrum) size+=lc->nentries*(long)sizeof(char*);
+  if (NULL!=lc->image) size+=lc->nentries*(long)sizeof(char*);
+  if (NULL!=lc->ratetable) size+=lc->nentries*(long)sizeof(double);
+  if (NULL!=lc->spectable) {
+    size+=lc->nentries*(long)(2*sizeof(void*)+sizeof(int)+2*sizeof(double));
+  }
+  return(size);
+}
+
+
+struct SimputLCBuffer* newSimputLCBuffer(const long capacity,
+					 const long psdcapacity,
+					 int* const status)
 {
   struct SimputLCBuffer *lcbuff=
     (struct SimputLCBuffer*)malloc(sizeof(struct SimputLCBuffer));
@@ -804,24 +1622,31 @@ struct SimputLCBuffer* newSimputLCBuffer(int* const status)
   CHECK_NULL_RET(lcbuff, *status,
 		 "memory allocation for SimputLCBuffer failed", lcbuff);
 
-  lcbuff->nlcs=0;
-  lcbuff->clc =0;
-  lcbuff->lcs =NULL;
+  lcbuff->lcs   =NULL;
+  lcbuff->psdlcs=NULL;
+
+  lcbuff->lcs=newSimputCacheIndex(capacity, releaseSimputLC, status);
+  if (EXIT_SUCCESS==*status) {
+    lcbuff->psdlcs=newSimputCacheIndex(psdcapacity, releaseSimputLC, status);
+  }
+  if (EXIT_SUCCESS!=*status) {
+    freeSimputLCBuffer(&lcbuff, status);
+    return(lcbuff);
+  }
+  lcbuff->lcs->size      =sizeSimputLC;
+  lcbuff->lcs->minentries=1;
+  lcbuff->psdlcs->size      =sizeSimputLC;
+  lcbuff->psdlcs->minentries=1;
 
   return(lcbuff);
 }
 
 
-void freeSimputLCBuffer(struct SimputLCBuffer** sb)
+void freeSimputLCBuffer(struct SimputLCBuffer** sb, int* const status)
 {
   if (NULL!=*sb) {
-    if (NULL!=(*sb)->lcs) {
-      long ii;
-      for (ii=0; ii<(*sb)->nlcs; ii++) {
-	freeSimputLC(&((*sb)->lcs[ii]));
-      }
-      free((*sb)->lcs);
-    }
+    freeSimputCacheIndex(&((*sb)->lcs), status);
+    freeSimputCacheIndex(&((*sb)->psdlcs), status);
     free(*sb);
     *sb=NULL;
   }
@@ -839,6 +1664,7 @@ SimputPSD* newSimputPSD(int* const status)
   psd->frequency=NULL;
   psd->power    =NULL;
   psd->fileref  =NULL;
+  psd->refid    =-1;
 
   return(psd);
 }
@@ -862,34 +1688,34 @@ void freeSimputPSD(SimputPSD** const psd)
 }
 
 
-struct SimputPSDBuffer* newSimputPSDBuffer(int* const status)
+static void releaseSimputPSD(void* obj, int* const status)
 {
-  struct SimputPSDBuffer *psdbuff =
-    (struct SimputPSDBuffer*)malloc(sizeof(struct SimputPSDBuffer));
-
-  CHECK_NULL_RET(psdbuff, *status,
-		 "memory allocation for SimputPSDBuffer failed", psdbuff);
+  SimputPSD* psd=(SimputPSD*)obj;
+  freeSimputPSD(&psd);
+  (void)(*status);
+}
 
-  psdbuff->npsds=0;
-  psdbuff->psds =NULL;
 
-  return(psdbuff);
+static long sizeSimputPSD(const void* const obj,
+			  const void* const arg)
+{
+  const SimputPSD* psd=(const SimputPSD*)obj;
+  (void)arg;
+  return((long)sizeof(SimputPSD)+psd->nentries*2*(long)sizeof(float)+
+	 sizeSimputStr(psd->fileref));
 }
 
 
-void freeSimputPSDBuffer(struct SimputPSDBuffer** sb)
+struct SimputCacheIndex* newSimputPSDBuffer(const long capacity,
+					    int* const status)
 {
-  if (NULL!=*sb) {
-    if (NULL!=(*sb)->psds) {
-      long ii;
-      for (ii=0; ii<(*sb)->npsds; ii++) {
-	freeSimputPSD(&((*sb)->psds[ii]));
-      }
-      free((*sb)->psds);
-    }
-    free(*sb);
-    *sb=NULL;
-  }
+  struct SimputCacheIndex* ci=
+    newSimputCacheIndex(capacity, releaseSimputPSD, status);
+  CHECK_STATUS_RET(*status, ci);
+  ci->size      =sizeSimputPSD;
+  ci->sizearg   =NULL;
+  ci->minentries=2;
+  return(ci);
 }
 
 
@@ -903,7 +1729,12 @@ SimputImg* newSimputImg(int* const status)
   img->naxis1  =0;
   img->naxis2  =0;
   img->dist    =NULL;
+  img->cdf     =NULL;
+  img->cdfx    =NULL;
+  img->aliasprob=NULL;
+  img->alias   =NULL;
   img->fileref =NULL;
+  img->refid   =-1;
   img->wcs     =NULL;
 
   return(img);
@@ -914,7 +1745,9 @@ void freeSimputImg(SimputImg** const img)
 {
   if (NULL!=*img) {
     if (NULL!=(*img)->dist) {
-      if ((*img)->naxis1>0) {
+      // The columns are released individually, unless they refer to
+      // the contiguous buffer.
+      if (((*img)->naxis1>0) && ((*img)->dist[0]!=(*img)->cdf)) {
 	long ii;
 	for (ii=0; ii<(*img)->naxis1; ii++) {
 	  if (NULL!=(*img)->dist[ii]) {
@@ -924,6 +1757,18 @@ void freeSimputImg(SimputImg** const img)
       }
       free((*img)->dist);
     }
+    if (NULL!=(*img)->cdf) {
+      free((*img)->cdf);
+    }
+    if (NULL!=(*img)->cdfx) {
+      free((*img)->cdfx);
+    }
+    if (NULL!=(*img)->aliasprob) {
+      free((*img)->aliasprob);
+    }
+    if (NULL!=(*img)->alias) {
+      free((*img)->alias);
+    }
     if (NULL!=(*img)->fileref) {
       free((*img)->fileref);
     }
@@ -936,36 +1781,248 @@ void freeSimputImg(SimputImg** const img)
 }
 
 
-struct SimputImgBuffer* newSimputImgBuffer(int* const status)
+struct SimputFFTWBuffer* newSimputFFTWBuffer(int* const status)
 {
-  struct SimputImgBuffer *imgbuff =
-    (struct SimputImgBuffer*)malloc(sizeof(struct SimputImgBuffer));
-  CHECK_NULL_RET(imgbuff, *status,
-		 "memory allocation for SimputImgBuffer failed", imgbuff);
+  struct SimputFFTWBuffer *fftwbuff=
+    (struct SimputFFTWBuffer*)malloc(sizeof(struct SimputFFTWBuffer));
+
+  CHECK_NULL_RET(fftwbuff, *status,
+		 "memory allocation for SimputFFTWBuffer failed", fftwbuff);
+
+  fftwbuff->nplans=0;
+  fftwbuff->cplan =0;
+  fftwbuff->length=NULL;
+  fftwbuff->nthreads=NULL;
+  fftwbuff->plans =NULL;
+  fftwbuff->in    =NULL;
+  fftwbuff->out   =NULL;
+  fftwbuff->wisdomfile  =NULL;
+  fftwbuff->wisdomloaded=0;
+
+  // Check whether a wisdom file is specified in the environment.
+  char* wisdomfile=getenv(SIMPUT_FFTW_WISDOM_ENVVAR);
+  if ((NULL!=wisdomfile) && (strlen(wisdomfile)>0)) {
+    fftwbuff->wisdomfile=(char*)malloc((strlen(wisdomfile)+1)*sizeof(char));
+    CHECK_NULL_RET(fftwbuff->wisdomfile, *status,
+		   "memory allocation for file name failed", fftwbuff);
+    strcpy(fftwbuff->wisdomfile, wisdomfile);
+  }
+
+  return(fftwbuff);
+}
 
-  imgbuff->nimgs=0;
-  imgbuff->imgs =NULL;
 
-  return(imgbuff);
+void freeSimputFFTWBuffer(struct SimputFFTWBuffer** fb)
+{
+  if (NULL!=*fb) {
+    long ii;
+    for (ii=0; ii<(*fb)->nplans; ii++) {
+      if ((*fb)->length[ii]<0) continue;
+      fftw_destroy_plan((*fb)->plans[ii]);
+      fftw_free((*fb)->in[ii]);
+      fftw_free((*fb)->out[ii]);
+    }
+    if (NULL!=(*fb)->length) {
+      free((*fb)->length);
+    }
+    if (NULL!=(*fb)->nthreads) {
+      free((*fb)->nthreads);
+    }
+    if (NULL!=(*fb)->plans) {
+      free((*fb)->plans);
+    }
+    if (NULL!=(*fb)->in) {
+      free((*fb)->in);
+    }
+    if (NULL!=(*fb)->out) {
+      free((*fb)->out);
+    }
+    if (NULL!=(*fb)->wisdomfile) {
+      free((*fb)->wisdomfile);
+    }
+    free(*fb);
+    *fb=NULL;
+  }
 }
 
 
-void freeSimputImgBuffer(struct SimputImgBuffer** sb)
+void freeSimputARFGrid(struct SimputARFGrid** ag)
 {
-  if (NULL!=*sb) {
-    if (NULL!=(*sb)->imgs) {
-      long ii;
-      for (ii=0; ii<(*sb)->nimgs; ii++) {
-	freeSimputImg(&((*sb)->imgs[ii]));
-      }
-      free((*sb)->imgs);
+  if (NULL!=*ag) {
+    if (NULL!=(*ag)->energy) {
+      free((*ag)->energy);
     }
-    free(*sb);
-    *sb=NULL;
+    if (NULL!=(*ag)->first) {
+      free((*ag)->first);
+    }
+    if (NULL!=(*ag)->offset) {
+      free((*ag)->offset);
+    }
+    if (NULL!=(*ag)->weight) {
+      free((*ag)->weight);
+    }
+    free(*ag);
+    *ag=NULL;
   }
 }
 
 
+struct SimputSpecDiskCache* newSimputSpecDiskCache(int* const status)
+{
+  struct SimputSpecDiskCache* sc=(struct SimputSpecDiskCache*)
+    malloc(sizeof(struct SimputSpecDiskCache));
+  CHECK_NULL_RET(sc, *status,
+		 "memory allocation for SimputSpecDiskCache failed", sc);
+
+  sc->dirname  =NULL;
+  sc->arf      =NULL;
+  sc->filename =NULL;
+  sc->map      =NULL;
+  sc->mapsize  =0;
+  sc->fd       =-1;
+  sc->failed   =0;
+  sc->records  =NULL;
+  sc->statfile[0]='\0';
+  memset(sc->statvals, 0, sizeof(sc->statvals));
+  sc->statvalid=0;
+
+  // Check whether a directory is specified in the environment.
+  char* dirname=getenv(SIMPUT_SPEC_CACHE_ENVVAR);
+  if ((NULL!=dirname) && (strlen(dirname)>0)) {
+    sc->dirname=(char*)malloc((strlen(dirname)+1)*sizeof(char));
+    CHECK_NULL_RET(sc->dirname, *status,
+		   "memory allocation for directory name failed", sc);
+    strcpy(sc->dirname, dirname);
+  }
+
+  return(sc);
+}
+
+
+void closeSimputSpecDiskCache(struct SimputSpecDiskCache* const sc,
+			      int* const status)
+{
+  if (NULL!=sc->records) {
+    freeSimputCacheIndex(&(sc->records), status);
+  }
+  if (NULL!=sc->map) {
+    munmap(sc->map, sc->mapsize);
+    sc->map=NULL;
+  }
+  sc->mapsize=0;
+  if (sc->fd>=0) {
+    close(sc->fd);
+    sc->fd=-1;
+  }
+  if (NULL!=sc->filename) {
+    free(sc->filename);
+    sc->filename=NULL;
+  }
+  sc->arf   =NULL;
+  sc->failed=0;
+  sc->statvalid=0;
+}
+
+
+void freeSimputSpecDiskCache(struct SimputSpecDiskCache** sc,
+			     int* const status)
+{
+  if (NULL!=*sc) {
+    closeSimputSpecDiskCache(*sc, status);
+    if (NULL!=(*sc)->dirname) {
+      free((*sc)->dirname);
+    }
+    free(*sc);
+    *sc=NULL;
+  }
+}
+
+
+static void releaseSimputRndStream(void* obj, int* const status)
+{
+  free(obj);
+  (void)(*status);
+}
+
+
+struct SimputSrcRndStreams* newSimputSrcRndStreams(const unsigned long long seed,
+						   int* const status)
+{
+  struct SimputSrcRndStreams* ss=
+    (struct SimputSrcRndStreams*)malloc(sizeof(struct SimputSrcRndStreams));
+  CHECK_NULL_RET(ss, *status,
+		 "memory allocation for SimputSrcRndStreams failed", ss);
+
+  ss->seed   =seed;
+  ss->current=NULL;
+  ss->streams=newSimputCacheIndex(0, releaseSimputRndStream, status);
+  if (EXIT_SUCCESS!=*status) {
+    free(ss);
+    return(NULL);
+  }
+
+  return(ss);
+}
+
+
+void freeSimputSrcRndStreams(struct SimputSrcRndStreams** ss,
+			     int* const status)
+{
+  if (NULL!=*ss) {
+    freeSimputCacheIndex(&((*ss)->streams), status);
+    free(*ss);
+    *ss=NULL;
+  }
+}
+
+
+static void releaseSimputImg(void* obj, int* const status)
+{
+  SimputImg* img=(SimputImg*)obj;
+  freeSimputImg(&img);
+  (void)(*status);
+}
+
+
+static long sizeSimputImg(const void* const obj,
+			  const void* const arg)
+{
+  const SimputImg* img=(const SimputImg*)obj;
+  (void)arg;
+  long npixels=img->naxis1*img->naxis2;
+  long size=(long)sizeof(SimputImg)+sizeSimputStr(img->fileref);
+  if (NULL!=img->dist) {
+    size+=img->naxis1*(long)sizeof(double*);
+    if ((img->naxis1>0) && (img->dist[0]!=img->cdf)) {
+      size+=npixels*(long)sizeof(double);
+    }
+  }
+  if (NULL!=img->cdf) {
+    size+=npixels*(long)sizeof(double);
+  }
+  if (NULL!=img->cdfx) {
+    size+=img->naxis1*(long)sizeof(double);
+  }
+  if (NULL!=img->alias) {
+    size+=npixels*(long)(sizeof(double)+sizeof(long));
+  }
+  return(size);
+}
+
+
+struct SimputCacheIndex* newSimputImgBuffer(const long capacity,
+					    int* const status)
+{
+  struct SimputCacheIndex* ci=
+    newSimputCacheIndex(capacity, releaseSimputImg, status);
+  CHECK_STATUS_RET(*status, ci);
+  ci->size      =sizeSimputImg;
+  ci->sizearg   =NULL;
+  ci->minentries=2;
+  return(ci);
+}
+
+
 SimputPhList* newSimputPhList(int* const status)
 {
   SimputPhList* phl=(SimputPhList*)malloc(sizeof(SimputPhList));
@@ -991,7 +2048,22 @@ SimputPhList* newSimputPhList(int* const status)
   phl->tstart  =0.;
   phl->tstop   =0.;
   phl->currrow =0;
+  phl->benergy =NULL;
+  phl->bra     =NULL;
+  phl->bdec    =NULL;
+  phl->btime   =NULL;
+  phl->buffrow =0;
+  phl->nbuffrows  =0;
+  phl->maxbuffrows=0;
+  phl->inmem   =-1;
+  phl->shared  =NULL;
+  phl->aliasprob=NULL;
+  phl->alias   =NULL;
+  phl->tsorted =-1;
+  phl->tindex  =NULL;
+  phl->ntindex =0;
   phl->fileref=NULL;
+  phl->refid  =-1;
 
   return(phl);
 }
@@ -1003,6 +2075,31 @@ void freeSimputPhList(SimputPhList** const phl, int* const status)
     if (NULL!=(*phl)->fileref) {
       free((*phl)->fileref);
     }
+    // Shared columns are released together with the photon list
+    // holding them.
+    if (NULL==(*phl)->shared) {
+      if (NULL!=(*phl)->benergy) {
+	free((*phl)->benergy);
+      }
+      if (NULL!=(*phl)->bra) {
+	free((*phl)->bra);
+      }
+      if (NULL!=(*phl)->bdec) {
+	free((*phl)->bdec);
+      }
+      if (NULL!=(*phl)->btime) {
+	free((*phl)->btime);
+      }
+      if (NULL!=(*phl)->aliasprob) {
+	free((*phl)->aliasprob);
+      }
+      if (NULL!=(*phl)->alias) {
+	free((*phl)->alias);
+      }
+    }
+    if (NULL!=(*phl)->tindex) {
+      free((*phl)->tindex);
+    }
     if (NULL!=(*phl)->fptr) {
       fits_close_file((*phl)->fptr, status);
     }
@@ -1012,33 +2109,93 @@ void freeSimputPhList(SimputPhList** const phl, int* const status)
 }
 
 
-struct SimputPhListBuffer* newSimputPhListBuffer(int* const status)
+static void releaseSimputPhList(void* obj, int* const status)
 {
-  struct SimputPhListBuffer *phlbuff =
-    (struct SimputPhListBuffer*)malloc(sizeof(struct SimputPhListBuffer));
-  CHECK_NULL_RET(phlbuff, *status,
-		 "memory allocation for SimputPhListBuffer failed", phlbuff);
+  SimputPhList* phl=(SimputPhList*)obj;
+  freeSimputPhList(&phl, status);
+}
 
-  phlbuff->nphls=0;
-  phlbuff->phls =NULL;
 
-  return(phlbuff);
+static long sizeSimputPhList(const void* const obj,
+			     const void* const arg)
+{
+  const SimputPhList* phl=(const SimputPhList*)obj;
+  (void)arg;
+  long size=(long)sizeof(SimputPhList)+sizeSimputStr(phl->fileref)+
+    phl->ntindex*(long)sizeof(double);
+  if (NULL!=phl->shared) {
+    return(size);
+  }
+  long rowsize=0;
+  if (NULL!=phl->benergy) rowsize+=sizeof(float);
+  if (NULL!=phl->bra) rowsize+=sizeof(double);
+  if (NULL!=phl->bdec) rowsize+=sizeof(double);
+  if (NULL!=phl->btime) rowsize+=sizeof(double);
+  size+=phl->maxbuffrows*rowsize;
+  if (NULL!=phl->alias) {
+    size+=phl->nphs*(long)(sizeof(double)+sizeof(long));
+  }
+  return(size);
 }
 
 
-void freeSimputPhListBuffer(struct SimputPhListBuffer** pb,
-			    int* const status)
+struct SimputCacheIndex* newSimputPhListBuffer(const long capacity,
+					       int* const status)
 {
-  if (NULL!=*pb) {
-    if (NULL!=(*pb)->phls) {
-      long ii;
-      for (ii=0; ii<(*pb)->nphls; ii++) {
-	freeSimputPhList(&((*pb)->phls[ii]), status);
-      }
-      free((*pb)->phls);
+  struct SimputCacheIndex* ci=
+    newSimputCacheIndex(capacity, releaseSimputPhList, status);
+  CHECK_STATUS_RET(*status, ci);
+  ci->size      =sizeSimputPhList;
+  ci->sizearg   =NULL;
+  ci->minentries=2;
+  return(ci);
+}
+
+
+struct SimputPhotonQueue* newSimputPhotonQueue(const long nsrcs,
+					       int* const status)
+{
+  struct SimputPhotonQueue* pq=
+    (struct SimputPhotonQueue*)malloc(sizeof(struct SimputPhotonQueue));
+  CHECK_NULL_RET(pq, *status,
+		 "memory allocation for SimputPhotonQueue failed", pq);
+
+  pq->nsrcs  =nsrcs;
+  pq->nheap  =0;
+  pq->photons=NULL;
+  pq->heap   =NULL;
+  pq->pos    =NULL;
+
+  if (nsrcs>0) {
+    pq->heap=(long*)malloc(nsrcs*sizeof(long));
+    pq->pos =(long*)malloc(nsrcs*sizeof(long));
+    if ((NULL==pq->heap) || (NULL==pq->pos)) {
+      freeSimputPhotonQueue(&pq);
+      SIMPUT_ERROR("memory allocation for SimputPhotonQueue failed");
+      *status=EXIT_FAILURE;
+      return(pq);
+    }
+    long ii;
+    for (ii=0; ii<nsrcs; ii++) {
+      pq->pos[ii]=-1;
+    }
+  }
+
+  return(pq);
+}
+
+
+void freeSimputPhotonQueue(struct SimputPhotonQueue** pq)
+{
+  if (NULL!=*pq) {
+    if (NULL!=(*pq)->heap) {
+      free((*pq)->heap);
+    }
+    if (NULL!=(*pq)->pos) {
+      free((*pq)->pos);
     }
-    free(*pb);
-    *pb=NULL;
+    free(*pq);
+    *pq=NULL;
   }
 }
 
@@ -653,6 +653,309 @@ SimputSrc* loadSimputSrc(SimputCtlg* const cat,
 }
 
 
+/** Allocate a buffer for reading a block of nrows entries from a
+    string column of the catalog. The pointers to the individual
+    strings are stored in the array strs. */
+static char* newSimputCtlgStrBuffer(SimputCtlg* const cat,
+				    const int colnum,
+				    const long nrows,
+				    char** const strs,
+				    int* const status)
+{
+  // Determine the maximum string length in the column. For
+  // variable-length columns the common string length is used.
+  int typecode;
+  long repeat=0, width=0;
+  fits_get_coltype(cat->fptr, colnum, &typecode, &repeat, &width, status);
+  if (EXIT_SUCCESS!=*status) {
+    SIMPUT_ERROR("failed determining type of string column in source catalog");
+    return(NULL);
+  }
+  long len=((typecode<0)||(repeat<=0)) ? SIMPUT_MAXSTR : repeat+1;
+
+  char* buffer=(char*)malloc(nrows*len*sizeof(char));
+  CHECK_NULL_RET(buffer, *status,
+		 "memory allocation for string buffer failed", NULL);
+  long ii;
+  for (ii=0; ii<nrows; ii++) {
+    strs[ii]=&(buffer[ii*len]);
+  }
+  return(buffer);
+}
+
+
+void loadCacheAllSimputSrc(SimputCtlg* const cat, int* const status)
+{
+  // The sources are shared with the per-thread contexts of the
+  // catalog.
+  SimputCtlg* const cf=getSimputCtlgCore(cat);
+
+  // Check if the source catalog contains a source buffer.
+  if (NULL==cf->srcbuff) {
+    cf->srcbuff=newSimputSrcBuffer(status);
+    CHECK_STATUS_VOID(*status);
+  }
+  struct SimputSrcBuffer* sb=(struct SimputSrcBuffer*)cf->srcbuff;
+
+  // Check if the sources have already been loaded.
+  if ((NULL!=sb->table) || (0==cf->nentries)) return;
+
+  // Buffers for a block of rows.
+  long* src_id=NULL;
+  double *ra=NULL, *dec=NULL;
+  float *imgrota=NULL, *imgscal=NULL, *e_min=NULL, *e_max=NULL, *flux=NULL;
+  char **src_name=NULL, **spectrum=NULL, **image=NULL, **timing=NULL;
+  char *bsrc_name=NULL, *bspectrum=NULL, *bimage=NULL, *btiming=NULL;
+
+  do { // Beginning of error handling loop.
+
+    // Determine the optimum number of rows to be read at once.
+    long blockrows=0;
+    fits_get_rowsize(cf->fptr, &blockrows, status);
+    CHECK_STATUS_BREAK(*status);
+    blockrows=MAX(MIN(blockrows, cf->nentries), 1);
+
+    // Allocate memory.
+    sb->table=(SimputSrc*)malloc(cf->nentries*sizeof(SimputSrc));
+    CHECK_NULL_BREAK(sb->table, *status,
+		     "memory allocation for source table failed");
+
+    src_id  =(long*)malloc(blockrows*sizeof(long));
+    ra      =(double*)malloc(blockrows*sizeof(double));
+    dec     =(double*)malloc(blockrows*sizeof(double));
+    imgrota =(float*)malloc(blockrows*sizeof(float));
+    imgscal =(float*)malloc(blockrows*sizeof(float));
+    e_min   =(float*)malloc(blockrows*sizeof(float));
+    e_max   =(float*)malloc(blockrows*sizeof(float));
+    flux    =(float*)malloc(blockrows*sizeof(float));
+    src_name=(char**)malloc(blockrows*sizeof(char*));
+    spectrum=(char**)malloc(blockrows*sizeof(char*));
+    image   =(char**)malloc(blockrows*sizeof(char*));
+    timing  =(char**)malloc(blockrows*sizeof(char*));
+    if ((NULL==src_id) || (NULL==ra) || (NULL==dec) || (NULL==imgrota) ||
+	(NULL==imgscal) || (NULL==e_min) || (NULL==e_max) || (NULL==flux) ||
+	(NULL==src_name) || (NULL==spectrum) || (NULL==image) ||
+	(NULL==timing)) {
+      SIMPUT_ERROR("memory allocation for source buffers failed");
+      *status=EXIT_FAILURE;
+      break;
+    }
+
+    if (cf->csrc_name>0) {
+      bsrc_name=newSimputCtlgStrBuffer(cf, cf->csrc_name, blockrows,
+				       src_name, status);
+      CHECK_STATUS_BREAK(*status);
+    }
+    bspectrum=newSimputCtlgStrBuffer(cf, cf->cspectrum, blockrows,
+				     spectrum, status);
+    CHECK_STATUS_BREAK(*status);
+    if (cf->cimage>0) {
+      bimage=newSimputCtlgStrBuffer(cf, cf->cimage, blockrows,
+				    image, status);
+      CHECK_STATUS_BREAK(*status);
+    }
+    if (cf->ctiming>0) {
+      btiming=newSimputCtlgStrBuffer(cf, cf->ctiming, blockrows,
+				     timing, status);
+      CHECK_STATUS_BREAK(*status);
+    }
+
+    // Empty string for optional columns, which are not present.
+    char* empty=internSimputCtlgRef(cf, "", status);
+    CHECK_STATUS_BREAK(*status);
+
+    // Read the catalog block by block.
+    long firstrow;
+    for (firstrow=1; firstrow<=cf->nentries; firstrow+=blockrows) {
+      long nrows=MIN(blockrows, cf->nentries-firstrow+1);
+      int anynul=0;
+
+      fits_read_col(cf->fptr, TLONG, cf->csrc_id, firstrow, 1, nrows,
+		    NULL, src_id, &anynul, status);
+      if (EXIT_SUCCESS!=*status) {
+	SIMPUT_ERROR("failed reading source ID from source catalog");
+	break;
+      }
+      if (cf->csrc_name>0) {
+	fits_read_col_str(cf->fptr, cf->csrc_name, firstrow, 1, nrows, "",
+			  src_name, &anynul, status);
+	if (EXIT_SUCCESS!=*status) {
+	  SIMPUT_ERROR("failed reading source name from source catalog");
+	  break;
+	}
+      }
+      fits_read_col(cf->fptr, TDOUBLE, cf->cra, firstrow, 1, nrows,
+		    NULL, ra, &anynul, status);
+      if (EXIT_SUCCESS!=*status) {
+	SIMPUT_ERROR("failed reading right ascension from source catalog");
+	break;
+      }
+      fits_read_col(cf->fptr, TDOUBLE, cf->cdec, firstrow, 1, nrows,
+		    NULL, dec, &anynul, status);
+      if (EXIT_SUCCESS!=*status) {
+	SIMPUT_ERROR("failed reading declination from source catalog");
+	break;
+      }
+      if (cf->cimgrota>0) {
+	fits_read_col(cf->fptr, TFLOAT, cf->cimgrota, firstrow, 1, nrows,
+		      NULL, imgrota, &anynul, status);
+	if (EXIT_SUCCESS!=*status) {
+	  SIMPUT_ERROR("failed reading image rotation angle from source catalog");
+	  break;
+	}
+      }
+      if (cf->cimgscal>0) {
+	fits_read_col(cf->fptr, TFLOAT, cf->cimgscal, firstrow, 1, nrows,
+		      NULL, imgscal, &anynul, status);
+	if (EXIT_SUCCESS!=*status) {
+	  SIMPUT_ERROR("failed reading image scaling from source catalog");
+	  break;
+	}
+      }
+      fits_read_col(cf->fptr, TFLOAT, cf->ce_min, firstrow, 1, nrows,
+		    NULL, e_min, &anynul, status);
+      if (EXIT_SUCCESS!=*status) {
+	SIMPUT_ERROR("failed reading 'E_MIN' from source catalog");
+	break;
+      }
+      fits_read_col(cf->fptr, TFLOAT, cf->ce_max, firstrow, 1, nrows,
+		    NULL, e_max, &anynul, status);
+      if (EXIT_SUCCESS!=*status) {
+	SIMPUT_ERROR("failed reading 'E_MAX' from source catalog");
+	break;
+      }
+      fits_read_col(cf->fptr, TFLOAT, cf->cflux, firstrow, 1, nrows,
+		    NULL, flux, &anynul, status);
+      if (EXIT_SUCCESS!=*status) {
+	SIMPUT_ERROR("failed reading reference flux from source catalog");
+	break;
+      }
+      fits_read_col_str(cf->fptr, cf->cspectrum, firstrow, 1, nrows, "",
+			spectrum, &anynul, status);
+      if (EXIT_SUCCESS!=*status) {
+	SIMPUT_ERROR("failed reading spectrum reference from source catalog");
+	break;
+      }
+      if (cf->cimage>0) {
+	fits_read_col_str(cf->fptr, cf->cimage, firstrow, 1, nrows, "",
+			  image, &anynul, status);
+	if (EXIT_SUCCESS!=*status) {
+	  SIMPUT_ERROR("failed reading image reference from source catalog");
+	  break;
+	}
+      }
+      if (cf->ctiming>0) {
+	fits_read_col_str(cf->fptr, cf->ctiming, firstrow, 1, nrows, "",
+			  timing, &anynul, status);
+	if (EXIT_SUCCESS!=*status) {
+	  SIMPUT_ERROR("failed reading timing reference from source catalog");
+	  break;
+	}
+      }
+
+      // Fill the entries of the source table. The values are checked
+      // in the same way as in loadSimputSrc.
+      long ii;
+      for (ii=0; ii<nrows; ii++) {
+	SimputSrc* src=&(sb->table[firstrow-1+ii]);
+	src->phrate      =NULL;
+	src->spec_ident  =NULL;
+	src->img_ident   =NULL;
+	src->timing_ident=NULL;
+	src->resolved    =NULL;
+	sb->ntable++;
+
+	if (src_id[ii]<0) {
+	  char msg[SIMPUT_MAXSTR];
+	  sprintf(msg, "SRC_ID (%ld) must have a positive value", src_id[ii]);
+	  SIMPUT_ERROR(msg);
+	  *status=EXIT_FAILURE;
+	  break;
+	}
+	src->src_id =src_id[ii];
+	src->ra     =ra[ii]*cf->fra; // Convert to [rad].
+	src->dec    =dec[ii]*cf->fdec; // Convert to [rad].
+	src->imgrota=(cf->cimgrota>0) ? imgrota[ii]*cf->fimgrota : 0.;
+	src->imgscal=(cf->cimgscal>0) ? imgscal[ii] : 1.;
+	src->e_min  =e_min[ii]*cf->fe_min; // Convert to [keV].
+	src->e_max  =e_max[ii]*cf->fe_max; // Convert to [keV].
+	src->eflux  =flux[ii]*cf->fflux; // Convert to [erg/s/cm**2].
+	if (src->eflux > 1.e20) {
+	  char msg[SIMPUT_MAXSTR];
+	  sprintf(msg, "flux (%e erg/s/cm**2) exceeds maximum value, "
+		  "therefore reset to 0", src->eflux);
+	  SIMPUT_WARNING(msg);
+	  src->eflux=0.;
+	}
+
+	if (cf->csrc_name>0) {
+	  src->src_name=internSimputCtlgRef(cf, src_name[ii], status);
+	} else {
+	  src->src_name=empty;
+	}
+	src->spectrum=internSimputCtlgRef(cf, spectrum[ii], status);
+	if (cf->cimage>0) {
+	  src->image=internSimputCtlgRef(cf, image[ii], status);
+	} else {
+	  src->image=empty;
+	}
+	if (cf->ctiming>0) {
+	  src->timing=internSimputCtlgRef(cf, timing[ii], status);
+	} else {
+	  src->timing=empty;
+	}
+	CHECK_STATUS_BREAK(*status);
+
+	// Check if imgscal value is valid (only if an image was specified).
+	if ((cf->cimage>0) && (strncmp(src->image, "NULL", 4) != 0)) {
+	  if (src->imgscal == 0) {
+	    char buffer[512];
+	    sprintf(buffer, "IMGSCAL of source %ld in %s must be non-zero",
+		    src->src_id, cf->filename);
+	    SIMPUT_ERROR(buffer);
+	    *status=EXIT_FAILURE;
+	    break;
+	  }
+	  if (src->imgscal < 1.e-8) {
+	    char buffer[512];
+	    sprintf(buffer, "IMGSCAL value of source %ld in %s is very small "
+		    "(IMGSCAL = %e)", src->src_id, cf->filename, src->imgscal);
+	    SIMPUT_WARNING(buffer);
+	  }
+	}
+      }
+      CHECK_STATUS_BREAK(*status);
+    }
+
+  } while(0); // END of error handling loop.
+
+  // Release memory.
+  if (NULL!=src_id)    free(src_id);
+  if (NULL!=ra)        free(ra);
+  if (NULL!=dec)       free(dec);
+  if (NULL!=imgrota)   free(imgrota);
+  if (NULL!=imgscal)   free(imgscal);
+  if (NULL!=e_min)     free(e_min);
+  if (NULL!=e_max)     free(e_max);
+  if (NULL!=flux)      free(flux);
+  if (NULL!=src_name)  free(src_name);
+  if (NULL!=spectrum)  free(spectrum);
+  if (NULL!=image)     free(image);
+  if (NULL!=timing)    free(timing);
+  if (NULL!=bsrc_name) free(bsrc_name);
+  if (NULL!=bspectrum) free(bspectrum);
+  if (NULL!=bimage)    free(bimage);
+  if (NULL!=btiming)   free(btiming);
+
+  // In case of an error, the incomplete table is discarded.
+  if ((EXIT_SUCCESS!=*status) && (NULL!=sb->table)) {
+    free(sb->table);
+    sb->table =NULL;
+    sb->ntable=0;
+  }
+}
+
+
 void appendSimputSrc(SimputCtlg* const cat,
 		     SimputSrc* const src,
 		     int* const status)
@@ -1239,7 +1542,8 @@ void loadCacheAllSimputMIdpSpec(SimputCtlg* const cat,
 {
   fitsfile* fptr=NULL;
   char* name[1]={NULL};
-  SimputMIdpSpec** sb=NULL; // Buffer for reading in the spectra.
+  float* energy=NULL;
+  struct SimputMIdpSpecMatrix* sm=NULL;
   long nrows;
 
   do { // Error handling loop.
@@ -1283,10 +1587,12 @@ void loadCacheAllSimputMIdpSpec(SimputCtlg* const cat,
       break;
     }
 
-    // Allocate memory for buffering the spectra
-    sb=(SimputMIdpSpec**)malloc(nrows*sizeof(SimputMIdpSpec*));
-    CHECK_NULL_BREAK(sb, *status,
-		     "memory allocation for buffer of spectra failed");
+    // Create the buffer for the spectra.
+    cat->midpspecbuff=
+      newSimputMIdpSpecBuffer(cat->cachecap[EXTTYPE_MIDPSPEC], status);
+    CHECK_STATUS_BREAK(*status);
+    manageSimputCtlgCache(cat, cat->midpspecbuff, status);
+    CHECK_STATUS_BREAK(*status);
 
     // Determine the column numbers.
     int cenergy=0, cfluxdensity=0, cname=0;
@@ -1389,6 +1695,15 @@ void loadCacheAllSimputMIdpSpec(SimputCtlg* const cat,
     CHECK_NULL_BREAK(name[0], *status,
 		     "memory allocation for string buffer failed");
 
+    // The flux densities are stored in a common matrix. Usually all
+    // spectra in the table are defined on the same energy grid,
+    // which is therefore stored only once.
+    sm=newSimputMIdpSpecMatrix(nrows, nenergy, status);
+    CHECK_STATUS_BREAK(*status);
+    energy=(float*)malloc((nenergy+1)*sizeof(float));
+    CHECK_NULL_BREAK(energy, *status,
+		     "memory allocation for energy grid failed");
+
     // Load the spectra.
     char msg[SIMPUT_MAXSTR];
     sprintf(msg, "load %ld spectra with %ld data points each",
@@ -1397,24 +1712,16 @@ void loadCacheAllSimputMIdpSpec(SimputCtlg* const cat,
 
     long jj;
     for (jj=0; jj<nrows; jj++) {
-      // Allocate memory for a new spectrum.
+      // Allocate memory for a new spectrum referring to the
+      // matrix.
       SimputMIdpSpec* spec=newSimputMIdpSpec(status);
       CHECK_STATUS_BREAK(*status);
-
-      spec->nentries=nenergy;
-
-      // Allocate memory for the arrays.
-      spec->energy=(float*)malloc(spec->nentries*sizeof(float));
-      CHECK_NULL_BREAK(spec->energy, *status,
-		       "memory allocation for spectrum failed");
-      spec->fluxdensity=(float*)malloc(spec->nentries*sizeof(float));
-      CHECK_NULL_BREAK(spec->fluxdensity, *status,
-		       "memory allocation for spectrum failed");
+      setSimputMIdpSpecMatrixRow(spec, sm, jj);
 
       // Read the data from the table.
       int anynul=0;
       fits_read_col(fptr, TFLOAT, cenergy, jj+1, 1, spec->nentries,
-		    NULL, spec->energy, &anynul, status);
+		    NULL, energy, &anynul, status);
       if (EXIT_SUCCESS!=*status) {
 	SIMPUT_ERROR("failed reading energy values from spectrum");
 	break;
@@ -1441,10 +1748,21 @@ void loadCacheAllSimputMIdpSpec(SimputCtlg* const cat,
       // Multiply with unit scaling factor.
       long ii;
       for (ii=0; ii<spec->nentries; ii++) {
-	spec->energy[ii]*=fenergy;
+	energy[ii]*=fenergy;
 	spec->fluxdensity[ii]*=ffluxdensity;
       }
 
+      // The energy grid of the first spectrum is used as common
+      // grid. Spectra with a different grid obtain an own copy.
+      if (0==jj) {
+	memcpy(sm->energy, energy, nenergy*sizeof(float));
+      } else if (0!=memcmp(sm->energy, energy, nenergy*sizeof(float))) {
+	spec->energy=(float*)malloc((nenergy+1)*sizeof(float));
+	CHECK_NULL_BREAK(spec->energy, *status,
+			 "memory allocation for spectrum failed");
+	memcpy(spec->energy, energy, nenergy*sizeof(float));
+      }
+
       // Copy the name (ID) of the spectrum from the string buffer
       // to the data structure.
       spec->name=(char*)malloc((strlen(name[0])+1)*sizeof(char));
@@ -1458,26 +1776,31 @@ void loadCacheAllSimputMIdpSpec(SimputCtlg* const cat,
       CHECK_NULL_BREAK(spec->fileref, *status,
 		       "memory allocation for file reference failed");
       sprintf(spec->fileref, "%s[NAME=='%s']", filename, name[0]);
+      spec->refid=getSimputCtlgRefId(cat, spec->fileref, status);
+      CHECK_STATUS_BREAK(*status);
 
-      // Add the spectrum to the buffer.
-      sb[jj]=spec;
+      // Add the spectrum to the buffer of the SimputCtlg data
+      // structure, unless the table contains it more than once.
+      if (NULL!=searchSimputCacheIndex(cat->midpspecbuff, spec->refid)) {
+	freeSimputMIdpSpec(&spec);
+	continue;
+      }
+      insertSimputCacheIndex(cat->midpspecbuff, spec->refid, spec,
+			     !isSimputCtlgShared(cat), status);
+      CHECK_STATUS_BREAK(*status);
     }
     CHECK_STATUS_BREAK(*status);
     // END of reading all spectra.
 
-    // Insert the spectra into the binary tree buffer of the
-    // SimputCtlg data structure.
-    buildSimputMIdpSpecBuffer(&(cat->midpspecbuff), sb, nrows, 0, status);
-    CHECK_STATUS_BREAK(*status);
-
   } while(0); // END of error handling loop.
 
   // Release allocated memory.
   if (NULL!=name[0]) free(name[0]);
-  if (NULL!=sb) free(sb);
+  if (NULL!=energy) free(energy);
   // Note: Do NOT release the memory of the individual spectra contained
-  // in the buffer! They are now part of the catalog-internal binary tree
-  // buffer.
+  // in the buffer! They are now part of the catalog-internal buffer.
+  // The matrix is released together with the last of them.
+  releaseSimputMIdpSpecMatrix(&sm);
 
   // Close the file.
   if (NULL!=fptr) fits_close_file(fptr, status);
@@ -2301,6 +2624,19 @@ SimputLC* loadSimputLC(const char* const filename, int* const status)
       for (row=0; row<nfitsentries; row++) {
         lc->time[row]*=ftime;
       }
+
+      // Check if the time values form a uniform grid.
+      if (lc->nentries>1) {
+	double step=(lc->time[lc->nentries-1]-lc->time[0])/(lc->nentries-1);
+	if (step>0.) {
+	  for (row=1; row<lc->nentries; row++) {
+	    if (fabs(lc->time[row]-(lc->time[0]+row*step))>1.e-6*step) break;
+	  }
+	  if (row>=lc->nentries) {
+	    lc->timestep=step;
+	  }
+	}
+      }
     }
 
     // PHASE
@@ -2467,6 +2803,9 @@ void saveSimputLC(SimputLC* const lc, const char* const filename,
   char* spectrum[1]={NULL};
   char* image[1]={NULL};
 
+  // Time values of a light curve with a uniform time grid.
+  double* gridtime=NULL;
+
   int ncolumns=0;
   char **ttype=NULL;
   char **tform=NULL;
@@ -2475,13 +2814,14 @@ void saveSimputLC(SimputLC* const lc, const char* const filename,
   do { // Error handling loop.
 
     // Check if the given light curve either contains a time
-    // or a phase column, but not both.
-    if ((NULL==lc->time) && (NULL==lc->phase)) {
+    // or a phase column, but not both. The time values may also be
+    // given by a uniform grid.
+    if ((NULL==lc->time) && (0.==lc->timestep) && (NULL==lc->phase)) {
       SIMPUT_ERROR("light curve does not contain TIME or PHASE column");
       *status=EXIT_FAILURE;
       break;
     }
-    if ((NULL!=lc->time) && (NULL!=lc->phase)) {
+    if (((NULL!=lc->time) || (0.!=lc->timestep)) && (NULL!=lc->phase)) {
       SIMPUT_ERROR("light curve contains both TIME and PHASE column");
       *status=EXIT_FAILURE;
       break;
@@ -2582,7 +2922,7 @@ void saveSimputLC(SimputLC* const lc, const char* const filename,
 
     // Set up the table format.
     int ctime=0, cphase=0, cflux=0, cspectrum=0, cimage=0;
-    if (NULL!=lc->time) {
+    if (NULL==lc->phase) {
       ctime=1;
       strcpy(ttype[0], "TIME");
       strcpy(tform[0], "D");
@@ -2657,8 +2997,19 @@ void saveSimputLC(SimputLC* const lc, const char* const filename,
     }
 
     if (ctime>0) {
+      // Light curves with a uniform time grid may not contain the
+      // time array.
+      if (NULL==lc->time) {
+	gridtime=(double*)malloc(lc->nentries*sizeof(double));
+	CHECK_NULL_BREAK(gridtime, *status,
+			 "memory allocation for time values failed");
+	long row;
+	for (row=0; row<lc->nentries; row++) {
+	  gridtime[row]=row*lc->timestep;
+	}
+      }
       fits_write_col(fptr, TDOUBLE, ctime, 1, 1, lc->nentries,
-		     lc->time, status);
+		     (NULL!=lc->time) ? lc->time : gridtime, status);
       if (EXIT_SUCCESS!=*status) {
 	SIMPUT_ERROR("failed writing time values to light curve");
 	break;
@@ -2715,6 +3066,9 @@ void saveSimputLC(SimputLC* const lc, const char* const filename,
     free(image[0]);
     image[0]=NULL;
   }
+  if (NULL!=gridtime) {
+    free(gridtime);
+  }
 
   if (NULL!=ttype) {
     int ii;
@@ -3137,17 +3491,18 @@ SimputImg* loadSimputImg(const char* const filename, int* const status)
     img->naxis1=naxes[0];
     img->naxis2=naxes[1];
 
-    // Allocate memory for the image.
+    // Allocate memory for the image. The columns refer to a
+    // contiguous buffer.
+    img->cdf=(double*)malloc(img->naxis1*img->naxis2*sizeof(double));
+    CHECK_NULL_BREAK(img->cdf, *status,
+		     "memory allocation for source image failed");
     img->dist=(double**)malloc(img->naxis1*sizeof(double*));
     CHECK_NULL_BREAK(img->dist, *status,
 		     "memory allocation for source image failed");
     long ii;
     for (ii=0; ii<img->naxis1; ii++) {
-      img->dist[ii] = (double*)malloc(img->naxis2*sizeof(double));
-      CHECK_NULL_BREAK(img->dist[ii], *status,
-		       "memory allocation for source image failed");
+      img->dist[ii]=&(img->cdf[ii*img->naxis2]);
     }
-    CHECK_STATUS_BREAK(*status);
 
     // Allocate memory for the image input buffer.
     image1d=(double*)malloc(img->naxis1*img->naxis2*sizeof(double));
@@ -3568,9 +3923,11 @@ SimputPhList* openSimputPhList(const char* const filename,
 }
 
 
-int getSimputExtType(SimputCtlg* const cat,
-		     const char* const filename,
-		     int* const status)
+/** Determine the extension type of a FITS file HDU without locking
+    the buffers of the catalog. */
+static int getSimputExtTypeUnlocked(SimputCtlg* const cat,
+				    const char* const filename,
+				    int* const status)
 {
   // Check if there is any reference at all.
   if (0==strlen(filename)) {
@@ -3594,7 +3951,9 @@ int getSimputExtType(SimputCtlg* const cat,
   // continuous re-opening.
 
   // Search if the required extension is available in the storage.
-  int type=searchSimputExttypeBuffer(cat->extbuff, fileref);
+  long refid=getSimputCtlgRefId(cat, fileref, status);
+  CHECK_STATUS_RET(*status, EXTTYPE_NONE);
+  int type=(int)(intptr_t)searchSimputCacheIndex(cat->extbuff, refid);
   if (EXTTYPE_NONE!=type) {
     return(type);
   }
@@ -3717,13 +4076,31 @@ int getSimputExtType(SimputCtlg* const cat,
   }
 
   // Store the extension type in the internal cache.
-  insertSimputExttypeBuffer(&(cat->extbuff), fileref, type, status);
+  if (NULL==cat->extbuff) {
+    cat->extbuff=newSimputExttypeBuffer(status);
+    CHECK_STATUS_RET(*status, EXTTYPE_NONE);
+  }
+  insertSimputCacheIndex(cat->extbuff, refid, (void*)(intptr_t)type, 0,
+			 status);
   CHECK_STATUS_RET(*status, EXTTYPE_NONE);
 
   return(type);
 }
 
 
+int getSimputExtType(SimputCtlg* const cat,
+		     const char* const filename,
+		     int* const status)
+{
+  // The cache of extension types is shared with the per-thread
+  // contexts of the catalog.
+  lockSimputCtlg(cat);
+  int type=getSimputExtTypeUnlocked(getSimputCtlgCore(cat), filename, status);
+  unlockSimputCtlg(cat);
+  return(type);
+}
+
+
 
 void read_isisSpec_fits_file(char *fname, SimputMIdpSpec* simputspec,
 		char *ISISFile, float Emin, float Emax,
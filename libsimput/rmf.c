@@ -456,7 +456,13 @@ static void ReturnChannelSixte(struct RMF *rmf, float energy, int NumberPhoton,
 
   int status = EXIT_SUCCESS;
   RandomNumber = (float *) malloc(NumberPhoton*sizeof(float));
-  for (i=0; i<NumberPhoton; i++) RandomNumber[i] = (float) getRndNum(&status);
+  for (i=0; i<NumberPhoton; i+=SIMPUT_RND_BLOCKSIZE) {
+    double rnd[SIMPUT_RND_BLOCKSIZE];
+    int nblock=MIN(SIMPUT_RND_BLOCKSIZE, NumberPhoton-i);
+    getRndNumBlock(rnd, nblock, &status);
+    if (EXIT_SUCCESS!=status) break;
+    for (j=0; j<nblock; j++) RandomNumber[i+j] = (float) rnd[j];
+  }
 
   CHECK_STATUS_VOID(status);
 
@@ -513,6 +519,186 @@ void returnRMFChannel(struct RMF *rmf,
 }
 
 
+struct CumulRMF* getCumulRMF(const struct RMF* const rmf,
+			     int* const status)
+{
+  struct CumulRMF* cumul=(struct CumulRMF*)malloc(sizeof(struct CumulRMF));
+  CHECK_NULL_RET(cumul, *status,
+		 "memory allocation for cumulative RMF failed", cumul);
+
+  // Initialize.
+  cumul->rmf               =rmf;
+  cumul->FirstSpanChannel  =NULL;
+  cumul->NumberSpanChannels=NULL;
+  cumul->FirstSpanElement  =NULL;
+  cumul->Cumul             =NULL;
+
+  do { // Error handling loop.
+
+    long nbins=rmf->NumberEnergyBins;
+    cumul->FirstSpanChannel=(long*)malloc(nbins*sizeof(long));
+    CHECK_NULL_BREAK(cumul->FirstSpanChannel, *status,
+		     "memory allocation for cumulative RMF failed");
+    cumul->NumberSpanChannels=(long*)malloc(nbins*sizeof(long));
+    CHECK_NULL_BREAK(cumul->NumberSpanChannels, *status,
+		     "memory allocation for cumulative RMF failed");
+    cumul->FirstSpanElement=(long*)malloc(nbins*sizeof(long));
+    CHECK_NULL_BREAK(cumul->FirstSpanElement, *status,
+		     "memory allocation for cumulative RMF failed");
+
+    // Determine the span of channels covered by the response groups
+    // of each energy bin.
+    long ii, jj, kk, nelements=0;
+    for (ii=0; ii<nbins; ii++) {
+      long first=rmf->NumberChannels, last=-1;
+      for (jj=0; jj<rmf->NumberGroups[ii]; jj++) {
+	long igrp=jj+rmf->FirstGroup[ii];
+	if (rmf->NumberChannelGroups[igrp]<=0) continue;
+	long ichan=rmf->FirstChannelGroup[igrp]-rmf->FirstChannel;
+	first=MIN(first, ichan);
+	last =MAX(last, ichan+rmf->NumberChannelGroups[igrp]-1);
+      }
+      if (last<first) {
+	first=0;
+	last =-1;
+      }
+      cumul->FirstSpanChannel[ii]  =first;
+      cumul->NumberSpanChannels[ii]=last-first+1;
+      cumul->FirstSpanElement[ii]  =nelements;
+      nelements+=cumul->NumberSpanChannels[ii];
+    }
+
+    cumul->Cumul=(float*)malloc(MAX(nelements, 1)*sizeof(float));
+    CHECK_NULL_BREAK(cumul->Cumul, *status,
+		     "memory allocation for cumulative RMF failed");
+
+    // Expand the response groups and integrate the response within
+    // each span.
+    for (ii=0; ii<nbins; ii++) {
+      float* span=&(cumul->Cumul[cumul->FirstSpanElement[ii]]);
+      for (kk=0; kk<cumul->NumberSpanChannels[ii]; kk++) {
+	span[kk]=0.;
+      }
+      for (jj=0; jj<rmf->NumberGroups[ii]; jj++) {
+	long igrp=jj+rmf->FirstGroup[ii];
+	for (kk=0; kk<rmf->NumberChannelGroups[igrp]; kk++) {
+	  long ichan=kk+rmf->FirstChannelGroup[igrp]-rmf->FirstChannel;
+	  span[ichan-cumul->FirstSpanChannel[ii]]=
+	    rmf->Matrix[kk+rmf->FirstElement[igrp]];
+	}
+      }
+      for (kk=1; kk<cumul->NumberSpanChannels[ii]; kk++) {
+	span[kk]+=span[kk-1];
+      }
+    }
+
+  } while(0); // END of error handling loop.
+
+  if (EXIT_SUCCESS!=*status) {
+    freeCumulRMF(&cumul);
+  }
+
+  return(cumul);
+}
+
+
+void freeCumulRMF(struct CumulRMF** const cumul)
+{
+  if (NULL!=*cumul) {
+    if (NULL!=(*cumul)->FirstSpanChannel) {
+      free((*cumul)->FirstSpanChannel);
+    }
+    if (NULL!=(*cumul)->NumberSpanChannels) {
+      free((*cumul)->NumberSpanChannels);
+    }
+    if (NULL!=(*cumul)->FirstSpanElement) {
+      free((*cumul)->FirstSpanElement);
+    }
+    if (NULL!=(*cumul)->Cumul) {
+      free((*cumul)->Cumul);
+    }
+    free(*cumul);
+    *cumul=NULL;
+  }
+}
+
+
+/** Return the energy bin of the RMF containing the specified energy
+    or -1, if the energy is outside the range of the response. The
+    search is the same as in ReturnChannelSixte. */
+static long getRMFEnergyBin(const struct RMF* const rmf, const float energy)
+{
+  long upper=rmf->NumberEnergyBins-1, lower=0, middle;
+
+  if ((energy<rmf->LowEnergy[lower]) || (energy>rmf->HighEnergy[upper])) {
+    return(-1);
+  }
+
+  while (upper-lower>1) {
+    middle=(upper+lower)/2;
+    if (energy<rmf->HighEnergy[middle]) {
+      upper=middle;
+    } else {
+      lower=middle;
+    }
+  }
+  if (energy>rmf->HighEnergy[lower]) {
+    return(upper);
+  } else {
+    return(lower);
+  }
+}
+
+
+void returnCumulRMFChannel(const struct CumulRMF* const cumul,
+			   const float energy,
+			   long* const channel)
+{
+  *channel=-1;
+
+  long energybin=getRMFEnergyBin(cumul->rmf, energy);
+  if (energybin<0) return;
+
+  long nspan=cumul->NumberSpanChannels[energybin];
+  if (0==nspan) return;
+  const float* span=&(cumul->Cumul[cumul->FirstSpanElement[energybin]]);
+
+  int status=EXIT_SUCCESS;
+  float rnd=(float)getRndNum(&status);
+  CHECK_STATUS_VOID(status);
+
+  // If the random number exceeds the total response, the event
+  // fell off the end of the channel array.
+  if (rnd>span[nspan-1]) return;
+
+  // Find the first channel in the span, up to which the integrated
+  // response reaches the random number.
+  long lower=0, upper=nspan-1, middle;
+  while (upper>lower) {
+    middle=(lower+upper)/2;
+    if (span[middle]<rnd) {
+      lower=middle+1;
+    } else {
+      upper=middle;
+    }
+  }
+
+  *channel=lower+cumul->FirstSpanChannel[energybin]+cumul->rmf->FirstChannel;
+}
+
+
+void returnCumulRMFChannels(const struct CumulRMF* const cumul,
+			    const float* const energy,
+			    const long nphotons,
+			    long* const channel)
+{
+  long ii;
+  for (ii=0; ii<nphotons; ii++) {
+    returnCumulRMFChannel(cumul, energy[ii], &(channel[ii]));
+  }
+}
+
+
 
 
 void loadEbounds(struct RMF* rmf, char* const filename, int* const status)
@@ -37,6 +37,32 @@
 /////////////////////////////////////////////////////////////////
 
 
+/** Pre-computed cumulative response of an RMF, which allows to draw
+    channels without expanding the response groups for each
+    photon. For each energy bin only the span of channels between the
+    first and the last channel with non-zero response is stored. */
+struct CumulRMF {
+  /** RMF the cumulative response has been determined from. It
+      provides the energy grid and must not be released before this
+      data structure. */
+  const struct RMF* rmf;
+
+  /** First channel of the span for each energy bin (counts from 0). */
+  long* FirstSpanChannel; /*NumberEnergyBins*/
+
+  /** Number of channels in the span for each energy bin. */
+  long* NumberSpanChannels; /*NumberEnergyBins*/
+
+  /** First element of the span for each energy bin in the array of
+      cumulative response values (counts from 0). */
+  long* FirstSpanElement; /*NumberEnergyBins*/
+
+  /** Response integrated up to and including the respective channel
+      in the span. */
+  float* Cumul;
+};
+
+
 /////////////////////////////////////////////////////////////////
 // Function Declarations.
 /////////////////////////////////////////////////////////////////
@@ -75,6 +101,31 @@ void returnRMFChannel(struct RMF *rmf,
 		      const float energy,
 		      long* const channel);
 
+/** Determine the cumulative response of an RMF for a fast random
+    selection of channels. The RMF must not be released before the
+    returned data structure. */
+struct CumulRMF* getCumulRMF(const struct RMF* const rmf,
+			     int* const status);
+
+/** Destructor for the CumulRMF data structure. The underlying RMF is
+    not released. */
+void freeCumulRMF(struct CumulRMF** const cumul);
+
+/** Same as returnRMFChannel, but using the pre-computed cumulative
+    response. The channel is found by a binary search within the span
+    of channels with non-zero response, without any memory
+    allocation. */
+void returnCumulRMFChannel(const struct CumulRMF* const cumul,
+			   const float energy,
+			   long* const channel);
+
+/** Randomly select channels for nphotons photons with the given input
+    energies using the pre-computed cumulative response. */
+void returnCumulRMFChannels(const struct CumulRMF* const cumul,
+			    const float* const energy,
+			    const long nphotons,
+			    long* const channel);
+
 /** Load the EBOUNDS extension from an RMF or RSP file. */
 void loadEbounds(struct RMF* rmf, char* const filename, int* const status);
 
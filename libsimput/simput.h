@@ -49,6 +49,10 @@
 #define SIMPUT_LC_TYPE (2)
 #define SIMPUT_PSD_TYPE (3)
 
+/** Methods to draw photon energies from a spectral distribution. */
+#define SIMPUT_SAMPLING_CDF (0)
+#define SIMPUT_SAMPLING_ALIAS (1)
+
 
 /////////////////////////////////////////////////////////////////
 // Type Declarations.
@@ -112,6 +116,11 @@ typedef struct {
   char* timing;
   uniqueSimputident* timing_ident;
 
+  /** Buffer for the resolved references to the timing, spectrum, and
+      image extensions of the source. It is filled on first use. This
+      pointer should not be modified directly. */
+  void* resolved;
+
 } SimputSrc;
 
 
@@ -162,18 +171,123 @@ typedef struct {
   /** Buffer for pre-loaded power spectra. */
   void* psdbuff;
 
+  /** Cache for FFTW plans. */
+  void* fftwbuff;
+
   /** Buffer for pre-loaded images. */
   void* imgbuff;
 
   /** Buffer for pre-loaded spectra. */
   void* specbuff;
 
+  /** Weights for the convolution of mission-independent spectra on
+      the most recently used energy grid with the ARF. */
+  void* arfgrid;
+
+  /** Cache of spectral distributions on disk. */
+  void* speccache;
+
+  /** Priority queue of pre-computed photons used by
+      getSimputPhotonAnySource. */
+  void* phqueue;
+
   /** Instrument ARF. */
   struct ARF* arf;
 
+  /** Method to draw photon energies from the spectral distributions
+      (SIMPUT_SAMPLING_CDF or SIMPUT_SAMPLING_ALIAS). */
+  int specsampling;
+
+  /** Method to draw photon positions from the images
+      (SIMPUT_SAMPLING_CDF or SIMPUT_SAMPLING_ALIAS). */
+  int imgsampling;
+
+  /** Expected duration of the simulation [s]. Light curves generated
+      from PSDs are sized to cover this interval. If 0, the length is
+      determined from the frequency range of the PSD. */
+  double psdexposure;
+
+  /** Length of the segments [s], in which light curves are generated
+      from PSDs. If 0, each realization covers the whole exposure and
+      is replaced by an independent realization when the simulation
+      time exceeds it. */
+  double psdsegment;
+
+  /** Flags of the warnings about the length of the light curves
+      generated from PSDs, which have been issued already. The flags
+      of the catalog are used by its per-thread contexts. This value
+      should not be modified directly. */
+  int psdwarnings;
+
+  /** Maximum numbers of extensions kept in the internal buffers
+      indexed by the extension type (EXTTYPE_*). 0 means unlimited.
+      The values should be modified via setSimputCacheCapacity. */
+  long cachecap[EXTTYPE_PSD+1];
+
+  /** Maximum number of rows of a photon list, which is kept in memory
+      completely. The value should be modified via
+      setSimputPhListMaxMemRows. */
+  long phlistmaxmemrows;
+
+  /** Catalog, whose sources, spectra, images, and other shared
+      buffers are used by this per-thread context. NULL if this data
+      structure is not a context. This pointer should not be modified
+      directly. */
+  void* core;
+
+  /** Mutex protecting the buffers shared by the catalog and its
+      per-thread contexts. NULL as long as no context has been
+      created. This pointer should not be modified directly. */
+  void* mutex;
+
+  /** Random number stream of a per-thread context. */
+  void* rndstream;
+
+  /** Random number streams of the individual sources (see
+      setSimputSrcRndSeed). This pointer should not be modified
+      directly. */
+  void* srcrndstreams;
+
+  /** Table of the distinct references to extensions and of other
+      strings used by the sources of the catalog. Each of them is
+      stored only once and is assigned a unique identifier, which is
+      used as key for the internal buffers. The table is shared with
+      the per-thread contexts. */
+  void* refpool;
+
+  /** Manager of the common memory budget of the internal buffers.
+      This pointer should not be modified directly. */
+  void* cachemgr;
+
+  /** Photon lists kept in memory completely, whose columns are shared
+      by the photon lists of the catalog and its per-thread
+      contexts. This pointer should not be modified directly. */
+  void* phlistshared;
+
 } SimputCtlg;
 
 
+/** Statistics of the internal buffers of a catalog (see
+    getSimputCacheStats). */
+typedef struct {
+
+  /** Numbers of requests for extensions, which have been found in the
+      buffers or have not been found, respectively. */
+  long hits, misses;
+
+  /** Number of extensions released from the buffers. */
+  long evictions;
+
+  /** Number of extensions currently contained in the buffers. */
+  long nentries;
+
+  /** Approximate memory currently occupied by the extensions in the
+      buffers [bytes]. */
+  long nbytes;
+
+} SimputCacheStats;
+
+
 /** Mission-independent spectrum. */
 typedef struct {
 
@@ -186,6 +300,12 @@ typedef struct {
   /** Photon flux density [photons/cm**2/keV]. */
   float* fluxdensity;
 
+  /** Matrix of spectra loaded from the same extension, which the
+      energy grid and the flux densities are part of. NULL if the
+      spectrum holds its own arrays. This pointer should not be
+      modified directly. */
+  void* matrix;
+
   /** Unique case-sensitive designator for an individual spectrum. */
   char* name;
 
@@ -194,6 +314,11 @@ typedef struct {
       spectrum is already contained in the internal storage. */
   char* fileref;
 
+  /** Identifier of the file reference in the table of references of
+      the catalog (-1 if not assigned). It is used to find the spectrum
+      in the internal storage. */
+  long refid;
+
 } SimputMIdpSpec;
 
 
@@ -204,11 +329,24 @@ typedef struct {
       [photons]. */
   double* distribution;
 
+  /** Alias table for drawing from the distribution in constant time
+      (Walker's alias method). For each bin it contains the
+      probability to keep the bin and the index of the alternative
+      bin. The table is only set up, if the alias method is selected
+      for the catalog. */
+  double* aliasprob;
+  long* alias;
+
   /** Reference to the location of the spectrum given by the extended
       filename syntax. This reference is used to check, whether the
       spectrum is already contained in the internal storage. */
   char* fileref;
 
+  /** Identifier of the file reference in the table of references of
+      the catalog (-1 if not assigned). It is used to find the spectrum
+      in the internal storage. */
+  long refid;
+
 } SimputSpec;
 
 
@@ -221,6 +359,14 @@ typedef struct {
   /** Time values [s]. */
   double* time;
 
+  /** Step width of the time values [s], if they form a uniform grid,
+      otherwise 0. The grid is detected, when the light curve is
+      loaded, and allows to find the bin for a particular time
+      directly. Light curves generated from PSDs do not contain the
+      time array, but only the step width. In that case the time of
+      bin k is k*timestep. */
+  double timestep;
+
   /** Phase values (between 0 and 1). */
   double* phase;
 
@@ -273,6 +419,21 @@ typedef struct {
       storage. */
   char* fileref;
 
+  /** Identifier of the file reference in the table of references of
+      the catalog (-1 if not assigned). It is used to find the light curve
+      in the internal storage. */
+  long refid;
+
+  /** Table of the integrated flux used to draw photon times. It is
+      created on first use. This pointer should not be modified
+      directly. */
+  void* ratetable;
+
+  /** Table of the spectra referred to in the individual bins. It is
+      created on first use. This pointer should not be modified
+      directly. */
+  void* spectable;
+
 } SimputLC;
 
 
@@ -294,6 +455,11 @@ typedef struct {
       storage. */
   char* fileref;
 
+  /** Identifier of the file reference in the table of references of
+      the catalog (-1 if not assigned). It is used to find the PSD
+      in the internal storage. */
+  long refid;
+
 } SimputPSD;
 
 
@@ -306,6 +472,21 @@ typedef struct {
   /** Pixel value distribution function. */
   double** dist;
 
+  /** Pixel value distribution function in a contiguous buffer, i.e.,
+      dist[ii][jj] is stored at cdf[ii*naxis2+jj]. For images loaded
+      from a file, dist refers to this buffer. Otherwise it is set up
+      on first use for the generation of photons. */
+  double* cdf;
+
+  /** Distribution function of the x-coordinate, i.e., the value of
+      the distribution function at the last pixel of each column. */
+  double* cdfx;
+
+  /** Alias table over all pixels (index ii*naxis2+jj). The table is
+      only set up, if the alias method is selected for the catalog. */
+  double* aliasprob;
+  long* alias;
+
   /** WCS data used by wcslib. */
   struct wcsprm* wcs;
 
@@ -315,6 +496,11 @@ typedef struct {
       storage. */
   char* fileref;
 
+  /** Identifier of the file reference in the table of references of
+      the catalog (-1 if not assigned). It is used to find the image
+      in the internal storage. */
+  long refid;
+
 } SimputImg;
 
 
@@ -365,12 +551,56 @@ typedef struct {
       the photon list is taken into account. */
   long currrow;
 
+  /** In-memory copy of a block of rows of the photon list. The
+      values are already converted with the unit conversion
+      factors. The block starts at row buffrow (numbering starts at 1)
+      and contains nbuffrows rows. Photon lists with up to the number
+      of rows set by setSimputPhListMaxMemRows are kept in memory
+      completely. */
+  float* benergy;
+  double *bra, *bdec, *btime;
+  long buffrow, nbuffrows, maxbuffrows;
+
+  /** Flag whether the photon list is kept in memory completely (1),
+      read in blocks (0), or not decided yet (-1). */
+  int inmem;
+
+  /** Photon list of a shared catalog, which holds the in-memory
+      columns and the alias table used by this photon list. NULL if
+      the photon list holds its own arrays. This pointer should not be
+      modified directly. */
+  void* shared;
+
+  /** Alias table over the rows of the photon list with the instrument
+      ARF at the photon energies as weights. It is set up on first use
+      for photon lists kept in memory completely and allows to draw
+      random photons without rejections. */
+  double* aliasprob;
+  long* alias;
+
+  /** Flag whether the photon times are sorted in ascending order
+      (1), not sorted (0), or not checked yet (-1). */
+  int tsorted;
+
+  /** Sparse index of the photon times containing the time of every
+      SIMPUT_PHLIST_INDEXSTEP-th row starting at the first one. It is
+      set up for sorted photon lists, which are not kept in memory
+      completely, and allows to find the first photon after a
+      particular time by binary search. */
+  double* tindex;
+  long ntindex;
+
   /** Reference to the location of the photon list given by the
       extended filename syntax. This reference is used to check,
       whether the photon list is already contained in the internal
       storage. */
   char* fileref;
 
+  /** Identifier of the file reference in the table of references of
+      the catalog (-1 if not assigned). It is used to find the
+      photon list in the internal storage. */
+  long refid;
+
 } SimputPhList;
 
 /** Just a single SIMPUT photon.
@@ -471,6 +701,43 @@ SimputCtlg* openSimputCtlg(const char* const filename,
     SIMPUTCtlg. */
 long getSimputCtlgNSources(const SimputCtlg* const cat);
 
+/** Create a per-thread context for a SIMPUT catalog. The context can
+    be used instead of the catalog in the routines producing photons
+    (getSimputPhoton, getSimputPhotonBatch, getSimputPhotonAnySource,
+    ...). It shares the sources, spectra, images, and ARF-convolved
+    spectral distributions with the catalog, such that they are kept
+    in memory only once. The random numbers, the cursors in photon
+    lists, and the light curves generated from PSDs are specific for
+    the context. The random numbers are obtained from an independent
+    stream initialized with the specified seed instead of the
+    generator set by setSimputRndGen.
+
+    When the first context of a catalog is created, all sources are
+    loaded and their extensions are resolved. Afterwards the catalog
+    and each of its contexts may be used by a different thread. The
+    ARF, the sampling methods, and the PSD parameters have to be set
+    before and must not be modified afterwards. The contexts have to
+    be released with freeSimputCtlg before the catalog. */
+SimputCtlg* newSimputCtlgContext(SimputCtlg* const cat,
+				 const unsigned long seed,
+				 int* const status);
+
+/** Let each source draw its random numbers from an own stream, which
+    is derived from the specified seed and the SRC_ID of the
+    source. The photons of a source then only depend on the seed and
+    on the sequence of requests for this source, but neither on the
+    other sources nor on the order, in which the sources are
+    processed. Therefore the sources may be distributed among
+    per-thread contexts or separate processes without affecting the
+    results. The function applies to the specified catalog or context
+    only, i.e., it has to be called for each context. A source should
+    be processed in only one of the contexts, since all of them
+    produce the same photons for it. Calling the function again
+    restarts all streams. */
+void setSimputSrcRndSeed(SimputCtlg* const cat,
+			 const unsigned long seed,
+			 int* const status);
+
 
 /** Constructor for the SimputSrc data structure. Allocates memory,
     initializes elements with their default values and pointers with
@@ -517,15 +784,24 @@ SimputSrc* loadSimputSrc(SimputCtlg* const cat,
 			 const long row,
 			 int* const status);
 
+/** Load all sources of the catalog at once into an internal table,
+    reading the columns of the FITS table in blocks of rows. The
+    reference strings of the sources are stored only once for all
+    sources with the same reference. Afterwards the sources are
+    returned by getSimputSrc from this table. The returned sources
+    must not be released by the caller. */
+void loadCacheAllSimputSrc(SimputCtlg* const cat, int* const status);
+
 
 /** Return an entry from a SimputCtlg, which is contained in a
     particular row of the FITS table. According to the FITS
     conventions row numbering starts with 1 for the first line. When
     loading the SimputSrc for the first time, the data are stored
     in a static cache, such that they do not have to be loaded again
-    on later access. The returned pointer to the SimputSrc must
-    not be free'd, since the allocated memory is managed by the
-    caching mechanism. */
+    on later access. If all sources have been loaded with
+    loadCacheAllSimputSrc, they are returned from the source table
+    instead. The returned pointer to the SimputSrc must not be free'd,
+    since the allocated memory is managed by the caching mechanism. */
 SimputSrc* getSimputSrc(SimputCtlg* const cat,
 			const long row,
 			int* const status);
@@ -587,6 +863,14 @@ void loadCacheAllSimputMIdpSpec(SimputCtlg* const cat,
 				const char* const filename,
 				int* const status);
 
+/** Convolve all mission-independent spectra in the internal cache,
+    which have not been convolved yet, with the instrument ARF and
+    store the resulting spectral distributions in the internal
+    cache. Spectra defined on the same energy grid are processed
+    together. Distributions available from the cache on disk (see
+    setSimputSpecCache) are used without convolution. */
+void loadCacheAllSimputSpec(SimputCtlg* const cat, int* const status);
+
 /** Save the mission-independent spectrum in the specified extension
     of the given FITS file. If the file does not exist yet, a new file
     is created. If the file exists, but does not contain the specified
@@ -666,11 +950,180 @@ void loadSimputARF(SimputCtlg* const cat,
 		   char* const filename,
 		   int* const status);
 
+/** Select the method to draw photon energies from the spectral
+    distributions. SIMPUT_SAMPLING_CDF (default) performs a binary
+    search on the cumulative distribution. SIMPUT_SAMPLING_ALIAS uses
+    an alias table, which is set up once per spectrum and provides
+    each photon energy in constant time. */
+void setSimputSpecSampling(SimputCtlg* const cat,
+			   const int method,
+			   int* const status);
+
+/** Select the method to draw photon positions from source images.
+    SIMPUT_SAMPLING_CDF (default) performs a binary search on the
+    distribution function of the x-coordinate and on the distribution
+    function within the selected column. SIMPUT_SAMPLING_ALIAS uses an
+    alias table over all pixels, which is set up once per image and
+    provides each pixel in constant time at the expense of 16 bytes
+    of memory per pixel. */
+void setSimputImgSampling(SimputCtlg* const cat,
+			  const int method,
+			  int* const status);
+
+/** Specify the expected duration of the simulation [s]. Light curves
+    generated from PSDs according to the algorithm of Timmer & Koenig
+    (1995) are sized to cover this interval, but at least the inverse
+    of the lowest frequency in the PSD. If the exposure is 0 (default),
+    the length is determined from the frequency range of the PSD
+    only. If in addition the lowest frequency is not positive, each
+    realization has only the minimum length of 2048 bins of width
+    1/(2*fmax), i.e., covers 1024/fmax seconds, and a warning is
+    issued. Light curves are limited to 2^27 bins; longer intervals
+    require setSimputPSDSegment. */
+void setSimputPSDExposure(SimputCtlg* const cat,
+			  const double exposure,
+			  int* const status);
+
+/** Generate light curves from PSDs in segments of the specified length
+    [s]. As the simulation time advances beyond the end of a segment,
+    the next segment is produced and blended into the preceding one
+    over a short overlap interval, such that the light curve is
+    continuous and memory consumption does not grow with the
+    exposure. A length of 0 (default) disables the segmentation. */
+void setSimputPSDSegment(SimputCtlg* const cat,
+			 const double segment,
+			 int* const status);
+
+/** Specify a file for FFTW wisdom, which is used for the generation of
+    light curves from PSDs. The wisdom is imported from the file (if
+    it exists) before the first FFTW plan is created. New plans are
+    created with FFTW_MEASURE and the accumulated wisdom is exported
+    to the file, such that subsequent runs can skip the planning. By
+    default the file name is taken from the environment variable
+    SIMPUT_FFTW_WISDOM. If no file is specified, the plans are created
+    with FFTW_ESTIMATE. */
+void setSimputFFTWWisdom(SimputCtlg* const cat,
+			 const char* const filename,
+			 int* const status);
+
+/** Specify a directory, where the spectral distributions obtained
+    from the convolution of the mission-independent spectra with the
+    ARF are stored for subsequent runs. For each ARF a separate file
+    is created, whose name contains a hash of the ARF contents. A
+    stored distribution is only used if the modification time (with
+    nanosecond resolution), the size, and the inode number of the file
+    containing the mission-independent spectrum have not changed. The
+    files can be deleted at any time. By default the directory is
+    taken from the environment variable SIMPUT_SPEC_CACHE. If no
+    directory is specified, the spectra are not stored. */
+void setSimputSpecCache(SimputCtlg* const cat,
+			const char* const dirname,
+			int* const status);
+
+/** Specify the maximum number of extensions of the given type
+    (EXTTYPE_MIDPSPEC, EXTTYPE_IMAGE, EXTTYPE_PHLIST, EXTTYPE_LC, or
+    EXTTYPE_PSD), which are kept in the internal buffers of the
+    catalog. If the capacity is exhausted, the least recently used
+    extension is released. A capacity of 0 means unlimited. The
+    capacity for mission-independent spectra also applies to the
+    spectra convolved with the ARF, the capacity for PSDs to the light
+    curves generated from them. If such a light curve is released, a
+    new independent realization is generated for the source. By
+    default 1000 images, 100 photon lists, 100 PSDs, 1 light curve,
+    and an unlimited number of spectra are kept. Buffers shared with
+    per-thread contexts never release any extensions, except for
+    photon lists and light curves generated from PSDs. Pointers to
+    extensions obtained from the library might become invalid, when
+    the extension is released. */
+void setSimputCacheCapacity(SimputCtlg* const cat,
+			    const int exttype,
+			    const long capacity,
+			    int* const status);
+
+/** Specify the memory budget [bytes] shared by the internal buffers
+    of the catalog for spectra, images, photon lists, light curves,
+    and PSDs. If the budget is exceeded, the least recently used
+    extension among all buffers is released, while at least two
+    extensions of each type (one light curve) are kept. A budget of 0
+    means unlimited. By default the budget is taken from the
+    environment variable SIMPUT_CACHE_BUDGET, where the value may have
+    the suffix k, M, or G. The budget does not apply to the photon
+    lists and the light curves generated from PSDs of per-thread
+    contexts and to buffers shared with per-thread contexts, which
+    never release any extensions. */
+void setSimputCacheBudget(SimputCtlg* const cat,
+			  const long budget,
+			  int* const status);
+
+/** Specify the maximum number of rows of a photon list, which is
+    loaded into memory completely in order to draw random photons
+    without accessing the file. Larger photon lists are read in
+    blocks. The memory for the columns is subject to the budget set
+    by setSimputCacheBudget. If it does not fit, the photon list is
+    read in blocks as well. In a shared catalog, the columns are
+    loaded only once for the catalog and all its per-thread
+    contexts. By default 20000000 rows are allowed, unless a
+    different value is specified by the environment variable
+    SIMPUT_PHLIST_MAXMEMROWS. The value has to be set before any
+    photon list is used and before the first per-thread context is
+    created. */
+void setSimputPhListMaxMemRows(SimputCtlg* const cat,
+			       const long nrows,
+			       int* const status);
+
+/** Obtain the statistics of the internal buffers of the catalog for
+    the specified extension type (see setSimputCacheCapacity). For
+    EXTTYPE_MIDPSPEC the buffers of the mission-independent spectra
+    and of the spectra convolved with the ARF are summed up. For
+    EXTTYPE_NONE the statistics of all buffers are summed up. */
+void getSimputCacheStats(SimputCtlg* const cat,
+			 const int exttype,
+			 SimputCacheStats* const stats,
+			 int* const status);
+
+/** Generate the light curves of all sources in the catalog, which
+    refer to a PSD as timing extension, and store them in the internal
+    cache. The light curves start at the time tstart [s] and are
+    generated in parallel by the specified number of threads. If there
+    are less sources than threads, the individual Fourier transforms
+    are parallelized as well. Instead of the random number generator
+    of the library, each light curve uses an independent random number
+    stream determined by the seed and the SRC_ID of the source, such
+    that the result is reproducible for a given seed irrespective of
+    the number of threads. The light curves are subject to the
+    capacity for PSDs and to the memory budget of the catalog (see
+    setSimputCacheCapacity). */
+void loadCacheAllSimputPSDLC(SimputCtlg* const cat,
+			     const double tstart,
+			     const double mjdref,
+			     const unsigned long seed,
+			     const int nthreads,
+			     int* const status);
+
 /** Set the random number generator, which is used by the simput
     library routines. The generator should return double valued,
-    uniformly distributed numbers in the interval [0,1). */
+    uniformly distributed numbers in the interval [0,1). Per-thread
+    contexts of a catalog use their own random number streams
+    instead. */
 void setSimputRndGen(double(*rndgen)(int* const));
 
+/** Set a generator, which fills an array with the specified number
+    of uniformly distributed random numbers in the interval [0,1). It
+    is used by the library routines requiring many random numbers at
+    once. If no generator for individual numbers is set, these are
+    also taken from the blocks. Otherwise both generators have to draw
+    from the same sequence. As setSimputRndGen resets the block
+    generator, it has to be called first. */
+void setSimputRndGenBlock(void(*rndgenblock)(double* const,
+					     const long,
+					     int* const));
+
+/** Use the built-in xoshiro256++ generator initialized with the
+    specified seed for individual random numbers as well as for
+    blocks of them. In contrast to the default C rand() generator the
+    results are reproducible. */
+void setSimputRndSeed(const unsigned long seed);
+
 /** Return the photon rate of a particular source. The return value is
     the nominal photon rate for the whole spectrum according to the
     reference flux given in the source catalog. WARNING: It does not
@@ -830,6 +1283,30 @@ int getSimputPhoton(SimputCtlg* const cat,
 		    double* const dec,
 		    int* const status);
 
+/** Produce a sequence of up to nphotons photons for a particular
+    source and store them in the caller-provided arrays. The result is
+    the same as for repeated calls of getSimputPhoton, where each call
+    uses the time of the previous photon as prevtime. However, the
+    references to the spectrum, image, and timing extensions of the
+    source are only resolved once for the whole batch. The return
+    value of the function is the number of produced photons. It is
+    less than nphotons, if there is no further light curve
+    information available. */
+long getSimputPhotonBatch(SimputCtlg* const cat,
+			  SimputSrc* const src,
+			  double prevtime,
+			  const double mjdref,
+			  const long nphotons,
+			  /** [s]. */
+			  double* const time,
+			  /** [keV]. */
+			  float* const energy,
+			  /** [rad]. */
+			  double* const ra,
+			  /** [rad]. */
+			  double* const dec,
+			  int* const status);
+
 /** Initialize an array and pre-compute photons for
     getSimputPhotonAnySource. */
 SimputPhoton* startSimputPhotonAnySource(SimputCtlg* const cat,
@@ -0,0 +1,710 @@
+/*
+   This file is part of SIMPUT.
+
+   SIMPUT is free software: you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   any later version.
+
+   SIMPUT is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+   GNU General Public License for more details.
+
+   For a copy of the GNU General Public License see
+   <http://www.gnu.org/licenses/>.
+
+
+   Copyright 2015-2019 Remeis-Sternwarte, Friedrich-Alexander-Universitaet
+                       Erlangen-Nuernberg
+*/
+
+/* Comparison of optimized library routines with straightforward
+   reference implementations, which correspond to the original
+   algorithms of the library:
+
+   1. Photon times drawn from light curves via the table of the
+      integrated flux are compared with the bin by bin algorithm of
+      Klein & Roberts for non-periodic, periodic, and periodic light
+      curves with DPERIOD. Both use the same random numbers. For each
+      photon the reference starts at the previous photon time of the
+      library, such that deviations do not accumulate.
+
+   2. The spectral distributions obtained from the convolution of
+      mission-independent spectra with the ARF on a shared energy
+      grid are compared bit by bit with the original convolution
+      routine. The distributions of the library are taken from the
+      spectrum cache on disk (see setSimputSpecCache).
+
+   The program creates the files test_reference.simput and
+   test_reference_cache/ in the current directory. The return value
+   is EXIT_FAILURE, if any deviation exceeds the tolerance. */
+
+#include <dirent.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "simput.h"
+
+#define MAXSTR (1024)
+
+#define CATALOG "test_reference.simput"
+#define CACHEDIR "test_reference_cache"
+
+/** Number of bins of the non-periodic light curve (1s each). */
+#define NLCBINS (20000)
+/** Number of phase bins of the periodic light curves. */
+#define NPHASEBINS (200)
+/** Number of spectra in the multi-spectrum extension. */
+#define NSPECS (150)
+/** Number of ARF bins. */
+#define NARFBINS (1000)
+
+/** Maximum number of photons drawn per source. */
+#define MAXPHOTONS (20000)
+/** Tolerated deviation of the photon times relative to the interval
+    since the previous photon. */
+#define TIMETOLERANCE (1.e-6)
+
+#define CHECK_STATUS_BREAK(a) if (EXIT_SUCCESS!=a) break
+
+#define CHECK_NULL_BREAK(a,status,msg) \
+  if (NULL==a) { \
+    printf(msg); \
+    status=EXIT_FAILURE; \
+    break;\
+  }
+
+
+/////////////////////////////////////////////////////////////////
+// Random numbers.
+/////////////////////////////////////////////////////////////////
+
+
+/** State of the generator, number of random numbers drawn so far,
+    and the most recent one. */
+static uint64_t rndstate=UINT64_C(0x853c49e6748fea9b);
+static long rndcount=0;
+static double rndlast=0.;
+
+
+/** Uniformly distributed random numbers in [0,1) (xorshift64*). The
+    most recent number is kept, such that the reference
+    implementation can use the same one as the library. */
+static double testRndGen(int* const status)
+{
+  (void)status;
+  rndstate^=rndstate>>12;
+  rndstate^=rndstate<<25;
+  rndstate^=rndstate>>27;
+  rndlast=(double)((rndstate*UINT64_C(2685821657736338717))>>11)*0x1.0p-53;
+  rndcount++;
+  return(rndlast);
+}
+
+
+/////////////////////////////////////////////////////////////////
+// Reference implementation of the photon times.
+/////////////////////////////////////////////////////////////////
+
+
+static double refLCTime(const SimputLC* const lc,
+			const long kk,
+			const long long nperiods,
+			const double mjdref)
+{
+  if (NULL==lc->phase) {
+    // Non-periodic light curve.
+    double time=(NULL!=lc->time) ? lc->time[kk] : kk*lc->timestep;
+    return(time+lc->timezero+(lc->mjdref-mjdref)*24.*3600.);
+  } else {
+    // Periodic light curve.
+    long double phase=lc->phase[kk]-lc->phase0+nperiods;
+    if (fabs(lc->dperiod)<1.e-20) {
+      return(phase*lc->period);
+    } else {
+      return((double)((expm1l(phase*lc->dperiod))*lc->period/lc->dperiod
+		      +lc->timezero+(lc->mjdref-mjdref)*24.*3600.));
+    }
+  }
+}
+
+
+static double refRefTime0(const SimputLC* const lc)
+{
+  if (lc->phase[0]==0.0) {
+    return(0.);
+  } else {
+    return((1+lc->phase[0])*lc->period);
+  }
+}
+
+
+/** Determine the bin of the light curve containing the specified
+    time by a binary search. The return value is -1, if the time is
+    not covered. */
+static long refLCBin(const SimputLC* const lc,
+		     const double time,
+		     const double mjdref,
+		     long long* nperiods)
+{
+  if (NULL==lc->phase) {
+    *nperiods=0;
+    if ((time<refLCTime(lc, 0, 0, mjdref)) ||
+	(time>=refLCTime(lc, lc->nentries-1, 0, mjdref))) {
+      return(-1);
+    }
+  } else {
+    double dt=time-(refLCTime(lc, 0, 0, mjdref)+refRefTime0(lc));
+    double phase;
+    if (fabs(lc->dperiod)<1.e-20) {
+      phase=lc->phase0+dt/lc->period;
+    } else {
+      phase=lc->phase0+log(1.+dt*lc->dperiod/lc->period)/lc->dperiod;
+    }
+    *nperiods=(long long)phase;
+    while (refLCTime(lc, 0, (*nperiods)+1, mjdref)+refRefTime0(lc) <= time) {
+      (*nperiods)++;
+    }
+    while (refLCTime(lc, 0, *nperiods, mjdref)+refRefTime0(lc) > time) {
+      (*nperiods)--;
+    }
+  }
+
+  long lower=0, upper=lc->nentries-2, mid;
+  while (upper>lower) {
+    mid=(lower+upper)/2;
+    if (refLCTime(lc, mid+1, *nperiods, mjdref) < time) {
+      lower=mid+1;
+    } else {
+      upper=mid;
+    }
+  }
+  return(lower);
+}
+
+
+/** Determine the time of the next photon from the light curve with
+    the algorithm of Klein & Roberts, passing the light curve bin by
+    bin. The return value is 1, if the end of the light curve is
+    reached. */
+static int refPhotonTime(const SimputLC* const lc,
+			 const float avgrate,
+			 double u,
+			 double prevtime,
+			 const double mjdref,
+			 double* const nexttime)
+{
+  long long nperiods=0;
+  long kk=refLCBin(lc, prevtime, mjdref, &nperiods);
+  if (kk<0) {
+    return(1);
+  }
+
+  while (kk<lc->nentries-1) {
+    double tk=refLCTime(lc, kk, nperiods, mjdref);
+    double t =prevtime-tk;
+    double stepwidth=refLCTime(lc, kk+1, nperiods, mjdref)-tk;
+    double ak=(lc->flux[kk+1]-lc->flux[kk])/lc->fluxscal/stepwidth;
+    double bk=lc->flux[kk]/lc->fluxscal;
+
+    double uk=1.-exp((-ak/2.*(pow(stepwidth,2.)-pow(t,2.))
+		      -bk*(stepwidth-t))*avgrate);
+
+    if (u<=uk) {
+      if (fabs(ak*stepwidth)>fabs(bk*1.e-6)) {
+	*nexttime=tk+
+	  (-bk+sqrt(pow(bk,2.)+pow(ak*t,2.)+2.*ak*t*bk-2.*ak*log(1.-u)/avgrate))/ak;
+      } else {
+	*nexttime=prevtime-log(1.-u)/(avgrate*bk);
+      }
+      return(0);
+    }
+
+    u=(u-uk)/(1-uk);
+    kk++;
+    if ((kk>=lc->nentries-1)&&(NULL!=lc->phase)) {
+      kk=0;
+      nperiods++;
+    }
+    prevtime=refLCTime(lc, kk, nperiods, mjdref);
+  }
+
+  return(1);
+}
+
+
+/////////////////////////////////////////////////////////////////
+// Reference implementation of the ARF convolution.
+/////////////////////////////////////////////////////////////////
+
+
+static void refMIdpSpecEbounds(const SimputMIdpSpec* const spec,
+			       const long idx,
+			       float* const emin,
+			       float* const emax)
+{
+  if (idx>0) {
+    *emin=0.5*(spec->energy[idx]+spec->energy[idx-1]);
+  } else {
+    *emin=spec->energy[idx];
+  }
+  if (idx<spec->nentries-1) {
+    *emax=0.5*(spec->energy[idx+1]+spec->energy[idx]);
+  } else {
+    *emax=spec->energy[idx];
+  }
+}
+
+
+/** Convolve the mission-independent spectrum with the ARF stepping
+    through the ARF bins and the spectral points. The result is the
+    cumulative distribution. */
+static void refConvolve(const SimputMIdpSpec* const midpspec,
+			const long nbins,
+			const float* const lowenergy,
+			const float* const highenergy,
+			const float* const effarea,
+			double* const distribution)
+{
+  long ii, jj=0;
+  for (ii=0; ii<nbins; ii++) {
+    distribution[ii]=0.;
+    float lo=lowenergy[ii];
+
+    int finished=0;
+    do {
+      float spec_emin=0., spec_emax=0.;
+      for ( ; jj<midpspec->nentries; jj++) {
+	refMIdpSpecEbounds(midpspec, jj, &spec_emin, &spec_emax);
+	if (spec_emax>lo) break;
+      }
+
+      if ((0==jj) && (spec_emin>lowenergy[ii])) {
+	if (spec_emin>highenergy[ii]) break;
+      } else if (jj==midpspec->nentries) {
+	break;
+      }
+
+      float hi;
+      if (spec_emax<=highenergy[ii]) {
+	hi=spec_emax;
+      } else {
+	hi=highenergy[ii];
+	finished=1;
+      }
+
+      distribution[ii]+=(hi-lo)*effarea[ii]*midpspec->fluxdensity[jj];
+      lo=hi;
+
+    } while (0==finished);
+
+    if (ii>0) {
+      distribution[ii]+=distribution[ii-1];
+    }
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////
+// Test data.
+/////////////////////////////////////////////////////////////////
+
+
+/** Create a mission-independent spectrum on a logarithmic grid. */
+static SimputMIdpSpec* createSpec(const char* const name,
+				  const long nentries,
+				  const float emin,
+				  const float emax,
+				  const float index,
+				  const float lineenergy,
+				  int* const status)
+{
+  SimputMIdpSpec* spec=newSimputMIdpSpec(status);
+  if (EXIT_SUCCESS!=*status) return(spec);
+  spec->nentries=nentries;
+  spec->energy=(float*)malloc(nentries*sizeof(float));
+  spec->fluxdensity=(float*)malloc(nentries*sizeof(float));
+  spec->name=(char*)malloc((strlen(name)+1)*sizeof(char));
+  if ((NULL==spec->energy) || (NULL==spec->fluxdensity) ||
+      (NULL==spec->name)) {
+    printf("Error: memory allocation for spectrum failed\n");
+    *status=EXIT_FAILURE;
+    return(spec);
+  }
+  strcpy(spec->name, name);
+  long ii;
+  for (ii=0; ii<nentries; ii++) {
+    spec->energy[ii]=emin*pow(emax/emin, ii/(double)(nentries-1));
+    spec->fluxdensity[ii]=pow(spec->energy[ii], -index)+
+      exp(-pow((spec->energy[ii]-lineenergy)/0.1, 2.));
+  }
+  return(spec);
+}
+
+
+/** Create a light curve with linearly interpolated, non-negative
+    flux values including an interval of zero flux. */
+static SimputLC* createLC(const long nentries,
+			  const int periodic,
+			  const double dperiod,
+			  int* const status)
+{
+  SimputLC* lc=newSimputLC(status);
+  if (EXIT_SUCCESS!=*status) return(lc);
+  lc->nentries=nentries;
+  lc->flux=(float*)malloc(nentries*sizeof(float));
+  if (0==periodic) {
+    lc->time=(double*)malloc(nentries*sizeof(double));
+  } else {
+    lc->phase=(double*)malloc(nentries*sizeof(double));
+  }
+  if ((NULL==lc->flux) || ((NULL==lc->time) && (NULL==lc->phase))) {
+    printf("Error: memory allocation for light curve failed\n");
+    *status=EXIT_FAILURE;
+    return(lc);
+  }
+  long ii;
+  for (ii=0; ii<nentries; ii++) {
+    double x=ii/(double)(nentries-1);
+    if (0==periodic) {
+      lc->time[ii]=(double)ii;
+    } else {
+      lc->phase[ii]=x;
+    }
+    lc->flux[ii]=(float)(1.+0.6*sin(2.*M_PI*7.*x)+0.39*sin(2.*M_PI*131.*x));
+    if ((x>0.3) && (x<0.35)) {
+      lc->flux[ii]=0.;
+    }
+  }
+  lc->mjdref  =55000.;
+  lc->timezero=0.;
+  lc->fluxscal=1.;
+  if (0!=periodic) {
+    lc->phase0 =0.;
+    lc->period =10.;
+    lc->dperiod=dperiod;
+  }
+  return(lc);
+}
+
+
+/** Remove the files created by a previous run. */
+static void cleanUp(void)
+{
+  remove(CATALOG);
+  DIR* dir=opendir(CACHEDIR);
+  if (NULL!=dir) {
+    struct dirent* entry;
+    while (NULL!=(entry=readdir(dir))) {
+      if ('.'==entry->d_name[0]) continue;
+      char path[MAXSTR];
+      snprintf(path, MAXSTR, "%s/%s", CACHEDIR, entry->d_name);
+      remove(path);
+    }
+    closedir(dir);
+  }
+}
+
+
+/** Compare the distributions stored in the spectrum cache on disk
+    with the reference convolution. The file format is described at
+    struct SimputSpecDiskCache. The return value is the number of
+    compared distributions, or -1 on a mismatch. */
+static long compareSpecCache(const long nbins,
+			     const float* const lowenergy,
+			     const float* const highenergy,
+			     const float* const effarea,
+			     int* const status)
+{
+  long ncompared=0, nfailed=0;
+  double* refdist=(double*)malloc(nbins*sizeof(double));
+  if (NULL==refdist) {
+    printf("Error: memory allocation failed\n");
+    *status=EXIT_FAILURE;
+    return(0);
+  }
+
+  DIR* dir=opendir(CACHEDIR);
+  if (NULL==dir) {
+    printf("Error: could not open directory '%s'\n", CACHEDIR);
+    *status=EXIT_FAILURE;
+    free(refdist);
+    return(0);
+  }
+  struct dirent* entry;
+  while ((NULL!=(entry=readdir(dir))) && (EXIT_SUCCESS==*status)) {
+    if ('.'==entry->d_name[0]) continue;
+    char path[MAXSTR];
+    snprintf(path, MAXSTR, "%s/%s", CACHEDIR, entry->d_name);
+    FILE* fp=fopen(path, "rb");
+    if (NULL==fp) continue;
+
+    // Skip the header (magic string, ARF hash, number of bins).
+    char header[24];
+    if (1!=fread(header, sizeof(header), 1, fp)) {
+      fclose(fp);
+      continue;
+    }
+
+    // Records: length, modification time (s, ns), size, inode, length
+    // of the file reference, file reference aligned to 8 bytes, and
+    // the distribution.
+    int64_t rec[6];
+    while (1==fread(rec, sizeof(rec), 1, fp)) {
+      int64_t reflen=rec[5];
+      int64_t alignedlen=(reflen+7)&~(int64_t)7;
+      char* fileref=(char*)malloc(alignedlen);
+      double* dist=(double*)malloc(nbins*sizeof(double));
+      if ((NULL==fileref) || (NULL==dist) ||
+	  (1!=fread(fileref, alignedlen, 1, fp)) ||
+	  (1!=fread(dist, nbins*sizeof(double), 1, fp))) {
+	if (NULL!=fileref) free(fileref);
+	if (NULL!=dist) free(dist);
+	break;
+      }
+
+      SimputMIdpSpec* midpspec=loadSimputMIdpSpec(fileref, status);
+      if (EXIT_SUCCESS==*status) {
+	refConvolve(midpspec, nbins, lowenergy, highenergy, effarea, refdist);
+	if (0!=memcmp(refdist, dist, nbins*sizeof(double))) {
+	  long ii;
+	  for (ii=0; ii<nbins; ii++) {
+	    if (refdist[ii]!=dist[ii]) break;
+	  }
+	  printf("  spectrum '%s' differs in bin %ld: %.17e instead of %.17e\n",
+		 fileref, ii, dist[ii], refdist[ii]);
+	  nfailed++;
+	}
+	ncompared++;
+      }
+      freeSimputMIdpSpec(&midpspec);
+      free(fileref);
+      free(dist);
+      if (EXIT_SUCCESS!=*status) break;
+    }
+    fclose(fp);
+  }
+  closedir(dir);
+  free(refdist);
+
+  return((nfailed>0) ? -1 : ncompared);
+}
+
+
+int main(int argc, char **argv)
+{
+  (void)argc;
+  (void)argv;
+
+  SimputCtlg* cat=NULL;
+  SimputMIdpSpec* spec=NULL;
+  SimputMIdpSpec** specs=NULL;
+  SimputLC* lcs[3]={NULL, NULL, NULL};
+  float lowenergy[NARFBINS], highenergy[NARFBINS], effarea[NARFBINS];
+  int failed=0;
+  long ii;
+
+  int status=EXIT_SUCCESS;
+
+  do { // Error handling loop.
+
+    cleanUp();
+    mkdir(CACHEDIR, 0755);
+
+    // Light curves: non-periodic, periodic, and periodic with DPERIOD.
+    const char* lcnames[3]={ "LC_TIME", "LC_PHASE", "LC_DPERIOD" };
+    for (ii=0; ii<3; ii++) {
+      SimputLC* lc=createLC((0==ii) ? NLCBINS : NPHASEBINS+1, (ii>0),
+			    (2==ii) ? 1.e-4 : 0., &status);
+      if (EXIT_SUCCESS==status) {
+	saveSimputLC(lc, CATALOG, (char*)lcnames[ii], 1, &status);
+      }
+      freeSimputLC(&lc);
+      CHECK_STATUS_BREAK(status);
+    }
+    CHECK_STATUS_BREAK(status);
+
+    // Spectrum of the sources used for the photon times, which does
+    // not cover the whole ARF.
+    spec=createSpec("powerlaw", 700, 0.5, 10., 2., 6.4, &status);
+    CHECK_STATUS_BREAK(status);
+    saveSimputMIdpSpec(spec, CATALOG, "SPECTRUM", 1, &status);
+    CHECK_STATUS_BREAK(status);
+    freeSimputMIdpSpec(&spec);
+
+    // Spectra on a common energy grid, which are convolved in blocks.
+    specs=(SimputMIdpSpec**)calloc(NSPECS, sizeof(SimputMIdpSpec*));
+    CHECK_NULL_BREAK(specs, status, "Error: memory allocation failed\n");
+    for (ii=0; ii<NSPECS; ii++) {
+      char name[32];
+      sprintf(name, "spec%03ld", ii);
+      specs[ii]=createSpec(name, 1500, 0.1, 20., 1.+ii*0.01, 1.+ii*0.05,
+			   &status);
+      CHECK_STATUS_BREAK(status);
+    }
+    CHECK_STATUS_BREAK(status);
+    saveSimputMIdpSpecBlock(specs, NSPECS, CATALOG, "MULTISPEC", 1, &status);
+    CHECK_STATUS_BREAK(status);
+
+    // Source catalog with a bright, an intermediate, and a faint
+    // source for each light curve.
+    cat=openSimputCtlg(CATALOG, READWRITE, 32, 64, 32, 32, &status);
+    CHECK_STATUS_BREAK(status);
+    const float fluxes[3]={ 1.e-10, 1.e-12, 1.e-13 };
+    for (ii=0; ii<9; ii++) {
+      char timing[32];
+      sprintf(timing, "[%s,1]", lcnames[ii/3]);
+      SimputSrc* src=newSimputSrcV(ii+1, "", 0., 0., 0., 1., 2., 10.,
+				   fluxes[ii%3], "[SPECTRUM,1][NAME=='powerlaw']",
+				   "", timing, &status);
+      CHECK_STATUS_BREAK(status);
+      appendSimputSrc(cat, src, &status);
+      freeSimputSrc(&src);
+      CHECK_STATUS_BREAK(status);
+    }
+    CHECK_STATUS_BREAK(status);
+    freeSimputCtlg(&cat, &status);
+    CHECK_STATUS_BREAK(status);
+
+    // Open the catalog for the simulation.
+    cat=openSimputCtlg(CATALOG, READONLY, 0, 0, 0, 0, &status);
+    CHECK_STATUS_BREAK(status);
+
+    // ARF on a logarithmic grid.
+    for (ii=0; ii<NARFBINS; ii++) {
+      lowenergy[ii] =0.3*pow(12./0.3, ii/(double)NARFBINS);
+      highenergy[ii]=0.3*pow(12./0.3, (ii+1)/(double)NARFBINS);
+      effarea[ii]   =100.*(1.+0.5*sin(lowenergy[ii]));
+    }
+    setSimputARFfromarrays(cat, NARFBINS, lowenergy, highenergy, effarea,
+			   "TEST", &status);
+    CHECK_STATUS_BREAK(status);
+    setSimputSpecCache(cat, CACHEDIR, &status);
+    CHECK_STATUS_BREAK(status);
+    setSimputRndGen(testRndGen);
+
+    // Convolve the spectra on the common grid in blocks.
+    char multispec[MAXSTR];
+    sprintf(multispec, "%s[MULTISPEC,1]", CATALOG);
+    loadCacheAllSimputMIdpSpec(cat, multispec, &status);
+    CHECK_STATUS_BREAK(status);
+    loadCacheAllSimputSpec(cat, &status);
+    CHECK_STATUS_BREAK(status);
+
+    // Light curves for the reference implementation.
+    for (ii=0; ii<3; ii++) {
+      char filename[MAXSTR];
+      sprintf(filename, "%s[%s,1]", CATALOG, lcnames[ii]);
+      lcs[ii]=loadSimputLC(filename, &status);
+      CHECK_STATUS_BREAK(status);
+    }
+    CHECK_STATUS_BREAK(status);
+
+    // 1. Photon times.
+    printf("### 1 ### photon times from light curves\n");
+    const double mjdref=55000.;
+    for (ii=0; ii<9; ii++) {
+      SimputSrc* src=getSimputSrc(cat, ii+1, &status);
+      CHECK_STATUS_BREAK(status);
+      const SimputLC* lc=lcs[ii/3];
+
+      double prevtime=0., maxdev=0.;
+      long nphotons=0, nfailed=0;
+      while (nphotons<MAXPHOTONS) {
+	float avgrate=getSimputPhotonRate(cat, src, prevtime, mjdref, &status);
+	CHECK_STATUS_BREAK(status);
+
+	long count=rndcount;
+	double time=0.;
+	int end=getSimputPhotonTime(cat, src, prevtime, mjdref, &time, &status);
+	CHECK_STATUS_BREAK(status);
+	if (rndcount!=count+1) {
+	  printf("Error: %ld random numbers used for one photon time\n",
+		 rndcount-count);
+	  status=EXIT_FAILURE;
+	  break;
+	}
+
+	double reftime=0.;
+	int refend=refPhotonTime(lc, avgrate, rndlast, prevtime, mjdref,
+				 &reftime);
+	if (end!=refend) {
+	  printf("  source %ld: end of light curve %s after %ld photons\n",
+		 ii+1, (0!=end) ? "reached too early" : "not detected",
+		 nphotons);
+	  nfailed++;
+	  break;
+	}
+	if (0!=end) break;
+
+	double dev=fabs(time-reftime)/(reftime-prevtime);
+	if (dev>maxdev) maxdev=dev;
+	if (dev>TIMETOLERANCE) {
+	  if (nfailed<5) {
+	    printf("  source %ld, photon %ld: %.15e instead of %.15e "
+		   "(previous %.15e)\n", ii+1, nphotons, time, reftime,
+		   prevtime);
+	  }
+	  nfailed++;
+	}
+	prevtime=time;
+	nphotons++;
+      }
+      CHECK_STATUS_BREAK(status);
+      printf("  %-10s flux %.0e: %5ld photons, maximum relative "
+	     "deviation %.2e%s\n", lcnames[ii/3], fluxes[ii%3], nphotons,
+	     maxdev, (nfailed>0) ? "  FAILED" : "");
+      if (nfailed>0) failed=1;
+    }
+    CHECK_STATUS_BREAK(status);
+
+    // The spectrum of the sources has been convolved individually
+    // for the photon rate.
+    freeSimputCtlg(&cat, &status);
+    CHECK_STATUS_BREAK(status);
+
+    // 2. Spectral distributions.
+    printf("### 2 ### spectral distributions convolved with the ARF\n");
+    long ncompared=compareSpecCache(NARFBINS, lowenergy, highenergy, effarea,
+				    &status);
+    CHECK_STATUS_BREAK(status);
+    if (ncompared<0) {
+      printf("  distributions differ  FAILED\n");
+      failed=1;
+    } else if (ncompared<NSPECS+1) {
+      printf("  only %ld of %d distributions found in the cache  FAILED\n",
+	     ncompared, NSPECS+1);
+      failed=1;
+    } else {
+      printf("  %ld distributions bit-identical\n", ncompared);
+    }
+
+  } while(0); // END of error handling loop.
+
+  // Release memory.
+  for (ii=0; ii<3; ii++) {
+    freeSimputLC(&lcs[ii]);
+  }
+  if (NULL!=specs) {
+    for (ii=0; ii<NSPECS; ii++) {
+      freeSimputMIdpSpec(&specs[ii]);
+    }
+    free(specs);
+  }
+  freeSimputMIdpSpec(&spec);
+  freeSimputCtlg(&cat, &status);
+
+  if ((EXIT_SUCCESS==status) && (0==failed)) {
+    printf("### all comparisons passed ###\n");
+    return(EXIT_SUCCESS);
+  } else {
+    printf("### comparison FAILED ###\n");
+    return(EXIT_FAILURE);
+  }
+}